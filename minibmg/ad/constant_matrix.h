@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace beanmachine::minibmg {
+
+// A matrix of constants (typically data) by which a vector may be multiplied.
+// Its values are stored in row-major order.  A matrix is held by a (shared)
+// pointer so that nodes and values using it, such as the product by its
+// transpose used in differentiating a product, do not copy it.
+class ConstantMatrix {
+ public:
+  ConstantMatrix(unsigned rows, unsigned cols, std::vector<double> values)
+      : rows{rows}, cols{cols}, values{std::move(values)} {
+    if (this->values.size() != (std::size_t)rows * cols) {
+      throw std::invalid_argument("matrix has the wrong number of values");
+    }
+  }
+  const unsigned rows;
+  const unsigned cols;
+  const std::vector<double> values;
+};
+
+using ConstantMatrixp = std::shared_ptr<const ConstantMatrix>;
+
+} // namespace beanmachine::minibmg
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <stdexcept>
+#include <vector>
+#include "beanmachine/minibmg/ad/constant_matrix.h"
+#include "beanmachine/minibmg/ad/number.h"
+#include "beanmachine/minibmg/ad/real.h"
+
+namespace beanmachine::minibmg {
+
+/*
+ * Vectors of numbers, used to evaluate vector nodes.  For each Number type N,
+ * VectorOf<N> is the type of a vector of N.  Every vector type provides
+ *
+ *     a constructor from a std::vector<double> of constants,
+ *     V::broadcast(N x, unsigned size),
+ *     v.size(),
+ *     elementwise +, -, and *, and unary -,
+ *     matmul(ConstantMatrixp m, V x, bool transposed),
+ *     sum(V x) and dot(V x, V y), both returning N.
+ *
+ * The default is ElementwiseVector, which simply holds one N per element.
+ * Types for which that would be wasteful specialize NumberVector: a vector of
+ * Real is an Eigen vector, a vector of Traced is a single vector node, and a
+ * vector of Reverse values records each vector operation on the tape once.
+ */
+template <class N>
+requires Number<N>
+class ElementwiseVector {
+ public:
+  std::vector<N> elements;
+
+  ElementwiseVector() {}
+  explicit ElementwiseVector(std::vector<N> elements)
+      : elements{std::move(elements)} {}
+  /* implicit */ ElementwiseVector(const std::vector<double>& values)
+      : elements{values.begin(), values.end()} {}
+
+  static ElementwiseVector broadcast(const N& x, unsigned size) {
+    return ElementwiseVector{std::vector<N>(size, x)};
+  }
+
+  unsigned size() const {
+    return elements.size();
+  }
+};
+
+template <class N>
+requires Number<N>
+struct NumberVector {
+  using type = ElementwiseVector<N>;
+};
+
+template <class N>
+requires Number<N>
+using VectorOf = typename NumberVector<N>::type;
+
+// Apply a binary operation to corresponding elements of two vectors.
+template <class N, class Op>
+requires Number<N> ElementwiseVector<N> elementwise(
+    const ElementwiseVector<N>& left,
+    const ElementwiseVector<N>& right,
+    Op op) {
+  if (left.size() != right.size()) {
+    throw std::invalid_argument("vector sizes do not match");
+  }
+  std::vector<N> result;
+  result.reserve(left.size());
+  for (unsigned i = 0, n = left.size(); i < n; i++) {
+    result.push_back(op(left.elements[i], right.elements[i]));
+  }
+  return ElementwiseVector<N>{std::move(result)};
+}
+
+template <class N>
+requires Number<N> ElementwiseVector<N> operator+(
+    const ElementwiseVector<N>& left,
+    const ElementwiseVector<N>& right) {
+  return elementwise(
+      left, right, [](const N& l, const N& r) -> N { return l + r; });
+}
+
+template <class N>
+requires Number<N> ElementwiseVector<N> operator-(
+    const ElementwiseVector<N>& left,
+    const ElementwiseVector<N>& right) {
+  return elementwise(
+      left, right, [](const N& l, const N& r) -> N { return l - r; });
+}
+
+template <class N>
+requires Number<N> ElementwiseVector<N> operator*(
+    const ElementwiseVector<N>& left,
+    const ElementwiseVector<N>& right) {
+  return elementwise(
+      left, right, [](const N& l, const N& r) -> N { return l * r; });
+}
+
+template <class N>
+requires Number<N> ElementwiseVector<N> operator-(
+    const ElementwiseVector<N>& x) {
+  std::vector<N> result;
+  result.reserve(x.size());
+  for (const auto& e : x.elements) {
+    result.push_back(-e);
+  }
+  return ElementwiseVector<N>{std::move(result)};
+}
+
+template <class N>
+requires Number<N> N sum(const ElementwiseVector<N>& x) {
+  if (x.size() == 0) {
+    return 0;
+  }
+  N result = x.elements[0];
+  for (unsigned i = 1, n = x.size(); i < n; i++) {
+    result = result + x.elements[i];
+  }
+  return result;
+}
+
+template <class N>
+requires Number<N> N dot(
+    const ElementwiseVector<N>& left,
+    const ElementwiseVector<N>& right) {
+  return sum(left * right);
+}
+
+template <class N>
+requires Number<N> ElementwiseVector<N> matmul(
+    const ConstantMatrixp& matrix,
+    const ElementwiseVector<N>& x,
+    bool transposed = false) {
+  unsigned rows = transposed ? matrix->cols : matrix->rows;
+  unsigned cols = transposed ? matrix->rows : matrix->cols;
+  if (x.size() != cols) {
+    throw std::invalid_argument("matrix and vector sizes do not match");
+  }
+  std::vector<N> result;
+  result.reserve(rows);
+  for (unsigned i = 0; i < rows; i++) {
+    N element = 0;
+    for (unsigned j = 0; j < cols; j++) {
+      double m = transposed ? matrix->values[j * matrix->cols + i]
+                            : matrix->values[i * matrix->cols + j];
+      element = element + m * x.elements[j];
+    }
+    result.push_back(element);
+  }
+  return ElementwiseVector<N>{std::move(result)};
+}
+
+/*
+ * A vector of real numbers, evaluated by Eigen's (vectorized) kernels.
+ */
+class RealVector {
+ public:
+  Eigen::VectorXd values;
+
+  RealVector() {}
+  explicit RealVector(Eigen::VectorXd values) : values{std::move(values)} {}
+  /* implicit */ RealVector(const std::vector<double>& values)
+      : values{
+            Eigen::Map<const Eigen::VectorXd>(values.data(), values.size())} {}
+
+  static RealVector broadcast(const Real& x, unsigned size) {
+    return RealVector{Eigen::VectorXd::Constant(size, x.as_double())};
+  }
+
+  unsigned size() const {
+    return values.size();
+  }
+};
+
+template <>
+struct NumberVector<Real> {
+  using type = RealVector;
+};
+
+inline RealVector operator+(const RealVector& left, const RealVector& right) {
+  return RealVector{left.values + right.values};
+}
+
+inline RealVector operator-(const RealVector& left, const RealVector& right) {
+  return RealVector{left.values - right.values};
+}
+
+inline RealVector operator*(const RealVector& left, const RealVector& right) {
+  return RealVector{left.values.cwiseProduct(right.values)};
+}
+
+inline RealVector operator-(const RealVector& x) {
+  return RealVector{-x.values};
+}
+
+inline Real sum(const RealVector& x) {
+  return x.values.sum();
+}
+
+inline Real dot(const RealVector& left, const RealVector& right) {
+  return left.values.dot(right.values);
+}
+
+using RowMajorMatrix =
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// A view of a ConstantMatrix as an Eigen matrix.
+inline Eigen::Map<const RowMajorMatrix> as_eigen(const ConstantMatrix& matrix) {
+  return {matrix.values.data(), matrix.rows, matrix.cols};
+}
+
+inline RealVector matmul(
+    const ConstantMatrixp& matrix,
+    const RealVector& x,
+    bool transposed = false) {
+  auto m = as_eigen(*matrix);
+  return RealVector{transposed ? Eigen::VectorXd{m.transpose() * x.values}
+                               : Eigen::VectorXd{m * x.values}};
+}
+
+} // namespace beanmachine::minibmg
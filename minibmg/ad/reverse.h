@@ -7,325 +7,315 @@
 
 #pragma once
 
+#include <fmt/format.h>
+#include <array>
+#include <functional>
+#include <memory>
 #include <vector>
 #include "beanmachine/minibmg/ad/num2.h"
 #include "beanmachine/minibmg/ad/number.h"
-#include "beanmachine/minibmg/topological.h"
+#include "beanmachine/minibmg/ad/number_vector.h"
 
 namespace beanmachine::minibmg {
 
-template <class Underlying>
-requires Number<Underlying>
-class ReverseBody;
-
 /*
- * An implementation of numbers offering reverse-mode differentiation.
- * Can be used to automatically compute derivatives of more complex functions
- * by using the overloaded operators for computing new values and their
- * derivatives.  Implements the Number concept.
+ * A tape (Wengert list) on which reverse-mode values record the operations
+ * that produced them.  Each entry holds the positions on the tape of (up to
+ * two) inputs and the partial derivative of the result with respect to each.
+ * Because inputs always precede their uses, the reverse pass is a single
+ * backwards sweep over the entries; no sorting or reference counting is
+ * needed.  The entries are stored in flat vectors that are cleared (but keep
+ * their capacity) between evaluations, so the tape acts as an arena.
+ *
+ * An operation on vectors (see ReverseVector) is recorded as a single "hook"
+ * entry, whose reverse step is performed by a function rather than by the
+ * partial derivatives of the entry.
+ *
+ * A tape is not thread-safe; each thread records onto its own current tape
+ * (see `current` and `Recording`).
  */
 template <class Underlying>
 requires Number<Underlying>
-class Reverse {
+class ReverseTape {
  public:
-  using Bodyp = std::shared_ptr<ReverseBody<Underlying>>;
-  Bodyp ptr;
-
-  Reverse();
-  /* implicit */ Reverse(double primal);
-  /* implicit */ Reverse(Underlying primal);
-  /* implicit */ Reverse(Bodyp body);
-  Reverse(const Reverse<Underlying>& other);
-  virtual ~Reverse();
-  Reverse<Underlying>& operator=(const Reverse<Underlying>& other);
-  double as_double() const;
-  void reverse(double initial_adjoint);
-  Underlying adjoint() {
-    return ptr->adjoint;
+  struct Entry {
+    std::array<int, 2> inputs;
+    std::array<Underlying, 2> partials;
+  };
+
+  // The tape onto which this thread is recording.
+  static ReverseTape& current() {
+    return *current_tape();
   }
-};
 
-template <class Underlying>
-requires Number<Underlying>
-class ReverseBody {
- public:
-  Underlying primal;
-  std::vector<Reverse<Underlying>> inputs;
-  Underlying adjoint = 0;
-
-  /* implicit */ ReverseBody(double primal);
-  /* implicit */ ReverseBody(Underlying primal);
-  ReverseBody(
-      Underlying primal,
-      const std::vector<Reverse<Underlying>>& inputs);
-  ReverseBody(const ReverseBody<Underlying>& other);
-  ReverseBody<Underlying>& operator=(const ReverseBody<Underlying>& other);
-  virtual ~ReverseBody() {}
-  virtual void backprop();
-};
+  // While a Recording is alive, operations on this thread are recorded onto the
+  // given tape, which is first cleared.  The previous tape is restored when the
+  // Recording is destroyed.  Values recorded onto a tape may not be used after
+  // the tape is cleared.
+  class Recording {
+   public:
+    explicit Recording(ReverseTape& tape) : previous{current_tape()} {
+      tape.clear();
+      current_tape() = &tape;
+    }
+    ~Recording() {
+      current_tape() = previous;
+    }
+    Recording(const Recording&) = delete;
+    Recording& operator=(const Recording&) = delete;
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::Reverse(double primal)
-    : ptr{std::make_shared<ReverseBody<Underlying>>(primal)} {}
+   private:
+    ReverseTape* previous;
+  };
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::Reverse(Underlying primal)
-    : ptr{std::make_shared<ReverseBody<Underlying>>(primal)} {}
+  // The reverse step of a hook entry, which is given the tape and the
+  // position of the entry.
+  using Hook = std::function<void(ReverseTape& tape, int index)>;
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::Reverse()
-    : ptr{std::make_shared<ReverseBody<Underlying>>(0)} {}
+  // Discard all entries, keeping the allocated storage for reuse.
+  void clear() {
+    entries.clear();
+    adjoints.clear();
+    hooks.clear();
+  }
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::~Reverse() {}
+  int size() const {
+    return entries.size();
+  }
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::Reverse(
-    std::shared_ptr<ReverseBody<Underlying>> body)
-    : ptr{body} {}
+  // Record an operation.  An input of -1 is one that has no derivative.
+  int push(int input0, Underlying partial0, int input1, Underlying partial1) {
+    entries.push_back(Entry{{input0, input1}, {partial0, partial1}});
+    return entries.size() - 1;
+  }
 
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>
-&Reverse<Underlying>::operator=(const Reverse<Underlying>& other) {
-  this->ptr = other.ptr;
-  return *this;
-}
+  // Record an operation whose reverse step is performed by the given hook.
+  int push_hook(Hook hook) {
+    hooks.push_back(std::move(hook));
+    entries.push_back(Entry{{HOOK, (int)hooks.size() - 1}, {0, 0}});
+    return entries.size() - 1;
+  }
 
-// This implementation of ReverseBody<Underlying> permits the precomputation of
-// the local derivative, and simply multiplies during the reverse phase to
-// implement the chain rule.  Although not necessarily storage efficient for
-// tensors, for scalars it is as good as anything else.
-template <class Underlying>
-class PrecomputedGradients : public ReverseBody<Underlying> {
- public:
-  const std::vector<Underlying> computed_partial_derivatives;
-  PrecomputedGradients(
-      Underlying primal,
-      const std::vector<Reverse<Underlying>>& inputs,
-      const std::vector<Underlying>& computed_partial_derivatives)
-      : ReverseBody<Underlying>{primal, inputs},
-        computed_partial_derivatives{computed_partial_derivatives} {}
-  void backprop() override {
-    auto& /*std::vector<Reverse<Underlying>>*/ t = this->inputs;
-    typename std::vector<Reverse<Underlying>>::iterator it1 = t.begin();
-    typename std::vector<Underlying>::const_iterator it2 =
-        computed_partial_derivatives.begin();
-    for (; it1 != t.end() && it2 != computed_partial_derivatives.end();
-         ++it1, ++it2) {
-      auto& grad = *it2;
-      auto& input_grad = it1->ptr->adjoint;
-      input_grad = input_grad + this->adjoint * grad;
+  // Add to the adjoint of an entry.  Used by hooks during the reverse pass.
+  void accumulate(int index, const Underlying& value) {
+    if (index >= 0) {
+      adjoints[index] = adjoints[index] + value;
     }
   }
-};
-
-template <class Underlying>
-requires Number<Underlying> Reverse<Underlying>::Reverse(
-    const Reverse<Underlying>& other)
-    : ptr{other.ptr} {}
 
-template <class Underlying>
-requires Number<Underlying>
-double Reverse<Underlying>::as_double() const {
-  return ptr->primal.as_double();
-}
-
-template <class Underlying>
-requires Number<Underlying>
-void Reverse<Underlying>::reverse(double initial_adjoint) {
-  // topologically sort the set of ReverseBody pointers reachable - these are
-  // the nodes to which we need to backprop.
-  std::vector<Bodyp> roots = {ptr};
-  std::function<std::vector<Bodyp>(const Bodyp&)> predecessors =
-      [&](const Bodyp& ptr) -> std::vector<Bodyp> {
-    std::vector<Bodyp> result;
-    for (auto& i : ptr->inputs) {
-      result.push_back(i.ptr);
+  // Compute the adjoint of every entry, given the adjoint of the entry at
+  // `root`.
+  void reverse(int root, const Underlying& initial_adjoint) {
+    adjoints.assign(entries.size(), Underlying{0});
+    adjoints[root] = initial_adjoint;
+    for (int i = root; i >= 0; i--) {
+      const Entry& entry = entries[i];
+      if (entry.inputs[0] == HOOK) {
+        hooks[entry.inputs[1]](*this, i);
+        continue;
+      }
+      const Underlying& adjoint = adjoints[i];
+      // Entries that do not contribute to the root are skipped.
+      if (is_constant(adjoint, 0.0)) {
+        continue;
+      }
+      for (int k = 0; k < 2; k++) {
+        int input = entry.inputs[k];
+        if (input >= 0) {
+          adjoints[input] = adjoints[input] + adjoint * entry.partials[k];
+        }
+      }
     }
-    return result;
-  };
-  std::vector<Bodyp> sorted;
-  if (!topological_sort<Bodyp>(roots, predecessors, sorted)) {
-    throw std::logic_error("reverse nodes have a loop");
   }
 
-  // clear their adjoints
-  for (const auto& p : sorted) {
-    p->adjoint = 0;
+  // The adjoint of an entry computed by the most recent call to reverse.
+  Underlying adjoint(int index) const {
+    return (index >= 0 && index < (int)adjoints.size()) ? adjoints[index]
+                                                        : Underlying{0};
   }
 
-  // set the initial adjoint
-  ptr->adjoint = initial_adjoint;
+ private:
+  // The first input of a hook entry, whose second input is the index of the
+  // hook.
+  static constexpr int HOOK = -2;
+
+  std::vector<Entry> entries;
+  std::vector<Underlying> adjoints;
+  std::vector<Hook> hooks;
 
-  // go through the list in order and call backprop() on each.
-  for (const auto& p : sorted) {
-    p->backprop();
+  static ReverseTape*& current_tape() {
+    thread_local ReverseTape default_tape;
+    thread_local ReverseTape* tape = &default_tape;
+    return tape;
   }
-}
+};
 
+/*
+ * An implementation of numbers offering reverse-mode differentiation.
+ * Can be used to automatically compute derivatives of more complex functions
+ * by using the overloaded operators for computing new values and their
+ * derivatives.  Implements the Number concept.
+ *
+ * A value holds its primal and its position on the current ReverseTape.
+ * Values constructed from a double or an Underlying are recorded as inputs
+ * (leaves) so that their adjoint may be read after calling `reverse`.  A
+ * default-constructed value is zero and is not on the tape.
+ */
 template <class Underlying>
-requires Number<Underlying> ReverseBody<Underlying>::ReverseBody(double primal)
-    : primal{primal} {}
+requires Number<Underlying>
+class Reverse {
+ public:
+  using Tape = ReverseTape<Underlying>;
+  Underlying primal;
+  int index;
+
+  Reverse() : primal{0}, index{-1} {}
+  /* implicit */ Reverse(double primal) : Reverse(Underlying{primal}) {}
+  /* implicit */ Reverse(Underlying primal)
+      : primal{primal}, index{Tape::current().push(-1, 0, -1, 0)} {}
+  Reverse(Underlying primal, int index) : primal{primal}, index{index} {}
+  double as_double() const {
+    return primal.as_double();
+  }
 
-template <class Underlying>
-requires Number<Underlying> ReverseBody<Underlying>::ReverseBody(
-    Underlying primal)
-    : primal{primal} {}
+  // Run the reverse pass of the current tape from this value.
+  void reverse(double initial_adjoint) const {
+    if (index >= 0) {
+      Tape::current().reverse(index, initial_adjoint);
+    }
+  }
+
+  // The derivative of the value `reverse` was last called on with respect to
+  // this one.
+  Underlying adjoint() const {
+    return Tape::current().adjoint(index);
+  }
+};
 
+// Record the result of a unary operation with the given partial derivative.
 template <class Underlying>
-requires Number<Underlying> ReverseBody<Underlying>::ReverseBody(
-    Underlying primal,
-    const std::vector<Reverse<Underlying>>& inputs)
-    : primal{primal}, inputs{inputs} {}
+requires Number<Underlying> Reverse<Underlying> record(
+    const Underlying& primal,
+    const Reverse<Underlying>& x,
+    const Underlying& dx) {
+  if (x.index < 0) {
+    return Reverse<Underlying>{primal, -1};
+  }
+  return Reverse<Underlying>{
+      primal, ReverseTape<Underlying>::current().push(x.index, dx, -1, 0)};
+}
 
+// Record the result of a binary operation with the given partial derivatives.
 template <class Underlying>
-requires Number<Underlying>
-void ReverseBody<Underlying>::backprop() {}
+requires Number<Underlying> Reverse<Underlying> record(
+    const Underlying& primal,
+    const Reverse<Underlying>& x,
+    const Underlying& dx,
+    const Reverse<Underlying>& y,
+    const Underlying& dy) {
+  if (x.index < 0 && y.index < 0) {
+    return Reverse<Underlying>{primal, -1};
+  }
+  return Reverse<Underlying>{
+      primal,
+      ReverseTape<Underlying>::current().push(x.index, dx, y.index, dy)};
+}
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying>
 operator+(const Reverse<Underlying>& left, const Reverse<Underlying>& right) {
-  Underlying new_primal = left.ptr->primal + right.ptr->primal;
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{left, right},
-      std::vector<Underlying>{1, 1})};
+  return record<Underlying>(left.primal + right.primal, left, 1, right, 1);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying>
 operator-(const Reverse<Underlying>& left, const Reverse<Underlying>& right) {
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      left.ptr->primal - right.ptr->primal,
-      std::vector<Reverse<Underlying>>{left, right},
-      std::vector<Underlying>{1, -1})};
+  return record<Underlying>(left.primal - right.primal, left, 1, right, -1);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying>
 operator-(const Reverse<Underlying>& x) {
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      -x.ptr->primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{-1})};
+  return record<Underlying>(-x.primal, x, -1);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying>
 operator*(const Reverse<Underlying>& left, const Reverse<Underlying>& right) {
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      left.ptr->primal * right.ptr->primal,
-      std::vector<Reverse<Underlying>>{left, right},
-      std::vector<Underlying>{right.ptr->primal, left.ptr->primal})};
+  return record<Underlying>(
+      left.primal * right.primal, left, right.primal, right, left.primal);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying>
 operator/(const Reverse<Underlying>& left, const Reverse<Underlying>& right) {
   // a / b
-  Underlying new_primal = left.ptr->primal / right.ptr->primal;
-
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
+  Underlying new_primal = left.primal / right.primal;
+  return record<Underlying>(
       new_primal,
-      std::vector<Reverse<Underlying>>{left, right},
-      std::vector<Underlying>{
-          1 / right.ptr->primal, -new_primal / right.ptr->primal})};
+      left,
+      1 / right.primal,
+      right,
+      -new_primal / right.primal);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> pow(
     const Reverse<Underlying>& base,
     const Reverse<Underlying>& exponent) {
-  double power;
-  // shortcut some cases.
-  if (is_constant(exponent, power)) {
-    if (power == 0)
-      return 1;
-    if (power == 1)
-      return base;
-  }
-
-  Underlying new_primal = pow(base.ptr->primal, exponent.ptr->primal);
+  Underlying new_primal = pow(base.primal, exponent.primal);
 
   // Doing these partial derivatives symbolically is too hard for my small
   // brain.  So we'll use Num2 to get the answer.  Eventually we should come
   // back and improve this.
-  Underlying grad1 = pow(Num2<Underlying>{base.ptr->primal, 1},
-                         Num2<Underlying>{exponent.ptr->primal})
-                         .derivative1;
-  Underlying grad2 = pow(Num2<Underlying>{base.ptr->primal},
-                         Num2<Underlying>{exponent.ptr->primal, 1})
-                         .derivative1;
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{base, exponent},
-      std::vector<Underlying>{grad1, grad2})};
+  Underlying grad1 =
+      pow(Num2<Underlying>{base.primal, 1}, Num2<Underlying>{exponent.primal})
+          .derivative1;
+  Underlying grad2 =
+      pow(Num2<Underlying>{base.primal}, Num2<Underlying>{exponent.primal, 1})
+          .derivative1;
+  return record<Underlying>(new_primal, base, grad1, exponent, grad2);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> exp(
     const Reverse<Underlying>& x) {
-  Underlying new_primal = exp(x.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{new_primal})};
+  Underlying new_primal = exp(x.primal);
+  return record<Underlying>(new_primal, x, new_primal);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> log(
     const Reverse<Underlying>& x) {
-  Underlying new_primal = log(x.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{1 / x.ptr->primal})};
+  return record<Underlying>(log(x.primal), x, 1 / x.primal);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> atan(
     const Reverse<Underlying>& x) {
-  Underlying new_primal = atan(x.ptr->primal);
-  Underlying new_derivative1 = 1 / (x.ptr->primal * x.ptr->primal + 1.0f);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{new_derivative1})};
+  Underlying new_derivative1 = 1 / (x.primal * x.primal + 1.0f);
+  return record<Underlying>(atan(x.primal), x, new_derivative1);
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> lgamma(
     const Reverse<Underlying>& x) {
-  Underlying new_primal = lgamma(x.ptr->primal);
-  Underlying new_derivative1 = polygamma(0, x.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{new_derivative1})};
+  return record<Underlying>(lgamma(x.primal), x, polygamma(0, x.primal));
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> polygamma(
     int n,
     const Reverse<Underlying>& x) {
-  Underlying new_primal = polygamma(n, x.ptr->primal);
-  Underlying new_derivative1 = polygamma(n + 1, x.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{new_derivative1})};
+  return record<Underlying>(
+      polygamma(n, x.primal), x, polygamma(n + 1, x.primal));
 }
 
 template <class Underlying>
 requires Number<Underlying> Reverse<Underlying> log1p(
     const Reverse<Underlying>& x) {
-  Underlying x_value = x.ptr->primal;
-  Underlying new_primal = log1p(x_value);
-  Underlying new_derivative1 = 1.0 / (x_value + 1);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
-      new_primal,
-      std::vector<Reverse<Underlying>>{x},
-      std::vector<Underlying>{new_derivative1})};
+  Underlying new_derivative1 = 1.0 / (x.primal + 1);
+  return record<Underlying>(log1p(x.primal), x, new_derivative1);
 }
 
 template <class Underlying>
@@ -334,19 +324,15 @@ requires Number<Underlying> Reverse<Underlying> if_equal(
     const Reverse<Underlying>& comparand,
     const Reverse<Underlying>& when_equal,
     const Reverse<Underlying>& when_not_equal) {
-  // Note: we discard and ignore left.derivative1 and
-  // comparand->derivative1
+  // Note: we discard and ignore the derivatives of value and comparand
   Underlying new_primal = if_equal(
-      value.ptr->primal,
-      comparand.ptr->primal,
-      when_equal.ptr->primal,
-      when_not_equal.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
+      value.primal, comparand.primal, when_equal.primal, when_not_equal.primal);
+  return record<Underlying>(
       new_primal,
-      std::vector<Reverse<Underlying>>{when_equal, when_not_equal},
-      std::vector<Underlying>{
-          if_equal(value.ptr->primal, comparand.ptr->primal, 1, 0),
-          if_equal(value.ptr->primal, comparand.ptr->primal, 0, 1)})};
+      when_equal,
+      if_equal(value.primal, comparand.primal, 1, 0),
+      when_not_equal,
+      if_equal(value.primal, comparand.primal, 0, 1));
 }
 
 template <class Underlying>
@@ -355,29 +341,23 @@ requires Number<Underlying> Reverse<Underlying> if_less(
     const Reverse<Underlying>& comparand,
     const Reverse<Underlying>& when_less,
     const Reverse<Underlying>& when_not_less) {
-  // Note: we discard and ignore left.derivative1 and
-  // comparand->derivative1
+  // Note: we discard and ignore the derivatives of value and comparand
   Underlying new_primal = if_less(
-      value.ptr->primal,
-      comparand.ptr->primal,
-      when_less.ptr->primal,
-      when_not_less.ptr->primal);
-  return Reverse<Underlying>{std::make_shared<PrecomputedGradients<Underlying>>(
+      value.primal, comparand.primal, when_less.primal, when_not_less.primal);
+  return record<Underlying>(
       new_primal,
-      std::vector<Reverse<Underlying>>{when_less, when_not_less},
-      std::vector<Underlying>{
-          if_less(value.ptr->primal, comparand.ptr->primal, 1, 0),
-          if_less(value.ptr->primal, comparand.ptr->primal, 0, 1)})};
+      when_less,
+      if_less(value.primal, comparand.primal, 1, 0),
+      when_not_less,
+      if_less(value.primal, comparand.primal, 0, 1));
 }
 
+// Every value on the tape may be one that a derivative is requested with
+// respect to, so only values that are not on the tape are constants.
 template <class Underlying>
 requires Number<Underlying>
 bool is_constant(const Reverse<Underlying>& x, double& value) {
-  if (typeid(x.ptr) == typeid(ReverseBody<Underlying>)) {
-    // this is the only class in the hierarchy that never backpropagates.
-    return is_constant(x.ptr->primal, value);
-  }
-  return false;
+  return x.index < 0 && is_constant(x.primal, value);
 }
 
 template <class Underlying>
@@ -390,9 +370,240 @@ bool is_constant(const Reverse<Underlying>& x, const double& value) {
 template <class Underlying>
 requires Number<Underlying> std::string to_string(
     const Reverse<Underlying>& x) {
-  return fmt::format("[back primal={0}]", to_string(x.ptr->primal));
+  return fmt::format("[back primal={0}]", to_string(x.primal));
 }
 
 static_assert(Number<Reverse<Real>>);
 
+/*
+ * A vector of reverse-mode values.  Rather than putting each element on the
+ * tape, each vector operation is recorded on the tape once, as a hook (see
+ * ReverseTape::push_hook) that propagates the adjoint of its result, a whole
+ * vector, to its inputs.  The adjoint of a vector is accumulated in a slot
+ * shared by the vector and the hooks of the operations using it.  A vector
+ * with no slot does not depend on any value on the tape.
+ */
+template <class Underlying>
+requires Number<Underlying>
+class ReverseVector {
+ public:
+  using Tape = ReverseTape<Underlying>;
+  using Vector = VectorOf<Underlying>;
+
+  struct Slot {
+    Vector adjoint;
+    bool set = false;
+  };
+
+  Vector primal;
+  std::shared_ptr<Slot> slot;
+
+  ReverseVector() {}
+  /* implicit */ ReverseVector(const std::vector<double>& values)
+      : primal{values} {}
+  explicit ReverseVector(Vector primal) : primal{std::move(primal)} {}
+
+  static ReverseVector broadcast(const Reverse<Underlying>& x, unsigned size);
+
+  unsigned size() const {
+    return primal.size();
+  }
+};
+
+template <class Underlying>
+requires Number<Underlying>
+struct NumberVector<Reverse<Underlying>> {
+  using type = ReverseVector<Underlying>;
+};
+
+// Add to the adjoint of a vector during the reverse pass.
+template <class Underlying>
+requires Number<Underlying>
+void accumulate(
+    const std::shared_ptr<typename ReverseVector<Underlying>::Slot>& slot,
+    const VectorOf<Underlying>& adjoint) {
+  if (slot == nullptr) {
+    return;
+  } else if (slot->set) {
+    slot->adjoint = slot->adjoint + adjoint;
+  } else {
+    slot->adjoint = adjoint;
+    slot->set = true;
+  }
+}
+
+// Record the result of a vector-valued operation, where `depends` tells if it
+// depends on any value on the tape, and `backward` propagates the adjoint of
+// the result to the inputs.
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> record_vector(
+    VectorOf<Underlying> primal,
+    bool depends,
+    std::function<void(
+        ReverseTape<Underlying>& tape,
+        const VectorOf<Underlying>& adjoint)> backward) {
+  ReverseVector<Underlying> result{std::move(primal)};
+  if (!depends) {
+    return result;
+  }
+  auto slot = result.slot =
+      std::make_shared<typename ReverseVector<Underlying>::Slot>();
+  ReverseTape<Underlying>::current().push_hook(
+      [slot, backward](ReverseTape<Underlying>& tape, int) {
+        if (slot->set) {
+          // The slot is emptied so that the reverse pass may be run again.
+          auto adjoint = std::move(slot->adjoint);
+          slot->set = false;
+          backward(tape, adjoint);
+        }
+      });
+  return result;
+}
+
+// Record the result of an operation reducing vectors to a scalar.
+template <class Underlying>
+requires Number<Underlying> Reverse<Underlying> record_reduction(
+    const Underlying& primal,
+    bool depends,
+    std::function<
+        void(ReverseTape<Underlying>& tape, const Underlying& adjoint)>
+        backward) {
+  if (!depends) {
+    return Reverse<Underlying>{primal, -1};
+  }
+  int index = ReverseTape<Underlying>::current().push_hook(
+      [backward](ReverseTape<Underlying>& tape, int index) {
+        Underlying adjoint = tape.adjoint(index);
+        if (!is_constant(adjoint, 0.0)) {
+          backward(tape, adjoint);
+        }
+      });
+  return Reverse<Underlying>{primal, index};
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying>
+ReverseVector<Underlying>::broadcast(
+    const Reverse<Underlying>& x,
+    unsigned size) {
+  int index = x.index;
+  return record_vector<Underlying>(
+      Vector::broadcast(x.primal, size),
+      index >= 0,
+      [index](Tape& tape, const Vector& adjoint) {
+        tape.accumulate(index, sum(adjoint));
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> operator+(
+    const ReverseVector<Underlying>& left,
+    const ReverseVector<Underlying>& right) {
+  auto l = left.slot, r = right.slot;
+  return record_vector<Underlying>(
+      left.primal + right.primal,
+      l || r,
+      [l, r](ReverseTape<Underlying>&, const VectorOf<Underlying>& adjoint) {
+        accumulate<Underlying>(l, adjoint);
+        accumulate<Underlying>(r, adjoint);
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> operator-(
+    const ReverseVector<Underlying>& left,
+    const ReverseVector<Underlying>& right) {
+  auto l = left.slot, r = right.slot;
+  return record_vector<Underlying>(
+      left.primal - right.primal,
+      l || r,
+      [l, r](ReverseTape<Underlying>&, const VectorOf<Underlying>& adjoint) {
+        accumulate<Underlying>(l, adjoint);
+        if (r) {
+          accumulate<Underlying>(r, -adjoint);
+        }
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> operator-(
+    const ReverseVector<Underlying>& x) {
+  auto s = x.slot;
+  return record_vector<Underlying>(
+      -x.primal,
+      s != nullptr,
+      [s](ReverseTape<Underlying>&, const VectorOf<Underlying>& adjoint) {
+        accumulate<Underlying>(s, -adjoint);
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> operator*(
+    const ReverseVector<Underlying>& left,
+    const ReverseVector<Underlying>& right) {
+  auto l = left.slot, r = right.slot;
+  auto lp = left.primal, rp = right.primal;
+  return record_vector<Underlying>(
+      left.primal * right.primal,
+      l || r,
+      [l, r, lp, rp](
+          ReverseTape<Underlying>&, const VectorOf<Underlying>& adjoint) {
+        if (l) {
+          accumulate<Underlying>(l, adjoint * rp);
+        }
+        if (r) {
+          accumulate<Underlying>(r, adjoint * lp);
+        }
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> ReverseVector<Underlying> matmul(
+    const ConstantMatrixp& matrix,
+    const ReverseVector<Underlying>& x,
+    bool transposed = false) {
+  auto s = x.slot;
+  return record_vector<Underlying>(
+      matmul(matrix, x.primal, transposed),
+      s != nullptr,
+      [s, matrix, transposed](
+          ReverseTape<Underlying>&, const VectorOf<Underlying>& adjoint) {
+        accumulate<Underlying>(s, matmul(matrix, adjoint, !transposed));
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> Reverse<Underlying> sum(
+    const ReverseVector<Underlying>& x) {
+  auto s = x.slot;
+  unsigned size = x.size();
+  return record_reduction<Underlying>(
+      sum(x.primal),
+      s != nullptr,
+      [s, size](ReverseTape<Underlying>&, const Underlying& adjoint) {
+        accumulate<Underlying>(
+            s, VectorOf<Underlying>::broadcast(adjoint, size));
+      });
+}
+
+template <class Underlying>
+requires Number<Underlying> Reverse<Underlying> dot(
+    const ReverseVector<Underlying>& left,
+    const ReverseVector<Underlying>& right) {
+  auto l = left.slot, r = right.slot;
+  auto lp = left.primal, rp = right.primal;
+  return record_reduction<Underlying>(
+      dot(left.primal, right.primal),
+      l || r,
+      [l, r, lp, rp](ReverseTape<Underlying>&, const Underlying& adjoint) {
+        auto a = VectorOf<Underlying>::broadcast(adjoint, lp.size());
+        if (l) {
+          accumulate<Underlying>(l, a * rp);
+        }
+        if (r) {
+          accumulate<Underlying>(r, a * lp);
+        }
+      });
+}
+
 } // namespace beanmachine::minibmg
@@ -126,6 +126,51 @@ bool is_constant(const Traced& x, const double& value) {
   return is_constant(x, v) && v == value;
 }
 
+TracedVector TracedVector::broadcast(const Traced& x, unsigned size) {
+  return TracedVector{std::make_shared<const VectorBroadcastNode>(x.node, size)};
+}
+
+TracedVector operator+(const TracedVector& left, const TracedVector& right) {
+  VectorNodep result =
+      std::make_shared<const VectorAddNode>(left.node, right.node);
+  return constant_fold(result);
+}
+
+TracedVector operator-(const TracedVector& left, const TracedVector& right) {
+  VectorNodep result =
+      std::make_shared<const VectorSubtractNode>(left.node, right.node);
+  return constant_fold(result);
+}
+
+// There is no vector negation node; we multiply by a broadcast -1 instead.
+TracedVector operator-(const TracedVector& x) {
+  return TracedVector::broadcast(-1, x.size()) * x;
+}
+
+TracedVector operator*(const TracedVector& left, const TracedVector& right) {
+  VectorNodep result =
+      std::make_shared<const VectorMultiplyNode>(left.node, right.node);
+  return constant_fold(result);
+}
+
+TracedVector
+matmul(const ConstantMatrixp& matrix, const TracedVector& x, bool transposed) {
+  VectorNodep result =
+      std::make_shared<const VectorMatmulNode>(matrix, x.node, transposed);
+  return constant_fold(result);
+}
+
+Traced sum(const TracedVector& x) {
+  ScalarNodep result = std::make_shared<const ScalarSumNode>(x.node);
+  return constant_fold(result);
+}
+
+Traced dot(const TracedVector& left, const TracedVector& right) {
+  ScalarNodep result =
+      std::make_shared<const ScalarDotNode>(left.node, right.node);
+  return constant_fold(result);
+}
+
 std::string to_string(const Traced& traced) {
   Nodep node = traced.node;
   return to_string(node);
@@ -12,6 +12,7 @@
 #include <unordered_map>
 #include <vector>
 #include "beanmachine/minibmg/ad/number.h"
+#include "beanmachine/minibmg/ad/number_vector.h"
 #include "beanmachine/minibmg/ad/real.h"
 #include "beanmachine/minibmg/node.h"
 #include "beanmachine/minibmg/rewriters/dedup.h"
@@ -70,6 +71,48 @@ std::string to_string(const Traced& x);
 
 static_assert(Number<Traced>);
 
+// A vector of Traced values, which is a single vector node rather than one
+// node per element.
+class TracedVector {
+ public:
+  VectorNodep node;
+
+  inline TracedVector() : node{nullptr} {}
+  /* implicit */ inline TracedVector(VectorNodep node) : node{node} {}
+  /* implicit */ inline TracedVector(const std::vector<double>& values)
+      : node{std::make_shared<const VectorConstantNode>(values)} {}
+
+  static TracedVector broadcast(const Traced& x, unsigned size);
+
+  static TracedVector variable(
+      const std::string& name,
+      const int identifier,
+      unsigned size) {
+    return TracedVector{
+        std::make_shared<const VectorVariableNode>(name, identifier, size)};
+  }
+
+  unsigned size() const {
+    return node->size;
+  }
+};
+
+template <>
+struct NumberVector<Traced> {
+  using type = TracedVector;
+};
+
+TracedVector operator+(const TracedVector& left, const TracedVector& right);
+TracedVector operator-(const TracedVector& left, const TracedVector& right);
+TracedVector operator-(const TracedVector& x);
+TracedVector operator*(const TracedVector& left, const TracedVector& right);
+TracedVector matmul(
+    const ConstantMatrixp& matrix,
+    const TracedVector& x,
+    bool transposed = false);
+Traced sum(const TracedVector& x);
+Traced dot(const TracedVector& left, const TracedVector& right);
+
 template <>
 class NodeRewriteAdapter<Traced> {
  public:
@@ -83,6 +126,21 @@ class NodeRewriteAdapter<Traced> {
   }
 };
 
+template <>
+class NodeRewriteAdapter<TracedVector> {
+ public:
+  std::vector<Nodep> find_roots(const TracedVector& t) const {
+    return {t.node};
+  }
+  TracedVector rewrite(
+      const TracedVector& t,
+      const std::unordered_map<Nodep, Nodep>& map) const {
+    const auto& f = map.find(t.node);
+    return (f == map.end()) ? t
+                            : TracedVector(downcast<VectorNode>(f->second));
+  }
+};
+
 } // namespace beanmachine::minibmg
 
 // We want to use Traced values in (unordered) maps and sets, so we need a good
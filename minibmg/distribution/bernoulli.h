@@ -8,6 +8,7 @@
 #pragma once
 
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/distribution/distribution.h"
 
 namespace beanmachine::minibmg {
@@ -38,6 +39,28 @@ class Bernoulli : public Distribution<Underlying> {
             log(probability_of_zero),
             Underlying{-INFINITY}));
   }
+  Underlying log_prob_iid(const std::vector<double>& values) const override {
+    double ones = 0, zeros = 0;
+    for (auto v : values) {
+      if (v == 1) {
+        ones++;
+      } else if (v == 0) {
+        zeros++;
+      } else {
+        return -INFINITY;
+      }
+    }
+    // The terms are omitted when their count is zero, so that a probability of
+    // zero (or one) does not give 0 * -inf.
+    Underlying result = 0;
+    if (ones != 0) {
+      result = result + ones * log(probability_of_one);
+    }
+    if (zeros != 0) {
+      result = result + zeros * log(1 - probability_of_one);
+    }
+    return result;
+  }
   bool is_discrete() const override {
     return true;
   }
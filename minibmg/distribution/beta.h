@@ -8,6 +8,7 @@
 #pragma once
 
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/distribution/distribution.h"
 #include "beanmachine/minibmg/distribution/sigmoid_transform.h"
 #include "beanmachine/minibmg/eval_error.h"
@@ -41,6 +42,19 @@ class Beta : public Distribution<Underlying> {
     return (a - 1) * log(value) + (b - 1) * log(1 - value) + lgamma(a + b) -
         lgamma(a) - lgamma(b);
   }
+  Underlying log_prob_iid(const std::vector<double>& values) const override {
+    double n = values.size();
+    if (n == 0) {
+      return 0;
+    }
+    double sum_log = 0, sum_log1m = 0;
+    for (auto v : values) {
+      sum_log += std::log(v);
+      sum_log1m += std::log(1 - v);
+    }
+    return (a - 1) * sum_log + (b - 1) * sum_log1m +
+        n * (lgamma(a + b) - lgamma(a) - lgamma(b));
+  }
   bool is_discrete() const override {
     return false;
   }
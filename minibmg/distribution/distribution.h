@@ -10,6 +10,7 @@
 #include <functional>
 #include <memory>
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/ad/number.h"
 #include "beanmachine/minibmg/distribution/transformation.h"
 
@@ -35,6 +36,18 @@ class Distribution {
   // Compute the log of the probability distribution function for the
   // distribution evaluated at a particular value.
   virtual Underlying log_prob(const Underlying& value) const = 0;
+  // The log of the joint probability of independent samples, all from this
+  // distribution, with the given (observed) values.  Distributions override
+  // this to compute it from sufficient statistics of the values, so that the
+  // result is a fixed-size expression of the parameters however many values
+  // there are.
+  virtual Underlying log_prob_iid(const std::vector<double>& values) const {
+    Underlying result = 0;
+    for (auto v : values) {
+      result = result + log_prob(Underlying{v});
+    }
+    return result;
+  }
   // return true if and only if the distribution support set is discrete (rather
   // than continuous).
   virtual bool is_discrete() const = 0;
@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/ad/real.h"
 #include "beanmachine/minibmg/distribution/distribution.h"
 #include "beanmachine/minibmg/distribution/log_transform.h"
@@ -30,6 +31,17 @@ class Exponential : public Distribution<Underlying> {
   Underlying log_prob(const Underlying& value) const override {
     return log(rate) - rate * value;
   }
+  Underlying log_prob_iid(const std::vector<double>& values) const override {
+    double n = values.size();
+    if (n == 0) {
+      return 0;
+    }
+    double sum = 0;
+    for (auto v : values) {
+      sum += v;
+    }
+    return n * log(rate) - rate * sum;
+  }
   bool is_discrete() const override {
     return false;
   }
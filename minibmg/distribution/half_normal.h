@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/ad/real.h"
 #include "beanmachine/minibmg/distribution/distribution.h"
 #include "beanmachine/minibmg/distribution/log_transform.h"
@@ -32,6 +33,19 @@ class HalfNormal : public Distribution<Underlying> {
     return -log(value) - std::log(M_PI / 2.0) / 2 -
         0.5 * sum_xsq / (stddev * stddev);
   }
+  Underlying log_prob_iid(const std::vector<double>& values) const override {
+    double n = values.size();
+    if (n == 0) {
+      return 0;
+    }
+    double sum_log = 0, sum_xsq = 0;
+    for (auto v : values) {
+      sum_log += std::log(v);
+      sum_xsq += v * v;
+    }
+    return -sum_log - n * std::log(M_PI / 2.0) / 2 -
+        0.5 * sum_xsq / (stddev * stddev);
+  }
   bool is_discrete() const override {
     return false;
   }
@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <random>
+#include <vector>
 #include "beanmachine/minibmg/distribution/distribution.h"
 
 namespace beanmachine::minibmg {
@@ -36,6 +37,27 @@ class Normal : public Distribution<Underlying> {
     auto t2 = vmm * vmm;
     return -t2 / (2 * stddev * stddev) - log(stddev) - ls2pi;
   }
+  Underlying log_prob_iid(const std::vector<double>& values) const override {
+    // sum_i (v_i-m)^2 = sum_i (v_i-mean(v))^2 + n (mean(v)-m)^2
+    static const double ls2pi = std::log(std::sqrt(2 * M_PI));
+    double n = values.size();
+    if (n == 0) {
+      return 0;
+    }
+    double sum = 0;
+    for (auto v : values) {
+      sum += v;
+    }
+    double average = sum / n;
+    double sum_squared_deviations = 0;
+    for (auto v : values) {
+      sum_squared_deviations += (v - average) * (v - average);
+    }
+    auto amm = average - mean;
+    return -(sum_squared_deviations + n * amm * amm) /
+        (2 * stddev * stddev) -
+        n * log(stddev) - n * ls2pi;
+  }
   bool is_discrete() const override {
     return false;
   }
@@ -12,21 +12,40 @@ namespace beanmachine::minibmg {
 
 RecursiveNodeEvaluatorVisitor::RecursiveNodeEvaluatorVisitor(
     std::function<double(const std::string& name, const int identifier)>
-        read_variable)
-    : read_variable{read_variable} {}
+        read_variable,
+    std::function<RealVector(const std::string& name, const int identifier)>
+        read_vector_variable)
+    : read_variable{read_variable},
+      read_vector_variable{read_vector_variable} {}
 
 void RecursiveNodeEvaluatorVisitor::visit(const ScalarVariableNode* node) {
   result = read_variable(node->name, node->identifier);
 }
 
+void RecursiveNodeEvaluatorVisitor::visit(const VectorVariableNode* node) {
+  if (read_vector_variable == nullptr) {
+    throw std::logic_error("recursive evaluator may not read vectors");
+  }
+  vector_result = read_vector_variable(node->name, node->identifier);
+}
+
 void RecursiveNodeEvaluatorVisitor::visit(const ScalarSampleNode*) {
   throw std::logic_error("recursive evaluator may not sample");
 }
 
+void RecursiveNodeEvaluatorVisitor::visit(const VectorSampleNode*) {
+  throw std::logic_error("recursive evaluator may not sample");
+}
+
 Real RecursiveNodeEvaluatorVisitor::evaluate_input(const ScalarNodep& node) {
   return evaluate_scalar(node);
 }
 
+RealVector RecursiveNodeEvaluatorVisitor::evaluate_vector_input(
+    const VectorNodep& node) {
+  return evaluate_vector(node);
+}
+
 std::shared_ptr<const Distribution<Real>>
 RecursiveNodeEvaluatorVisitor::evaluate_input_distribution(
     const DistributionNodep&) {
@@ -40,4 +59,10 @@ double eval_node(
   return evaluator.evaluate_scalar(node).value;
 }
 
+RealVector eval_node(
+    RecursiveNodeEvaluatorVisitor& evaluator,
+    const VectorNodep& node) {
+  return evaluator.evaluate_vector(node);
+}
+
 } // namespace beanmachine::minibmg
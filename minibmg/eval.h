@@ -10,9 +10,14 @@
 #include <fmt/format.h>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <random>
 #include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <vector>
 #include "beanmachine/minibmg/ad/number.h"
+#include "beanmachine/minibmg/ad/number_vector.h"
 #include "beanmachine/minibmg/distribution/bernoulli.h"
 #include "beanmachine/minibmg/distribution/beta.h"
 #include "beanmachine/minibmg/distribution/distribution.h"
@@ -50,6 +55,8 @@ template <class N>
 requires Number<N>
 class NodeEvaluatorVisitor : public NodeVisitor {
  public:
+  using Vector = VectorOf<N>;
+
   // We intentionally leave the following several methods abstract for the
   // caller to implement.
 
@@ -61,6 +68,11 @@ class NodeEvaluatorVisitor : public NodeVisitor {
   // e.g. by sampling from the distribution.
   void visit(const ScalarSampleNode* node) override = 0;
 
+  // Similarly for vector variables and vector samples (which are always
+  // observed).
+  void visit(const VectorVariableNode* node) override = 0;
+  void visit(const VectorSampleNode* node) override = 0;
+
   // The caller must provide a mechanism for evaluating the inputs to a node.
   // For example, if the graph is a tree it might be done recursively.  Or it
   // might keep values in a map from node to value.
@@ -71,6 +83,9 @@ class NodeEvaluatorVisitor : public NodeVisitor {
   virtual std::shared_ptr<const Distribution<N>> evaluate_input_distribution(
       const DistributionNodep& node) = 0;
 
+  // And inputs that are vectors.
+  virtual Vector evaluate_vector_input(const VectorNodep& node) = 0;
+
   N result;
   N evaluate_scalar(const ScalarNodep& node) {
     node->accept(*this);
@@ -84,6 +99,12 @@ class NodeEvaluatorVisitor : public NodeVisitor {
     return dist_result;
   }
 
+  Vector vector_result;
+  Vector evaluate_vector(const VectorNodep& node) {
+    node->accept(*this);
+    return vector_result;
+  }
+
   void visit(const ScalarConstantNode* node) override {
     result = node->constant_value;
   }
@@ -139,6 +160,36 @@ class NodeEvaluatorVisitor : public NodeVisitor {
         evaluate_input(node->c),
         evaluate_input(node->d));
   }
+  void visit(const ScalarSumNode* node) override {
+    result = sum(evaluate_vector_input(node->x));
+  }
+  void visit(const ScalarDotNode* node) override {
+    result =
+        dot(evaluate_vector_input(node->left),
+            evaluate_vector_input(node->right));
+  }
+  void visit(const VectorConstantNode* node) override {
+    vector_result = Vector{node->values};
+  }
+  void visit(const VectorBroadcastNode* node) override {
+    vector_result = Vector::broadcast(evaluate_input(node->x), node->size);
+  }
+  void visit(const VectorAddNode* node) override {
+    vector_result = evaluate_vector_input(node->left) +
+        evaluate_vector_input(node->right);
+  }
+  void visit(const VectorSubtractNode* node) override {
+    vector_result = evaluate_vector_input(node->left) -
+        evaluate_vector_input(node->right);
+  }
+  void visit(const VectorMultiplyNode* node) override {
+    vector_result = evaluate_vector_input(node->left) *
+        evaluate_vector_input(node->right);
+  }
+  void visit(const VectorMatmulNode* node) override {
+    vector_result =
+        matmul(node->matrix, evaluate_vector_input(node->x), node->transposed);
+  }
   void visit(const DistributionNormalNode* node) override {
     dist_result = std::make_shared<Normal<N>>(
         evaluate_input(node->mean), evaluate_input(node->stddev));
@@ -158,31 +209,68 @@ class NodeEvaluatorVisitor : public NodeVisitor {
   }
 };
 
-// An evaluator whose strategy is to evaluate just a single node, pulling the
-// value for the inputs from a map, and depositing the computed value for that
-// node into the map.
+// A distribution held by value, so that evaluating a distribution node does
+// not allocate.
+template <class N>
+requires Number<N>
+using DistributionValue = std::variant<
+    std::monostate,
+    Normal<N>,
+    HalfNormal<N>,
+    Beta<N>,
+    Bernoulli<N>,
+    Exponential<N>>;
+
+template <class N>
+requires Number<N>
+const Distribution<N>& as_distribution(const DistributionValue<N>& value) {
+  return std::visit(
+      [](const auto& d) -> const Distribution<N>& {
+        if constexpr (std::is_same_v<
+                          std::decay_t<decltype(d)>,
+                          std::monostate>) {
+          throw std::logic_error("distribution has not been evaluated");
+        } else {
+          return d;
+        }
+      },
+      value);
+}
+
+// An evaluator whose strategy is to evaluate just a single node of a graph,
+// pulling the value for the inputs from vectors indexed by the position of
+// each node in the graph, and depositing the computed value for that node into
+// the vectors.  Distributions are constructed in place in their slot, and
+// vector-valued nodes are evaluated into a separate vector of vectors.
 template <class N>
 requires Number<N>
 class OneNodeAtATimeEvaluatorVisitor : public NodeEvaluatorVisitor<N> {
+  const Graph& graph;
   std::function<N(const std::string& name, const int identifier)> read_variable;
-  std::unordered_map<const Node*, double> observations;
+  const std::vector<std::optional<double>>& observations;
+  const std::vector<const std::vector<double>*>& vector_observations;
   N& log_prob;
-  std::unordered_map<Nodep, N>& data;
-  std::unordered_map<Nodep, std::shared_ptr<const Distribution<N>>>&
-      distributions;
+  std::vector<N>& data;
+  std::vector<VectorOf<N>>& vectors;
+  std::vector<DistributionValue<N>>& distributions;
   bool eval_log_prob;
   std::mt19937& gen;
   const std::function<SampledValue<N>(
       const Distribution<N>& distribution,
       std::mt19937& gen)>& sampler;
 
-  static std::unordered_map<const Node*, double> make_observations_by_node(
-      const Graph& graph) {
-    std::unordered_map<const Node*, double> result;
-    for (auto& p : observations_by_node(graph)) {
-      result[p.first.get()] = p.second;
+  // The position of the node being evaluated.
+  unsigned index = 0;
+
+  // The position of the given input of the node being evaluated.  A node has
+  // only a few inputs, so a linear search is cheaper than a hash lookup.
+  unsigned input_index(const Node* input) const {
+    for (auto i : graph.in_node_indices[index]) {
+      if (graph.nodes[i].get() == input) {
+        return i;
+      }
     }
-    return result;
+    throw std::logic_error("node is not an input of the node being evaluated");
   }
 
  public:
@@ -190,50 +278,107 @@ class OneNodeAtATimeEvaluatorVisitor : public NodeEvaluatorVisitor<N> {
       const Graph& graph,
       std::function<N(const std::string& name, const int identifier)>
           read_variable,
-      std::unordered_map<Nodep, N>& data,
-      std::unordered_map<Nodep, std::shared_ptr<const Distribution<N>>>&
-          distributions,
+      std::vector<N>& data,
+      std::vector<VectorOf<N>>& vectors,
+      std::vector<DistributionValue<N>>& distributions,
       N& log_prob,
       bool eval_log_prob,
       std::mt19937& gen,
       const std::function<SampledValue<
           N>(const Distribution<N>& distribution, std::mt19937& gen)>& sampler)
-      : read_variable{read_variable},
-        observations{make_observations_by_node(graph)},
+      : graph{graph},
+        read_variable{read_variable},
+        observations{observations_by_index(graph)},
+        vector_observations{vector_observations_by_index(graph)},
         log_prob{log_prob},
         data{data},
+        vectors{vectors},
         distributions{distributions},
         eval_log_prob{eval_log_prob},
         gen{gen},
         sampler{sampler} {}
 
+  // Evaluate the node at the given position in the graph.
+  void evaluate(unsigned i) {
+    index = i;
+    const Nodep& node = graph.nodes[i];
+    node->accept(*this);
+    if (downcast<ScalarNode>(node)) {
+      data[i] = this->result;
+    } else if (downcast<VectorNode>(node)) {
+      vectors[i] = std::move(this->vector_result);
+    }
+  }
+
   void visit(const ScalarVariableNode* node) override {
     this->result = read_variable(node->name, node->identifier);
   }
   void visit(const ScalarSampleNode* node) override {
-    auto obsp = observations.find(node);
-    auto dist_node = node->distribution;
-    auto dist = distributions.at(dist_node);
-    if (obsp != observations.end()) {
-      auto value = this->result = obsp->second;
+    auto& obs = observations[index];
+    auto& dist =
+        as_distribution(distributions[input_index(node->distribution.get())]);
+    if (obs.has_value()) {
+      auto value = this->result = *obs;
       if (eval_log_prob) {
-        N logp = dist->log_prob(value);
+        N logp = dist.log_prob(value);
         log_prob = log_prob + logp;
       }
     } else {
-      auto sampled_value = sampler(*dist, gen);
+      auto sampled_value = sampler(dist, gen);
       this->result = sampled_value.constrained;
       if (eval_log_prob) {
         log_prob = log_prob + sampled_value.log_prob;
       }
     }
   }
+  void visit(const VectorVariableNode* node) override {
+    throw std::logic_error(
+        fmt::format("vector variable {} cannot be evaluated", node->name));
+  }
+  void visit(const VectorSampleNode* node) override {
+    auto obs = vector_observations[index];
+    if (obs == nullptr) {
+      throw std::logic_error("vector sample is not observed");
+    }
+    this->vector_result = VectorOf<N>{*obs};
+    if (eval_log_prob) {
+      auto& dist =
+          as_distribution(distributions[input_index(node->distribution.get())]);
+      log_prob = log_prob + dist.log_prob_iid(*obs);
+    }
+  }
+  void visit(const DistributionNormalNode* node) override {
+    distributions[index].template emplace<Normal<N>>(
+        evaluate_input(node->mean), evaluate_input(node->stddev));
+  }
+  void visit(const DistributionHalfNormalNode* node) override {
+    distributions[index].template emplace<HalfNormal<N>>(
+        evaluate_input(node->stddev));
+  }
+  void visit(const DistributionBetaNode* node) override {
+    distributions[index].template emplace<Beta<N>>(
+        evaluate_input(node->a), evaluate_input(node->b));
+  }
+  void visit(const DistributionBernoulliNode* node) override {
+    distributions[index].template emplace<Bernoulli<N>>(
+        evaluate_input(node->prob));
+  }
+  void visit(const DistributionExponentialNode* node) override {
+    distributions[index].template emplace<Exponential<N>>(
+        evaluate_input(node->rate));
+  }
   N evaluate_input(const ScalarNodep& node) override {
-    return data.at(node);
+    return data[input_index(node.get())];
+  }
+  VectorOf<N> evaluate_vector_input(const VectorNodep& node) override {
+    return vectors[input_index(node.get())];
   }
   std::shared_ptr<const Distribution<N>> evaluate_input_distribution(
       const DistributionNodep& node) override {
-    return distributions.at(node);
+    // A non-owning pointer to the distribution held in place.
+    return std::shared_ptr<const Distribution<N>>{
+        std::shared_ptr<void>{},
+        &as_distribution(distributions[input_index(node.get())])};
   }
 };
 
@@ -267,11 +412,11 @@ requires Number<N> SampledValue<N> sample_from_distribution(
   }
 }
 
-// Evaluating an entire graph, producing into `data` a map of doubles that
-// contains, for each scalar-valued node at graph index i, the evaluated value
-// of that node at the corresponding index in the returned value.  Also returns
-// the log probability of the samples.  The sampler function, if passed, is used
-// to sample from the distribution.  It should return the sample in both
+// Evaluating an entire graph, producing into `data` a vector that contains,
+// for each scalar-valued node at graph index i, the evaluated value of that
+// node at the same index in `data` (see Graph::index_of).  Also returns the log
+// probability of the samples.  The sampler function, if passed, is used to
+// sample from the distribution.  It should return the sample in both
 // constrained and unconstrained spaces, and a log_prob value with respect to
 // its distribution transformed to the unconstrained space.
 template <class N>
@@ -280,14 +425,16 @@ requires Number<N> EvalResult<N> eval_graph(
     std::mt19937& gen,
     std::function<N(const std::string& name, const int identifier)>
         read_variable,
-    std::unordered_map<Nodep, N>& data,
+    std::vector<N>& data,
     bool run_queries = false,
     bool eval_log_prob = false,
     std::function<
         SampledValue<N>(const Distribution<N>& distribution, std::mt19937& gen)>
         sampler = sample_from_distribution<N>) {
-  std::unordered_map<Nodep, std::shared_ptr<const Distribution<N>>>
-      distributions;
+  // The caller may reuse `data` across evaluations to avoid reallocating it.
+  data.resize(graph.size());
+  std::vector<VectorOf<N>> vectors(graph.size());
+  std::vector<DistributionValue<N>> distributions(graph.size());
   N log_prob = 0;
 
   std::function<SampledValue<N>(
@@ -297,31 +444,22 @@ requires Number<N> EvalResult<N> eval_graph(
       graph,
       read_variable,
       data,
+      vectors,
       distributions,
       log_prob,
       eval_log_prob,
       gen,
       sampler2};
 
-  for (const auto& node : graph) {
-    if (auto dist_node = downcast<DistributionNode>(node)) {
-      std::shared_ptr<const Distribution<N>> dist =
-          evaluator.evaluate_distribution(dist_node);
-      distributions[node] = dist;
-    } else if (auto expr_node = downcast<ScalarNode>(node)) {
-      N expr = evaluator.evaluate_scalar(expr_node);
-      data[node] = expr;
-    } else {
-      throw std::logic_error("unexpected node");
-    }
+  for (unsigned i = 0, n = graph.size(); i < n; i++) {
+    evaluator.evaluate(i);
   }
 
   std::vector<N> queries;
   if (run_queries) {
+    queries.reserve(graph.queries.size());
     for (const auto& q : graph.queries) {
-      auto d = data.find(q);
-      N value = (d == data.end()) ? 0 : d->second;
-      queries.push_back(value);
+      queries.push_back(data[graph.index_of(q)]);
     }
   }
   return {log_prob, queries};
@@ -348,14 +486,20 @@ class RecursiveNodeEvaluatorVisitor : public NodeEvaluatorVisitor<Real> {
  private:
   std::function<double(const std::string& name, const int identifier)>
       read_variable;
+  std::function<RealVector(const std::string& name, const int identifier)>
+      read_vector_variable;
 
  public:
   explicit RecursiveNodeEvaluatorVisitor(
       std::function<double(const std::string& name, const int identifier)>
-          read_variable);
+          read_variable,
+      std::function<RealVector(const std::string& name, const int identifier)>
+          read_vector_variable = nullptr);
 
  private:
   void visit(const ScalarVariableNode* node) override;
+  void visit(const VectorVariableNode* node) override;
+  void visit(const VectorSampleNode* node) override;
 
   // The caller must provide a mechanism for proposing values for a sample node,
   // e.g. by sampling from the distribution.
@@ -365,6 +509,7 @@ class RecursiveNodeEvaluatorVisitor : public NodeEvaluatorVisitor<Real> {
   // For example, if the graph is a tree it might be done recursively.  Or it
   // might keep values in a map from node to value.
   Real evaluate_input(const ScalarNodep& node) override;
+  RealVector evaluate_vector_input(const VectorNodep& node) override;
 
   // Similarly, the caller must provide a mechanism to evaluate inputs that are
   // distributions.
@@ -379,5 +524,8 @@ class RecursiveNodeEvaluatorVisitor : public NodeEvaluatorVisitor<Real> {
 double eval_node(
     RecursiveNodeEvaluatorVisitor& evaluator,
     const ScalarNodep& node);
+RealVector eval_node(
+    RecursiveNodeEvaluatorVisitor& evaluator,
+    const VectorNodep& node);
 
 } // namespace beanmachine::minibmg
@@ -8,6 +8,7 @@
 #include "beanmachine/minibmg/graph.h"
 #include <memory>
 #include <stdexcept>
+#include <unordered_set>
 #include <vector>
 #include "beanmachine/minibmg/rewriters/dedup.h"
 #include "beanmachine/minibmg/topological.h"
@@ -18,7 +19,9 @@ using namespace beanmachine::minibmg;
 
 const std::vector<Nodep> roots(
     const std::vector<Nodep>& queries,
-    const std::vector<std::pair<Nodep, double>>& observations) {
+    const std::vector<std::pair<Nodep, double>>& observations,
+    const std::vector<std::pair<Nodep, std::vector<double>>>&
+        vector_observations) {
   std::vector<Nodep> roots;
   for (auto& n : queries) {
     roots.push_back(n);
@@ -29,6 +32,9 @@ const std::vector<Nodep> roots(
     }
     roots.push_back(p.first);
   }
+  for (auto& p : vector_observations) {
+    roots.push_back(p.first);
+  }
   std::vector<Nodep> all_nodes;
   if (!topological_sort<Nodep>(roots, &in_nodes, all_nodes)) {
     throw std::invalid_argument("graph has a cycle");
@@ -37,12 +43,53 @@ const std::vector<Nodep> roots(
   return all_nodes;
 }
 
+std::unordered_map<Nodep, unsigned> make_node_indices(
+    const std::vector<Nodep>& nodes) {
+  std::unordered_map<Nodep, unsigned> result;
+  for (unsigned i = 0, n = nodes.size(); i < n; i++) {
+    result[nodes[i]] = i;
+  }
+  return result;
+}
+
+std::vector<std::vector<unsigned>> make_in_node_indices(
+    const std::vector<Nodep>& nodes,
+    const std::unordered_map<Nodep, unsigned>& node_indices) {
+  std::vector<std::vector<unsigned>> result;
+  result.reserve(nodes.size());
+  for (auto& node : nodes) {
+    std::vector<unsigned> inputs;
+    for (auto& in_node : in_nodes(node)) {
+      inputs.push_back(node_indices.at(in_node));
+    }
+    result.push_back(std::move(inputs));
+  }
+  return result;
+}
+
 struct QueriesAndObservations {
   std::vector<Nodep> queries;
   std::vector<std::pair<Nodep, double>> observations;
+  std::vector<std::pair<Nodep, std::vector<double>>> vector_observations;
   ~QueriesAndObservations() {}
 };
 
+// Every vector sample must be observed, as the samples of a graph are scalars.
+void validate_vector_samples(
+    const std::vector<Nodep>& nodes,
+    const std::vector<std::pair<Nodep, std::vector<double>>>&
+        vector_observations) {
+  std::unordered_set<Nodep> observed;
+  for (auto& p : vector_observations) {
+    observed.insert(p.first);
+  }
+  for (auto& node : nodes) {
+    if (downcast<VectorSampleNode>(node) && !observed.contains(node)) {
+      throw std::invalid_argument("a vector sample must be observed");
+    }
+  }
+}
+
 } // namespace
 
 namespace beanmachine::minibmg {
@@ -55,6 +102,9 @@ class NodeRewriteAdapter<QueriesAndObservations> {
     for (auto& q : qo.observations) {
       roots.push_back(q.first);
     }
+    for (auto& q : qo.vector_observations) {
+      roots.push_back(q.first);
+    }
     for (auto& n : qo.queries) {
       roots.push_back(n);
     }
@@ -65,8 +115,11 @@ class NodeRewriteAdapter<QueriesAndObservations> {
       const std::unordered_map<Nodep, Nodep>& map) const {
     NodeRewriteAdapter<std::vector<Nodep>> h1{};
     NodeRewriteAdapter<std::vector<std::pair<Nodep, double>>> h2{};
+    NodeRewriteAdapter<std::vector<std::pair<Nodep, std::vector<double>>>> h3{};
     return QueriesAndObservations{
-        h1.rewrite(qo.queries, map), h2.rewrite(qo.observations, map)};
+        h1.rewrite(qo.queries, map),
+        h2.rewrite(qo.observations, map),
+        h3.rewrite(qo.vector_observations, map)};
   }
 };
 
@@ -76,17 +129,46 @@ Graph Graph::create(
     const std::vector<Nodep>& queries,
     const std::vector<std::pair<Nodep, double>>& observations,
     std::unordered_map<Nodep, Nodep>* built_map) {
+  return create(queries, observations, {}, built_map);
+}
+
+Graph Graph::create(
+    const std::vector<Nodep>& queries,
+    const std::vector<std::pair<Nodep, double>>& observations,
+    const std::vector<std::pair<Nodep, std::vector<double>>>&
+        vector_observations,
+    std::unordered_map<Nodep, Nodep>* built_map) {
+  for (auto& q : queries) {
+    if (downcast<VectorNode>(q)) {
+      throw std::invalid_argument("can only query a scalar");
+    }
+  }
   for (auto& p : observations) {
     if (!downcast<ScalarSampleNode>(p.first)) {
       throw std::invalid_argument(fmt::format("can only observe a sample"));
     }
   }
+  for (auto& p : vector_observations) {
+    auto sample = downcast<VectorSampleNode>(p.first);
+    if (!sample) {
+      throw std::invalid_argument("can only observe a sample");
+    }
+    if (p.second.size() != sample->size) {
+      throw std::invalid_argument(fmt::format(
+          "observed {} values of a vector sample of size {}",
+          p.second.size(),
+          sample->size));
+    }
+  }
 
-  auto qo0 = QueriesAndObservations{queries, observations};
+  auto qo0 = QueriesAndObservations{queries, observations, vector_observations};
   auto qo1 = dedup(qo0, built_map);
 
-  std::vector<Nodep> all_nodes = roots(qo1.queries, qo1.observations);
-  return Graph{all_nodes, qo1.queries, qo1.observations};
+  std::vector<Nodep> all_nodes =
+      roots(qo1.queries, qo1.observations, qo1.vector_observations);
+  validate_vector_samples(all_nodes, qo1.vector_observations);
+  return Graph{
+      all_nodes, qo1.queries, qo1.observations, qo1.vector_observations};
 }
 
 Graph::~Graph() {}
@@ -94,7 +176,18 @@ Graph::~Graph() {}
 Graph::Graph(
     const std::vector<Nodep>& nodes,
     const std::vector<Nodep>& queries,
-    const std::vector<std::pair<Nodep, double>>& observations)
-    : nodes{nodes}, queries{queries}, observations{observations} {}
+    const std::vector<std::pair<Nodep, double>>& observations,
+    const std::vector<std::pair<Nodep, std::vector<double>>>&
+        vector_observations)
+    : nodes{nodes},
+      queries{queries},
+      observations{observations},
+      vector_observations{vector_observations},
+      node_indices{make_node_indices(nodes)},
+      in_node_indices{make_in_node_indices(nodes, node_indices)} {}
+
+unsigned Graph::index_of(const Nodep& node) const {
+  return node_indices.at(node);
+}
 
 } // namespace beanmachine::minibmg
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <folly/json.h>
+#include <unordered_map>
 #include <vector>
 #include "beanmachine/minibmg/graph_properties/container.h"
 #include "beanmachine/minibmg/node.h"
@@ -29,6 +30,15 @@ class Graph : public Container {
       const std::vector<Nodep>& queries,
       const std::vector<std::pair<Nodep, double>>& observations,
       std::unordered_map<Nodep, Nodep>* built_map = nullptr);
+
+  // As above, for a graph which also observes vectors of IID samples (see
+  // VectorSampleNode), each of which must be observed.
+  static Graph create(
+      const std::vector<Nodep>& queries,
+      const std::vector<std::pair<Nodep, double>>& observations,
+      const std::vector<std::pair<Nodep, std::vector<double>>>&
+          vector_observations,
+      std::unordered_map<Nodep, Nodep>* built_map = nullptr);
   ~Graph();
 
   // Implement the iterator pattern so clients can iterate over the nodes.
@@ -57,13 +67,32 @@ class Graph : public Container {
   // values are known.
   const std::vector<std::pair<Nodep, double>> observations;
 
+  // Observations of vector SAMPLE nodes, with their observed values.
+  const std::vector<std::pair<Nodep, std::vector<double>>> vector_observations;
+
+  // The position of the given node in `nodes`.  Throws std::out_of_range if
+  // the node is not in the graph.
+  unsigned index_of(const Nodep& node) const;
+
+ private:
+  // The position of each node in `nodes`.
+  const std::unordered_map<Nodep, unsigned> node_indices;
+
+ public:
+  // For each node, the positions in `nodes` of its inputs, in the order
+  // returned by in_nodes().  This allows a graph to be evaluated into a vector
+  // indexed by position rather than a map keyed by node.
+  const std::vector<std::vector<unsigned>> in_node_indices;
+
  private:
   // A private constructor that forms a graph without validation.
   // Used internally.  All exposed graphs should be validated.
   Graph(
       const std::vector<Nodep>& nodes,
       const std::vector<Nodep>& queries,
-      const std::vector<std::pair<Nodep, double>>& observations);
+      const std::vector<std::pair<Nodep, double>>& observations,
+      const std::vector<std::pair<Nodep, std::vector<double>>>&
+          vector_observations);
 
  public:
   // A factory for making graphs, like the bmg API used by Beanstalk
@@ -91,6 +120,9 @@ class NodeRewriteAdapter<Graph> {
     for (auto& q : graph.observations) {
       roots.push_back(q.first);
     }
+    for (auto& q : graph.vector_observations) {
+      roots.push_back(q.first);
+    }
     for (auto& n : graph.queries) {
       roots.push_back(n);
     }
@@ -100,8 +132,11 @@ class NodeRewriteAdapter<Graph> {
       const {
     NodeRewriteAdapter<std::vector<Nodep>> h1{};
     NodeRewriteAdapter<std::vector<std::pair<Nodep, double>>> h2{};
+    NodeRewriteAdapter<std::vector<std::pair<Nodep, std::vector<double>>>> h3{};
     return Graph::create(
-        h1.rewrite(qo.queries, map), h2.rewrite(qo.observations, map));
+        h1.rewrite(qo.queries, map),
+        h2.rewrite(qo.observations, map),
+        h3.rewrite(qo.vector_observations, map));
   }
 };
 
@@ -24,6 +24,40 @@ class ObservationByNodeProperty : public Property<
   ~ObservationByNodeProperty() {}
 };
 
+class ObservationByIndexProperty
+    : public Property<
+          ObservationByIndexProperty,
+          Graph,
+          const std::vector<std::optional<double>>> {
+ public:
+  const std::vector<std::optional<double>>* create(
+      const Graph& g) const override {
+    auto result = new std::vector<std::optional<double>>(g.size());
+    for (auto& [node, value] : g.observations) {
+      (*result)[g.index_of(node)] = value;
+    }
+    return result;
+  }
+  ~ObservationByIndexProperty() {}
+};
+
+class VectorObservationByIndexProperty
+    : public Property<
+          VectorObservationByIndexProperty,
+          Graph,
+          const std::vector<const std::vector<double>*>> {
+ public:
+  const std::vector<const std::vector<double>*>* create(
+      const Graph& g) const override {
+    auto result = new std::vector<const std::vector<double>*>(g.size());
+    for (auto& [node, values] : g.vector_observations) {
+      (*result)[g.index_of(node)] = &values;
+    }
+    return result;
+  }
+  ~VectorObservationByIndexProperty() {}
+};
+
 } // namespace
 
 namespace beanmachine::minibmg {
@@ -33,4 +67,14 @@ const std::unordered_map<Nodep, double>& observations_by_node(
   return ObservationByNodeProperty::get(graph);
 }
 
+const std::vector<std::optional<double>>& observations_by_index(
+    const Graph& graph) {
+  return ObservationByIndexProperty::get(graph);
+}
+
+const std::vector<const std::vector<double>*>& vector_observations_by_index(
+    const Graph& graph) {
+  return VectorObservationByIndexProperty::get(graph);
+}
+
 } // namespace beanmachine::minibmg
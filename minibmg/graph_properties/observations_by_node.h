@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <optional>
 #include <unordered_set>
+#include <vector>
 #include "beanmachine/minibmg/graph.h"
 #include "beanmachine/minibmg/node.h"
 
@@ -17,4 +19,14 @@ namespace beanmachine::minibmg {
 const std::unordered_map<Nodep, double>& observations_by_node(
     const Graph& graph);
 
+// For each node of the graph, by its position in the graph, the observed value
+// of the node if it is an observed sample.
+const std::vector<std::optional<double>>& observations_by_index(
+    const Graph& graph);
+
+// For each node of the graph, by its position in the graph, the observed values
+// of the node if it is an observed vector sample, or else nullptr.
+const std::vector<const std::vector<double>*>& vector_observations_by_index(
+    const Graph& graph);
+
 } // namespace beanmachine::minibmg
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "beanmachine/minibmg/inference/batched_global_state.h"
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include "beanmachine/graph/global/nuts.h"
+
+namespace beanmachine::minibmg {
+
+BatchedHMCWorldEvaluator::BatchedHMCWorldEvaluator(
+    std::shared_ptr<const HMCWorld> world,
+    unsigned num_chains)
+    : _world{std::move(world)},
+      num_active{num_chains},
+      waiting(num_chains, false),
+      values{Eigen::MatrixXd::Zero(
+          num_chains,
+          _world->num_unobserved_samples())},
+      log_probs{Eigen::VectorXd::Zero(num_chains)},
+      gradients{Eigen::MatrixXd::Zero(
+          num_chains,
+          _world->num_unobserved_samples())} {
+  if (num_chains == 0) {
+    throw std::invalid_argument("BatchedHMCWorldEvaluator needs a chain");
+  }
+}
+
+void BatchedHMCWorldEvaluator::evaluate(
+    unsigned chain,
+    const std::vector<double>& proposed_unconstrained_values,
+    HMCWorldEvalResult& result) {
+  std::unique_lock<std::mutex> lock{mutex};
+  if (chain >= waiting.size() || waiting[chain]) {
+    throw std::invalid_argument("invalid chain for BatchedHMCWorldEvaluator");
+  }
+  for (int j = 0, n = values.cols(); j < n; j++) {
+    values(chain, j) = proposed_unconstrained_values[j];
+  }
+  waiting[chain] = true;
+  num_waiting++;
+  if (num_waiting == num_active) {
+    evaluate_batch();
+  } else {
+    auto batch = generation;
+    batch_done.wait(lock, [&] { return generation != batch; });
+  }
+  result.log_prob = log_probs[chain];
+  result.gradients.resize(gradients.cols());
+  for (int j = 0, n = gradients.cols(); j < n; j++) {
+    result.gradients[j] = gradients(chain, j);
+  }
+  result.queries.resize(queries.cols());
+  for (int j = 0, n = queries.cols(); j < n; j++) {
+    result.queries[j] = queries(chain, j);
+  }
+}
+
+void BatchedHMCWorldEvaluator::leave() {
+  std::unique_lock<std::mutex> lock{mutex};
+  num_active--;
+  // The chains left waiting may be complete now.
+  if (num_waiting > 0 && num_waiting == num_active) {
+    evaluate_batch();
+  }
+}
+
+void BatchedHMCWorldEvaluator::evaluate_batch() {
+  batch_values.resize(num_waiting, values.cols());
+  Eigen::Index row = 0;
+  for (unsigned chain = 0; chain < waiting.size(); chain++) {
+    if (waiting[chain]) {
+      batch_values.row(row++) = values.row(chain);
+    }
+  }
+  _world->evaluate_batch(
+      batch_values, batch_log_probs, batch_gradients, batch_queries);
+  queries.resize(values.rows(), batch_queries.cols());
+  row = 0;
+  for (unsigned chain = 0; chain < waiting.size(); chain++) {
+    if (waiting[chain]) {
+      log_probs[chain] = batch_log_probs[row];
+      gradients.row(chain) = batch_gradients.row(row);
+      queries.row(chain) = batch_queries.row(row);
+      row++;
+      waiting[chain] = false;
+    }
+  }
+  num_waiting = 0;
+  generation++;
+  batch_done.notify_all();
+}
+
+BatchedMinibmgGlobalState::BatchedMinibmgGlobalState(
+    const beanmachine::minibmg::Graph& graph,
+    BatchedHMCWorldEvaluator& evaluator,
+    unsigned chain)
+    : MinibmgGlobalState{graph, evaluator.world()},
+      evaluator{evaluator},
+      chain{chain} {}
+
+void BatchedMinibmgGlobalState::evaluate(
+    const std::vector<double>& values,
+    HMCWorldEvalResult& result) {
+  evaluator.evaluate(chain, values, result);
+}
+
+std::vector<std::vector<std::vector<beanmachine::graph::NodeValue>>>
+batched_nuts(
+    const beanmachine::minibmg::Graph& graph,
+    std::shared_ptr<const HMCWorld> world,
+    unsigned num_chains,
+    int num_samples,
+    unsigned seed,
+    int num_warmup_samples,
+    bool adapt_mass_matrix) {
+  BatchedHMCWorldEvaluator evaluator{std::move(world), num_chains};
+  std::vector<std::vector<std::vector<beanmachine::graph::NodeValue>>> samples(
+      num_chains);
+  std::vector<std::thread> threads;
+  std::exception_ptr e = nullptr;
+  std::mutex e_mutex;
+  for (unsigned i = 0; i < num_chains; i++) {
+    threads.emplace_back([&, i]() {
+      try {
+        beanmachine::graph::NUTS nuts{
+            std::make_unique<BatchedMinibmgGlobalState>(graph, evaluator, i),
+            adapt_mass_matrix};
+        samples[i] = nuts.infer(num_samples, seed + 13 * i, num_warmup_samples);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{e_mutex};
+        e = std::current_exception();
+      }
+      evaluator.leave();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (e != nullptr) {
+    std::rethrow_exception(e);
+  }
+  return samples;
+}
+
+} // namespace beanmachine::minibmg
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/minibmg/graph.h"
+#include "beanmachine/minibmg/inference/global_state.h"
+#include "beanmachine/minibmg/inference/hmc_world.h"
+
+namespace beanmachine::minibmg {
+
+// Evaluates an HMCWorld for several chains, each running in its own thread, in
+// batches (see HMCWorld::evaluate_batch).  A chain asking for an evaluation
+// waits until every other chain still running has asked too, or has left, and
+// the batch is then evaluated once for all of them.  Every chain must
+// therefore keep asking for evaluations until it leaves.
+class BatchedHMCWorldEvaluator {
+ public:
+  BatchedHMCWorldEvaluator(
+      std::shared_ptr<const HMCWorld> world,
+      unsigned num_chains);
+
+  // The log probability, gradients, and queries at the proposed values of a
+  // chain.
+  void evaluate(
+      unsigned chain,
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result);
+
+  // Called by a chain which will ask for no more evaluations.
+  void leave();
+
+  const std::shared_ptr<const HMCWorld>& world() const {
+    return _world;
+  }
+
+  // The number of batches evaluated so far.
+  std::uint64_t num_batches() const {
+    return generation;
+  }
+
+ private:
+  // Evaluates the waiting chains, with the mutex held.
+  void evaluate_batch();
+
+  const std::shared_ptr<const HMCWorld> _world;
+  std::mutex mutex;
+  std::condition_variable batch_done;
+  unsigned num_active;
+  unsigned num_waiting = 0;
+  std::uint64_t generation = 0;
+  std::vector<bool> waiting;
+  // One row per chain.
+  Eigen::MatrixXd values;
+  Eigen::VectorXd log_probs;
+  Eigen::MatrixXd gradients;
+  Eigen::MatrixXd queries;
+  // The rows of the waiting chains.
+  Eigen::MatrixXd batch_values;
+  Eigen::VectorXd batch_log_probs;
+  Eigen::MatrixXd batch_gradients;
+  Eigen::MatrixXd batch_queries;
+};
+
+// The global state of one chain sharing a BatchedHMCWorldEvaluator, so that
+// several NUTS chains can run on one batched world.
+class BatchedMinibmgGlobalState : public MinibmgGlobalState {
+ public:
+  BatchedMinibmgGlobalState(
+      const beanmachine::minibmg::Graph& graph,
+      BatchedHMCWorldEvaluator& evaluator,
+      unsigned chain);
+
+ protected:
+  void evaluate(const std::vector<double>& values, HMCWorldEvalResult& result)
+      override;
+
+ private:
+  BatchedHMCWorldEvaluator& evaluator;
+  unsigned chain;
+};
+
+// Runs NUTS on num_chains chains of the graph, one thread per chain, with the
+// log probabilities, gradients, and queries of all of the chains evaluated in
+// batches by the given world.  The seed of chain i is seed + 13 i, as in
+// beanmachine::graph::Graph::infer.  Returns the samples of each chain.
+std::vector<std::vector<std::vector<beanmachine::graph::NodeValue>>>
+batched_nuts(
+    const beanmachine::minibmg::Graph& graph,
+    std::shared_ptr<const HMCWorld> world,
+    unsigned num_chains,
+    int num_samples,
+    unsigned seed,
+    int num_warmup_samples = 0,
+    bool adapt_mass_matrix = true);
+
+} // namespace beanmachine::minibmg
@@ -32,9 +32,15 @@ std::unique_ptr<MinibmgGlobalState> MinibmgGlobalState::create2(
       new MinibmgGlobalState{graph, hmc_world_2(graph)}};
 }
 
+std::unique_ptr<MinibmgGlobalState> MinibmgGlobalState::create3(
+    const beanmachine::minibmg::Graph& graph) {
+  return std::unique_ptr<MinibmgGlobalState>{
+      new MinibmgGlobalState{graph, hmc_world_3(graph)}};
+}
+
 MinibmgGlobalState::MinibmgGlobalState(
     const beanmachine::minibmg::Graph& graph,
-    std::unique_ptr<const HMCWorld> world)
+    std::shared_ptr<const HMCWorld> world)
     : graph{graph}, world{std::move(world)} {
   samples.clear();
   // Since we only support scalars, we count the unobserved samples by ones.
@@ -67,7 +73,7 @@ void MinibmgGlobalState::initialize_values(
         samples.push_back(result.unconstrained.as_double());
         return result;
       };
-      std::unordered_map<Nodep, Real> real_eval_data;
+      std::vector<Real> real_eval_data;
       auto eval_result = eval_graph<Real>(
           graph,
           gen,
@@ -99,6 +105,9 @@ void MinibmgGlobalState::initialize_values(
 
 void MinibmgGlobalState::backup_unconstrained_values() {
   saved_unconstrained_values = unconstrained_values;
+  saved_has_evaluation = has_evaluation;
+  saved_evaluated_values = evaluated_values;
+  saved_evaluation = evaluation;
 }
 
 void MinibmgGlobalState::backup_unconstrained_grads() {
@@ -107,6 +116,9 @@ void MinibmgGlobalState::backup_unconstrained_grads() {
 
 void MinibmgGlobalState::revert_unconstrained_values() {
   unconstrained_values = saved_unconstrained_values;
+  has_evaluation = saved_has_evaluation;
+  evaluated_values = saved_evaluated_values;
+  evaluation = saved_evaluation;
 }
 
 void MinibmgGlobalState::revert_unconstrained_grads() {
@@ -155,19 +167,35 @@ double MinibmgGlobalState::get_log_prob() {
   return log_prob;
 }
 
+void MinibmgGlobalState::evaluate(
+    const std::vector<double>& values,
+    HMCWorldEvalResult& result) {
+  world->evaluate(values, result);
+}
+
+void MinibmgGlobalState::ensure_evaluated() {
+  if (has_evaluation && evaluated_values == unconstrained_values) {
+    return;
+  }
+  evaluate(unconstrained_values, evaluation);
+  evaluated_values = unconstrained_values;
+  has_evaluation = true;
+}
+
 void MinibmgGlobalState::update_log_prob() {
-  log_prob = world->log_prob(this->unconstrained_values);
+  ensure_evaluated();
+  log_prob = evaluation.log_prob;
 }
 
 void MinibmgGlobalState::update_backgrad() {
-  world->gradients(this->unconstrained_values, unconstrained_grads);
+  ensure_evaluated();
+  unconstrained_grads = evaluation.gradients;
 }
 
 void MinibmgGlobalState::collect_sample() {
-  std::vector<double> queries;
-  world->queries(this->unconstrained_values, queries);
+  ensure_evaluated();
   std::vector<beanmachine::graph::NodeValue> compat_query;
-  for (auto v : queries) {
+  for (auto v : evaluation.queries) {
     compat_query.emplace_back(v);
   }
   this->samples.emplace_back(compat_query);
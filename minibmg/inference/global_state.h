@@ -33,10 +33,16 @@ class MinibmgGlobalState : public beanmachine::graph::GlobalState {
       const beanmachine::minibmg::Graph& graph);
 
   // Create a global state that first compiles the model to an expression tree,
-  // generates code from that tree, and evaluates by running the generated code.
+  // compiles that tree to bytecode, and evaluates by interpreting the bytecode.
   static std::unique_ptr<MinibmgGlobalState> create2(
       const beanmachine::minibmg::Graph& graph);
 
+  // Create a global state that first compiles the model to an expression tree,
+  // generates native code from that tree, and evaluates by running the
+  // generated code.
+  static std::unique_ptr<MinibmgGlobalState> create3(
+      const beanmachine::minibmg::Graph& graph);
+
   void initialize_values(beanmachine::graph::InitType init_type, uint seed)
       override;
   void backup_unconstrained_values() override;
@@ -61,13 +67,22 @@ class MinibmgGlobalState : public beanmachine::graph::GlobalState {
   void set_agg_type(beanmachine::graph::AggregationType) override;
   void clear_samples() override;
 
- private:
+ protected:
   explicit MinibmgGlobalState(
       const beanmachine::minibmg::Graph& graph,
-      std::unique_ptr<const HMCWorld> world);
+      std::shared_ptr<const HMCWorld> world);
+
+  // Evaluate the log_prob, gradients, and queries of the world at the given
+  // values (see HMCWorld::evaluate).  Overridden by chains whose evaluations
+  // are batched.
+  virtual void evaluate(
+      const std::vector<double>& values,
+      HMCWorldEvalResult& result);
 
   const beanmachine::minibmg::Graph& graph;
-  const std::unique_ptr<const HMCWorld> world;
+  // Shared by the global states of chains that evaluate their model in batches
+  // (see BatchedMinibmgGlobalState).
+  const std::shared_ptr<const HMCWorld> world;
   std::vector<std::vector<beanmachine::graph::NodeValue>> samples;
   int flat_size;
   double log_prob;
@@ -75,6 +90,21 @@ class MinibmgGlobalState : public beanmachine::graph::GlobalState {
   std::vector<double> unconstrained_grads;
   std::vector<double> saved_unconstrained_values;
   std::vector<double> saved_unconstrained_grads;
+
+ private:
+  // Make `evaluation` current for the unconstrained values.  The log_prob,
+  // gradients, and queries at a point are computed by a single evaluation of
+  // the world, however many of them inference asks for.
+  void ensure_evaluated();
+
+  // The most recent evaluation, and the values at which it was made.
+  bool has_evaluation = false;
+  std::vector<double> evaluated_values;
+  HMCWorldEvalResult evaluation;
+  // The evaluation saved along with the unconstrained values.
+  bool saved_has_evaluation = false;
+  std::vector<double> saved_evaluated_values;
+  HMCWorldEvalResult saved_evaluation;
 };
 
 } // namespace beanmachine::minibmg
@@ -6,10 +6,20 @@
  */
 
 #include "beanmachine/minibmg/inference/hmc_world.h"
+#include <fmt/format.h>
+#include <folly/json.h>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <random>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 #include "beanmachine/minibmg/ad/real.h"
@@ -24,6 +34,19 @@
 #include "beanmachine/minibmg/pretty.h"
 #include "beanmachine/minibmg/rewriters/dedag.h"
 
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+// The iterations of a loop over the chains of a batch are independent, so the
+// loop may be vectorized.
+#if defined(__GNUC__)
+#define MINIBMG_CHAIN_LOOP _Pragma("omp simd")
+#else
+#define MINIBMG_CHAIN_LOOP
+#endif
+
 namespace {
 
 using namespace beanmachine::minibmg;
@@ -32,10 +55,11 @@ template <class T, class U = double>
 requires Number<T> EvalResult<T> evaluate_internal(
     const Graph& graph,
     const std::vector<U>& proposed_unconstrained_values,
-    std::unordered_map<Nodep, T>& data,
+    std::vector<T>& data,
     std::mt19937& gen,
     bool run_queries,
-    bool eval_log_prob) {
+    bool eval_log_prob,
+    std::vector<T>* unconstrained_samples = nullptr) {
   unsigned next_sample = 0;
 
   // Here is our function for producing an unobserved sample by drawing from
@@ -46,6 +70,9 @@ requires Number<T> EvalResult<T> evaluate_internal(
       sample_from_distribution = [&](const Distribution<T>& distribution,
                                      std::mt19937&) -> SampledValue<T> {
     T unconstrained = proposed_unconstrained_values[next_sample++];
+    if (unconstrained_samples != nullptr) {
+      unconstrained_samples->push_back(unconstrained);
+    }
     auto transform = distribution.transformation();
     if (transform == nullptr) {
       const T& constrained = unconstrained;
@@ -108,6 +135,10 @@ class HMCWorld0 : public HMCWorld {
   void queries(
       const std::vector<double>& proposed_unconstrained_values,
       std::vector<double>& result) const override;
+
+  void evaluate(
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result) const override;
 };
 
 HMCWorld0::HMCWorld0(const Graph& graph)
@@ -124,7 +155,7 @@ unsigned HMCWorld0::num_unobserved_samples() const {
 double HMCWorld0::log_prob(
     const std::vector<double>& proposed_unconstrained_values) const {
   using T = Real;
-  std::unordered_map<Nodep, T> data;
+  std::vector<T> data;
   std::mt19937 gen;
 
   // evaluate the graph and its log_prob in normal mode
@@ -143,8 +174,15 @@ void HMCWorld0::gradients(
     const std::vector<double>& proposed_unconstrained_values,
     std::vector<double>& result) const {
   using T = Reverse<Real>;
-  std::unordered_map<Nodep, T> data;
+
+  // Record onto a tape owned by this thread, reusing its storage from one
+  // evaluation to the next.
+  thread_local T::Tape tape;
+  T::Tape::Recording recording{tape};
+
+  std::vector<T> data;
   std::mt19937 gen;
+  std::vector<T> samples;
 
   // evaluate the graph and its log_prob in reverse mode
   auto eval_result = evaluate_internal<T>(
@@ -153,27 +191,18 @@ void HMCWorld0::gradients(
       data,
       gen,
       /* run_queries = */ false,
-      /* eval_log_prob = */ true);
+      /* eval_log_prob = */ true,
+      &samples);
 
-  // extract the gradients for the unobserved samples.
+  // extract the gradients for the unobserved samples.  These are taken with
+  // respect to the proposed (unconstrained) values, not the values of the
+  // sample nodes, which differ when the distribution has a transformation.  If
+  // the log_prob does not depend on a sample at all, its adjoint is zero.
   eval_result.log_prob.reverse(1);
-  std::vector<double> gradients;
-  auto& obs = observations_by_node(graph);
   result.resize(num_unobserved_samples());
-  int i = 0;
-  for (const auto& node : graph) {
-    if (dynamic_cast<const ScalarSampleNode*>(node.get()) &&
-        !obs.contains(node)) {
-      // we found an unobserved sample.  Add its gradient to the result.
-      auto found = data.find(node);
-      // It is possible that the node is not found in the data.  This occurs
-      // when the log_prob does not depend on that sample at all.  In this case
-      // the gradient is zero.
-      auto grad =
-          (found == data.end()) ? 0 : found->second.adjoint().as_double();
-      assert(!result.empty());
-      result[i++] = grad;
-    }
+  assert(samples.size() == result.size());
+  for (int i = 0, n = samples.size(); i < n; i++) {
+    result[i] = samples[i].adjoint().as_double();
   }
 }
 
@@ -184,7 +213,7 @@ void HMCWorld0::queries(
   // gradients.
   using T = Real;
 
-  std::unordered_map<Nodep, T> data;
+  std::vector<T> data;
   std::mt19937 gen;
 
   // evaluate the graph and its log_prob using real numbers
@@ -205,51 +234,76 @@ void HMCWorld0::queries(
   }
 }
 
-// "In a world in which" we evaluate things by computing them the hard way once,
-// symbolically, and then optimize and save the symbolic form for (hopefully)
-// fast recursive evaluation later.  This reduces the memory allocation
-// overhead, because we do not need to allocate nodes for reverse AD.
-class HMCWorld1 : public HMCWorld {
- private:
-  const Graph& graph;
-  std::unordered_set<Nodep> unobserved_sample_set;
-  std::unordered_map<Nodep, double> observations;
-
-  Dedagged<std::vector<ScalarNodep>> log_prob_graph;
-  Dedagged<std::vector<ScalarNodep>> gradients_graph;
-  Dedagged<std::vector<ScalarNodep>> queries_graph;
-
- public:
-  explicit HMCWorld1(const Graph& graph);
+void HMCWorld0::evaluate(
+    const std::vector<double>& proposed_unconstrained_values,
+    HMCWorldEvalResult& result) const {
+  using T = Reverse<Real>;
+  thread_local T::Tape tape;
+  T::Tape::Recording recording{tape};
 
-  unsigned num_unobserved_samples() const override;
+  std::vector<T> data;
+  std::mt19937 gen;
+  std::vector<T> samples;
 
-  double log_prob(
-      const std::vector<double>& proposed_unconstrained_values) const override;
+  // evaluate the graph, its log_prob, and its queries in reverse mode, once.
+  auto eval_result = evaluate_internal<T>(
+      graph,
+      proposed_unconstrained_values,
+      data,
+      gen,
+      /* run_queries = */ true,
+      /* eval_log_prob = */ true,
+      &samples);
 
-  void gradients(
-      const std::vector<double>& proposed_unconstrained_values,
-      std::vector<double>& result) const override;
+  result.log_prob = eval_result.log_prob.as_double();
+  eval_result.log_prob.reverse(1);
+  result.gradients.resize(samples.size());
+  for (int i = 0, n = samples.size(); i < n; i++) {
+    result.gradients[i] = samples[i].adjoint().as_double();
+  }
+  result.queries.resize(eval_result.queries.size());
+  for (int i = 0, n = eval_result.queries.size(); i < n; i++) {
+    result.queries[i] = eval_result.queries[i].as_double();
+  }
+}
 
-  void queries(
-      const std::vector<double>& proposed_unconstrained_values,
-      std::vector<double>& result) const override;
+// The symbolic forms of the computations an HMCWorld performs, optimized and
+// dedagged for evaluation.  See `optimized_forms`.
+struct OptimizedForms {
+  Dedagged<std::vector<ScalarNodep>> log_prob;
+  Dedagged<std::vector<ScalarNodep>> gradients;
+  Dedagged<std::vector<ScalarNodep>> queries;
+  // All three together, with one shared prelude.  The results are the
+  // log_prob, followed by the gradients, followed by the queries.
+  Dedagged<std::vector<ScalarNodep>> joint;
 };
 
-// An implementation of HMCWorld that compultes things symbolically, once, up
-// front, and then evaluates that symbolic form when required later.
-HMCWorld1::HMCWorld1(const Graph& graph)
-    : graph{graph},
-      unobserved_sample_set{
-          unobserved_samples(graph).begin(),
-          unobserved_samples(graph).end()},
-      observations{observations_by_node(graph)} {
+void print_dedagged(
+    const std::string& title,
+    const Dedagged<std::vector<ScalarNodep>>& dedagged) {
+  std::cout << "\ncode for optimized " << title << ":\n";
+  for (auto& p : dedagged.prelude) {
+    std::cout << " " << p.first->name << " = " << to_string(p.second)
+              << std::endl;
+  }
+  for (auto& p : dedagged.result) {
+    const Nodep& q = p;
+    std::cout << "   " << to_string(q) << std::endl;
+  }
+}
+
+// Compute the symbolic forms of the log_prob, its gradients, and the queries of
+// the graph.  In the result, the variable with identifier i (named
+// proposals[i]) stands for the i-th proposed unconstrained value.
+OptimizedForms optimized_forms(const Graph& graph) {
   //
   // We evaluate the graph using automatic derivatives (AD) in reverse mode,
   // computing symbolic forms for the queries, log_prob, and gradients.  We save
   // those symbolic forms for fast recursive evaluation later.
   //
   using T = Reverse<Traced>;
+  T::Tape tape;
+  T::Tape::Recording recording{tape};
 
   // We count the unobserved samples as we encounter them, and save them for
   // later extraction of the gradient computed in reverse mode AD.
@@ -304,7 +358,7 @@ HMCWorld1::HMCWorld1(const Graph& graph)
 
   // evaluate the graph.
   std::mt19937 random;
-  std::unordered_map<Nodep, T> data{};
+  std::vector<T> data{};
   auto eval_result = eval_graph<T>(
       graph,
       random,
@@ -315,12 +369,12 @@ HMCWorld1::HMCWorld1(const Graph& graph)
       sample_from_distribution);
 
   // Save the symbolic form of the computation of the log_prob
-  std::vector<ScalarNodep> log_prob = {eval_result.log_prob.ptr->primal.node};
+  std::vector<ScalarNodep> log_prob = {eval_result.log_prob.primal.node};
 
   // Save the symbolic form of the computation of the set of queries.
   std::vector<ScalarNodep> queries{};
   for (auto& q : eval_result.queries) {
-    queries.push_back(q.ptr->primal.node);
+    queries.push_back(q.primal.node);
   }
 
   // trigger the reverse pass of reverse-mode AD, using the log_prob as the
@@ -336,12 +390,11 @@ HMCWorld1::HMCWorld1(const Graph& graph)
   // were computed during the reverse pass of reverse-mode AD, just above.
   std::vector<ScalarNodep> gradients{};
   for (auto& g : samples) {
-    // g is a Reverse<Traced>; Reverse is  a wrapper around a pointer (ptr)
-    // to the reverse body.  The adjoint field of that contains a Traced for the
-    // derivative that was computed during the reverse pass, just above.  The
-    // node field of a Traced contains the Nodep for that expression dag.  We
-    // capture that expression dag for later evaluation.
-    gradients.push_back(g.ptr->adjoint.node);
+    // g is a Reverse<Traced>; its adjoint is a Traced for the derivative that
+    // was computed during the reverse pass, just above.  The node field of a
+    // Traced contains the Nodep for that expression dag.  We capture that
+    // expression dag for later evaluation.
+    gradients.push_back(g.adjoint().node);
   }
 
   // We optimize each of the saved symbolic forms and prepare them for fast
@@ -352,45 +405,81 @@ HMCWorld1::HMCWorld1(const Graph& graph)
   // opportunities might exist.
   const bool print_optimized_code = false;
 
-  this->log_prob_graph = dedag(opt(log_prob));
+  // The forms are optimized together, so that their common subexpressions are
+  // optimized once.
+  std::vector<ScalarNodep> all = log_prob;
+  all.insert(all.end(), gradients.begin(), gradients.end());
+  all.insert(all.end(), queries.begin(), queries.end());
+  all = opt(all);
+  auto part = [&](int begin, int end) {
+    return std::vector<ScalarNodep>{all.begin() + begin, all.begin() + end};
+  };
+  int num_gradients = gradients.size();
+  OptimizedForms result{
+      dedag(part(0, 1)),
+      dedag(part(1, 1 + num_gradients)),
+      dedag(part(1 + num_gradients, all.size())),
+      dedag(all)};
   if (print_optimized_code) {
-    std::cout << "\ncode for optimized log_prob:\n";
-    for (auto& p : this->log_prob_graph.prelude) {
-      std::cout << " " << p.first->name << " = " << to_string(p.second)
-                << std::endl;
-    }
-    for (auto& p : this->log_prob_graph.result) {
-      const Nodep& q = p;
-      std::cout << "   " << to_string(q) << std::endl;
-    }
+    print_dedagged("log_prob", result.log_prob);
+    print_dedagged("gradients", result.gradients);
+    print_dedagged("queries", result.queries);
+    print_dedagged("joint", result.joint);
+    std::cout << std::endl;
   }
 
-  this->gradients_graph = dedag(opt(gradients));
-  if (print_optimized_code) {
-    std::cout << "\ncode for optimized gradients:\n";
-    for (auto& p : this->gradients_graph.prelude) {
-      std::cout << " " << p.first->name << " = " << to_string(p.second)
-                << std::endl;
-    }
-    for (auto& p : this->gradients_graph.result) {
-      const Nodep& q = p;
-      std::cout << "   " << to_string(q) << std::endl;
-    }
-  }
+  return result;
+}
 
-  this->queries_graph = dedag(opt(queries));
-  if (print_optimized_code) {
-    std::cout << "\ncode for optimized queries:\n";
-    for (auto& p : this->queries_graph.prelude) {
-      std::cout << " " << p.first->name << " = " << to_string(p.second)
-                << std::endl;
-    }
-    for (auto& p : this->queries_graph.result) {
-      const Nodep& q = p;
-      std::cout << "   " << to_string(q) << std::endl;
-    }
-    std::cout << std::endl;
-  }
+// "In a world in which" we evaluate things by computing them the hard way once,
+// symbolically, and then optimize and save the symbolic form for (hopefully)
+// fast recursive evaluation later.  This reduces the memory allocation
+// overhead, because we do not need to allocate nodes for reverse AD.
+class HMCWorld1 : public HMCWorld {
+ private:
+  const Graph& graph;
+  std::unordered_set<Nodep> unobserved_sample_set;
+  std::unordered_map<Nodep, double> observations;
+
+  Dedagged<std::vector<ScalarNodep>> log_prob_graph;
+  Dedagged<std::vector<ScalarNodep>> gradients_graph;
+  Dedagged<std::vector<ScalarNodep>> queries_graph;
+  Dedagged<std::vector<ScalarNodep>> joint_graph;
+
+ public:
+  explicit HMCWorld1(const Graph& graph);
+
+  unsigned num_unobserved_samples() const override;
+
+  double log_prob(
+      const std::vector<double>& proposed_unconstrained_values) const override;
+
+  void gradients(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override;
+
+  void queries(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override;
+
+  void evaluate(
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result) const override;
+};
+
+// An implementation of HMCWorld that compultes things symbolically, once, up
+// front, and then evaluates that symbolic form when required later.
+HMCWorld1::HMCWorld1(const Graph& graph)
+    : graph{graph},
+      unobserved_sample_set{
+          unobserved_samples(graph).begin(),
+          unobserved_samples(graph).end()},
+      observations{observations_by_node(graph)} {
+  auto forms = optimized_forms(graph);
+  this->log_prob_graph = std::move(forms.log_prob);
+  this->gradients_graph = std::move(forms.gradients);
+  this->queries_graph = std::move(forms.queries);
+  this->joint_graph = std::move(forms.joint);
 }
 
 unsigned HMCWorld1::num_unobserved_samples() const {
@@ -453,10 +542,1028 @@ void HMCWorld1::queries(
   eval_saved_dedagged(proposed_unconstrained_values, queries_graph, result);
 }
 
+// Split the results of a joint program (see OptimizedForms) into the log_prob,
+// gradients, and queries.
+void split_joint_results(
+    const std::vector<double>& joint_results,
+    unsigned num_samples,
+    HMCWorldEvalResult& result) {
+  assert(joint_results.size() >= 1 + num_samples);
+  result.log_prob = joint_results[0];
+  result.gradients.assign(
+      joint_results.begin() + 1, joint_results.begin() + 1 + num_samples);
+  result.queries.assign(
+      joint_results.begin() + 1 + num_samples, joint_results.end());
+}
+
+void HMCWorld1::evaluate(
+    const std::vector<double>& proposed_unconstrained_values,
+    HMCWorldEvalResult& result) const {
+  std::vector<double> joint_results;
+  eval_saved_dedagged(
+      proposed_unconstrained_values, joint_graph, joint_results);
+  split_joint_results(joint_results, num_unobserved_samples(), result);
+}
+
+// The operations of the register bytecode executed by HMCWorld2.  Each
+// corresponds to a scalar node type.
+enum class Opcode : unsigned char {
+  ADD,
+  SUBTRACT,
+  NEGATE,
+  MULTIPLY,
+  DIVIDE,
+  POW,
+  EXP,
+  LOG,
+  ATAN,
+  LGAMMA,
+  POLYGAMMA,
+  LOG1P,
+  IF_EQUAL,
+  IF_LESS,
+};
+
+// A bytecode instruction.  It reads its operands from, and writes its result
+// to, registers, which are indices into a single array of doubles.
+struct Instruction {
+  Opcode opcode;
+  unsigned result;
+  std::array<unsigned, 4> args;
+};
+
+// A straight-line bytecode program and the registers holding its results.
+struct BytecodeProgram {
+  std::vector<Instruction> code;
+  std::vector<unsigned> results;
+};
+
+// Compiles dedagged expression trees to bytecode.  Registers are laid out as
+//
+//     [ proposals | constants | temps ]
+//
+// in one array, so that reading a proposal, a constant, or a temp is the same
+// indexed load.  Every distinct constant value occupies a single register of
+// the constant pool.  Because the size of the pool is not known until all of
+// the programs sharing it have been compiled, constant and temp registers are
+// numbered separately while compiling and relocated by `finish`.
+class BytecodeCompiler : public ScalarNodeVisitor {
+ public:
+  explicit BytecodeCompiler(unsigned num_proposals)
+      : num_proposals{num_proposals} {}
+
+  BytecodeProgram compile(const Dedagged<std::vector<ScalarNodep>>& dedagged) {
+    BytecodeProgram program;
+    this->program = &program;
+    prelude_registers.clear();
+    for (int i = 0, n = dedagged.prelude.size(); i < n; i++) {
+      assert(dedagged.prelude[i].first->identifier == ~i);
+      prelude_registers.push_back(
+          compile_scalar(downcast<ScalarNode>(dedagged.prelude[i].second)));
+    }
+    for (auto& r : dedagged.result) {
+      program.results.push_back(compile_scalar(r));
+    }
+    this->program = nullptr;
+    return program;
+  }
+
+  // Relocate the registers of the given programs (which must be all of those
+  // compiled by this compiler) and return the initial contents of the register
+  // file, with the constant pool in place.
+  std::vector<double> finish(const std::vector<BytecodeProgram*>& all) {
+    unsigned num_constants = constants.size();
+    auto relocate = [&](unsigned& r) {
+      if ((r & CONSTANT_BIT) != 0) {
+        r = num_proposals + (r & ~CONSTANT_BIT);
+      } else if (r >= num_proposals) {
+        r += num_constants;
+      }
+    };
+    for (auto p : all) {
+      for (auto& instruction : p->code) {
+        relocate(instruction.result);
+        for (auto& a : instruction.args) {
+          relocate(a);
+        }
+      }
+      for (auto& r : p->results) {
+        relocate(r);
+      }
+    }
+    std::vector<double> registers(
+        num_proposals + num_constants + num_temps, 0);
+    std::copy(
+        constants.begin(), constants.end(), registers.begin() + num_proposals);
+    return registers;
+  }
+
+ private:
+  static constexpr unsigned CONSTANT_BIT = 1u << 31;
+
+  const unsigned num_proposals;
+  unsigned num_temps = 0;
+  std::vector<double> constants;
+  // The constant pool is keyed by bit pattern so that, for example, 0.0 and
+  // -0.0 are kept distinct.
+  std::unordered_map<std::uint64_t, unsigned> constant_registers;
+  std::vector<unsigned> prelude_registers;
+  BytecodeProgram* program = nullptr;
+  unsigned result;
+
+  unsigned compile_scalar(const ScalarNodep& node) {
+    node->accept(*this);
+    return result;
+  }
+
+  void emit(Opcode opcode, std::initializer_list<ScalarNodep> inputs) {
+    Instruction instruction{opcode, 0, {0, 0, 0, 0}};
+    int i = 0;
+    for (auto& input : inputs) {
+      instruction.args[i++] = compile_scalar(input);
+    }
+    instruction.result = num_proposals + num_temps++;
+    program->code.push_back(instruction);
+    result = instruction.result;
+  }
+
+  void visit(const ScalarConstantNode* node) override {
+    auto key = std::bit_cast<std::uint64_t>(node->constant_value);
+    auto found = constant_registers.find(key);
+    if (found != constant_registers.end()) {
+      result = found->second;
+      return;
+    }
+    result = CONSTANT_BIT | constants.size();
+    constants.push_back(node->constant_value);
+    constant_registers[key] = result;
+  }
+  void visit(const ScalarVariableNode* node) override {
+    result = (node->identifier >= 0) ? node->identifier
+                                     : prelude_registers[~node->identifier];
+  }
+  void visit(const ScalarSampleNode*) override {
+    throw std::logic_error("bytecode may not sample");
+  }
+  void visit(const ScalarAddNode* node) override {
+    emit(Opcode::ADD, {node->left, node->right});
+  }
+  void visit(const ScalarSubtractNode* node) override {
+    emit(Opcode::SUBTRACT, {node->left, node->right});
+  }
+  void visit(const ScalarNegateNode* node) override {
+    emit(Opcode::NEGATE, {node->x});
+  }
+  void visit(const ScalarMultiplyNode* node) override {
+    emit(Opcode::MULTIPLY, {node->left, node->right});
+  }
+  void visit(const ScalarDivideNode* node) override {
+    emit(Opcode::DIVIDE, {node->left, node->right});
+  }
+  void visit(const ScalarPowNode* node) override {
+    emit(Opcode::POW, {node->left, node->right});
+  }
+  void visit(const ScalarExpNode* node) override {
+    emit(Opcode::EXP, {node->x});
+  }
+  void visit(const ScalarLogNode* node) override {
+    emit(Opcode::LOG, {node->x});
+  }
+  void visit(const ScalarAtanNode* node) override {
+    emit(Opcode::ATAN, {node->x});
+  }
+  void visit(const ScalarLgammaNode* node) override {
+    emit(Opcode::LGAMMA, {node->x});
+  }
+  void visit(const ScalarPolygammaNode* node) override {
+    emit(Opcode::POLYGAMMA, {node->n, node->x});
+  }
+  void visit(const ScalarLog1pNode* node) override {
+    emit(Opcode::LOG1P, {node->x});
+  }
+  void visit(const ScalarIfEqualNode* node) override {
+    emit(Opcode::IF_EQUAL, {node->a, node->b, node->c, node->d});
+  }
+  void visit(const ScalarIfLessNode* node) override {
+    emit(Opcode::IF_LESS, {node->a, node->b, node->c, node->d});
+  }
+};
+
+// The number of chains evaluated together by the batched forms of HMCWorld2
+// and HMCWorld3.
+const int CHAIN_BLOCK = 8;
+
+// "In a world in which" we compute things symbolically once, as in HMCWorld1,
+// and then compile the optimized symbolic form to a register bytecode.
+// Evaluation is a single loop over a flat array of instructions, rather than a
+// recursive walk of the expression trees through virtual calls.
+class HMCWorld2 : public HMCWorld {
+ private:
+  unsigned num_samples;
+  BytecodeProgram log_prob_program;
+  BytecodeProgram gradients_program;
+  BytecodeProgram queries_program;
+  BytecodeProgram joint_program;
+  // The register file with the constant pool filled in.  Each evaluation
+  // starts from a copy of this.
+  std::vector<double> initial_registers;
+
+  void run(
+      const BytecodeProgram& program,
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const;
+
+  void run_batch(
+      const BytecodeProgram& program,
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::MatrixXd& result) const;
+
+ public:
+  HMCWorld2(unsigned num_samples, const OptimizedForms& forms);
+
+  unsigned num_unobserved_samples() const override;
+
+  double log_prob(
+      const std::vector<double>& proposed_unconstrained_values) const override;
+
+  void gradients(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override;
+
+  void queries(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override;
+
+  void log_prob_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& result) const override;
+
+  void gradients_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::MatrixXd& result) const override;
+
+  void evaluate(
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result) const override;
+
+  void evaluate_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& log_probs,
+      Eigen::MatrixXd& gradients,
+      Eigen::MatrixXd& queries) const override;
+};
+
+HMCWorld2::HMCWorld2(unsigned num_samples, const OptimizedForms& forms)
+    : num_samples(num_samples) {
+  BytecodeCompiler compiler{num_samples};
+  log_prob_program = compiler.compile(forms.log_prob);
+  gradients_program = compiler.compile(forms.gradients);
+  queries_program = compiler.compile(forms.queries);
+  joint_program = compiler.compile(forms.joint);
+  initial_registers = compiler.finish(
+      {&log_prob_program,
+       &gradients_program,
+       &queries_program,
+       &joint_program});
+}
+
+unsigned HMCWorld2::num_unobserved_samples() const {
+  return num_samples;
+}
+
+void HMCWorld2::run(
+    const BytecodeProgram& program,
+    const std::vector<double>& proposed_unconstrained_values,
+    std::vector<double>& result) const {
+  assert(proposed_unconstrained_values.size() == num_samples);
+  std::vector<double> registers = initial_registers;
+  std::copy(
+      proposed_unconstrained_values.begin(),
+      proposed_unconstrained_values.end(),
+      registers.begin());
+  double* r = registers.data();
+  for (const auto& instruction : program.code) {
+    const auto& a = instruction.args;
+    double& out = r[instruction.result];
+    switch (instruction.opcode) {
+      case Opcode::ADD:
+        out = r[a[0]] + r[a[1]];
+        break;
+      case Opcode::SUBTRACT:
+        out = r[a[0]] - r[a[1]];
+        break;
+      case Opcode::NEGATE:
+        out = -r[a[0]];
+        break;
+      case Opcode::MULTIPLY:
+        out = r[a[0]] * r[a[1]];
+        break;
+      case Opcode::DIVIDE:
+        out = r[a[0]] / r[a[1]];
+        break;
+      case Opcode::POW:
+        out = std::pow(r[a[0]], r[a[1]]);
+        break;
+      case Opcode::EXP:
+        out = std::exp(r[a[0]]);
+        break;
+      case Opcode::LOG:
+        out = std::log(r[a[0]]);
+        break;
+      case Opcode::ATAN:
+        out = std::atan(r[a[0]]);
+        break;
+      case Opcode::LGAMMA:
+        out = std::lgamma(r[a[0]]);
+        break;
+      case Opcode::POLYGAMMA:
+        out = polygamma((int)r[a[0]], Real{r[a[1]]}).as_double();
+        break;
+      case Opcode::LOG1P:
+        out = std::log1p(r[a[0]]);
+        break;
+      case Opcode::IF_EQUAL:
+        out = (r[a[0]] == r[a[1]]) ? r[a[2]] : r[a[3]];
+        break;
+      case Opcode::IF_LESS:
+        out = (r[a[0]] < r[a[1]]) ? r[a[2]] : r[a[3]];
+        break;
+    }
+  }
+  result.resize(program.results.size());
+  for (int i = 0, n = program.results.size(); i < n; i++) {
+    result[i] = r[program.results[i]];
+  }
+}
+
+// Runs a program for a batch of chains.  The chains are evaluated in blocks of
+// CHAIN_BLOCK, with each register holding one value per chain of the block,
+// contiguously, so that each instruction is a fixed-length loop over the
+// chains that the compiler can vectorize, and the register file of a block
+// stays in cache.
+void HMCWorld2::run_batch(
+    const BytecodeProgram& program,
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::MatrixXd& result) const {
+  assert(proposed_unconstrained_values.cols() == num_samples);
+  const long m = proposed_unconstrained_values.rows();
+  const int L = CHAIN_BLOCK;
+  result.resize(m, program.results.size());
+
+  // Temps are always written before they are read, and constants are never
+  // written, so the register file need only be initialized once.
+  thread_local std::vector<double> registers;
+  registers.resize(initial_registers.size() * L);
+  for (int i = 0, n = initial_registers.size(); i < n; i++) {
+    std::fill_n(registers.begin() + i * L, L, initial_registers[i]);
+  }
+  double* r = registers.data();
+  for (long block = 0; block < m; block += L) {
+    // Lanes past the last chain compute unused values.
+    const long lanes = std::min<long>(L, m - block);
+    for (unsigned j = 0; j < num_samples; j++) {
+      for (long c = 0; c < lanes; c++) {
+        r[j * L + c] = proposed_unconstrained_values(block + c, j);
+      }
+    }
+    for (const auto& instruction : program.code) {
+      const auto& a = instruction.args;
+      double* out = r + instruction.result * L;
+      const double* x = r + a[0] * L;
+      const double* y = r + a[1] * L;
+      const double* z = r + a[2] * L;
+      const double* w = r + a[3] * L;
+      switch (instruction.opcode) {
+        case Opcode::ADD:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = x[c] + y[c];
+          }
+          break;
+        case Opcode::SUBTRACT:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = x[c] - y[c];
+          }
+          break;
+        case Opcode::NEGATE:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = -x[c];
+          }
+          break;
+        case Opcode::MULTIPLY:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = x[c] * y[c];
+          }
+          break;
+        case Opcode::DIVIDE:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = x[c] / y[c];
+          }
+          break;
+        case Opcode::POW:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::pow(x[c], y[c]);
+          }
+          break;
+        case Opcode::EXP:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::exp(x[c]);
+          }
+          break;
+        case Opcode::LOG:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::log(x[c]);
+          }
+          break;
+        case Opcode::ATAN:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::atan(x[c]);
+          }
+          break;
+        case Opcode::LGAMMA:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::lgamma(x[c]);
+          }
+          break;
+        case Opcode::POLYGAMMA:
+          for (int c = 0; c < L; c++) {
+            out[c] = polygamma((int)x[c], Real{y[c]}).as_double();
+          }
+          break;
+        case Opcode::LOG1P:
+          for (int c = 0; c < L; c++) {
+            out[c] = std::log1p(x[c]);
+          }
+          break;
+        case Opcode::IF_EQUAL:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = (x[c] == y[c]) ? z[c] : w[c];
+          }
+          break;
+        case Opcode::IF_LESS:
+          MINIBMG_CHAIN_LOOP
+          for (int c = 0; c < L; c++) {
+            out[c] = (x[c] < y[c]) ? z[c] : w[c];
+          }
+          break;
+      }
+    }
+    for (int i = 0, n = program.results.size(); i < n; i++) {
+      for (long c = 0; c < lanes; c++) {
+        result(block + c, i) = r[program.results[i] * L + c];
+      }
+    }
+  }
+}
+
+double HMCWorld2::log_prob(
+    const std::vector<double>& proposed_unconstrained_values) const {
+  std::vector<double> result;
+  run(log_prob_program, proposed_unconstrained_values, result);
+  assert(!result.empty());
+  return result[0];
+}
+
+void HMCWorld2::gradients(
+    const std::vector<double>& proposed_unconstrained_values,
+    std::vector<double>& result) const {
+  run(gradients_program, proposed_unconstrained_values, result);
+}
+
+void HMCWorld2::queries(
+    const std::vector<double>& proposed_unconstrained_values,
+    std::vector<double>& result) const {
+  run(queries_program, proposed_unconstrained_values, result);
+}
+
+void HMCWorld2::log_prob_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::VectorXd& result) const {
+  Eigen::MatrixXd log_probs;
+  run_batch(log_prob_program, proposed_unconstrained_values, log_probs);
+  result = log_probs.col(0);
+}
+
+void HMCWorld2::gradients_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::MatrixXd& result) const {
+  run_batch(gradients_program, proposed_unconstrained_values, result);
+}
+
+void HMCWorld2::evaluate(
+    const std::vector<double>& proposed_unconstrained_values,
+    HMCWorldEvalResult& result) const {
+  std::vector<double> joint_results;
+  run(joint_program, proposed_unconstrained_values, joint_results);
+  split_joint_results(joint_results, num_samples, result);
+}
+
+void HMCWorld2::evaluate_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::VectorXd& log_probs,
+    Eigen::MatrixXd& gradients,
+    Eigen::MatrixXd& queries) const {
+  Eigen::MatrixXd joint_results;
+  run_batch(joint_program, proposed_unconstrained_values, joint_results);
+  log_probs = joint_results.col(0);
+  gradients = joint_results.middleCols(1, num_samples);
+  queries = joint_results.rightCols(joint_results.cols() - 1 - num_samples);
+}
+
+// Generates C++ source for dedagged expression trees.  Proposals are read from
+// the array `p`, and each entry of the prelude becomes a local constant.
+class CppEmitter : public ScalarNodeVisitor {
+ public:
+  bool uses_polygamma = false;
+
+  // Emit a function with C linkage that computes the results of the given
+  // dedagged program into the array `r`.
+  std::string emit_function(
+      const std::string& name,
+      const Dedagged<std::vector<ScalarNodep>>& dedagged) {
+    std::string body = fmt::format(
+        "extern \"C\" void {}(const double* p, double* r) {{\n", name);
+    for (int i = 0, n = dedagged.prelude.size(); i < n; i++) {
+      body += fmt::format(
+          "  const double t{} = {};\n",
+          i,
+          emit(downcast<ScalarNode>(dedagged.prelude[i].second)));
+    }
+    for (int i = 0, n = dedagged.result.size(); i < n; i++) {
+      body += fmt::format("  r[{}] = {};\n", i, emit(dedagged.result[i]));
+    }
+    return body + "}\n";
+  }
+
+  // Emit a function with C linkage that computes the results of the given
+  // dedagged program for a batch of `n` chains.  The proposals `p` and the
+  // results `r` are column-major matrices with a row for each chain.  As in the
+  // batched bytecode of HMCWorld2, the chains are evaluated in blocks of
+  // CHAIN_BLOCK, each entry of the prelude becoming an array with one value
+  // per chain of the block computed by a loop that the compiler can vectorize.
+  std::string emit_batch_function(
+      const std::string& name,
+      const Dedagged<std::vector<ScalarNodep>>& dedagged,
+      unsigned num_samples) {
+    batched = true;
+    std::string body = fmt::format(
+        "extern \"C\" void {0}(const double* p, double* r, long n) {{\n"
+        "  const int L = {1};\n"
+        "  for (long b = 0; b < n; b += L) {{\n"
+        "    const long lanes = (n - b < L) ? n - b : L;\n"
+        "    double q[{2}][L] = {{}};\n"
+        "    for (int j = 0; j < {3}; j++) {{\n"
+        "      for (long c = 0; c < lanes; c++) {{\n"
+        "        q[j][c] = p[j * n + b + c];\n"
+        "      }}\n"
+        "    }}\n",
+        name,
+        CHAIN_BLOCK,
+        std::max(num_samples, 1u),
+        num_samples);
+    for (int i = 0, n = dedagged.prelude.size(); i < n; i++) {
+      body += fmt::format(
+          "    double t{0}[L];\n"
+          "#pragma omp simd\n"
+          "    for (int c = 0; c < L; c++) {{\n"
+          "      t{0}[c] = {1};\n"
+          "    }}\n",
+          i,
+          emit(downcast<ScalarNode>(dedagged.prelude[i].second)));
+    }
+    for (int i = 0, n = dedagged.result.size(); i < n; i++) {
+      body += fmt::format(
+          "    for (long c = 0; c < lanes; c++) {{\n"
+          "      r[{} * n + b + c] = {};\n"
+          "    }}\n",
+          i,
+          emit(dedagged.result[i]));
+    }
+    batched = false;
+    return body + "  }\n}\n";
+  }
+
+ private:
+  std::string result;
+  bool batched = false;
+
+  std::string emit(const ScalarNodep& node) {
+    node->accept(*this);
+    return std::move(result);
+  }
+
+  void visit(const ScalarConstantNode* node) override {
+    double value = node->constant_value;
+    if (std::isnan(value)) {
+      result = "std::numeric_limits<double>::quiet_NaN()";
+    } else if (std::isinf(value)) {
+      result = (value > 0) ? "std::numeric_limits<double>::infinity()"
+                           : "(-std::numeric_limits<double>::infinity())";
+    } else {
+      // Hexadecimal floating-point literals are exact.
+      result = fmt::format("({:a})", value);
+    }
+  }
+  void visit(const ScalarVariableNode* node) override {
+    if (node->identifier < 0) {
+      result = batched ? fmt::format("t{}[c]", ~node->identifier)
+                       : fmt::format("t{}", ~node->identifier);
+    } else if (batched) {
+      result = fmt::format("q[{}][c]", node->identifier);
+    } else {
+      result = fmt::format("p[{}]", node->identifier);
+    }
+  }
+  void visit(const ScalarSampleNode*) override {
+    throw std::logic_error("generated code may not sample");
+  }
+  void visit(const ScalarAddNode* node) override {
+    result = fmt::format("({} + {})", emit(node->left), emit(node->right));
+  }
+  void visit(const ScalarSubtractNode* node) override {
+    result = fmt::format("({} - {})", emit(node->left), emit(node->right));
+  }
+  void visit(const ScalarNegateNode* node) override {
+    result = fmt::format("(-{})", emit(node->x));
+  }
+  void visit(const ScalarMultiplyNode* node) override {
+    result = fmt::format("({} * {})", emit(node->left), emit(node->right));
+  }
+  void visit(const ScalarDivideNode* node) override {
+    result = fmt::format("({} / {})", emit(node->left), emit(node->right));
+  }
+  void visit(const ScalarPowNode* node) override {
+    result =
+        fmt::format("std::pow({}, {})", emit(node->left), emit(node->right));
+  }
+  void visit(const ScalarExpNode* node) override {
+    result = fmt::format("std::exp({})", emit(node->x));
+  }
+  void visit(const ScalarLogNode* node) override {
+    result = fmt::format("std::log({})", emit(node->x));
+  }
+  void visit(const ScalarAtanNode* node) override {
+    result = fmt::format("std::atan({})", emit(node->x));
+  }
+  void visit(const ScalarLgammaNode* node) override {
+    result = fmt::format("std::lgamma({})", emit(node->x));
+  }
+  void visit(const ScalarPolygammaNode* node) override {
+    uses_polygamma = true;
+    result = fmt::format(
+        "boost::math::polygamma((int){}, {})", emit(node->n), emit(node->x));
+  }
+  void visit(const ScalarLog1pNode* node) override {
+    result = fmt::format("std::log1p({})", emit(node->x));
+  }
+  void visit(const ScalarIfEqualNode* node) override {
+    result = fmt::format(
+        "({} == {} ? {} : {})",
+        emit(node->a),
+        emit(node->b),
+        emit(node->c),
+        emit(node->d));
+  }
+  void visit(const ScalarIfLessNode* node) override {
+    result = fmt::format(
+        "({} < {} ? {} : {})",
+        emit(node->a),
+        emit(node->b),
+        emit(node->c),
+        emit(node->d));
+  }
+};
+
+std::string generate_cpp(const OptimizedForms& forms, unsigned num_samples) {
+  CppEmitter emitter;
+  std::string functions = emitter.emit_function("log_prob", forms.log_prob) +
+      emitter.emit_function("gradients", forms.gradients) +
+      emitter.emit_function("queries", forms.queries) +
+      emitter.emit_function("evaluate", forms.joint) +
+      emitter.emit_batch_function(
+          "log_prob_batch", forms.log_prob, num_samples) +
+      emitter.emit_batch_function(
+          "gradients_batch", forms.gradients, num_samples) +
+      emitter.emit_batch_function("evaluate_batch", forms.joint, num_samples);
+  std::string includes = "#include <cmath>\n#include <limits>\n";
+  if (emitter.uses_polygamma) {
+    includes += "#include <boost/math/special_functions/polygamma.hpp>\n";
+  }
+  return includes + functions;
+}
+
+// The 64-bit FNV-1a hash, which (unlike std::hash) is the same in every process
+// and so can be used to name files in the on-disk cache.
+std::uint64_t fnv1a(std::string_view data) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// The directory in which compiled models are cached: $MINIBMG_CACHE_DIR if
+// set, otherwise a minibmg directory in the system's temporary directory.
+std::filesystem::path cache_directory() {
+  if (const char* dir = std::getenv("MINIBMG_CACHE_DIR"); dir && *dir) {
+    return dir;
+  }
+  std::error_code error;
+  auto temp = std::filesystem::temp_directory_path(error);
+  return error ? std::filesystem::path{"minibmg"} : temp / "minibmg";
+}
+
+#ifndef _WIN32
+
+// Increment this whenever the generated code changes, so that libraries
+// generated by earlier versions are not reused.
+const int NATIVE_CODE_VERSION = 3;
+
+const char* const NATIVE_CODE_FLAGS =
+    "-std=c++17 -O2 -fopenmp-simd -shared -fPIC";
+
+std::string native_compiler() {
+  const char* cxx = std::getenv("CXX");
+  return (cxx && *cxx) ? cxx : "c++";
+}
+
+std::string shell_quote(const std::string& s) {
+  std::string result = "'";
+  for (char c : s) {
+    result += (c == '\'') ? std::string{"'\\''"} : std::string{c};
+  }
+  return result + "'";
+}
+
+// Compile the generated source into a shared library at `library`.  The
+// library is written to a temporary file and then renamed, so that concurrent
+// processes never load a partially written library.
+bool compile_native_library(
+    const std::string& source,
+    const std::filesystem::path& library) {
+  std::error_code error;
+  std::filesystem::create_directories(library.parent_path(), error);
+  if (error) {
+    return false;
+  }
+  std::string unique = fmt::format(
+      "{}.{}",
+      ::getpid(),
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  auto source_path = library;
+  source_path.replace_extension(unique + ".cpp");
+  auto temp_library = library;
+  temp_library.replace_extension(unique + ".tmp");
+  {
+    std::ofstream out{source_path};
+    out << source;
+    if (!out) {
+      return false;
+    }
+  }
+  std::string command = fmt::format(
+      "{} {} -o {} {} > /dev/null 2>&1",
+      shell_quote(native_compiler()),
+      NATIVE_CODE_FLAGS,
+      shell_quote(temp_library.string()),
+      shell_quote(source_path.string()));
+  bool compiled = std::system(command.c_str()) == 0;
+  std::filesystem::remove(source_path, error);
+  if (compiled) {
+    std::filesystem::rename(temp_library, library, error);
+    compiled = !error;
+  }
+  std::filesystem::remove(temp_library, error);
+  return compiled;
+}
+
+// "In a world in which" we compute things symbolically once, as in HMCWorld1,
+// and then generate, compile, and load native code for the optimized symbolic
+// form.
+class HMCWorld3 : public HMCWorld {
+ public:
+  // The functions of a library compiled from the output of generate_cpp.
+  struct Functions {
+    using Function = void (*)(const double*, double*);
+    using BatchFunction = void (*)(const double*, double*, long);
+    Function log_prob;
+    Function gradients;
+    Function queries;
+    Function evaluate;
+    BatchFunction log_prob_batch;
+    BatchFunction gradients_batch;
+    BatchFunction evaluate_batch;
+  };
+
+ private:
+  unsigned num_samples;
+  unsigned num_queries;
+  void* library;
+  Functions functions;
+
+ public:
+  HMCWorld3(
+      unsigned num_samples,
+      unsigned num_queries,
+      void* library,
+      const Functions& functions)
+      : num_samples{num_samples},
+        num_queries{num_queries},
+        library{library},
+        functions{functions} {}
+
+  // Load a library compiled from the output of generate_cpp, returning nullptr
+  // if it is not present or cannot be loaded.
+  static std::unique_ptr<const HMCWorld> load(
+      const std::filesystem::path& path,
+      unsigned num_samples,
+      unsigned num_queries) {
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+      return nullptr;
+    }
+    void* library = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+      return nullptr;
+    }
+    Functions functions{
+        (Functions::Function)::dlsym(library, "log_prob"),
+        (Functions::Function)::dlsym(library, "gradients"),
+        (Functions::Function)::dlsym(library, "queries"),
+        (Functions::Function)::dlsym(library, "evaluate"),
+        (Functions::BatchFunction)::dlsym(library, "log_prob_batch"),
+        (Functions::BatchFunction)::dlsym(library, "gradients_batch"),
+        (Functions::BatchFunction)::dlsym(library, "evaluate_batch")};
+    if (!functions.log_prob || !functions.gradients || !functions.queries ||
+        !functions.evaluate || !functions.log_prob_batch ||
+        !functions.gradients_batch || !functions.evaluate_batch) {
+      ::dlclose(library);
+      return nullptr;
+    }
+    return std::make_unique<HMCWorld3>(
+        num_samples, num_queries, library, functions);
+  }
+
+  ~HMCWorld3() override {
+    ::dlclose(library);
+  }
+
+  unsigned num_unobserved_samples() const override {
+    return num_samples;
+  }
+
+  double log_prob(const std::vector<double>& proposed_unconstrained_values)
+      const override {
+    assert(proposed_unconstrained_values.size() == num_samples);
+    double result;
+    functions.log_prob(proposed_unconstrained_values.data(), &result);
+    return result;
+  }
+
+  void gradients(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override {
+    assert(proposed_unconstrained_values.size() == num_samples);
+    result.resize(num_samples);
+    functions.gradients(proposed_unconstrained_values.data(), result.data());
+  }
+
+  void queries(
+      const std::vector<double>& proposed_unconstrained_values,
+      std::vector<double>& result) const override {
+    assert(proposed_unconstrained_values.size() == num_samples);
+    result.resize(num_queries);
+    functions.queries(proposed_unconstrained_values.data(), result.data());
+  }
+
+  void log_prob_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& result) const override {
+    assert(proposed_unconstrained_values.cols() == num_samples);
+    const long m = proposed_unconstrained_values.rows();
+    result.resize(m);
+    functions.log_prob_batch(
+        proposed_unconstrained_values.data(), result.data(), m);
+  }
+
+  void gradients_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::MatrixXd& result) const override {
+    assert(proposed_unconstrained_values.cols() == num_samples);
+    const long m = proposed_unconstrained_values.rows();
+    result.resize(m, num_samples);
+    functions.gradients_batch(
+        proposed_unconstrained_values.data(), result.data(), m);
+  }
+
+  void evaluate(
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result) const override {
+    assert(proposed_unconstrained_values.size() == num_samples);
+    std::vector<double> joint_results(1 + num_samples + num_queries);
+    functions.evaluate(
+        proposed_unconstrained_values.data(), joint_results.data());
+    split_joint_results(joint_results, num_samples, result);
+  }
+
+  void evaluate_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& log_probs,
+      Eigen::MatrixXd& gradients,
+      Eigen::MatrixXd& queries) const override {
+    assert(proposed_unconstrained_values.cols() == num_samples);
+    const long m = proposed_unconstrained_values.rows();
+    Eigen::MatrixXd joint_results(m, 1 + num_samples + num_queries);
+    functions.evaluate_batch(
+        proposed_unconstrained_values.data(), joint_results.data(), m);
+    log_probs = joint_results.col(0);
+    gradients = joint_results.middleCols(1, num_samples);
+    queries = joint_results.rightCols(num_queries);
+  }
+};
+
+#endif // _WIN32
+
 } // namespace
 
 namespace beanmachine::minibmg {
 
+void HMCWorld::log_prob_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::VectorXd& result) const {
+  const long m = proposed_unconstrained_values.rows();
+  const long n = proposed_unconstrained_values.cols();
+  result.resize(m);
+  std::vector<double> proposals(n);
+  for (long c = 0; c < m; c++) {
+    for (long j = 0; j < n; j++) {
+      proposals[j] = proposed_unconstrained_values(c, j);
+    }
+    result[c] = log_prob(proposals);
+  }
+}
+
+void HMCWorld::gradients_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::MatrixXd& result) const {
+  const long m = proposed_unconstrained_values.rows();
+  const long n = proposed_unconstrained_values.cols();
+  result.resize(m, n);
+  std::vector<double> proposals(n), chain_gradients;
+  for (long c = 0; c < m; c++) {
+    for (long j = 0; j < n; j++) {
+      proposals[j] = proposed_unconstrained_values(c, j);
+    }
+    gradients(proposals, chain_gradients);
+    for (long j = 0; j < n; j++) {
+      result(c, j) = chain_gradients[j];
+    }
+  }
+}
+
+void HMCWorld::evaluate(
+    const std::vector<double>& proposed_unconstrained_values,
+    HMCWorldEvalResult& result) const {
+  result.log_prob = log_prob(proposed_unconstrained_values);
+  gradients(proposed_unconstrained_values, result.gradients);
+  queries(proposed_unconstrained_values, result.queries);
+}
+
+void HMCWorld::evaluate_batch(
+    const Eigen::MatrixXd& proposed_unconstrained_values,
+    Eigen::VectorXd& log_probs,
+    Eigen::MatrixXd& gradients,
+    Eigen::MatrixXd& queries) const {
+  const long m = proposed_unconstrained_values.rows();
+  const long n = proposed_unconstrained_values.cols();
+  log_probs.resize(m);
+  gradients.resize(m, n);
+  queries.resize(m, 0);
+  std::vector<double> proposals(n);
+  HMCWorldEvalResult result;
+  for (long c = 0; c < m; c++) {
+    for (long j = 0; j < n; j++) {
+      proposals[j] = proposed_unconstrained_values(c, j);
+    }
+    evaluate(proposals, result);
+    if (c == 0) {
+      queries.resize(m, result.queries.size());
+    }
+    log_probs[c] = result.log_prob;
+    for (long j = 0; j < n; j++) {
+      gradients(c, j) = result.gradients[j];
+    }
+    for (int j = 0, nq = result.queries.size(); j < nq; j++) {
+      queries(c, j) = result.queries[j];
+    }
+  }
+}
+
 std::unique_ptr<const HMCWorld> hmc_world_0(const Graph& graph) {
   return std::make_unique<HMCWorld0>(graph);
 }
@@ -465,8 +1572,42 @@ std::unique_ptr<const HMCWorld> hmc_world_1(const Graph& graph) {
   return std::make_unique<HMCWorld1>(graph);
 }
 
-std::unique_ptr<const HMCWorld> hmc_world_2(const Graph&) {
-  throw std::logic_error("hmc_world_2 not implemented");
+std::unique_ptr<const HMCWorld> hmc_world_2(const Graph& graph) {
+  return std::make_unique<HMCWorld2>(
+      unobserved_samples(graph).size(), optimized_forms(graph));
+}
+
+std::unique_ptr<const HMCWorld> hmc_world_3(const Graph& graph) {
+  unsigned num_samples = unobserved_samples(graph).size();
+#ifdef _WIN32
+  return std::make_unique<HMCWorld2>(num_samples, optimized_forms(graph));
+#else
+  unsigned num_queries = graph.queries.size();
+  std::string key = fmt::format(
+      "{}\n{}\n{}\n{}",
+      NATIVE_CODE_VERSION,
+      native_compiler(),
+      NATIVE_CODE_FLAGS,
+      folly::toJson(graph_to_json(graph)));
+  auto path = cache_directory() /
+      fmt::format("hmc_world_{:016x}.so", fnv1a(key));
+
+  // A library compiled earlier, perhaps by another process, needs neither
+  // optimization nor compilation.
+  if (auto world = HMCWorld3::load(path, num_samples, num_queries)) {
+    return world;
+  }
+
+  auto forms = optimized_forms(graph);
+  if (compile_native_library(generate_cpp(forms, num_samples), path)) {
+    if (auto world = HMCWorld3::load(path, num_samples, num_queries)) {
+      return world;
+    }
+  }
+
+  // If there is no working compiler, fall back to interpretation.
+  return std::make_unique<HMCWorld2>(num_samples, forms);
+#endif
 }
 
 } // namespace beanmachine::minibmg
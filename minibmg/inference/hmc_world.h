@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <Eigen/Dense>
 #include <array>
 #include <memory>
 #include <vector>
@@ -15,7 +16,11 @@
 namespace beanmachine::minibmg {
 
 // The result of calling HMCWorld::evaluate
-struct HMCWorldEvalResult;
+struct HMCWorldEvalResult {
+  double log_prob;
+  std::vector<double> gradients;
+  std::vector<double> queries;
+};
 
 // This interface defines an abstraction of a graph containing exactly and only
 // what is needed for some inference methods, such as gradient ascent
@@ -59,6 +64,37 @@ class HMCWorld {
       const std::vector<double>& proposed_unconstrained_values,
       std::vector<double>& result) const = 0;
 
+  // Given proposed assigned values for all of the unobserved samples in the
+  // model (as in log_prob), compute the log probability, its gradients, and
+  // the queries together, sharing the computation common to them.  This is what
+  // inference needs at each step.  The default implementation calls log_prob,
+  // gradients, and queries.
+  virtual void evaluate(
+      const std::vector<double>& proposed_unconstrained_values,
+      HMCWorldEvalResult& result) const;
+
+  // Batched forms of log_prob and gradients, for running several chains on the
+  // same model.  Row c of the (chains x num_unobserved_samples) matrix
+  // `proposed_unconstrained_values` holds the proposed values of chain c, and
+  // row c of the result holds the log probability or gradients for that chain.
+  // The default implementations evaluate one chain at a time; a world may
+  // override them to evaluate all of the chains together, vectorized over the
+  // chains.
+  virtual void log_prob_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& result) const;
+  virtual void gradients_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::MatrixXd& result) const;
+
+  // The batched form of evaluate.  Row c of each result holds the log
+  // probability, gradients, or queries for chain c.
+  virtual void evaluate_batch(
+      const Eigen::MatrixXd& proposed_unconstrained_values,
+      Eigen::VectorXd& log_probs,
+      Eigen::MatrixXd& gradients,
+      Eigen::MatrixXd& queries) const;
+
   virtual ~HMCWorld() {}
 };
 
@@ -70,15 +106,29 @@ std::unique_ptr<const HMCWorld> hmc_world_0(const Graph& graph);
 // produce an abstraction of the graph for use by inference.  This
 // implementation performs its work by evaluating the graph symbolically,
 // optimizing the symbolic form, and cacheing it for later use.  Then it
-// evaluates the optimized expression graph when needed.  You can think of this
-// as a bytecode compiler and bytecode interpreter for the graph.
+// evaluates the optimized expression trees recursively when needed.  You can
+// think of this as a tree-walking interpreter for the optimized graph.
 std::unique_ptr<const HMCWorld> hmc_world_1(const Graph& graph);
 
 // produce an abstraction of the graph for use by inference.  This
-// implementation performs its work by evaluating the graph symbolically,
-// optimizing the symbolic form, generating native machine code from that, and
-// cacheing that code for later use.  Then it calls the generated native code
-// when needed.  This can be considered a JIT compiler for the graph.
+// implementation optimizes the symbolic form as in hmc_world_1, and then
+// compiles it to a register bytecode whose registers (the proposed values, a
+// pool of constants, and temporaries) live in one contiguous array.  You can
+// think of this as a bytecode compiler and bytecode interpreter for the graph.
+// Batches of chains are evaluated with one value per chain in each register,
+// so that each instruction is a loop over the chains.
 std::unique_ptr<const HMCWorld> hmc_world_2(const Graph& graph);
 
+// produce an abstraction of the graph for use by inference.  This
+// implementation generates C++ code from the optimized symbolic form, compiles
+// it with the system's compiler ($CXX, or c++) into a shared library, and loads
+// that library.  Libraries are cached on disk ($MINIBMG_CACHE_DIR, or a minibmg
+// directory in the system's temporary directory) keyed by a hash of
+// graph_to_json(graph), so a model that was seen before is neither optimized
+// nor compiled again.  If the code cannot be compiled or loaded, this falls
+// back to the bytecode interpreter of hmc_world_2.  The generated batched
+// functions loop over the chains, so that the compiler may vectorize them.
+// This can be considered a JIT compiler for the graph.
+std::unique_ptr<const HMCWorld> hmc_world_3(const Graph& graph);
+
 } // namespace beanmachine::minibmg
@@ -9,6 +9,7 @@
 #include <boost/functional/hash.hpp>
 #include <fmt/format.h>
 #include <atomic>
+#include <stdexcept>
 #include <typeinfo>
 #include "beanmachine/minibmg/pretty.h"
 
@@ -39,6 +40,34 @@ inline std::size_t hash_combine(const std::vector<std::size_t>& many) {
   return seed;
 }
 
+inline std::size_t hash_values(const std::vector<double>& values) {
+  return boost::hash_range(values.begin(), values.end());
+}
+
+// The size of the elementwise combination of two vectors.
+unsigned elementwise_size(const VectorNodep& left, const VectorNodep& right) {
+  if (left->size != right->size) {
+    throw std::invalid_argument(fmt::format(
+        "vector sizes {} and {} do not match", left->size, right->size));
+  }
+  return left->size;
+}
+
+unsigned matmul_size(
+    const ConstantMatrixp& matrix,
+    const VectorNodep& x,
+    bool transposed) {
+  unsigned rows = transposed ? matrix->cols : matrix->rows;
+  unsigned cols = transposed ? matrix->rows : matrix->cols;
+  if (cols != x->size) {
+    throw std::invalid_argument(fmt::format(
+        "cannot multiply a matrix with {} columns by a vector of size {}",
+        cols,
+        x->size));
+  }
+  return rows;
+}
+
 // A visitor class used to implement in_nodes.
 class in_node_gatherer : public NodeVisitor {
  private:
@@ -104,6 +133,36 @@ class in_node_gatherer : public NodeVisitor {
   void visit(const ScalarIfLessNode* n) override {
     result = {n->a, n->b, n->c, n->d};
   }
+  void visit(const ScalarSumNode* n) override {
+    result = {n->x};
+  }
+  void visit(const ScalarDotNode* n) override {
+    result = {n->left, n->right};
+  }
+  void visit(const VectorConstantNode*) override {
+    result = {};
+  }
+  void visit(const VectorVariableNode*) override {
+    result = {};
+  }
+  void visit(const VectorSampleNode* n) override {
+    result = {n->distribution};
+  }
+  void visit(const VectorBroadcastNode* n) override {
+    result = {n->x};
+  }
+  void visit(const VectorAddNode* n) override {
+    result = {n->left, n->right};
+  }
+  void visit(const VectorSubtractNode* n) override {
+    result = {n->left, n->right};
+  }
+  void visit(const VectorMultiplyNode* n) override {
+    result = {n->left, n->right};
+  }
+  void visit(const VectorMatmulNode* n) override {
+    result = {n->x};
+  }
   void visit(const DistributionNormalNode* n) override {
     result = {n->mean, n->stddev};
   }
@@ -207,6 +266,56 @@ class EqualsTester : public NodeVisitor {
     result = node_equals(node->a, other->a) && node_equals(node->b, other->b) &&
         node_equals(node->c, other->c) && node_equals(node->d, other->d);
   }
+  void visit(const ScalarSumNode* node) override {
+    auto other = static_cast<const ScalarSumNode*>(this->other);
+    result = node_equals(node->x, other->x);
+  }
+  void visit(const ScalarDotNode* node) override {
+    auto other = static_cast<const ScalarDotNode*>(this->other);
+    result = node_equals(node->left, other->left) &&
+        node_equals(node->right, other->right);
+  }
+  void visit(const VectorConstantNode* node) override {
+    auto other = static_cast<const VectorConstantNode*>(this->other);
+    result = node->values == other->values;
+  }
+  void visit(const VectorVariableNode* node) override {
+    auto other = static_cast<const VectorVariableNode*>(this->other);
+    result = node->identifier == other->identifier &&
+        node->name == other->name && node->size == other->size;
+  }
+  void visit(const VectorSampleNode* node) override {
+    auto other = static_cast<const VectorSampleNode*>(this->other);
+    result = node->size == other->size &&
+        node_equals(node->distribution, other->distribution);
+  }
+  void visit(const VectorBroadcastNode* node) override {
+    auto other = static_cast<const VectorBroadcastNode*>(this->other);
+    result = node->size == other->size && node_equals(node->x, other->x);
+  }
+  void visit(const VectorAddNode* node) override {
+    auto other = static_cast<const VectorAddNode*>(this->other);
+    result = node_equals(node->left, other->left) &&
+        node_equals(node->right, other->right);
+  }
+  void visit(const VectorSubtractNode* node) override {
+    auto other = static_cast<const VectorSubtractNode*>(this->other);
+    result = node_equals(node->left, other->left) &&
+        node_equals(node->right, other->right);
+  }
+  void visit(const VectorMultiplyNode* node) override {
+    auto other = static_cast<const VectorMultiplyNode*>(this->other);
+    result = node_equals(node->left, other->left) &&
+        node_equals(node->right, other->right);
+  }
+  void visit(const VectorMatmulNode* node) override {
+    auto other = static_cast<const VectorMatmulNode*>(this->other);
+    result = node->transposed == other->transposed &&
+        (node->matrix == other->matrix ||
+         (node->matrix->rows == other->matrix->rows &&
+          node->matrix->values == other->matrix->values)) &&
+        node_equals(node->x, other->x);
+  }
   void visit(const DistributionNormalNode* node) override {
     auto other = static_cast<const DistributionNormalNode*>(this->other);
     result = node_equals(node->mean, other->mean) &&
@@ -252,6 +361,9 @@ std::string to_string(const Nodep& node) {
 ScalarNode::ScalarNode(std::size_t cached_hash_value)
     : Node{cached_hash_value} {}
 
+VectorNode::VectorNode(std::size_t cached_hash_value, unsigned size)
+    : Node{cached_hash_value}, size{size} {}
+
 DistributionNode::DistributionNode(std::size_t cached_hash_value)
     : Node{cached_hash_value} {}
 
@@ -455,6 +567,136 @@ void ScalarIfLessNode::accept(NodeVisitor& visitor) const {
   visitor.visit(this);
 }
 
+ScalarSumNode::ScalarSumNode(const VectorNodep& x)
+    : ScalarNode{hash_combine(23, x->cached_hash_value)}, x{x} {}
+
+void ScalarSumNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+ScalarDotNode::ScalarDotNode(const VectorNodep& left, const VectorNodep& right)
+    : ScalarNode{hash_combine(
+          {24,
+           left->cached_hash_value,
+           right->cached_hash_value,
+           elementwise_size(left, right)})},
+      left{left},
+      right{right} {}
+
+void ScalarDotNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorConstantNode::VectorConstantNode(std::vector<double> values)
+    : VectorNode{
+          hash_combine(25, hash_values(values)),
+          (unsigned)values.size()},
+      values{std::move(values)} {}
+
+void VectorConstantNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorVariableNode::VectorVariableNode(
+    const std::string& name,
+    const int identifier,
+    unsigned size)
+    : VectorNode{
+          hash_combine(
+              {26,
+               std::hash<std::string>{}(name),
+               std::hash<unsigned>{}(identifier),
+               size}),
+          size},
+      name{name},
+      identifier{identifier} {}
+
+void VectorVariableNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorSampleNode::VectorSampleNode(
+    const DistributionNodep& distribution,
+    unsigned size,
+    const std::string& rvid)
+    : VectorNode{
+          hash_combine(
+              {27,
+               distribution->cached_hash_value,
+               std::hash<std::string>{}(rvid),
+               size}),
+          size},
+      distribution{distribution},
+      rvid{rvid} {}
+
+void VectorSampleNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorBroadcastNode::VectorBroadcastNode(const ScalarNodep& x, unsigned size)
+    : VectorNode{hash_combine(28, x->cached_hash_value, size), size}, x{x} {}
+
+void VectorBroadcastNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorAddNode::VectorAddNode(const VectorNodep& left, const VectorNodep& right)
+    : VectorNode{
+          hash_combine(29, left->cached_hash_value, right->cached_hash_value),
+          elementwise_size(left, right)},
+      left{left},
+      right{right} {}
+
+void VectorAddNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorSubtractNode::VectorSubtractNode(
+    const VectorNodep& left,
+    const VectorNodep& right)
+    : VectorNode{
+          hash_combine(30, left->cached_hash_value, right->cached_hash_value),
+          elementwise_size(left, right)},
+      left{left},
+      right{right} {}
+
+void VectorSubtractNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorMultiplyNode::VectorMultiplyNode(
+    const VectorNodep& left,
+    const VectorNodep& right)
+    : VectorNode{
+          hash_combine(31, left->cached_hash_value, right->cached_hash_value),
+          elementwise_size(left, right)},
+      left{left},
+      right{right} {}
+
+void VectorMultiplyNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
+VectorMatmulNode::VectorMatmulNode(
+    const ConstantMatrixp& matrix,
+    const VectorNodep& x,
+    bool transposed)
+    : VectorNode{
+          hash_combine(
+              {32,
+               hash_values(matrix->values),
+               matrix->rows,
+               x->cached_hash_value,
+               transposed}),
+          matmul_size(matrix, x, transposed)},
+      matrix{matrix},
+      x{x},
+      transposed{transposed} {}
+
+void VectorMatmulNode::accept(NodeVisitor& visitor) const {
+  visitor.visit(this);
+}
+
 DistributionNormalNode::DistributionNormalNode(
     const ScalarNodep& mean,
     const ScalarNodep& stddev)
@@ -588,6 +830,36 @@ void DefaultNodeVisitor::visit(const ScalarIfEqualNode* node) {
 void DefaultNodeVisitor::visit(const ScalarIfLessNode* node) {
   this->default_visit(node);
 }
+void DefaultNodeVisitor::visit(const ScalarSumNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const ScalarDotNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorConstantNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorVariableNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorSampleNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorBroadcastNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorAddNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorSubtractNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorMultiplyNode* node) {
+  this->default_visit(node);
+}
+void DefaultNodeVisitor::visit(const VectorMatmulNode* node) {
+  this->default_visit(node);
+}
 void DefaultNodeVisitor::visit(const DistributionNormalNode* node) {
   this->default_visit(node);
 }
@@ -624,7 +896,7 @@ void ScalarNodeVisitor::visit(const DistributionExponentialNode* node) {
 }
 
 void DistributionNodeVisitor::default_visit(const Node*) {
-  throw std::logic_error("scalar passed to a distribution visitor");
+  throw std::logic_error("scalar or vector passed to a distribution visitor");
 }
 void DistributionNodeVisitor::visit(const ScalarConstantNode* node) {
   default_visit(node);
@@ -677,5 +949,35 @@ void DistributionNodeVisitor::visit(const ScalarIfEqualNode* node) {
 void DistributionNodeVisitor::visit(const ScalarIfLessNode* node) {
   default_visit(node);
 }
+void DistributionNodeVisitor::visit(const ScalarSumNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const ScalarDotNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorConstantNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorVariableNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorSampleNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorBroadcastNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorAddNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorSubtractNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorMultiplyNode* node) {
+  default_visit(node);
+}
+void DistributionNodeVisitor::visit(const VectorMatmulNode* node) {
+  default_visit(node);
+}
 
 } // namespace beanmachine::minibmg
@@ -11,19 +11,24 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include "beanmachine/minibmg/ad/constant_matrix.h"
 
 namespace beanmachine::minibmg {
 
 class Node;
 class ScalarNode;
+class VectorNode;
 class DistributionNode;
 class ScalarSampleNode;
+class VectorSampleNode;
 class NodeVisitor;
 
 using Nodep = std::shared_ptr<const Node>;
 using ScalarNodep = std::shared_ptr<const ScalarNode>;
+using VectorNodep = std::shared_ptr<const VectorNode>;
 using DistributionNodep = std::shared_ptr<const DistributionNode>;
 using ScalarSampleNodep = std::shared_ptr<const ScalarSampleNode>;
+using VectorSampleNodep = std::shared_ptr<const VectorSampleNode>;
 
 template <class T>
 std::shared_ptr<const T> downcast(Nodep node) {
@@ -45,6 +50,18 @@ class ScalarNode : public Node {
   explicit ScalarNode(std::size_t cached_hash_value);
 };
 
+// A node whose value is a vector of scalars, such as the values of a set of
+// observations.  Vector nodes keep the size of a graph independent of the size
+// of the data it is applied to.
+class VectorNode : public Node {
+ public:
+  // The number of elements of the vector.
+  const unsigned size;
+
+ protected:
+  VectorNode(std::size_t cached_hash_value, unsigned size);
+};
+
 class DistributionNode : public Node {
  protected:
   explicit DistributionNode(std::size_t cached_hash_value);
@@ -188,6 +205,105 @@ class ScalarIfLessNode : public ScalarNode {
   void accept(NodeVisitor& visitor) const override;
 };
 
+// The sum of the elements of a vector.
+class ScalarSumNode : public ScalarNode {
+ public:
+  explicit ScalarSumNode(const VectorNodep& x);
+  VectorNodep x;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// The dot product of two vectors of the same size.
+class ScalarDotNode : public ScalarNode {
+ public:
+  ScalarDotNode(const VectorNodep& left, const VectorNodep& right);
+  VectorNodep left;
+  VectorNodep right;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+class VectorConstantNode : public VectorNode {
+ public:
+  explicit VectorConstantNode(std::vector<double> values);
+  std::vector<double> values;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+class VectorVariableNode : public VectorNode {
+ public:
+  VectorVariableNode(
+      const std::string& name,
+      const int identifier,
+      unsigned size);
+  std::string name;
+  int identifier;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// A vector of `size` independent samples from the same (scalar) distribution.
+// It must be observed, and the log probability of the observation is computed
+// from sufficient statistics of the observed values (see
+// Distribution::log_prob_iid), so it does not grow with the number of samples.
+class VectorSampleNode : public VectorNode {
+ public:
+  VectorSampleNode(
+      const DistributionNodep& distribution,
+      unsigned size,
+      const std::string& rvid = make_fresh_rvid());
+  const DistributionNodep distribution;
+  std::string rvid;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// A vector of `size` copies of a scalar.
+class VectorBroadcastNode : public VectorNode {
+ public:
+  VectorBroadcastNode(const ScalarNodep& x, unsigned size);
+  ScalarNodep x;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// Elementwise addition of two vectors of the same size.
+class VectorAddNode : public VectorNode {
+ public:
+  VectorAddNode(const VectorNodep& left, const VectorNodep& right);
+  VectorNodep left;
+  VectorNodep right;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// Elementwise subtraction of two vectors of the same size.
+class VectorSubtractNode : public VectorNode {
+ public:
+  VectorSubtractNode(const VectorNodep& left, const VectorNodep& right);
+  VectorNodep left;
+  VectorNodep right;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// Elementwise multiplication of two vectors of the same size.
+class VectorMultiplyNode : public VectorNode {
+ public:
+  VectorMultiplyNode(const VectorNodep& left, const VectorNodep& right);
+  VectorNodep left;
+  VectorNodep right;
+  void accept(NodeVisitor& visitor) const override;
+};
+
+// The product of a constant matrix (or, if `transposed`, its transpose) and a
+// vector.
+class VectorMatmulNode : public VectorNode {
+ public:
+  VectorMatmulNode(
+      const ConstantMatrixp& matrix,
+      const VectorNodep& x,
+      bool transposed = false);
+  ConstantMatrixp matrix;
+  VectorNodep x;
+  bool transposed;
+  void accept(NodeVisitor& visitor) const override;
+};
+
 class DistributionNormalNode : public DistributionNode {
  public:
   DistributionNormalNode(const ScalarNodep& mean, const ScalarNodep& stddev);
@@ -258,6 +374,9 @@ class NodeNodeValueMap {
   ScalarNodep at(const ScalarNodep& p) const {
     return downcast<ScalarNode>(map.at(p));
   }
+  VectorNodep at(const VectorNodep& p) const {
+    return downcast<VectorNode>(map.at(p));
+  }
   DistributionNodep at(const DistributionNodep& p) const {
     return downcast<DistributionNode>(map.at(p));
   }
@@ -298,6 +417,16 @@ class NodeVisitor {
   virtual void visit(const ScalarLog1pNode* node) = 0;
   virtual void visit(const ScalarIfEqualNode* node) = 0;
   virtual void visit(const ScalarIfLessNode* node) = 0;
+  virtual void visit(const ScalarSumNode* node) = 0;
+  virtual void visit(const ScalarDotNode* node) = 0;
+  virtual void visit(const VectorConstantNode* node) = 0;
+  virtual void visit(const VectorVariableNode* node) = 0;
+  virtual void visit(const VectorSampleNode* node) = 0;
+  virtual void visit(const VectorBroadcastNode* node) = 0;
+  virtual void visit(const VectorAddNode* node) = 0;
+  virtual void visit(const VectorSubtractNode* node) = 0;
+  virtual void visit(const VectorMultiplyNode* node) = 0;
+  virtual void visit(const VectorMatmulNode* node) = 0;
   virtual void visit(const DistributionNormalNode* node) = 0;
   virtual void visit(const DistributionHalfNormalNode* node) = 0;
   virtual void visit(const DistributionBetaNode* node) = 0;
@@ -329,6 +458,16 @@ class DefaultNodeVisitor : public NodeVisitor {
   void visit(const ScalarLog1pNode* node) override;
   void visit(const ScalarIfEqualNode* node) override;
   void visit(const ScalarIfLessNode* node) override;
+  void visit(const ScalarSumNode* node) override;
+  void visit(const ScalarDotNode* node) override;
+  void visit(const VectorConstantNode* node) override;
+  void visit(const VectorVariableNode* node) override;
+  void visit(const VectorSampleNode* node) override;
+  void visit(const VectorBroadcastNode* node) override;
+  void visit(const VectorAddNode* node) override;
+  void visit(const VectorSubtractNode* node) override;
+  void visit(const VectorMultiplyNode* node) override;
+  void visit(const VectorMatmulNode* node) override;
   void visit(const DistributionNormalNode* node) override;
   void visit(const DistributionHalfNormalNode* node) override;
   void visit(const DistributionBetaNode* node) override;
@@ -336,7 +475,8 @@ class DefaultNodeVisitor : public NodeVisitor {
   void visit(const DistributionExponentialNode* node) override;
 };
 
-// A visitor for scalar nodes.  Throws an exception for distributions.
+// A visitor for scalar and vector nodes.  Throws an exception for
+// distributions.
 class ScalarNodeVisitor : public NodeVisitor {
   void default_visit(const Node* node);
   void visit(const DistributionNormalNode* node) override;
@@ -346,7 +486,8 @@ class ScalarNodeVisitor : public NodeVisitor {
   void visit(const DistributionExponentialNode* node) override;
 };
 
-// A visitor for distribution nodes.  Throws an exception for scalars.
+// A visitor for distribution nodes.  Throws an exception for scalars and
+// vectors.
 class DistributionNodeVisitor : public NodeVisitor {
   void default_visit(const Node* node);
   void visit(const ScalarConstantNode* node) override;
@@ -366,6 +507,16 @@ class DistributionNodeVisitor : public NodeVisitor {
   void visit(const ScalarLog1pNode* node) override;
   void visit(const ScalarIfEqualNode* node) override;
   void visit(const ScalarIfLessNode* node) override;
+  void visit(const ScalarSumNode* node) override;
+  void visit(const ScalarDotNode* node) override;
+  void visit(const VectorConstantNode* node) override;
+  void visit(const VectorVariableNode* node) override;
+  void visit(const VectorSampleNode* node) override;
+  void visit(const VectorBroadcastNode* node) override;
+  void visit(const VectorAddNode* node) override;
+  void visit(const VectorSubtractNode* node) override;
+  void visit(const VectorMultiplyNode* node) override;
+  void visit(const VectorMatmulNode* node) override;
 };
 
 } // namespace beanmachine::minibmg
@@ -9,11 +9,28 @@
 #include <boost/math/special_functions/polygamma.hpp>
 #include <cmath>
 #include <memory>
+#include "beanmachine/minibmg/ad/number_vector.h"
 
 namespace {
 
 using namespace beanmachine::minibmg;
 
+// The value of a vector node if it is a constant, as a vector of reals.
+bool is_constant_vector(const VectorNodep& node, RealVector& value) {
+  auto constant = downcast<VectorConstantNode>(node);
+  if (constant == nullptr) {
+    return false;
+  }
+  value = RealVector{constant->values};
+  return true;
+}
+
+VectorNodep make_constant_vector(const RealVector& value) {
+  const auto& v = value.values;
+  return std::make_shared<const VectorConstantNode>(
+      std::vector<double>(v.data(), v.data() + v.size()));
+}
+
 // A visitor that performs constant folding on a single node when its children
 // are constants.  Otherwise returns the original node.
 class ConstantFoldingVisitor : DefaultNodeVisitor {
@@ -190,6 +207,70 @@ class ConstantFoldingVisitor : DefaultNodeVisitor {
       rewritten = original;
     }
   }
+
+  void visit(const ScalarSumNode* node) override {
+    RealVector x;
+    if (is_constant_vector(node->x, x)) {
+      rewritten = std::make_shared<const ScalarConstantNode>(
+          sum(x).as_double());
+    } else {
+      rewritten = original;
+    }
+  }
+
+  void visit(const ScalarDotNode* node) override {
+    RealVector left, right;
+    if (is_constant_vector(node->left, left) &&
+        is_constant_vector(node->right, right)) {
+      rewritten = std::make_shared<const ScalarConstantNode>(
+          dot(left, right).as_double());
+    } else {
+      rewritten = original;
+    }
+  }
+
+  // A broadcast of a constant is not folded, as that would put a vector of the
+  // size of the data into the graph for what is a single number.
+
+  void visit(const VectorAddNode* node) override {
+    RealVector left, right;
+    if (is_constant_vector(node->left, left) &&
+        is_constant_vector(node->right, right)) {
+      rewritten = make_constant_vector(left + right);
+    } else {
+      rewritten = original;
+    }
+  }
+
+  void visit(const VectorSubtractNode* node) override {
+    RealVector left, right;
+    if (is_constant_vector(node->left, left) &&
+        is_constant_vector(node->right, right)) {
+      rewritten = make_constant_vector(left - right);
+    } else {
+      rewritten = original;
+    }
+  }
+
+  void visit(const VectorMultiplyNode* node) override {
+    RealVector left, right;
+    if (is_constant_vector(node->left, left) &&
+        is_constant_vector(node->right, right)) {
+      rewritten = make_constant_vector(left * right);
+    } else {
+      rewritten = original;
+    }
+  }
+
+  void visit(const VectorMatmulNode* node) override {
+    RealVector x;
+    if (is_constant_vector(node->x, x)) {
+      rewritten =
+          make_constant_vector(matmul(node->matrix, x, node->transposed));
+    } else {
+      rewritten = original;
+    }
+  }
 };
 
 } // namespace
@@ -203,5 +284,9 @@ ScalarNodep constant_fold(ScalarNodep node) {
   return std::dynamic_pointer_cast<const ScalarNode>(
       ConstantFoldingVisitor::constant_fold(node));
 }
+VectorNodep constant_fold(VectorNodep node) {
+  return std::dynamic_pointer_cast<const VectorNode>(
+      ConstantFoldingVisitor::constant_fold(node));
+}
 
 } // namespace beanmachine::minibmg
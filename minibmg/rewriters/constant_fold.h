@@ -17,5 +17,6 @@ namespace beanmachine::minibmg {
 // recursively; input nodes should be folded before calling this.
 Nodep constant_fold(Nodep node);
 ScalarNodep constant_fold(ScalarNodep node);
+VectorNodep constant_fold(VectorNodep node);
 
 } // namespace beanmachine::minibmg
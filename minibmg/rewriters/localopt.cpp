@@ -121,7 +121,7 @@ std::vector<LocalRewriteRule> local_rewrite_rules = {
     {a - (-x), a + x},
     {x - a * x, (1 - a) * x},
     {b + x - a * x, b + (1 - a) * x},
-    {b - x - a * x, b - (1 - a) * x},
+    {b - x - a * x, b - (1 + a) * x},
 
     // fold constants into the numerator of a sum
     {-(k1 / x), (-k1) / x},
@@ -185,11 +185,6 @@ std::vector<LocalRewriteRule> local_rewrite_rules = {
      [](const Nodep&, const Environment& env) {
        return should_precede(env.at(x.node), env.at(y.node));
      }},
-    {y - x,
-     x - y,
-     [](const Nodep&, const Environment& env) {
-       return should_precede(env.at(x.node), env.at(y.node));
-     }},
     {a + y + x,
      a + x + y,
      [](const Nodep&, const Environment& env) {
@@ -352,9 +347,18 @@ class ExpressionInterpolator : NodeEvaluatorVisitor<Traced> {
   void visit(const ScalarSampleNode*) override {
     throw std::logic_error("replacements should not contain samples");
   }
+  void visit(const VectorVariableNode*) override {
+    throw std::logic_error("replacements should not contain vectors");
+  }
+  void visit(const VectorSampleNode*) override {
+    throw std::logic_error("replacements should not contain samples");
+  }
   Traced evaluate_input(const ScalarNodep& node) override {
     return Traced{interpolate(node, false)};
   }
+  TracedVector evaluate_vector_input(const VectorNodep&) override {
+    throw std::logic_error("replacements should not contain vectors");
+  }
   std::shared_ptr<const Distribution<Traced>> evaluate_input_distribution(
       const DistributionNodep&) override {
     throw std::logic_error("replacements should not contain distributions");
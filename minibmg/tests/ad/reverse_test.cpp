@@ -86,10 +86,10 @@ TEST(reverse_test, compare_to_num2) {
       Back a_back = a0;
       Back b_back = b0;
       Back result_back = f1(a_back, b_back);
-      Real primal_back = result_back.ptr->primal;
+      Real primal_back = result_back.primal;
       result_back.reverse(1);
-      Real dfda_back = a1 * a_back.ptr->adjoint;
-      Real dfdb_back = b1 * b_back.ptr->adjoint;
+      Real dfda_back = a1 * a_back.adjoint();
+      Real dfdb_back = b1 * b_back.adjoint();
 
       // compute the derivative of the result of the function with respect to
       // its first input in forward mode
@@ -123,3 +123,36 @@ TEST(reverse_test, compare_to_num2) {
     }
   }
 }
+
+TEST(reverse_test, shared_subexpressions) {
+  // Adjoints of a value used more than once are accumulated.
+  Back x = 3.0;
+  Back y = x * x;
+  Back z = y * y + y;
+  z.reverse(1);
+  // z = x^4 + x^2, so dz/dx = 4x^3 + 2x
+  EXPECT_CLOSE(4 * 27 + 2 * 3, x.adjoint().as_double());
+  // dz/dy = 2y + 1
+  EXPECT_CLOSE(2 * 9 + 1, y.adjoint().as_double());
+}
+
+TEST(reverse_test, recording) {
+  Back a = 2.0;
+  Back f = a * a * a;
+
+  // A recording onto another tape, reused for several evaluations, does not
+  // disturb values on the current tape.
+  Back::Tape tape;
+  for (int i = 1; i <= 3; i++) {
+    Back::Tape::Recording recording{tape};
+    Back x = i;
+    Back g = exp(x) * x;
+    EXPECT_LE(tape.size(), 4);
+    g.reverse(1);
+    // dg/dx = exp(x) * (x + 1)
+    EXPECT_CLOSE(std::exp(i) * (i + 1), x.adjoint().as_double());
+  }
+
+  f.reverse(1);
+  EXPECT_CLOSE(12, a.adjoint().as_double());
+}
@@ -33,7 +33,7 @@ TEST(eval_test, simple1) {
   std::mt19937 gen{123456};
   auto read_variable = [](const std::string&, const unsigned) { return 1.15; };
   int graph_size = graph.size();
-  unordered_map<Nodep, Real> data;
+  std::vector<Real> data;
   auto eval_result = eval_graph<Real>(
       graph, gen, read_variable, data, /* run_queries= */ true);
   EXPECT_CLOSE(1.995, eval_result.queries[0].value);
@@ -59,7 +59,7 @@ TEST(eval_test, sample1) {
   double sum = 0;
   double sum_squared = 0;
   int graph_size = graph.size();
-  std::unordered_map<Nodep, Real> data;
+  std::vector<Real> data;
   for (int i = 0; i < n; i++) {
     auto eval_result =
         eval_graph<Real>(graph, gen, nullptr, data, /* run_queries= */ true);
@@ -109,19 +109,18 @@ TEST(eval_test, derivative_dual) {
   // We generate several doubles between -2.0 and 2.0 to test with.
   std::uniform_real_distribution<double> unif(-2.0, 2.0);
 
-  std::unordered_map<Nodep, Dual> data;
+  std::vector<Dual> data;
   for (int i = 0; i < 10; i++) {
     double input = unif(gen);
     auto read_variable = [=](const std::string&, const unsigned) {
       return Dual{input, 1};
     };
-    data.clear();
     auto eval_result = eval_graph<Dual>(
         graph, gen, read_variable, data, /* run_queries = */ true);
     Nodep s_node = fac[s];
-    EXPECT_CLOSE(f<Real>(input).as_double(), data[s_node].primal.as_double());
-    EXPECT_CLOSE(
-        fp<Real>(input).as_double(), data[s_node].derivative1.as_double());
+    const Dual& value = data[graph.index_of(s_node)];
+    EXPECT_CLOSE(f<Real>(input).as_double(), value.primal.as_double());
+    EXPECT_CLOSE(fp<Real>(input).as_double(), value.derivative1.as_double());
   }
 }
 
@@ -142,18 +141,17 @@ TEST(eval_test, derivatives_triune) {
   // We generate several doubles between -2.0 and 2.0 to test with.
   std::uniform_real_distribution<double> unif(-2.0, 2.0);
 
-  std::unordered_map<Nodep, Triune> data;
+  std::vector<Triune> data;
   for (int i = 0; i < 10; i++) {
     double input = unif(gen);
     auto read_variable = [=](const std::string&, const unsigned) {
       return Triune{input, 1, 0};
     };
-    data.clear();
     eval_graph<Triune>(graph, gen, read_variable, data);
-    EXPECT_CLOSE(f<Real>(input).as_double(), data[sn].primal.as_double());
-    EXPECT_CLOSE(fp<Real>(input).as_double(), data[sn].derivative1.as_double());
-    EXPECT_CLOSE(
-        fpp<Real>(input).as_double(), data[sn].derivative2.as_double());
+    const Triune& value = data[graph.index_of(sn)];
+    EXPECT_CLOSE(f<Real>(input).as_double(), value.primal.as_double());
+    EXPECT_CLOSE(fp<Real>(input).as_double(), value.derivative1.as_double());
+    EXPECT_CLOSE(fpp<Real>(input).as_double(), value.derivative2.as_double());
   }
 }
 
@@ -168,7 +166,7 @@ TEST(eval_test, log1p) {
   auto read_variable = [=](const std::string&, const unsigned) -> Real {
     throw std::logic_error("model has no variables to read");
   };
-  std::unordered_map<Nodep, Real> data;
+  std::vector<Real> data;
   auto eval_result = eval_graph<Real>(
       graph, gen, read_variable, data, /* run_queries = */ true);
   EXPECT_CLOSE(eval_result.queries[qi].value, std::log1p(k));
@@ -193,7 +191,7 @@ TEST(eval_test, sample_exponential) {
   double sum = 0;
   double sum_squared = 0;
   int graph_size = graph.size();
-  std::unordered_map<Nodep, Real> data;
+  std::vector<Real> data;
   for (int i = 0; i < n; i++) {
     auto eval_result =
         eval_graph<Real>(graph, gen, nullptr, data, /* run_queries= */ true);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "beanmachine/minibmg/fluid_factory.h"
+#include "beanmachine/minibmg/inference/batched_global_state.h"
+#include "beanmachine/minibmg/inference/hmc_world.h"
+
+using namespace ::testing;
+using namespace beanmachine::minibmg;
+using beanmachine::graph::NodeValue;
+
+namespace {
+
+template <typename T>
+requires Number<T> T expit(const T& x) {
+  return 1 / (1 + exp(-x));
+}
+
+// The coin flipping model of nuts_test.
+Graph coin_flipping() {
+  Graph::FluidFactory f;
+  auto s = expit(sample(normal(0, 100)));
+  auto bn = bernoulli(s);
+  for (int i = 0; i < 85; i++) {
+    f.observe(sample(bn), 1);
+  }
+  for (int i = 0; i < 16; i++) {
+    f.observe(sample(bn), 0);
+  }
+  f.query(s);
+  return f.build();
+}
+
+} // namespace
+
+TEST(batched_global_state_test, evaluator) {
+  auto graph = coin_flipping();
+  std::shared_ptr<const HMCWorld> world = hmc_world_2(graph);
+  const unsigned num_chains = 3;
+  BatchedHMCWorldEvaluator evaluator{world, num_chains};
+
+  // Chain c asks for 10 (c + 1) evaluations, so the batches go on without the
+  // chains which left.
+  struct Evaluation {
+    std::vector<double> values;
+    HMCWorldEvalResult result;
+  };
+  std::vector<std::vector<Evaluation>> evaluations(num_chains);
+  std::vector<std::thread> threads;
+  for (unsigned chain = 0; chain < num_chains; chain++) {
+    threads.emplace_back([&, chain]() {
+      for (unsigned i = 0; i < 10 * (chain + 1); i++) {
+        Evaluation evaluation;
+        evaluation.values = {0.1 * i - chain};
+        evaluator.evaluate(chain, evaluation.values, evaluation.result);
+        evaluations[chain].push_back(evaluation);
+      }
+      evaluator.leave();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(evaluator.num_batches(), 30);
+
+  for (const auto& chain_evaluations : evaluations) {
+    for (const auto& evaluation : chain_evaluations) {
+      const auto& result = evaluation.result;
+      std::vector<double> expected_gradients, expected_queries;
+      world->gradients(evaluation.values, expected_gradients);
+      world->queries(evaluation.values, expected_queries);
+      EXPECT_NEAR(result.log_prob, world->log_prob(evaluation.values), 1e-9);
+      ASSERT_EQ(result.gradients.size(), expected_gradients.size());
+      EXPECT_NEAR(result.gradients[0], expected_gradients[0], 1e-9);
+      ASSERT_EQ(result.queries.size(), expected_queries.size());
+      EXPECT_NEAR(result.queries[0], expected_queries[0], 1e-9);
+    }
+  }
+}
+
+TEST(batched_global_state_test, batched_nuts) {
+  auto graph = coin_flipping();
+  const unsigned num_chains = 4;
+  const int num_samples = 2000;
+  auto samples = batched_nuts(
+      graph,
+      hmc_world_2(graph),
+      num_chains,
+      num_samples,
+      /* seed = */ 17,
+      /* num_warmup_samples = */ 500);
+  ASSERT_EQ(samples.size(), num_chains);
+  double sum = 0;
+  for (const auto& chain_samples : samples) {
+    ASSERT_EQ(chain_samples.size(), num_samples);
+    for (const auto& sample : chain_samples) {
+      sum += sample[0]._double;
+    }
+  }
+  // The chains differ.
+  EXPECT_NE(samples[0][0][0]._double, samples[1][0][0]._double);
+  // With a (nearly) flat prior on the log odds, the posterior of the
+  // probability of heads is beta(85, 16).
+  EXPECT_NEAR(sum / (num_chains * num_samples), 85.0 / 101, 0.01);
+}
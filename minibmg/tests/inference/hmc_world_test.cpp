@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include "beanmachine/minibmg/fluid_factory.h"
+#include "beanmachine/minibmg/inference/hmc_world.h"
+
+using namespace ::testing;
+using namespace beanmachine::minibmg;
+
+namespace {
+
+template <typename T>
+requires Number<T> T expit(const T& x) {
+  return 1 / (1 + exp(-x));
+}
+
+// The coin flipping model of nuts_test.
+Graph coin_flipping() {
+  Graph::FluidFactory f;
+  auto s = expit(sample(normal(0, 100)));
+  auto bn = bernoulli(s);
+  for (int i = 0; i < 85; i++) {
+    f.observe(sample(bn), 1);
+  }
+  for (int i = 0; i < 16; i++) {
+    f.observe(sample(bn), 0);
+  }
+  f.query(s);
+  return f.build();
+}
+
+// A model that exercises every distribution and most operators.
+Graph assorted() {
+  Graph::FluidFactory f;
+  auto a = sample(beta(2, 3));
+  auto b = sample(normal(a * 2 - 1, 1.5));
+  auto c = sample(half_normal(exp(a)));
+  auto d = sample(exponential(1 / (1 + c)));
+  auto e = sample(normal(atan(b) + log1p(c) - lgamma(d + 1), pow(c + 1, a)));
+  f.observe(sample(normal(b / (c + 1), 2)), 0.25);
+  f.observe(sample(bernoulli(a)), 1);
+  f.observe(sample(exponential(d + 0.5)), 1.5);
+  f.query(a);
+  f.query(-b);
+  f.query(c * d);
+  f.query(log(d) + e);
+  return f.build();
+}
+
+std::vector<std::function<std::unique_ptr<const HMCWorld>(const Graph&)>>
+    worlds = {hmc_world_0, hmc_world_1, hmc_world_2, hmc_world_3};
+
+// Point the cache of hmc_world_3 at a fresh directory of the given name.
+std::filesystem::path use_cache_directory(const std::string& name) {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  setenv("MINIBMG_CACHE_DIR", dir.c_str(), 1);
+  return dir;
+}
+
+int count_files(const std::filesystem::path& dir) {
+  if (!std::filesystem::exists(dir)) {
+    return 0;
+  }
+  int count = 0;
+  for (auto& entry : std::filesystem::directory_iterator{dir}) {
+    count += entry.is_regular_file();
+  }
+  return count;
+}
+
+void expect_worlds_agree(const Graph& graph) {
+  use_cache_directory("hmc_world_test");
+  auto world0 = hmc_world_0(graph);
+  auto n = world0->num_unobserved_samples();
+  std::mt19937 gen{12345};
+  std::normal_distribution<double> proposal{0, 1};
+  for (int trial = 0; trial < 10; trial++) {
+    std::vector<double> proposals;
+    for (unsigned i = 0; i < n; i++) {
+      proposals.push_back(proposal(gen));
+    }
+    std::vector<double> grad0, queries0;
+    world0->gradients(proposals, grad0);
+    world0->queries(proposals, queries0);
+    for (int w = 1, nw = worlds.size(); w < nw; w++) {
+      auto world = worlds[w](graph);
+      ASSERT_EQ(world->num_unobserved_samples(), n);
+      EXPECT_NEAR(
+          world->log_prob(proposals), world0->log_prob(proposals), 1e-9)
+          << "world " << w;
+      std::vector<double> grad, queries;
+      world->gradients(proposals, grad);
+      world->queries(proposals, queries);
+      ASSERT_EQ(grad.size(), grad0.size());
+      ASSERT_EQ(queries.size(), queries0.size());
+      for (int i = 0, m = grad.size(); i < m; i++) {
+        EXPECT_NEAR(grad[i], grad0[i], 1e-9) << "world " << w;
+      }
+      for (int i = 0, m = queries.size(); i < m; i++) {
+        EXPECT_NEAR(queries[i], queries0[i], 1e-9) << "world " << w;
+      }
+    }
+  }
+}
+
+// The batched evaluation of every world agrees with evaluating one chain at a
+// time.
+void expect_batches_agree(const Graph& graph) {
+  use_cache_directory("hmc_world_test");
+  const int num_chains = 7;
+  std::mt19937 gen{54321};
+  std::normal_distribution<double> proposal{0, 1};
+  for (int w = 0, nw = worlds.size(); w < nw; w++) {
+    auto world = worlds[w](graph);
+    int n = world->num_unobserved_samples();
+    Eigen::MatrixXd proposals(num_chains, n);
+    for (int c = 0; c < num_chains; c++) {
+      for (int j = 0; j < n; j++) {
+        proposals(c, j) = proposal(gen);
+      }
+    }
+    Eigen::VectorXd log_probs;
+    Eigen::MatrixXd grads;
+    world->log_prob_batch(proposals, log_probs);
+    world->gradients_batch(proposals, grads);
+    ASSERT_EQ(log_probs.size(), num_chains);
+    ASSERT_EQ(grads.rows(), num_chains);
+    ASSERT_EQ(grads.cols(), n);
+    for (int c = 0; c < num_chains; c++) {
+      std::vector<double> chain_proposals(n), chain_grads;
+      for (int j = 0; j < n; j++) {
+        chain_proposals[j] = proposals(c, j);
+      }
+      EXPECT_NEAR(log_probs[c], world->log_prob(chain_proposals), 1e-9)
+          << "world " << w;
+      world->gradients(chain_proposals, chain_grads);
+      for (int j = 0; j < n; j++) {
+        EXPECT_NEAR(grads(c, j), chain_grads[j], 1e-9) << "world " << w;
+      }
+    }
+  }
+}
+
+// The joint evaluation of every world, one chain at a time and batched, agrees
+// with evaluating the log probability, gradients, and queries separately.
+void expect_joint_evaluations_agree(const Graph& graph) {
+  use_cache_directory("hmc_world_test");
+  const int num_chains = 5;
+  std::mt19937 gen{31415};
+  std::normal_distribution<double> proposal{0, 1};
+  for (int w = 0, nw = worlds.size(); w < nw; w++) {
+    auto world = worlds[w](graph);
+    int n = world->num_unobserved_samples();
+    Eigen::MatrixXd proposals(num_chains, n);
+    for (int c = 0; c < num_chains; c++) {
+      for (int j = 0; j < n; j++) {
+        proposals(c, j) = proposal(gen);
+      }
+    }
+    Eigen::VectorXd log_probs;
+    Eigen::MatrixXd grads, queries;
+    world->evaluate_batch(proposals, log_probs, grads, queries);
+    ASSERT_EQ(log_probs.size(), num_chains);
+    ASSERT_EQ(grads.rows(), num_chains);
+    ASSERT_EQ(queries.rows(), num_chains);
+    for (int c = 0; c < num_chains; c++) {
+      std::vector<double> chain_proposals(n), chain_grads, chain_queries;
+      for (int j = 0; j < n; j++) {
+        chain_proposals[j] = proposals(c, j);
+      }
+      double log_prob = world->log_prob(chain_proposals);
+      world->gradients(chain_proposals, chain_grads);
+      world->queries(chain_proposals, chain_queries);
+      HMCWorldEvalResult result;
+      world->evaluate(chain_proposals, result);
+      EXPECT_NEAR(result.log_prob, log_prob, 1e-9) << "world " << w;
+      EXPECT_NEAR(log_probs[c], log_prob, 1e-9) << "world " << w;
+      ASSERT_EQ(result.gradients.size(), chain_grads.size());
+      ASSERT_EQ(grads.cols(), chain_grads.size());
+      for (int j = 0, m = chain_grads.size(); j < m; j++) {
+        EXPECT_NEAR(result.gradients[j], chain_grads[j], 1e-9) << "world " << w;
+        EXPECT_NEAR(grads(c, j), chain_grads[j], 1e-9) << "world " << w;
+      }
+      ASSERT_EQ(result.queries.size(), chain_queries.size());
+      ASSERT_EQ(queries.cols(), chain_queries.size());
+      for (int j = 0, m = chain_queries.size(); j < m; j++) {
+        EXPECT_NEAR(result.queries[j], chain_queries[j], 1e-9)
+            << "world " << w;
+        EXPECT_NEAR(queries(c, j), chain_queries[j], 1e-9) << "world " << w;
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(hmc_world_test, coin_flipping_worlds_agree) {
+  expect_worlds_agree(coin_flipping());
+}
+
+TEST(hmc_world_test, assorted_worlds_agree) {
+  expect_worlds_agree(assorted());
+}
+
+TEST(hmc_world_test, coin_flipping_batches_agree) {
+  expect_batches_agree(coin_flipping());
+}
+
+TEST(hmc_world_test, assorted_batches_agree) {
+  expect_batches_agree(assorted());
+}
+
+TEST(hmc_world_test, coin_flipping_joint_evaluations_agree) {
+  expect_joint_evaluations_agree(coin_flipping());
+}
+
+TEST(hmc_world_test, assorted_joint_evaluations_agree) {
+  expect_joint_evaluations_agree(assorted());
+}
+
+TEST(hmc_world_test, native_code_is_cached) {
+  auto dir = use_cache_directory("hmc_world_test_cache");
+  auto graph = assorted();
+  auto world = hmc_world_3(graph);
+  ASSERT_EQ(count_files(dir), 1);
+
+  // A second world for the same model loads the cached library.
+  auto library = std::filesystem::directory_iterator{dir}->path();
+  auto write_time = std::filesystem::last_write_time(library);
+  auto cached = hmc_world_3(assorted());
+  EXPECT_EQ(count_files(dir), 1);
+  EXPECT_EQ(std::filesystem::last_write_time(library), write_time);
+
+  std::vector<double> proposals{0.1, -0.2, 0.3, 0.4, -0.5};
+  std::vector<double> grads, cached_grads;
+  world->gradients(proposals, grads);
+  cached->gradients(proposals, cached_grads);
+  EXPECT_EQ(grads, cached_grads);
+}
+
+TEST(hmc_world_test, native_code_falls_back_to_bytecode) {
+  auto dir = use_cache_directory("hmc_world_test_fallback");
+  const char* cxx = std::getenv("CXX");
+  std::string saved_cxx = cxx ? cxx : "";
+  setenv("CXX", "/nonexistent/c++", 1);
+  auto graph = assorted();
+  auto world = hmc_world_3(graph);
+  if (cxx) {
+    setenv("CXX", saved_cxx.c_str(), 1);
+  } else {
+    unsetenv("CXX");
+  }
+
+  // Nothing was compiled, but the world still works.
+  EXPECT_EQ(count_files(dir), 0);
+  auto world2 = hmc_world_2(graph);
+  std::vector<double> proposals{0.1, -0.2, 0.3, 0.4, -0.5};
+  EXPECT_EQ(world->log_prob(proposals), world2->log_prob(proposals));
+}
+
+// Set this to true (temporarily) to benchmark the number of gradient
+// evaluations per second of each HMCWorld.
+const bool should_benchmark_gradients = false;
+
+TEST(hmc_world_test, gradient_performance) {
+  const long n = should_benchmark_gradients ? 200'000 : 10;
+  std::string report;
+  use_cache_directory("hmc_world_test");
+  for (auto& [name, graph] : std::vector<std::pair<std::string, Graph>>{
+           {"coin_flipping", coin_flipping()}, {"assorted", assorted()}}) {
+    for (int w = 0, nw = worlds.size(); w < nw; w++) {
+      auto world = worlds[w](graph);
+      std::vector<double> proposals(world->num_unobserved_samples(), 0.5);
+      std::vector<double> grads;
+      double sum = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      for (long i = 0; i < n; i++) {
+        world->gradients(proposals, grads);
+        sum += grads[0];
+      }
+      auto finish = std::chrono::high_resolution_clock::now();
+      auto time_in_microseconds =
+          std::chrono::duration_cast<std::chrono::microseconds>(finish - start)
+              .count();
+      EXPECT_TRUE(std::isfinite(sum));
+      report += fmt::format(
+          "{}: hmc_world_{}: {:.0f} gradients/s\n",
+          name,
+          w,
+          n / (std::max(time_in_microseconds, 1L) / 1E6));
+    }
+  }
+  if (should_benchmark_gradients) {
+    // This test always fails, but prints out the performance data.
+    EXPECT_TRUE(false) << report;
+  }
+}
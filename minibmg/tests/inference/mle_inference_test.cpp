@@ -26,7 +26,10 @@ TEST(mle_inference_test, coin_flipping) {
   f.observe(sample(bn), 0);
   f.query(s);
 
-  auto inference_result = mle_inference_0(f.build());
+  // Learning rate set by trial and error
+  const double learning_rate = 0.5;
+  auto inference_result =
+      mle_inference_0(f.build(), /* learning_rate= */ learning_rate);
 
   auto s_expected = 0.6;
   auto s_inferred = inference_result[0];
@@ -92,7 +95,10 @@ TEST(mle_inference_test, beta) {
   double mode = (a - 1) / (a + b - 2);
   auto s_expected = mode;
 
-  auto inference_result = mle_inference_0(f.build());
+  // Learning rate set by trial and error
+  const double learning_rate = 0.5;
+  auto inference_result =
+      mle_inference_0(f.build(), /* learning_rate= */ learning_rate);
   auto s_inferred = inference_result[0];
 
   ASSERT_NEAR(s_inferred, s_expected, 1e-7);
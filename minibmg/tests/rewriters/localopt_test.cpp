@@ -45,7 +45,7 @@ TEST(localopt_test, symbolic_derivatives) {
       [](const std::string& name, const int id) -> T {
     return Traced::variable(name, id);
   };
-  std::unordered_map<Nodep, T> data;
+  std::vector<T> data;
   std::function<SampledValue<T>(
       const Distribution<T>& distribution, std::mt19937& gen)>
       sampler = [](const Distribution<T>& distribution,
@@ -84,9 +84,10 @@ TEST(localopt_test, symbolic_derivatives) {
   printed << print_result.code[d2] << std::endl;
 
   auto expected = R"(auto temp_1 = -rvid.constrained + 1;
+auto temp_2 = pow(rvid.constrained, -2);
 log_prob = 2 * log(temp_1) + 3 * log(rvid.constrained) + 1.791759469228055
 d1 = -2 / temp_1 + 3 / rvid.constrained
-d2 = -pow(rvid.constrained, -2)
+d2 = -temp_2 - 2 * pow(temp_1, -2) - 2 * temp_2
 )";
   ASSERT_EQ(expected, printed.str());
 }
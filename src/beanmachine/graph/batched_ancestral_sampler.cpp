@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "beanmachine/graph/batched_ancestral_sampler.h"
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/operator/operator.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+// Columns hold every scalar as a double: booleans as 0 or 1 and naturals
+// exactly up to 2^53.
+inline double get_scalar(const NodeValue& value) {
+  switch (value.type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      return value._bool ? 1.0 : 0.0;
+    case AtomicType::NATURAL:
+      return static_cast<double>(value._natural);
+    default:
+      return value._double;
+  }
+}
+
+inline void set_scalar(NodeValue& value, double x) {
+  switch (value.type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      value._bool = x != 0;
+      break;
+    case AtomicType::NATURAL:
+      value._natural = static_cast<natural_t>(x);
+      break;
+    default:
+      value._double = x;
+      break;
+  }
+}
+
+inline bool is_scalar(const Node* node) {
+  return node->value.type.variable_type == VariableType::SCALAR;
+}
+
+} // namespace
+
+std::vector<Node*> BatchedAncestralSampler::ancestors_of(
+    Graph& graph,
+    const std::vector<NodeID>& node_ids) {
+  std::vector<char> marked(graph.node_ptrs().size(), false);
+  std::vector<Node*> stack;
+  for (NodeID node_id : node_ids) {
+    Node* node = graph.get_node(node_id);
+    if (not marked[node_id]) {
+      marked[node_id] = true;
+      stack.push_back(node);
+    }
+  }
+  while (not stack.empty()) {
+    Node* node = stack.back();
+    stack.pop_back();
+    for (Node* parent : node->in_nodes) {
+      if (not marked[parent->index]) {
+        marked[parent->index] = true;
+        stack.push_back(parent);
+      }
+    }
+  }
+  // parents always have smaller indices than their children
+  std::vector<Node*> result;
+  for (Node* node : graph.node_ptrs()) {
+    if (marked[node->index]) {
+      result.push_back(node);
+    }
+  }
+  return result;
+}
+
+bool BatchedAncestralSampler::is_supported(const std::vector<Node*>& nodes) {
+  return std::all_of(nodes.begin(), nodes.end(), [](const Node* node) {
+    return node->node_type != NodeType::OPERATOR or is_scalar(node);
+  });
+}
+
+BatchedAncestralSampler::BatchedAncestralSampler(
+    const std::vector<Node*>& nodes,
+    uint batch_size,
+    Evidence evidence)
+    : _batch_size(batch_size),
+      evidence(evidence),
+      alive(batch_size, true),
+      log_weights(batch_size, 0.0) {
+  if (not is_supported(nodes)) {
+    throw std::invalid_argument(
+        "batched sampling requires all operators to be scalar-valued");
+  }
+  NodeID max_index = 0;
+  for (const Node* node : nodes) {
+    max_index = std::max(max_index, node->index);
+  }
+  column_of.assign(max_index + 1, -1);
+  uint num_columns = 0;
+  std::vector<std::pair<uint, double>> constants;
+  for (Node* node : nodes) {
+    if (node->node_type == NodeType::CONSTANT and is_scalar(node)) {
+      constants.emplace_back(num_columns, get_scalar(node->value));
+      column_of[node->index] = num_columns++;
+    } else if (node->node_type == NodeType::OPERATOR) {
+      column_of[node->index] = num_columns++;
+    }
+  }
+  data.resize(static_cast<size_t>(num_columns) * batch_size);
+  for (auto [c, value] : constants) {
+    std::fill_n(column(c), batch_size, value);
+  }
+
+  // columns of the given nodes, or an empty vector if some has no column
+  auto columns_of = [&](const std::vector<Node*>& operands) {
+    std::vector<uint> columns;
+    for (const Node* operand : operands) {
+      if (column_of[operand->index] < 0) {
+        return std::vector<uint>();
+      }
+      columns.push_back(column_of[operand->index]);
+    }
+    return columns;
+  };
+
+  for (Node* node : nodes) {
+    if (node->node_type != NodeType::OPERATOR) {
+      continue;
+    }
+    Step step;
+    step.node = node;
+    step.column = column_of[node->index];
+    step.observed = node->is_observed;
+    step.observation = node->is_observed ? get_scalar(node->value) : 0;
+    step.kernel = Kernel::GENERIC;
+    // the operands of a kernel must all have columns
+    const auto& operand_nodes = node->in_nodes;
+    auto op_type = static_cast<oper::Operator*>(node)->op_type;
+    if (op_type == OperatorType::SAMPLE) {
+      auto dist = static_cast<distribution::Distribution*>(node->in_nodes[0]);
+      step.operands = columns_of(dist->in_nodes);
+      if (step.operands.size() == dist->in_nodes.size()) {
+        if (dist->dist_type == DistributionType::BERNOULLI) {
+          step.kernel = Kernel::SAMPLE_BERNOULLI;
+        } else if (dist->dist_type == DistributionType::NORMAL) {
+          step.kernel = Kernel::SAMPLE_NORMAL;
+        }
+      }
+    } else {
+      step.operands = columns_of(operand_nodes);
+      if (step.operands.size() == operand_nodes.size()) {
+        switch (op_type) {
+          case OperatorType::TO_REAL:
+            step.kernel = Kernel::COPY;
+            break;
+          case OperatorType::NEGATE:
+            step.kernel = Kernel::NEGATE;
+            break;
+          case OperatorType::COMPLEMENT:
+            step.kernel = Kernel::COMPLEMENT;
+            break;
+          case OperatorType::EXP:
+            step.kernel = Kernel::EXP;
+            break;
+          case OperatorType::LOG:
+            step.kernel = Kernel::LOG;
+            break;
+          case OperatorType::ADD:
+            step.kernel = Kernel::ADD;
+            break;
+          case OperatorType::MULTIPLY:
+            step.kernel = Kernel::MULTIPLY;
+            break;
+          case OperatorType::IF_THEN_ELSE:
+            step.kernel = Kernel::IF_THEN_ELSE;
+            break;
+          default:
+            break;
+        }
+      }
+    }
+    if (step.observed and evidence == Evidence::WEIGHT) {
+      if (op_type != OperatorType::SAMPLE) {
+        throw std::invalid_argument(
+            "only sample nodes can be observed when weighting worlds");
+      }
+      std::fill_n(column(step.column), batch_size, step.observation);
+    }
+    steps.push_back(std::move(step));
+  }
+}
+
+void BatchedAncestralSampler::sample_in_parallel(
+    Graph& graph,
+    const std::vector<Node*>& nodes,
+    uint batch_size,
+    Evidence evidence,
+    uint num_threads,
+    std::mt19937& gen,
+    const std::function<void(uint, Graph&, BatchedAncestralSampler&)>& record,
+    const std::function<bool(uint)>& collect) {
+  num_threads = std::max(num_threads, 1u);
+  std::vector<std::unique_ptr<Graph>> copies;
+  std::vector<Graph*> graphs{&graph};
+  for (uint t = 1; t < num_threads; t++) {
+    copies.push_back(std::make_unique<Graph>(graph));
+    graphs.push_back(copies.back().get());
+  }
+  std::vector<BatchedAncestralSampler> samplers;
+  for (Graph* graph_copy : graphs) {
+    std::vector<Node*> copy_nodes;
+    for (Node* node : nodes) {
+      copy_nodes.push_back(graph_copy->node_ptrs()[node->index]);
+    }
+    samplers.emplace_back(copy_nodes, batch_size, evidence);
+  }
+  // thread 0 draws from gen itself, so that with a single thread a graph
+  // with one random node draws the same values as one world at a time
+  std::vector<std::mt19937> generators(num_threads);
+  for (uint t = 1; t < num_threads; t++) {
+    generators[t].seed(gen());
+  }
+  generators[0] = gen;
+
+  auto sample_batch = [&](uint t) {
+    samplers[t].sample(generators[t]);
+    record(t, *graphs[t], samplers[t]);
+  };
+  if (num_threads == 1) {
+    do {
+      sample_batch(0);
+    } while (not collect(0));
+    return;
+  }
+
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception = nullptr;
+  std::mutex exception_mutex;
+  auto record_exception = [&]() {
+    std::lock_guard<std::mutex> lock(exception_mutex);
+    if (exception == nullptr) {
+      exception = std::current_exception();
+    }
+    failed = true;
+  };
+  bool done = false;
+  // runs on a single thread once all threads have sampled a batch
+  auto on_batch_completion = [&]() noexcept {
+    for (uint t = 0; t < num_threads and not failed and not done; t++) {
+      try {
+        done = collect(t);
+      } catch (...) {
+        record_exception();
+      }
+    }
+    done = done or failed;
+  };
+  std::barrier sync(num_threads, on_batch_completion);
+  auto work = [&](uint t) {
+    while (not done) {
+      if (not failed) {
+        try {
+          sample_batch(t);
+        } catch (...) {
+          record_exception();
+        }
+      }
+      sync.arrive_and_wait();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint t = 1; t < num_threads; t++) {
+    threads.emplace_back(work, t);
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (exception != nullptr) {
+    std::rethrow_exception(exception);
+  }
+}
+
+uint BatchedAncestralSampler::sample(std::mt19937& gen) {
+  if (evidence == Evidence::WEIGHT) {
+    // observed columns hold the observations and are never sampled
+    std::fill(log_weights.begin(), log_weights.end(), 0.0);
+    for (const Step& step : steps) {
+      if (step.observed) {
+        add_log_likelihood(step);
+      } else {
+        run(step, gen);
+      }
+    }
+    return _batch_size;
+  }
+  std::fill(alive.begin(), alive.end(), true);
+  uint num_alive = _batch_size;
+  for (const Step& step : steps) {
+    run(step, gen);
+    if (step.observed) {
+      // reject the worlds that disagree with the observation
+      const double* values = column(step.column);
+      num_alive = 0;
+      for (uint w = 0; w < _batch_size; w++) {
+        alive[w] &= values[w] == step.observation;
+        num_alive += alive[w];
+      }
+      if (num_alive == 0) {
+        // the rest of the batch need not be sampled
+        break;
+      }
+    }
+  }
+  return num_alive;
+}
+
+void BatchedAncestralSampler::run(const Step& step, std::mt19937& gen) {
+  const uint n = _batch_size;
+  double* out = column(step.column);
+  auto in = [&](uint i) -> const double* {
+    return column(step.operands[i]);
+  };
+  switch (step.kernel) {
+    case Kernel::COPY:
+      std::copy_n(in(0), n, out);
+      break;
+    case Kernel::NEGATE: {
+      const double* x = in(0);
+      for (uint w = 0; w < n; w++) {
+        out[w] = -x[w];
+      }
+      break;
+    }
+    case Kernel::COMPLEMENT: {
+      const double* x = in(0);
+      for (uint w = 0; w < n; w++) {
+        out[w] = 1 - x[w];
+      }
+      break;
+    }
+    case Kernel::EXP: {
+      const double* x = in(0);
+      for (uint w = 0; w < n; w++) {
+        out[w] = std::exp(x[w]);
+      }
+      break;
+    }
+    case Kernel::LOG: {
+      const double* x = in(0);
+      for (uint w = 0; w < n; w++) {
+        out[w] = std::log(x[w]);
+      }
+      break;
+    }
+    case Kernel::ADD:
+    case Kernel::MULTIPLY: {
+      std::copy_n(in(0), n, out);
+      for (uint i = 1; i < step.operands.size(); i++) {
+        const double* x = in(i);
+        if (step.kernel == Kernel::ADD) {
+          for (uint w = 0; w < n; w++) {
+            out[w] += x[w];
+          }
+        } else {
+          for (uint w = 0; w < n; w++) {
+            out[w] *= x[w];
+          }
+        }
+      }
+      break;
+    }
+    case Kernel::IF_THEN_ELSE: {
+      const double* cond = in(0);
+      const double* x = in(1);
+      const double* y = in(2);
+      for (uint w = 0; w < n; w++) {
+        out[w] = cond[w] != 0 ? x[w] : y[w];
+      }
+      break;
+    }
+    case Kernel::SAMPLE_BERNOULLI: {
+      const double* p = in(0);
+      std::uniform_real_distribution<double> uniform(0, 1);
+      for (uint w = 0; w < n; w++) {
+        out[w] = uniform(gen) < p[w];
+      }
+      break;
+    }
+    case Kernel::SAMPLE_NORMAL: {
+      const double* mean = in(0);
+      const double* sd = in(1);
+      std::normal_distribution<double> standard_normal(0, 1);
+      for (uint w = 0; w < n; w++) {
+        out[w] = mean[w] + sd[w] * standard_normal(gen);
+      }
+      break;
+    }
+    case Kernel::GENERIC:
+      run_generic(step, gen);
+      break;
+  }
+}
+
+// Evaluates the node one world at a time with its own eval method, using
+// the graph's nodes as scratch space. Worlds that have already been
+// rejected are skipped.
+void BatchedAncestralSampler::run_generic(const Step& step, std::mt19937& gen) {
+  Node* node = step.node;
+  NodeValue observation;
+  if (step.observed) {
+    observation = node->value;
+  }
+  double* out = column(step.column);
+  for (uint w = 0; w < _batch_size; w++) {
+    if (not alive[w]) {
+      continue;
+    }
+    load_parents(node, w);
+    node->eval(gen);
+    out[w] = get_scalar(node->value);
+  }
+  if (step.observed) {
+    node->value = observation;
+  }
+}
+
+// Adds the log probability of the observation of the step's node to the
+// log weight of each world.
+void BatchedAncestralSampler::add_log_likelihood(const Step& step) {
+  const uint n = _batch_size;
+  const double x = step.observation;
+  switch (step.kernel) {
+    case Kernel::SAMPLE_BERNOULLI: {
+      const double* p = column(step.operands[0]);
+      for (uint w = 0; w < n; w++) {
+        log_weights[w] += x != 0 ? std::log(p[w]) : std::log1p(-p[w]);
+      }
+      break;
+    }
+    case Kernel::SAMPLE_NORMAL: {
+      const double* mean = column(step.operands[0]);
+      const double* sd = column(step.operands[1]);
+      for (uint w = 0; w < n; w++) {
+        double z = (x - mean[w]) / sd[w];
+        log_weights[w] += -std::log(sd[w]) - 0.5 * std::log(2 * M_PI) -
+            0.5 * z * z;
+      }
+      break;
+    }
+    default: {
+      auto dist =
+          static_cast<distribution::Distribution*>(step.node->in_nodes[0]);
+      for (uint w = 0; w < n; w++) {
+        load_parents(step.node, w);
+        log_weights[w] += dist->log_prob(step.node->value);
+      }
+      break;
+    }
+  }
+}
+
+void BatchedAncestralSampler::load_parents(const Node* node, uint world) {
+  for (Node* parent : node->in_nodes) {
+    if (parent->node_type == NodeType::DISTRIBUTION) {
+      // the parameters of a sampled distribution
+      load_parents(parent, world);
+    } else if (parent->node_type == NodeType::OPERATOR) {
+      set_scalar(parent->value, column(column_of[parent->index])[world]);
+    }
+  }
+}
+
+void BatchedAncestralSampler::load_world(uint world) {
+  for (const Step& step : steps) {
+    if (not step.observed) {
+      set_scalar(step.node->value, column(step.column)[world]);
+    }
+  }
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <functional>
+#include <random>
+#include <vector>
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+Forward-samples a batch of independent worlds of a graph at once.
+
+The sampler is built over a topologically ordered subset of the graph's
+nodes that is closed under parents (see ancestors_of). Every scalar node in
+that subset gets a column holding its value in each world of the batch, and
+each operator is evaluated over the whole column before moving on to the
+next node. Common operators and distributions have dedicated column kernels;
+any other scalar operator is evaluated one world at a time by loading the
+world's parent values into the graph's nodes and calling the node's own eval.
+Only scalar operators are supported (see is_supported).
+
+Observed nodes are either sampled like any other node, rejecting the worlds
+in which the sampled value differs from the observation, or set to their
+observation, weighting each world by the likelihood of the observations.
+*/
+class BatchedAncestralSampler {
+ public:
+  // How observed nodes are treated.
+  enum class Evidence {
+    REJECT,
+    WEIGHT,
+  };
+
+  BatchedAncestralSampler(
+      const std::vector<Node*>& nodes,
+      uint batch_size,
+      Evidence evidence = Evidence::REJECT);
+
+  /*
+  Returns the nodes with the given ids together with all their ancestors,
+  in topological order.
+  */
+  static std::vector<Node*> ancestors_of(
+      Graph& graph,
+      const std::vector<NodeID>& node_ids);
+
+  /*
+  Whether the given nodes can be sampled in batch, that is, whether all
+  operators among them are scalar-valued.
+  */
+  static bool is_supported(const std::vector<Node*>& nodes);
+
+  /*
+  Samples batches of worlds of the given nodes of `graph` (see
+  ancestors_of) on `num_threads` threads until `collect` returns true.
+  Thread t samples with its own sampler over a copy of the graph (the graph
+  itself for thread 0), then calls record(t, graph_t, sampler_t) to extract
+  what it needs from the batch. Once every thread has sampled a batch,
+  collect(t) is called for each thread in order, on a single thread, so
+  results only depend on the state of `gen` and the number of threads.
+  */
+  static void sample_in_parallel(
+      Graph& graph,
+      const std::vector<Node*>& nodes,
+      uint batch_size,
+      Evidence evidence,
+      uint num_threads,
+      std::mt19937& gen,
+      const std::function<void(uint, Graph&, BatchedAncestralSampler&)>&
+          record,
+      const std::function<bool(uint)>& collect);
+
+  /*
+  Samples a new batch of worlds and returns the number of worlds
+  consistent with the observations (all of them when weighting).
+  */
+  uint sample(std::mt19937& gen);
+
+  uint batch_size() const {
+    return _batch_size;
+  }
+
+  bool accepted(uint world) const {
+    return alive[world] != 0;
+  }
+
+  // The log likelihood of the observations in the given world when weighting.
+  double log_weight(uint world) const {
+    return log_weights[world];
+  }
+
+  /*
+  Sets the values of the sampled nodes (in the graph) to their values in the
+  given world of the last batch.
+  */
+  void load_world(uint world);
+
+ private:
+  // How a node is evaluated over a column.
+  enum class Kernel {
+    COPY,
+    NEGATE,
+    COMPLEMENT,
+    EXP,
+    LOG,
+    ADD,
+    MULTIPLY,
+    IF_THEN_ELSE,
+    SAMPLE_BERNOULLI,
+    SAMPLE_NORMAL,
+    GENERIC,
+  };
+
+  struct Step {
+    Node* node;
+    Kernel kernel;
+    // column of the node
+    uint column;
+    // columns of the operands of the kernel (for SAMPLE_* kernels, the
+    // parameters of the distribution); unused by GENERIC
+    std::vector<uint> operands;
+    // observed value of the node, if it is observed
+    bool observed;
+    double observation;
+  };
+
+  double* column(uint c) {
+    return data.data() + static_cast<size_t>(c) * _batch_size;
+  }
+
+  void run(const Step& step, std::mt19937& gen);
+  void run_generic(const Step& step, std::mt19937& gen);
+  void add_log_likelihood(const Step& step);
+  void load_parents(const Node* node, uint world);
+
+  uint _batch_size;
+  Evidence evidence;
+  std::vector<Step> steps;
+  // node index -> column, or -1 for nodes without a column
+  std::vector<int> column_of;
+  std::vector<double> data;
+  // per world, whether it is consistent with the observations so far
+  std::vector<char> alive;
+  std::vector<double> log_weights;
+};
+
+} // namespace graph
+} // namespace beanmachine
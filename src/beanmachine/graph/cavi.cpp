@@ -8,8 +8,17 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
 #include <stdexcept>
-#include <unordered_set>
+#include <thread>
 
 #include <beanmachine/graph/distribution/distribution.h>
 #include <beanmachine/graph/graph.h>
@@ -19,170 +28,356 @@
 namespace beanmachine {
 namespace graph {
 
+namespace {
+
+// The samples of the variational distribution of the pool nodes:
+// one row of bits per pool node, one column per step.
+class SampleMatrix {
+ public:
+  SampleMatrix(uint num_rows, uint num_cols)
+      : words_per_row((num_cols + 63) / 64),
+        words(static_cast<size_t>(num_rows) * words_per_row, 0) {}
+
+  bool get(uint row, uint col) const {
+    return (words[index(row, col)] >> (col % 64)) & 1;
+  }
+
+  void set(uint row, uint col, bool value) {
+    std::uint64_t mask = std::uint64_t(1) << (col % 64);
+    if (value) {
+      words[index(row, col)] |= mask;
+    } else {
+      words[index(row, col)] &= ~mask;
+    }
+  }
+
+ private:
+  size_t index(uint row, uint col) const {
+    return static_cast<size_t>(row) * words_per_row + col / 64;
+  }
+
+  size_t words_per_row;
+  std::vector<std::uint64_t> words;
+};
+
+// A list of ids for each pool node, stored back to back.
+class IdLists {
+ public:
+  void append(const std::vector<uint>& ids) {
+    data.insert(data.end(), ids.begin(), ids.end());
+    offsets.push_back(static_cast<uint>(data.size()));
+  }
+  const uint* begin(uint i) const {
+    return data.data() + offsets[i];
+  }
+  const uint* end(uint i) const {
+    return data.data() + offsets[i + 1];
+  }
+
+ private:
+  std::vector<uint> offsets{0};
+  std::vector<uint> data;
+};
+
+// The first of `n` items handled by thread `t` of `num_threads`.
+inline uint chunk_begin(uint n, uint t, uint num_threads) {
+  return static_cast<uint>(static_cast<std::uint64_t>(n) * t / num_threads);
+}
+
+} // namespace
+
 void Graph::cavi(
     uint num_iters,
     uint steps_per_iter,
     std::mt19937& gen,
-    uint elbo_samples) {
+    uint elbo_samples,
+    uint num_threads) {
+  num_threads = std::max(num_threads, 1u);
   DeterministicAncestors det_anc;
   StochasticAncestors sto_anc;
   std::tie(det_anc, sto_anc) =
       collect_deterministic_and_stochastic_ancestors(*this);
-  // convert the smart pointers in nodes to dumb pointers in node_ptrs
-  // for faster access
-  std::vector<Node*> node_ptrs;
-  // store all the sampled values for each node
-  std::vector<std::vector<NodeValue>> var_samples;
-  for (uint node_id = 0; node_id < static_cast<uint>(nodes.size()); node_id++) {
-    node_ptrs.push_back(nodes[node_id].get());
-    var_samples.push_back(std::vector<NodeValue>());
-  }
-  assert(node_ptrs.size() > 0); // keep linter happy
   std::set<uint> mutable_support = compute_mutable_support();
-  // the variational parameter probability for each node (initially 0.5)
-  std::vector<double> param_probability =
-      std::vector<double>(nodes.size(), 0.5);
-  assert(param_probability.size() > 0); // keep linter happy
-  // compute pool : nodes that we will infer over
-  //    -> nodes to sample, nodes to eval, nodes to log_prob
-  // NOTE: we want the list of nodes in the pool to be sorted to ensure
-  // that we update the nodes in topological order. This helps in some models
-  // where some of the ancestor nodes have deterministic probabilities.
-  std::map<
-      uint,
-      std::tuple<std::vector<uint>, std::vector<uint>, std::vector<uint>>>
-      pool;
-  for (uint node_id : mutable_support) {
-    Node* node = node_ptrs[node_id];
+  const std::vector<uint> support(
+      mutable_support.begin(), mutable_support.end());
+  // The pool holds the nodes that we will infer over, each identified by its
+  // row in the sample matrix. Rows follow the node ids so that the nodes are
+  // updated in topological order. This helps in some models where some of
+  // the ancestor nodes have deterministic probabilities.
+  std::vector<uint> pool;
+  // node id -> row in the pool, or -1 for nodes outside of the pool
+  std::vector<int> row_of(nodes.size(), -1);
+  for (uint node_id : support) {
+    Node* node = nodes[node_id].get();
+    if (node->is_stochastic() and not node->is_observed) {
+      if (node->value.type != AtomicType::BOOLEAN) {
+        throw std::invalid_argument(
+            "variational inference only supports boolean latent variables");
+      }
+      row_of[node_id] = static_cast<int>(pool.size());
+      pool.push_back(node_id);
+    }
+  }
+  // the variational parameter probability for each pool node
+  std::vector<double> param_probability(pool.size(), 0.5);
+  SampleMatrix samples(static_cast<uint>(pool.size()), steps_per_iter);
+  // For each node in the pool we need its stochastic descendants because
+  // those are the nodes for which we will compute the expected log_prob.
+  // We will call these nodes the logprob_nodes. In order to compute the
+  // log_prob of these nodes we need to materialize their ancestors both
+  // deterministic and stochastic. The unobserved stochastic ancestors are to
+  // be sampled while the deterministic ancestors will be "eval"ed hence we
+  // call these the sample_rows and the eval_nodes respectively. Note: the
+  // unobserved logprob_nodes also need to be sampled excluding the target.
+  IdLists sample_rows;
+  IdLists eval_nodes;
+  IdLists logprob_nodes;
+  std::vector<bool> marked(nodes.size(), false);
+  for (uint node_id : support) {
+    Node* node = nodes[node_id].get();
     if (not node->is_observed) {
       node->eval(gen); // evaluate the value of non-observed operator nodes
     }
-    if (node->is_stochastic() and not node->is_observed) {
-      // sample some values for this node
-      auto& samples = var_samples[node_id];
-      std::bernoulli_distribution distrib(param_probability[node_id]);
-      for (uint step = 0; step < steps_per_iter; step++) {
-        samples.push_back(NodeValue(bool(distrib(gen))));
+    int row = row_of[node_id];
+    if (row < 0) {
+      continue;
+    }
+    std::bernoulli_distribution distrib(param_probability[row]);
+    for (uint step = 0; step < steps_per_iter; step++) {
+      samples.set(row, step, distrib(gen));
+    }
+    std::vector<uint> det_desc;
+    std::vector<uint> logprob_ids;
+    std::tie(det_desc, logprob_ids) =
+        compute_affected_nodes(node_id, mutable_support);
+    std::vector<uint> rows;
+    std::vector<uint> det_ids;
+    for (uint id : logprob_ids) {
+      if (id != node_id and row_of[id] >= 0 and not marked[id]) {
+        marked[id] = true;
+        rows.push_back(row_of[id]);
       }
-      // For each node in the pool we need its stochastic descendants
-      // because those are the nodes for which we will compute the expected
-      // log_prob. We will call these nodes the log_prob_nodes.
-      std::vector<uint> det_desc;
-      std::vector<uint> logprob_nodes;
-      std::tie(det_desc, logprob_nodes) =
-          compute_affected_nodes(node_id, mutable_support);
-      // In order to compute the log_prob of these nodes we need to
-      // materialize their ancestors both deterministic and stochastic.
-      // The unobserved stochastic ancestors are to be sampled while the
-      // deterministic ancestors will be "eval"ed hence we call these nodes the
-      // sample_nodes and the eval_nodes respectively. Note: the unobserved
-      // logprob_nodes also need to be sampled excluding the target node.
-      // To avoid duplicates and to sort the nodes we will first create sets.
-      std::unordered_set<uint> sample_set;
-      // the deterministic nodes have to be evaluated in topological order
-      std::set<uint> det_set;
-      for (auto id : logprob_nodes) {
-        assert(id < det_anc.size());
-        for (auto id2 : det_anc[id]) {
-          det_set.insert(id2);
+      for (uint id2 : sto_anc[id]) {
+        if (id2 != node_id and row_of[id2] >= 0 and not marked[id2]) {
+          marked[id2] = true;
+          rows.push_back(row_of[id2]);
         }
-        assert(id < sto_anc.size());
-        for (auto id2 : sto_anc[id]) {
-          if (id2 != node_id and observed.find(id2) == observed.end()) {
-            sample_set.insert(id2);
-          }
-        }
-        if (id != node_id and observed.find(id) == observed.end()) {
-          sample_set.insert(id);
+      }
+      for (uint id2 : det_anc[id]) {
+        if (not marked[id2]) {
+          marked[id2] = true;
+          det_ids.push_back(id2);
         }
       }
-      std::vector<uint> eval_nodes;
-      eval_nodes.insert(eval_nodes.end(), det_set.begin(), det_set.end());
-      std::vector<uint> sample_nodes;
-      sample_nodes.insert(
-          sample_nodes.end(), sample_set.begin(), sample_set.end());
-      pool[node_id] = std::make_tuple(sample_nodes, eval_nodes, logprob_nodes);
     }
+    for (uint r : rows) {
+      marked[pool[r]] = false;
+    }
+    for (uint id : det_ids) {
+      marked[id] = false;
+    }
+    // the deterministic nodes have to be evaluated in topological order
+    std::sort(rows.begin(), rows.end());
+    std::sort(det_ids.begin(), det_ids.end());
+    sample_rows.append(rows);
+    eval_nodes.append(det_ids);
+    logprob_nodes.append(logprob_ids);
   }
-  // optimization outer loop
-  for (uint inum = 0; inum < num_iters; inum++) {
-    for (auto it = pool.begin(); it != pool.end(); ++it) {
-      uint tgt_node_id = it->first;
-      Node* tgt_node = node_ptrs[tgt_node_id];
-      // the following dance of getting into a tuple is needed because this
-      // version of C++ doesn't have structured bindings
-      std::tuple<
-          const std::vector<uint>&,
-          const std::vector<uint>&,
-          const std::vector<uint>&>
-          tmp_tuple = it->second;
-      const std::vector<uint>& sample_nodes = std::get<0>(tmp_tuple);
-      const std::vector<uint>& eval_nodes = std::get<1>(tmp_tuple);
-      const std::vector<uint>& logprob_nodes = std::get<2>(tmp_tuple);
-      std::vector<double> expec(2, 0.0);
-      for (uint step = 0; step < steps_per_iter; step++) {
-        for (uint node_id : sample_nodes) {
-          node_ptrs[node_id]->value = var_samples[node_id][step];
+
+  // Thread t works on its own copy of the graph (the graph itself for
+  // thread 0), estimating the expectations over a contiguous range of the
+  // steps and the ELBO over a contiguous range of its samples.
+  std::vector<std::unique_ptr<Graph>> copies;
+  std::vector<std::vector<Node*>> thread_nodes{node_ptrs()};
+  for (uint t = 1; t < num_threads; t++) {
+    copies.push_back(std::make_unique<Graph>(*this));
+    for (uint node_id : support) {
+      copies.back()->nodes[node_id]->value = nodes[node_id]->value;
+    }
+    thread_nodes.push_back(copies.back()->node_ptrs());
+  }
+  // thread 0 draws from gen itself, so that with a single thread the
+  // results are those of the serial algorithm
+  std::vector<std::mt19937> generators(num_threads);
+  for (uint t = 1; t < num_threads; t++) {
+    generators[t].seed(gen());
+  }
+  std::vector<std::mt19937*> thread_gens{&gen};
+  for (uint t = 1; t < num_threads; t++) {
+    thread_gens.push_back(&generators[t]);
+  }
+
+  // partial_expec[t][val] : thread t's share of the expected log_prob of the
+  // target's logprob_nodes when the target has value val
+  std::vector<std::array<double, 2>> partial_expec(num_threads);
+  auto estimate_expectation = [&](uint t, uint row) {
+    Node* const* tnodes = thread_nodes[t].data();
+    Node* tgt_node = tnodes[pool[row]];
+    std::mt19937& tgen = *thread_gens[t];
+    std::array<double, 2> expec = {0.0, 0.0};
+    uint end = chunk_begin(steps_per_iter, t + 1, num_threads);
+    for (uint step = chunk_begin(steps_per_iter, t, num_threads); step < end;
+         step++) {
+      for (const uint* r = sample_rows.begin(row); r != sample_rows.end(row);
+           ++r) {
+        tnodes[pool[*r]]->value._bool = samples.get(*r, step);
+      }
+      for (uint val = 0; val < 2; val++) {
+        tgt_node->value._bool = val == 1;
+        for (const uint* id = eval_nodes.begin(row); id != eval_nodes.end(row);
+             ++id) {
+          tnodes[*id]->eval(tgen);
         }
-        for (uint val = 0; val < 2; val++) {
-          tgt_node->value = NodeValue(bool(val));
-          for (uint node_id : eval_nodes) {
-            node_ptrs[node_id]->eval(gen);
-          }
-          double log_prob = 0;
-          for (uint node_id : logprob_nodes) {
-            log_prob += node_ptrs[node_id]->log_prob();
+        double log_prob = 0;
+        for (const uint* id = logprob_nodes.begin(row);
+             id != logprob_nodes.end(row);
+             ++id) {
+          log_prob += tnodes[*id]->log_prob();
+        }
+        // update the expectation w.r.t. current value of target node
+        expec[val] += log_prob / steps_per_iter;
+      }
+    }
+    partial_expec[t] = expec;
+  };
+  auto update_target = [&](uint row) {
+    std::array<double, 2> expec = {0.0, 0.0};
+    for (uint t = 0; t < num_threads; t++) {
+      expec[0] += partial_expec[t][0];
+      expec[1] += partial_expec[t][1];
+    }
+    if (std::isfinite(expec[0]) or std::isfinite(expec[1])) {
+      param_probability[row] = util::logistic(expec[1] - expec[0]);
+    } else {
+      param_probability[row] = 0.5;
+    }
+    std::bernoulli_distribution distrib(param_probability[row]);
+    for (uint step = 0; step < steps_per_iter; step++) {
+      samples.set(row, step, distrib(gen));
+    }
+  };
+
+  // For a model p(X, Z) assume we are trying to estimate p(Z | X=x)
+  //  using a variational approximation Q(Z).
+  // Now KL-Divergence of  Q(Z) || p(Z|x) >= 0
+  // => E[log Q(Z) - log p(Z|x) | Z ~ Q] >= 0
+  // => p(x) >= E[log p(Z, x) - log Q(Z) | Z ~ Q]
+  // the RHS is the ELBO or evidence lower bound
+  // We compute this expectation using the samples of the nodes in our pool.
+  // log p(Z, x) is the log_prob of all the stochastic nodes
+  // and log Q(Z) is the log of the variational distribution for the pool.
+  std::vector<double> partial_elbo(num_threads);
+  auto estimate_elbo = [&](uint t) {
+    Node* const* tnodes = thread_nodes[t].data();
+    std::mt19937& tgen = *thread_gens[t];
+    double elbo = 0;
+    uint end = chunk_begin(elbo_samples, t + 1, num_threads);
+    for (uint step = chunk_begin(elbo_samples, t, num_threads); step < end;
+         step++) {
+      for (uint node_id : support) {
+        Node* node = tnodes[node_id];
+        if (node->is_stochastic()) {
+          if (not node->is_observed) {
+            double prob = param_probability[row_of[node_id]];
+            std::bernoulli_distribution distrib(prob);
+            node->value._bool = distrib(tgen);
+            // subtract the log_prob of the variational distribution
+            elbo -= node->value._bool ? std::log(prob) : std::log(1 - prob);
           }
-          // update the expectation w.r.t. current value of target node
-          expec[val] += log_prob / steps_per_iter;
+          // add the log_prob of the joint distribution
+          elbo += node->log_prob();
+        } else if (node->node_type == NodeType::OPERATOR) {
+          node->eval(tgen);
         }
       }
-      if (std::isfinite(expec[0]) or std::isfinite(expec[1])) {
-        param_probability[tgt_node_id] = util::logistic(expec[1] - expec[0]);
-      } else {
-        param_probability[tgt_node_id] = 0.5;
+    }
+    partial_elbo[t] = elbo;
+  };
+  auto record_elbo = [&]() {
+    double elbo = 0;
+    for (uint t = 0; t < num_threads; t++) {
+      elbo += partial_elbo[t];
+    }
+    elbo_vals.push_back(elbo / elbo_samples);
+  };
+
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception = nullptr;
+  std::mutex exception_mutex;
+  auto record_exception = [&]() {
+    std::lock_guard<std::mutex> lock(exception_mutex);
+    if (exception == nullptr) {
+      exception = std::current_exception();
+    }
+    failed = true;
+  };
+  // The threads go through the optimization in lockstep; each phase ends
+  // with the threads' partial estimates being combined on a single thread
+  // (in thread order, so that the results do not depend on the scheduling).
+  // finishing_row is the pool row whose expectation was just estimated, or
+  // -1 after the ELBO was estimated; it is only written by thread 0 before
+  // arriving at the barrier. stop is only written by the completion step, so
+  // all the threads agree on when to leave the loop.
+  int finishing_row = 0;
+  bool stop = false;
+  auto on_phase_completion = [&]() noexcept {
+    if (not failed) {
+      try {
+        if (finishing_row < 0) {
+          record_elbo();
+        } else {
+          update_target(finishing_row);
+        }
+      } catch (...) {
+        record_exception();
       }
-      auto& samples = var_samples[tgt_node_id];
-      std::bernoulli_distribution distrib(param_probability[tgt_node_id]);
-      for (uint step = 0; step < steps_per_iter; step++) {
-        samples[step] = NodeValue(bool(distrib(gen)));
+    }
+    stop = failed;
+  };
+  std::barrier sync(num_threads, on_phase_completion);
+  auto run_phase = [&](auto&& phase) {
+    if (not failed) {
+      try {
+        phase();
+      } catch (...) {
+        record_exception();
       }
     }
-    if (elbo_samples > 0) {
-      // For a model p(X, Z) assume we are trying to estimate p(Z | X=x)
-      //  using a variational approximation Q(Z).
-      // Now KL-Divergence of  Q(Z) || p(Z|x) >= 0
-      // => E[log Q(Z) - log p(Z|x) | Z ~ Q] >= 0
-      // => p(x) >= E[log p(Z, x) - log Q(Z) | Z ~ Q]
-      // the RHS is the ELBO or evidence lower bound
-      // We compute this expectation using the samples of the nodes in our pool.
-      // log p(Z, x) is the log_prob of all the stochastic nodes
-      // and log Q(Z) is the log of the variational distribution for the pool.
-      double elbo = 0;
-      for (uint step = 0; step < elbo_samples; step++) {
-        for (uint node_id : mutable_support) {
-          Node* node = node_ptrs[node_id];
-          if (node->is_stochastic()) {
-            if (not node->is_observed) {
-              double prob = param_probability[node_id];
-              std::bernoulli_distribution distrib(prob);
-              node->value = NodeValue(bool(distrib(gen)));
-              // subtract the log_prob of the variational distribution
-              elbo -= node->value._bool ? log(prob) : log(1 - prob);
-            }
-            // add the log_prob of the joint distribution
-            elbo += node->log_prob();
-          } else if (node->node_type == NodeType::OPERATOR) {
-            node->eval(gen);
-          }
+    sync.arrive_and_wait();
+  };
+  // optimization outer loop
+  auto work = [&](uint t) {
+    for (uint inum = 0; inum < num_iters and not stop; inum++) {
+      for (uint row = 0; row < pool.size() and not stop; row++) {
+        if (t == 0) {
+          finishing_row = static_cast<int>(row);
+        }
+        run_phase([&]() { estimate_expectation(t, row); });
+      }
+      if (elbo_samples > 0 and not stop) {
+        if (t == 0) {
+          finishing_row = -1;
         }
+        run_phase([&]() { estimate_elbo(t); });
       }
-      elbo_vals.push_back(elbo / elbo_samples);
     }
+  };
+  std::vector<std::thread> threads;
+  for (uint t = 1; t < num_threads; t++) {
+    threads.emplace_back(work, t);
   }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (exception != nullptr) {
+    std::rethrow_exception(exception);
+  }
+
   variational_params.clear();
   for (uint node_id : queries) {
-    variational_params.push_back({param_probability[node_id]});
+    int row = row_of[node_id];
+    variational_params.push_back({row < 0 ? 0.5 : param_probability[row]});
   }
 }
 
@@ -156,5 +156,32 @@ void Bernoulli::backward_param_iid(
   }
 }
 
+// The sufficient statistic is the number of true elements.
+bool Bernoulli::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  stats.size = static_cast<double>(value._bmatrix.size());
+  stats.sums = {static_cast<double>(value._bmatrix.count()), 0, 0};
+  return true;
+}
+
+double Bernoulli::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double prob = in_nodes[0]->value._double;
+  double n_positive = stats.sums[0];
+  return std::log(prob) * n_positive +
+      std::log(1 - prob) * (stats.size - n_positive);
+}
+
+void Bernoulli::backward_param_sufficient(
+    const SufficientStatistics& stats) const {
+  if (in_nodes[0]->needs_gradient()) {
+    double prob = in_nodes[0]->value._double;
+    double n_positive = stats.sums[0];
+    in_nodes[0]->back_grad1 +=
+        (1 / prob * n_positive - 1 / (1 - prob) * (stats.size - n_positive));
+  }
+}
+
 } // namespace distribution
 } // namespace beanmachine
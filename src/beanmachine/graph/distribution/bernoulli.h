@@ -52,6 +52,13 @@ class Bernoulli : public Distribution {
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
 
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
+
   static double _grad1_log_prob_param(bool x, double p);
 };
 
@@ -12,6 +12,7 @@
 #include <string>
 
 #include "beanmachine/graph/distribution/bernoulli_logit.h"
+#include "beanmachine/graph/distribution/iid_kernels.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -85,11 +86,13 @@ void BernoulliLogit::log_prob_iid(
     Eigen::MatrixXd& log_probs) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double l = in_nodes[0]->value._double;
-  double pos_val = -util::log1pexp(-l);
-  double neg_val = -util::log1pexp(l);
-  log_probs = Eigen::MatrixXd::Constant(
-      value._bmatrix.rows(), value._bmatrix.cols(), neg_val);
-  log_probs = value._bmatrix.select(pos_val, log_probs);
+  log_probs.resize(value._bmatrix.rows(), value._bmatrix.cols());
+  iid::bernoulli_logit(
+      value._bmatrix.data(),
+      value._bmatrix.size(),
+      l,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void BernoulliLogit::gradient_log_prob_value(
@@ -140,11 +143,14 @@ void BernoulliLogit::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
     double l = in_nodes[0]->value._double;
-    int size = static_cast<int>(value._bmatrix.size());
-    int n_positive = static_cast<int>(value._bmatrix.count());
-    in_nodes[0]->back_grad1 +=
-        (1 / (1 + std::exp(l)) * n_positive -
-         1 / (1 + std::exp(-l)) * (size - n_positive));
+    double grad;
+    iid::bernoulli_logit(
+        value._bmatrix.data(),
+        value._bmatrix.size(),
+        l,
+        nullptr,
+        {.param_grads = &grad});
+    in_nodes[0]->back_grad1 += grad;
   }
 }
 
@@ -154,12 +160,14 @@ void BernoulliLogit::backward_param_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
     double l = in_nodes[0]->value._double;
-    double sum_adjunct = adjunct.sum();
-    double sum_pos_adjunct =
-        (value._bmatrix.cast<double>().array() * adjunct.array()).sum();
-    in_nodes[0]->back_grad1 +=
-        (1 / (1 + std::exp(l)) * sum_pos_adjunct -
-         1 / (1 + std::exp(-l)) * (sum_adjunct - sum_pos_adjunct));
+    double grad;
+    iid::bernoulli_logit(
+        value._bmatrix.data(),
+        value._bmatrix.size(),
+        l,
+        adjunct.data(),
+        {.param_grads = &grad});
+    in_nodes[0]->back_grad1 += grad;
   }
 }
 
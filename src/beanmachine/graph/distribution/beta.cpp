@@ -9,6 +9,8 @@
 #include <cmath>
 
 #include "beanmachine/graph/distribution/beta.h"
+#include "beanmachine/graph/distribution/iid_kernels.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -42,6 +44,37 @@ double Beta::_double_sampler(std::mt19937& gen) const {
       gen, in_nodes[0]->value._double, in_nodes[1]->value._double);
 }
 
+double Beta::log_normalizer() const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return log_normalizer_cache.get({param_a, param_b}, [&]() {
+    return special::lgamma(param_a + param_b) - special::lgamma(param_a) -
+        special::lgamma(param_b);
+  });
+}
+
+std::array<double, 2> Beta::digamma_diffs() const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return digamma_diffs_cache.get({param_a, param_b}, [&]() {
+    double digamma_a_p_b = special::digamma(param_a + param_b);
+    return std::array<double, 2>{
+        digamma_a_p_b - special::digamma(param_a),
+        digamma_a_p_b - special::digamma(param_b)};
+  });
+}
+
+std::array<double, 3> Beta::trigammas() const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return trigammas_cache.get({param_a, param_b}, [&]() {
+    return std::array<double, 3>{
+        special::trigamma(param_a + param_b),
+        special::trigamma(param_a),
+        special::trigamma(param_b)};
+  });
+}
+
 double Beta::log_prob(const graph::NodeValue& value) const {
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
@@ -51,7 +84,7 @@ double Beta::log_prob(const graph::NodeValue& value) const {
   };
   if (value.type.variable_type == graph::VariableType::SCALAR) {
     update_logprob(value._double);
-    ret_val += lgamma(param_a + param_b) - lgamma(param_a) - lgamma(param_b);
+    ret_val += log_normalizer();
     return ret_val;
   }
 
@@ -61,8 +94,7 @@ double Beta::log_prob(const graph::NodeValue& value) const {
   for (uint i = 0; i < size; i++) {
     update_logprob(*(value._matrix.data() + i));
   }
-  ret_val +=
-      size * (lgamma(param_a + param_b) - lgamma(param_a) - lgamma(param_b));
+  ret_val += size * log_normalizer();
   return ret_val;
 }
 
@@ -72,9 +104,14 @@ void Beta::log_prob_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double result = lgamma(param_a + param_b) - lgamma(param_a) - lgamma(param_b);
-  log_probs = result + (param_a - 1) * value._matrix.array().log() +
-      (param_b - 1) * (1 - value._matrix.array()).log();
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::beta(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 // Note log_prob(x | a, b) = (a-1) log(x) + (b-1) log(1-x) + log G(a+b) - log
@@ -126,17 +163,12 @@ void Beta::compute_jacobian_hessian(
     const graph::NodeValue& value,
     Eigen::Matrix<double, 1, 2>& jacobian,
     Eigen::Matrix2d& hessian) const {
-  double param_a = in_nodes[0]->value._double;
-  double param_b = in_nodes[1]->value._double;
-  double digamma_a_p_b = util::polygamma(0, param_a + param_b); // digamma(a+b)
-  double digamma_diff_a = digamma_a_p_b - util::polygamma(0, param_a);
-  double digamma_diff_b = digamma_a_p_b - util::polygamma(0, param_b);
-  double poly1_a_p_b =
-      util::polygamma(1, param_a + param_b); // polygamma(1, a+b)
+  auto [digamma_diff_a, digamma_diff_b] = digamma_diffs();
+  auto [poly1_a_p_b, poly1_a, poly1_b] = trigammas(); // polygamma(1, .)
 
-  *hessian.data() = poly1_a_p_b - util::polygamma(1, param_a);
+  *hessian.data() = poly1_a_p_b - poly1_a;
   *(hessian.data() + 1) = *(hessian.data() + 2) = poly1_a_p_b;
-  *(hessian.data() + 3) = poly1_a_p_b - util::polygamma(1, param_b);
+  *(hessian.data() + 3) = poly1_a_p_b - poly1_b;
 
   if (value.type.variable_type == graph::VariableType::SCALAR) {
     *jacobian.data() = std::log(value._double) + digamma_diff_a;
@@ -174,9 +206,13 @@ void Beta::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  back_grad += ((param_a - 1) / value._matrix.array() -
-                (param_b - 1) / (1 - value._matrix.array()))
-                   .matrix();
+  iid::beta(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Beta::backward_value_iid(
@@ -186,42 +222,49 @@ void Beta::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  back_grad += (adjunct.array() *
-                ((param_a - 1) / value._matrix.array() -
-                 (param_b - 1) / (1 - value._matrix.array())))
-                   .matrix();
+  iid::beta(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Beta::backward_param(const graph::NodeValue& value, double adjunct) const {
   assert(value.type.variable_type == graph::VariableType::SCALAR);
   double x = value._double;
-  double param_a = in_nodes[0]->value._double;
-  double param_b = in_nodes[1]->value._double;
-  double digamma_a_p_b = util::polygamma(0, param_a + param_b);
+  auto [digamma_diff_a, digamma_diff_b] = digamma_diffs();
   if (in_nodes[0]->needs_gradient()) {
-    double jacob = std::log(x) + digamma_a_p_b - util::polygamma(0, param_a);
+    double jacob = std::log(x) + digamma_diff_a;
     in_nodes[0]->back_grad1 += adjunct * jacob;
   }
   if (in_nodes[1]->needs_gradient()) {
-    double jacob =
-        std::log(1 - x) + digamma_a_p_b - util::polygamma(0, param_b);
+    double jacob = std::log(1 - x) + digamma_diff_b;
     in_nodes[1]->back_grad1 += adjunct * jacob;
   }
 }
 
 void Beta::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double digamma_a_p_b = util::polygamma(0, param_a + param_b);
-  int size = static_cast<int>(value._matrix.size());
+  double grads[2];
+  iid::beta(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += value._matrix.array().log().sum() +
-        size * (digamma_a_p_b - util::polygamma(0, param_a));
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 += (1 - value._matrix.array()).log().sum() +
-        size * (digamma_a_p_b - util::polygamma(0, param_b));
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -229,22 +272,54 @@ void Beta::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double digamma_a_p_b = util::polygamma(0, param_a + param_b);
-  double adjunct_sum = 1.0;
-  if (in_nodes[0]->needs_gradient() or in_nodes[1]->needs_gradient()) {
-    adjunct_sum = adjunct.sum();
+  double grads[2];
+  iid::beta(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      adjunct.data(),
+      {.param_grads = grads});
+  if (in_nodes[0]->needs_gradient()) {
+    in_nodes[0]->back_grad1 += grads[0];
   }
+  if (in_nodes[1]->needs_gradient()) {
+    in_nodes[1]->back_grad1 += grads[1];
+  }
+}
+
+// The sufficient statistics are the sums of log(x) and of log(1 - x).
+bool Beta::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  stats.size = static_cast<double>(value._matrix.size());
+  stats.sums = {
+      value._matrix.array().log().sum(),
+      (1 - value._matrix.array()).log().sum(),
+      0};
+  return true;
+}
+
+double Beta::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return stats.size * log_normalizer() + (param_a - 1) * stats.sums[0] +
+      (param_b - 1) * stats.sums[1];
+}
+
+void Beta::backward_param_sufficient(const SufficientStatistics& stats) const {
+  auto [digamma_diff_a, digamma_diff_b] = digamma_diffs();
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 +=
-        (adjunct.array() * value._matrix.array().log()).sum() +
-        adjunct_sum * (digamma_a_p_b - util::polygamma(0, param_a));
+    in_nodes[0]->back_grad1 += stats.size * digamma_diff_a + stats.sums[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 +=
-        (adjunct.array() * (1 - value._matrix.array()).log()).sum() +
-        adjunct_sum * (digamma_a_p_b - util::polygamma(0, param_b));
+    in_nodes[1]->back_grad1 += stats.size * digamma_diff_b + stats.sums[1];
   }
 }
 
@@ -54,11 +54,31 @@ class Beta : public Distribution {
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
 
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
+
   static void _grad1_log_prob_value(
       double& grad1,
       double x,
       double param_a,
       double param_b);
+
+ private:
+  // The terms of the log prob and its gradients that depend only on the
+  // parameters a and b (see ParameterCache).
+  double log_normalizer() const;
+  std::array<double, 2> digamma_diffs() const;
+  std::array<double, 3> trigammas() const;
+  // lgamma(a + b) - lgamma(a) - lgamma(b)
+  mutable ParameterCache<2> log_normalizer_cache;
+  // digamma(a + b) - digamma(a), digamma(a + b) - digamma(b)
+  mutable ParameterCache<2, std::array<double, 2>> digamma_diffs_cache;
+  // trigamma(a + b), trigamma(a), trigamma(b)
+  mutable ParameterCache<2, std::array<double, 3>> trigammas_cache;
 };
 
 } // namespace distribution
@@ -46,6 +46,10 @@ graph::natural_t Binomial::_natural_sampler(std::mt19937& gen) const {
   return distrib(gen);
 }
 
+graph::natural_t Binomial::finite_support_size() const {
+  return in_nodes[0]->value._natural + 1;
+}
+
 double Binomial::log_prob(const graph::NodeValue& value) const {
   graph::natural_t n = in_nodes[0]->value._natural;
   double p = in_nodes[1]->value._double;
@@ -180,5 +184,50 @@ void Binomial::backward_param_iid(
   }
 }
 
+// The sufficient statistics are the sums of k and of log(k!) + log((n-k)!),
+// the latter depending on n; they are only used when n is a constant and no
+// element exceeds it.
+bool Binomial::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  graph::natural_t n = in_nodes[0]->value._natural;
+  if (in_nodes[0]->node_type != graph::NodeType::CONSTANT or
+      (value._nmatrix.array() > n).any()) {
+    return false;
+  }
+  Eigen::MatrixXd value_double = value._nmatrix.cast<double>();
+  double k_factorial_sum = (value_double.array() + 1).lgamma().sum();
+  double n_k_factorial_sum = (n - value_double.array() + 1).lgamma().sum();
+  stats.size = static_cast<double>(value_double.size());
+  stats.sums = {value_double.sum(), k_factorial_sum + n_k_factorial_sum, 0};
+  return true;
+}
+
+double Binomial::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double n = static_cast<double>(in_nodes[0]->value._natural);
+  double p = in_nodes[1]->value._double;
+  double sum_k = stats.sums[0];
+  double ret_val = 0;
+  // we will try not to evaluate log(p) or log(1-p) unless needed
+  if (sum_k > 0) {
+    ret_val += sum_k * log(p);
+  }
+  if (sum_k < n * stats.size) {
+    ret_val += (n * stats.size - sum_k) * log(1 - p);
+  }
+  return ret_val + std::lgamma(n + 1) * stats.size - stats.sums[1];
+}
+
+void Binomial::backward_param_sufficient(
+    const SufficientStatistics& stats) const {
+  if (in_nodes[1]->needs_gradient()) {
+    double n = static_cast<double>(in_nodes[0]->value._natural);
+    double p = in_nodes[1]->value._double;
+    double sum_k = stats.sums[0];
+    in_nodes[1]->back_grad1 += sum_k / p - (stats.size * n - sum_k) / (1 - p);
+  }
+}
+
 } // namespace distribution
 } // namespace beanmachine
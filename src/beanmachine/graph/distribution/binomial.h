@@ -21,6 +21,7 @@ class Binomial : public Distribution {
       const std::vector<graph::Node*>& in_nodes);
   ~Binomial() override {}
   graph::natural_t _natural_sampler(std::mt19937& gen) const override;
+  graph::natural_t finite_support_size() const override;
   double log_prob(const graph::NodeValue& value) const override;
   void log_prob_iid(const graph::NodeValue& value, Eigen::MatrixXd& log_probs)
       const override;
@@ -50,6 +51,13 @@ class Binomial : public Distribution {
   void backward_param_iid(
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
+
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
 };
 
 } // namespace distribution
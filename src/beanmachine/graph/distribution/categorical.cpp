@@ -57,9 +57,20 @@ graph::natural_t Categorical::_natural_sampler(std::mt19937& gen) const {
   return (graph::natural_t)distrib(gen);
 }
 
+graph::natural_t Categorical::finite_support_size() const {
+  return (graph::natural_t)in_nodes[0]->value._matrix.rows();
+}
+
 double Categorical::log_prob(const graph::NodeValue& value) const {
   assert(in_nodes.size() == 1);
   assert(in_nodes[0] != 0);
+  if (value.type.variable_type == graph::VariableType::BROADCAST_MATRIX) {
+    double result = 0.0;
+    for (uint i = 0; i < value._nmatrix.size(); i++) {
+      result += log_prob(graph::NodeValue(value._nmatrix(i)));
+    }
+    return result;
+  }
   const Eigen::MatrixXd& matrix = in_nodes[0]->value._matrix;
   double prob = 0.0;
   graph::natural_t r = (graph::natural_t)matrix.rows();
@@ -110,18 +121,26 @@ void Categorical::gradient_log_prob_param(
   grad2 += 0; // TODO
 }
 
+// The gradient of log(p_x) with respect to the parameters is 1/p_x
+// at position x and 0 elsewhere.
 void Categorical::backward_param(const graph::NodeValue& value, double adjunct)
     const {
   assert(value.type.variable_type == graph::VariableType::SCALAR);
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += 0; // TODO
+    const Eigen::MatrixXd& matrix = in_nodes[0]->value._matrix;
+    if (value._natural < static_cast<graph::natural_t>(matrix.rows())) {
+      in_nodes[0]->back_grad1(value._natural) +=
+          adjunct / matrix(value._natural, 0);
+    }
   }
 }
 
 void Categorical::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += 0; // TODO
+    for (uint i = 0; i < value._nmatrix.size(); i++) {
+      backward_param(graph::NodeValue(value._nmatrix(i)));
+    }
   }
 }
 
@@ -130,7 +149,9 @@ void Categorical::backward_param_iid(
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += 0; // TODO
+    for (uint i = 0; i < value._nmatrix.size(); i++) {
+      backward_param(graph::NodeValue(value._nmatrix(i)), adjunct(i));
+    }
   }
 }
 
@@ -21,6 +21,7 @@ class Categorical : public Distribution {
       const std::vector<graph::Node*>& in_nodes);
   ~Categorical() override {}
   graph::natural_t _natural_sampler(std::mt19937& gen) const override;
+  graph::natural_t finite_support_size() const override;
   double log_prob(const graph::NodeValue& value) const override;
   void log_prob_iid(const graph::NodeValue& value, Eigen::MatrixXd& log_probs)
       const override;
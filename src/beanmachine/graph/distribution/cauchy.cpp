@@ -11,6 +11,7 @@
 #include <string>
 
 #include "beanmachine/graph/distribution/cauchy.h"
+#include "beanmachine/graph/distribution/iid_kernels.h"
 
 namespace beanmachine {
 namespace distribution {
@@ -87,14 +88,17 @@ double Cauchy::log_prob(const NodeValue& value) const {
 void Cauchy::log_prob_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& log_probs) const {
-  // log(PDF) = -log(π * s) - log(1 + ((x - x0)/s)^2)
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double x0 = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  auto x = value._matrix.array();
-  auto scaledX = (x - x0) / s;
-  auto scaledX2 = scaledX.pow(2);
-  log_probs = (-log(M_PI * s)) - scaledX2.log1p();
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::cauchy(
+      value._matrix.data(),
+      value._matrix.size(),
+      x0,
+      s,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void Cauchy::gradient_log_prob_value(
@@ -215,15 +219,15 @@ void Cauchy::backward_value_iid(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  auto x = value._matrix.array();
   double x0 = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  // D[log(PDF[CauchyDistribution[x0, s], x]), x]
-  //             = -2(x - x0) / (s^2 + (x - x0)^2)
-  auto t1 = x - x0; // (x - x0)
-  auto d = s * s + t1 * t1; // (s^2 + (x - x0)^2)
-  auto grad = -2 * t1 / d; // -2(x - x0) / (s^2 + (x - x0)^2)
-  back_grad += grad;
+  iid::cauchy(
+      value._matrix.data(),
+      value._matrix.size(),
+      x0,
+      s,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Cauchy::backward_value_iid(
@@ -231,15 +235,15 @@ void Cauchy::backward_value_iid(
     graph::DoubleMatrix& back_grad,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  auto x = value._matrix.array();
   double x0 = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  // D[log(PDF[CauchyDistribution[x0, s], x]), x]
-  //             = -2(x - x0) / (s^2 + (x - x0)^2)
-  auto t1 = x - x0;
-  auto d = s * s + t1 * t1;
-  auto grad = -2 * t1 / d;
-  back_grad += adjunct.array() * grad;
+  iid::cauchy(
+      value._matrix.data(),
+      value._matrix.size(),
+      x0,
+      s,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Cauchy::backward_param(const graph::NodeValue& value, double adjunct)
@@ -275,28 +279,24 @@ void Cauchy::backward_param(const graph::NodeValue& value, double adjunct)
 
 void Cauchy::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  auto x = value._matrix.array();
-  auto x0_node = in_nodes[0];
-  double x0 = x0_node->value._double;
-  auto s_node = in_nodes[1];
-  double s = s_node->value._double;
-  auto t1 = x - x0; // x - x0
-  auto s2 = s * s; // s^2
-  auto t2 = t1 * t1; // (x - x0)^2
-  auto t3 = s2 + t2; // (s^2 + (x - x0)^2)
-  if (x0_node->needs_gradient()) {
-    // D[log(PDF[CauchyDistribution[x0, s], x]), x0]
-    //           = (2 (x - x0))/(s^2 + (x - x0)^2)
-    auto derivative1 = 2 * t1 / t3; // (2 (x - x0))/(s^2 + (x - x0)^2)
-    x0_node->back_grad1 += derivative1;
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
   }
-  if (s_node->needs_gradient()) {
-    // D[log(PDF[CauchyDistribution[x0, s], x]), s]
-    //           = (-s^2 + (x - x0)^2)/(s (s^2 + (x - x0)^2))
-    auto t4 = t2 - s2; // ((x - x0)^2 - s^2)
-    auto derivative1 =
-        t4 / (s * t3); // ((x - x0)^2 - s^2)/(s (s^2 + (x - x0)^2))
-    s_node->back_grad1 += derivative1;
+  double x0 = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  double grads[2];
+  iid::cauchy(
+      value._matrix.data(),
+      value._matrix.size(),
+      x0,
+      s,
+      nullptr,
+      {.param_grads = grads});
+  if (in_nodes[0]->needs_gradient()) {
+    in_nodes[0]->back_grad1 += grads[0];
+  }
+  if (in_nodes[1]->needs_gradient()) {
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -304,27 +304,24 @@ void Cauchy::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  auto x = value._matrix.array();
-  auto x0_node = in_nodes[0];
-  double x0 = x0_node->value._double;
-  auto s_node = in_nodes[1];
-  double s = s_node->value._double;
-  // D[log(PDF), x0] = (2 (x - x0))/(s^2 + (x - x0)^2)
-  // D[log(PDF), s] = ((x - x0)^2 - s^2)/(s (s^2 + (x - x0)^2))
-  auto t1 = x - x0; // x - x0
-  auto s2 = s * s; // s^2
-  auto t2 = t1 * t1; // (x - x0)^2
-  auto t3 = s2 + t2; // (s^2 + (x - x0)^2)
-  auto adjunct_array = adjunct.array();
-  if (x0_node->needs_gradient()) {
-    auto derivative1 = 2 * t1 / t3; // (2 (x - x0))/(s^2 + (x - x0)^2)
-    x0_node->back_grad1 += adjunct_array * derivative1;
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
   }
-  if (s_node->needs_gradient()) {
-    auto t4 = t2 - s2; // ((x - x0)^2 - s^2)
-    auto derivative1 =
-        t4 / (s * t3); // ((x - x0)^2 - s^2)/(s (s^2 + (x - x0)^2))
-    s_node->back_grad1 += adjunct_array * derivative1;
+  double x0 = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  double grads[2];
+  iid::cauchy(
+      value._matrix.data(),
+      value._matrix.size(),
+      x0,
+      s,
+      adjunct.data(),
+      {.param_grads = grads});
+  if (in_nodes[0]->needs_gradient()) {
+    in_nodes[0]->back_grad1 += grads[0];
+  }
+  if (in_nodes[1]->needs_gradient()) {
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -9,6 +9,7 @@
 #include <cmath>
 
 #include "beanmachine/graph/distribution/dirichlet.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -62,13 +63,15 @@ double Dirichlet::log_prob(const graph::NodeValue& value) const {
   assert(value.type.cols == 1);
   Eigen::MatrixXd param = in_nodes[0]->value._matrix;
 
+  Eigen::VectorXd lgamma_param(param.size());
+  special::lgamma(param.data(), param.size(), lgamma_param.data());
   double log_prob = 0.0;
   for (int i = 0; i < param.size(); i++) {
     double alpha = param(i);
-    log_prob -= lgamma(alpha);
+    log_prob -= lgamma_param(i);
     log_prob += std::log(value._matrix(i)) * (alpha - 1);
   }
-  log_prob += lgamma(param.sum());
+  log_prob += special::lgamma(param.sum());
 
   return log_prob;
 }
@@ -99,11 +102,12 @@ void Dirichlet::backward_param(const graph::NodeValue& value, double adjunct)
   assert(value.type.variable_type == graph::VariableType::COL_SIMPLEX_MATRIX);
   Eigen::MatrixXd x = value._matrix;
   Eigen::MatrixXd param = in_nodes[0]->value._matrix;
-  double digamma_sum = util::polygamma(0, param.sum());
   if (in_nodes[0]->needs_gradient()) {
+    Eigen::VectorXd digamma_param(param.size());
+    special::digamma(param.data(), param.size(), digamma_param.data());
+    double digamma_sum = special::digamma(param.sum());
     for (int i = 0; i < param.size(); i++) {
-      double jacob =
-          std::log(x(i)) + digamma_sum - util::polygamma(0, param(i));
+      double jacob = std::log(x(i)) + digamma_sum - digamma_param(i);
       in_nodes[0]->back_grad1(i) += adjunct * jacob;
     }
   }
@@ -7,12 +7,67 @@
 
 #pragma once
 #include <boost/iterator/transform_iterator.hpp>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include "beanmachine/graph/graph.h"
 
 namespace beanmachine {
 namespace distribution {
 
+/*
+A value computed from the scalar parameters of a distribution, such as its
+log normalizing constant, and kept until those parameters change.
+In single-site inference most calls to log_prob and to the gradients of a
+distribution happen while its parameters are fixed (only one of its samples
+changed, or a parameter of another distribution), so with many samples per
+distribution the lgamma, digamma and trigamma of the parameters would
+otherwise dominate the cost of these calls.
+The key of the cache is the parameter values themselves rather than a
+version number of the parent nodes: node values are assigned in place
+throughout the graph library, and a missed update of a version number
+would silently give stale densities, whereas the comparison is exact and
+costs one comparison per parameter.
+A cache may be used by several threads at once: a distribution shared by
+the children of nodes of the same color, such as a mixture component, is
+evaluated concurrently by the parallel Gibbs sweeps. Each entry is
+immutable and replaced as a whole by an atomic swap, so a thread either
+finds the entry of its parameters or computes the value itself.
+*/
+template <std::size_t N, class T = double>
+class ParameterCache {
+ public:
+  template <class Compute>
+  T get(const std::array<double, N>& params, Compute compute) {
+    std::shared_ptr<const Entry> entry = current.load();
+    if (entry != nullptr and entry->key == params) {
+      return entry->value;
+    }
+    T value = compute();
+    current.store(std::make_shared<const Entry>(Entry{params, value}));
+    return value;
+  }
+
+ private:
+  struct Entry {
+    std::array<double, N> key;
+    T value;
+  };
+  std::atomic<std::shared_ptr<const Entry>> current;
+};
+
+/*
+The sums over the elements of an observed IID value through which the log
+prob of an exponential-family distribution, and its gradients w.r.t. the
+parameters, depend on that value. Which sums these are is up to each
+distribution; see Distribution::sufficient_statistics.
+*/
+struct SufficientStatistics {
+  double size = 0; // the number of elements
+  std::array<double, 3> sums = {};
+};
+
 class Distribution : public graph::Node {
  public:
   static std::unique_ptr<Distribution> new_distribution(
@@ -163,9 +218,43 @@ class Distribution : public graph::Node {
   virtual void backward_param_iid(
       const graph::NodeValue& /* value */,
       Eigen::MatrixXd& /* adjunct */) const {}
+
+  /*
+  Observed values do not change during inference, and for exponential-family
+  distributions the log prob of an IID value and its gradients w.r.t. the
+  parameters depend on that value only through a few sums over its elements.
+  An IId_Sample computes these once when it is observed, and then uses
+  log_prob_sufficient and backward_param_sufficient in place of log_prob and
+  backward_param_iid, at O(1) rather than O(n) cost per evaluation.
+  Returns false if this distribution does not support sufficient statistics.
+  */
+  virtual bool sufficient_statistics(
+      const graph::NodeValue& /* value */,
+      SufficientStatistics& /* stats */) const {
+    return false;
+  }
+  virtual double log_prob_sufficient(
+      const SufficientStatistics& /* stats */) const {
+    throw std::runtime_error(
+        "log_prob_sufficient has not been implemented for this distribution.");
+  }
+  virtual void backward_param_sufficient(
+      const SufficientStatistics& /* stats */) const {
+    throw std::runtime_error(
+        "backward_param_sufficient has not been implemented for this distribution.");
+  }
+
   graph::DistributionType dist_type;
   graph::ValueType sample_type;
 
+  // The number of values in the support of this distribution given the
+  // current values of its parents, if that support is a finite set that can
+  // be enumerated: {false, true} for boolean samples, {0, ..., n - 1} for
+  // natural samples. Returns 0 if the support is not finite.
+  virtual graph::natural_t finite_support_size() const {
+    return sample_type == graph::AtomicType::BOOLEAN ? 2 : 0;
+  }
+
   virtual double _double_sampler(std::mt19937& /* gen */) const {
     throw std::runtime_error(
         "_double_sampler has not been implemented for this distribution.");
@@ -12,7 +12,8 @@
 #include <string>
 
 #include "beanmachine/graph/distribution/gamma.h"
-#include "beanmachine/graph/util.h"
+#include "beanmachine/graph/distribution/iid_kernels.h"
+#include "beanmachine/graph/special_functions.h"
 
 namespace beanmachine {
 namespace distribution {
@@ -58,11 +59,33 @@ double Gamma::_double_sampler(std::mt19937& gen) const {
 // computes g'(x). [g is the current function f is the final target]
 // - In forward propagation, g'(x) is given by in_nodes[x]->grad1,
 // the above equation computes f'(g) [f is the current function g is the input]
+double Gamma::log_normalizer() const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return log_normalizer_cache.get({param_a, param_b}, [&]() {
+    return param_a * std::log(param_b) - special::lgamma(param_a);
+  });
+}
+
+double Gamma::log_b_m_digamma_a() const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return log_b_m_digamma_a_cache.get({param_a, param_b}, [&]() {
+    return std::log(param_b) - special::digamma(param_a);
+  });
+}
+
+double Gamma::trigamma_a() const {
+  double param_a = in_nodes[0]->value._double;
+  return trigamma_a_cache.get(
+      {param_a}, [&]() { return special::trigamma(param_a); });
+}
+
 double Gamma::log_prob(const graph::NodeValue& value) const {
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
 
-  double result = param_a * std::log(param_b) - lgamma(param_a);
+  double result = log_normalizer();
   if (value.type.variable_type == graph::VariableType::SCALAR) {
     result +=
         (param_a - 1.0) * std::log(value._double) - param_b * value._double;
@@ -84,9 +107,14 @@ void Gamma::log_prob_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double result = param_a * std::log(param_b) - lgamma(param_a);
-  log_probs = result + (param_a - 1.0) * value._matrix.array().log() -
-      param_b * value._matrix.array();
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::gamma(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void Gamma::_grad1_log_prob_value(
@@ -113,10 +141,9 @@ void Gamma::gradient_log_prob_param(
     double& grad2) const {
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double digamma_a = util::polygamma(0, param_a); // digamma(a)
-  double poly1_a = util::polygamma(1, param_a); // polygamma(1, a)
+  double poly1_a = trigamma_a(); // polygamma(1, a)
   // 1st order derivatives
-  double grad_a = std::log(param_b) - digamma_a + std::log(value._double);
+  double grad_a = log_b_m_digamma_a() + std::log(value._double);
   double grad_b = param_a / param_b - value._double;
   // 2nd order derivatives
   double grad2_a2 = -poly1_a;
@@ -146,7 +173,13 @@ void Gamma::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  back_grad += ((param_a - 1.0) / value._matrix.array() - param_b).matrix();
+  iid::gamma(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Gamma::backward_value_iid(
@@ -156,9 +189,13 @@ void Gamma::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  back_grad +=
-      (adjunct.array() * ((param_a - 1.0) / value._matrix.array() - param_b))
-          .matrix();
+  iid::gamma(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Gamma::backward_param(const graph::NodeValue& value, double adjunct)
@@ -167,8 +204,7 @@ void Gamma::backward_param(const graph::NodeValue& value, double adjunct)
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
   if (in_nodes[0]->needs_gradient()) {
-    double digamma_a = util::polygamma(0, param_a); // digamma(a)
-    double jacob = std::log(param_b) - digamma_a + std::log(value._double);
+    double jacob = log_b_m_digamma_a() + std::log(value._double);
     in_nodes[0]->back_grad1 += adjunct * jacob;
   }
   if (in_nodes[1]->needs_gradient()) {
@@ -179,17 +215,24 @@ void Gamma::backward_param(const graph::NodeValue& value, double adjunct)
 
 void Gamma::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  int size = static_cast<int>(value._matrix.size());
+  double grads[2];
+  iid::gamma(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    double digamma_a = util::polygamma(0, param_a); // digamma(a)
-    in_nodes[0]->back_grad1 += size * (std::log(param_b) - digamma_a) +
-        value._matrix.array().log().sum();
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 +=
-        size * (param_a / param_b) - value._matrix.array().sum();
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -197,20 +240,52 @@ void Gamma::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double param_a = in_nodes[0]->value._double;
   double param_b = in_nodes[1]->value._double;
-  double adjunct_sum = 1.0;
-  if (in_nodes[0]->needs_gradient() or in_nodes[1]->needs_gradient()) {
-    adjunct_sum = adjunct.sum();
+  double grads[2];
+  iid::gamma(
+      value._matrix.data(),
+      value._matrix.size(),
+      param_a,
+      param_b,
+      adjunct.data(),
+      {.param_grads = grads});
+  if (in_nodes[0]->needs_gradient()) {
+    in_nodes[0]->back_grad1 += grads[0];
+  }
+  if (in_nodes[1]->needs_gradient()) {
+    in_nodes[1]->back_grad1 += grads[1];
   }
+}
+
+// The sufficient statistics are the sums of x and of log(x).
+bool Gamma::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  stats.size = static_cast<double>(value._matrix.size());
+  stats.sums = {value._matrix.sum(), value._matrix.array().log().sum(), 0};
+  return true;
+}
+
+double Gamma::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double param_a = in_nodes[0]->value._double;
+  double param_b = in_nodes[1]->value._double;
+  return stats.size * log_normalizer() + (param_a - 1.0) * stats.sums[1] -
+      param_b * stats.sums[0];
+}
+
+void Gamma::backward_param_sufficient(const SufficientStatistics& stats) const {
   if (in_nodes[0]->needs_gradient()) {
-    double digamma_a = util::polygamma(0, param_a); // digamma(a)
-    in_nodes[0]->back_grad1 += adjunct_sum * (std::log(param_b) - digamma_a) +
-        (value._matrix.array().log() * adjunct.array()).sum();
+    in_nodes[0]->back_grad1 += stats.size * log_b_m_digamma_a() + stats.sums[1];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 += adjunct_sum * (param_a / param_b) -
-        (value._matrix.array() * adjunct.array()).sum();
+    double param_a = in_nodes[0]->value._double;
+    double param_b = in_nodes[1]->value._double;
+    in_nodes[1]->back_grad1 += stats.size * param_a / param_b - stats.sums[0];
   }
 }
 
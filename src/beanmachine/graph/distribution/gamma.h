@@ -52,11 +52,31 @@ class Gamma : public Distribution {
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
 
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
+
   static void _grad1_log_prob_value(
       double& grad1,
       double x,
       double param_a,
       double param_b);
+
+ private:
+  // The terms of the log prob and its gradients that depend only on the
+  // parameters a and b (see ParameterCache).
+  double log_normalizer() const;
+  double log_b_m_digamma_a() const;
+  double trigamma_a() const;
+  // a log(b) - lgamma(a)
+  mutable ParameterCache<2> log_normalizer_cache;
+  // log(b) - digamma(a)
+  mutable ParameterCache<2> log_b_m_digamma_a_cache;
+  // trigamma(a)
+  mutable ParameterCache<1> trigamma_a_cache;
 };
 
 } // namespace distribution
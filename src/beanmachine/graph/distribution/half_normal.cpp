@@ -12,6 +12,7 @@
 #include <string>
 
 #include "beanmachine/graph/distribution/half_normal.h"
+#include "beanmachine/graph/distribution/iid_kernels.h"
 
 namespace beanmachine {
 namespace distribution {
@@ -97,9 +98,13 @@ void Half_Normal::log_prob_iid(
     Eigen::MatrixXd& log_probs) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double s = in_nodes[0]->value._double;
-  /// TODO[Walid]: Need to figure out how to do constants and conditionals here
-  log_probs = (-std::log(s) - 0.5 * std::log(M_PI / 2)) -
-      0.5 * (value._matrix.array()).pow(2) / (s * s);
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::half_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      s,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 /// TODO[Walid]: This function can be inlined (it has only two uses)
@@ -157,8 +162,12 @@ void Half_Normal::backward_value_iid(
     graph::DoubleMatrix& back_grad) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double s = in_nodes[0]->value._double;
-  double s_sq = s * s;
-  back_grad -= (value._matrix.array() / s_sq);
+  iid::half_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      s,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Half_Normal::backward_value_iid(
@@ -167,8 +176,12 @@ void Half_Normal::backward_value_iid(
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double s = in_nodes[0]->value._double;
-  double s_sq = s * s;
-  back_grad -= (adjunct.array() * value._matrix.array() / s_sq);
+  iid::half_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      s,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Half_Normal::backward_param(const graph::NodeValue& value, double adjunct)
@@ -189,17 +202,19 @@ void Half_Normal::backward_param(const graph::NodeValue& value, double adjunct)
 
 void Half_Normal::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient()) {
+    return;
+  }
   double s = in_nodes[0]->value._double;
-  double s_sq = s * s;
-
-  int size = static_cast<int>(value._matrix.size());
-  /// The following should be deleted
-  ///  if (in_nodes[0]->needs_gradient()) {
-  ///    in_nodes[0]->back_grad1 += sum_x / s_sq - size * m / s_sq;
-  ///  }
+  double grads[1];
+  iid::half_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      s,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    double sum_xsq = value._matrix.squaredNorm();
-    in_nodes[0]->back_grad1 += (-size / s + sum_xsq / (s * s_sq));
+    in_nodes[0]->back_grad1 += grads[0];
   }
 }
 
@@ -207,17 +222,19 @@ void Half_Normal::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient()) {
+    return;
+  }
   double s = in_nodes[0]->value._double;
-  double s_sq = s * s;
-
-  double sum_adjunct = adjunct.sum();
-  /// The following should be deleted
-  /// if (in_nodes[0]->needs_gradient()) {
-  ///  in_nodes[0]->back_grad1 += sum_x / s_sq - sum_adjunct * m / s_sq;
-  /// }
+  double grads[1];
+  iid::half_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      s,
+      adjunct.data(),
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    double sum_xsq = (value._matrix.array().pow(2) * adjunct.array()).sum();
-    in_nodes[0]->back_grad1 += (-sum_adjunct / s + sum_xsq / (s * s_sq));
+    in_nodes[0]->back_grad1 += grads[0];
   }
 }
 
@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include "beanmachine/graph/distribution/iid_kernels.h"
+#include "beanmachine/graph/special_functions.h"
+
+// The kernels are plain loops written so that the compiler can vectorize
+// them: every element goes through the same branch-free arithmetic, and sums
+// are accumulated in kLanes independent lanes (so that vectorizing them
+// needs no reassociation, and the results do not depend on the instruction
+// set). Where supported, each kernel is compiled for AVX-512, AVX2 and the
+// baseline instruction set, and the loader picks the best one for the CPU.
+
+namespace beanmachine {
+namespace distribution {
+namespace iid {
+
+namespace {
+
+const std::size_t kLanes = 8;
+
+// log(k!) for k < kFactorialTableSize
+const int kFactorialTableSize = 16;
+struct LogFactorials {
+  double values[kFactorialTableSize];
+  LogFactorials() {
+    values[0] = 0.0;
+    for (int k = 1; k < kFactorialTableSize; k++) {
+      values[k] = values[k - 1] + std::log(static_cast<double>(k));
+    }
+  }
+};
+const LogFactorials log_factorials;
+
+// log(k!): from a table for small k, where it is exact, and as lgamma(k + 1)
+// for the others
+BM_ALWAYS_INLINE double vlog_factorial(double k) {
+  double from_lgamma = special::lgamma(k + 1.0);
+  int index = static_cast<int>(k < kFactorialTableSize ? k : 0);
+  double from_table = log_factorials.values[index];
+  return k < kFactorialTableSize ? from_table : from_lgamma;
+}
+
+// A kernel describes, for one value x, its log_prob lp, the gradient dx of
+// lp w.r.t. x, and num_stats statistics whose (weighted) sums over the
+// values determine the gradients w.r.t. the parameters (see param_grads).
+
+struct NormalKernel {
+  using Value = double;
+  static const int num_stats = 2;
+  double m, s, inv_s_sq, c;
+  NormalKernel(double m, double s)
+      : m(m),
+        s(s),
+        inv_s_sq(1 / (s * s)),
+        c(-std::log(s) - 0.5 * std::log(2 * M_PI)) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    double z = x - m;
+    double z_sq = z * z;
+    lp = c - 0.5 * z_sq * inv_s_sq;
+    dx = -z * inv_s_sq;
+    stats[0] = z;
+    stats[1] = z_sq;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = sums[0] * inv_s_sq;
+    grads[1] = -weight / s + sums[1] * inv_s_sq / s;
+  }
+};
+
+struct HalfNormalKernel {
+  using Value = double;
+  static const int num_stats = 1;
+  double s, inv_s_sq, c;
+  explicit HalfNormalKernel(double s)
+      : s(s),
+        inv_s_sq(1 / (s * s)),
+        c(-std::log(s) - 0.5 * std::log(M_PI / 2)) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    double x_sq = x * x;
+    lp = c - 0.5 * x_sq * inv_s_sq;
+    dx = -x * inv_s_sq;
+    stats[0] = x_sq;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = -weight / s + sums[0] * inv_s_sq / s;
+  }
+};
+
+struct LogNormalKernel {
+  using Value = double;
+  static const int num_stats = 2;
+  NormalKernel normal;
+  LogNormalKernel(double m, double s) : normal(m, s) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    double log_x = special::log(x);
+    double z = log_x - normal.m;
+    double z_sq = z * z;
+    lp = normal.c - 0.5 * z_sq * normal.inv_s_sq - log_x;
+    dx = -(z * normal.inv_s_sq + 1) / x;
+    stats[0] = z;
+    stats[1] = z_sq;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    normal.param_grads(sums, weight, grads);
+  }
+};
+
+struct GammaKernel {
+  using Value = double;
+  static const int num_stats = 2;
+  double a, b, c;
+  GammaKernel(double a, double b)
+      : a(a), b(b), c(a * std::log(b) - special::lgamma(a)) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    double log_x = special::log(x);
+    lp = c + (a - 1) * log_x - b * x;
+    dx = (a - 1) / x - b;
+    stats[0] = log_x;
+    stats[1] = x;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = weight * (std::log(b) - special::digamma(a)) + sums[0];
+    grads[1] = weight * (a / b) - sums[1];
+  }
+};
+
+struct BetaKernel {
+  using Value = double;
+  static const int num_stats = 2;
+  double a, b, c;
+  BetaKernel(double a, double b)
+      : a(a),
+        b(b),
+        c(special::lgamma(a + b) - special::lgamma(a) -
+          special::lgamma(b)) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    double log_x = special::log(x);
+    double log_1mx = special::log(1 - x);
+    lp = c + (a - 1) * log_x + (b - 1) * log_1mx;
+    dx = (a - 1) / x - (b - 1) / (1 - x);
+    stats[0] = log_x;
+    stats[1] = log_1mx;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    double digamma_a_p_b = special::digamma(a + b);
+    grads[0] = sums[0] + weight * (digamma_a_p_b - special::digamma(a));
+    grads[1] = sums[1] + weight * (digamma_a_p_b - special::digamma(b));
+  }
+};
+
+struct StudentTKernel {
+  using Value = double;
+  static const int num_stats = 3;
+  double n, l, s, n_s_sq, c;
+  StudentTKernel(double n, double l, double s)
+      : n(n),
+        l(l),
+        s(s),
+        n_s_sq(n * s * s),
+        c(special::lgamma((n + 1) / 2) - special::lgamma(n / 2) -
+          0.5 * std::log(n) - 0.5 * std::log(M_PI) - std::log(s) +
+          ((n + 1) / 2) * (std::log(n) + 2 * std::log(s))) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    // q = n s^2 + (x - l)^2
+    double z = x - l;
+    double q = n_s_sq + z * z;
+    double log_q = special::log(q);
+    double inv_q = 1 / q;
+    lp = c - ((n + 1) / 2) * log_q;
+    dx = -(n + 1) * z * inv_q;
+    stats[0] = log_q;
+    stats[1] = inv_q;
+    stats[2] = z * inv_q;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = weight *
+            (0.5 * special::digamma((n + 1) / 2) -
+             0.5 * special::digamma(n / 2) - 0.5 / n + 0.5 * std::log(n) +
+             std::log(s) + 0.5 * (n + 1) / n) -
+        (0.5 * sums[0] + 0.5 * (n + 1) * s * s * sums[1]);
+    grads[1] = (n + 1) * sums[2];
+    grads[2] = weight * n / s - (n + 1) * n * s * sums[1];
+  }
+};
+
+struct CauchyKernel {
+  using Value = double;
+  static const int num_stats = 2;
+  double x0, s, s_sq, inv_s, c;
+  CauchyKernel(double x0, double s)
+      : x0(x0), s(s), s_sq(s * s), inv_s(1 / s), c(-std::log(M_PI * s)) {}
+  BM_ALWAYS_INLINE void
+  element(double x, double& lp, double& dx, double* stats) const {
+    // log(PDF) = -log(pi * s) - log(1 + ((x - x0)/s)^2)
+    double t = x - x0;
+    double u = t * inv_s;
+    double t_sq = t * t;
+    double inv_q = 1 / (s_sq + t_sq);
+    lp = c - special::log1p(u * u);
+    dx = -2 * t * inv_q;
+    stats[0] = t * inv_q;
+    stats[1] = (t_sq - s_sq) * inv_q;
+  }
+  void param_grads(const double* sums, double /* weight */, double* grads)
+      const {
+    grads[0] = 2 * sums[0];
+    grads[1] = sums[1] / s;
+  }
+};
+
+struct PoissonKernel {
+  using Value = graph::natural_t;
+  static const int num_stats = 1;
+  double lambda, log_lambda;
+  explicit PoissonKernel(double lambda)
+      : lambda(lambda), log_lambda(std::log(lambda)) {}
+  BM_ALWAYS_INLINE void element(
+      graph::natural_t k,
+      double& lp,
+      double& dx,
+      double* stats) const {
+    double k_double = static_cast<double>(k);
+    lp = k_double * log_lambda - lambda - vlog_factorial(k_double);
+    dx = 0;
+    stats[0] = k_double;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = sums[0] / lambda - weight;
+  }
+};
+
+struct BernoulliLogitKernel {
+  using Value = bool;
+  static const int num_stats = 1;
+  double l, pos_val, neg_val;
+  explicit BernoulliLogitKernel(double l)
+      : l(l),
+        pos_val(-special::log1pexp(-l)),
+        neg_val(-special::log1pexp(l)) {}
+  BM_ALWAYS_INLINE void element(bool x, double& lp, double& dx, double* stats)
+      const {
+    lp = x ? pos_val : neg_val;
+    dx = 0;
+    stats[0] = x ? 1.0 : 0.0;
+  }
+  void param_grads(const double* sums, double weight, double* grads) const {
+    grads[0] = 1 / (1 + std::exp(l)) * sums[0] -
+        1 / (1 + std::exp(-l)) * (weight - sums[0]);
+  }
+};
+
+template <bool LP, bool VG, bool PG, bool ADJ, class Kernel>
+BM_ALWAYS_INLINE void visit(
+    const Kernel& kernel,
+    const typename Kernel::Value* BM_RESTRICT x,
+    const double* BM_RESTRICT adjunct,
+    double* BM_RESTRICT log_probs,
+    double* BM_RESTRICT value_grads,
+    double (&lane_sums)[Kernel::num_stats][kLanes],
+    double (&lane_weights)[kLanes],
+    std::size_t i,
+    std::size_t lane) {
+  double lp, dx;
+  double stats[Kernel::num_stats];
+  kernel.element(x[i], lp, dx, stats);
+  if constexpr (LP) {
+    log_probs[i] = lp;
+  }
+  if constexpr (VG) {
+    value_grads[i] += ADJ ? adjunct[i] * dx : dx;
+  }
+  if constexpr (PG) {
+    for (int j = 0; j < Kernel::num_stats; j++) {
+      lane_sums[j][lane] += ADJ ? adjunct[i] * stats[j] : stats[j];
+    }
+    if constexpr (ADJ) {
+      lane_weights[lane] += adjunct[i];
+    }
+  }
+}
+
+template <bool LP, bool VG, bool PG, bool ADJ, class Kernel>
+BM_ALWAYS_INLINE void run_pass(
+    const Kernel& kernel,
+    const typename Kernel::Value* BM_RESTRICT x,
+    std::size_t n,
+    const double* BM_RESTRICT adjunct,
+    double* BM_RESTRICT log_probs,
+    double* BM_RESTRICT value_grads,
+    double* sums,
+    double& weight) {
+  double lane_sums[Kernel::num_stats][kLanes] = {};
+  double lane_weights[kLanes] = {};
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    BM_SIMD_LOOP
+    for (std::size_t lane = 0; lane < kLanes; lane++) {
+      visit<LP, VG, PG, ADJ>(
+          kernel,
+          x,
+          adjunct,
+          log_probs,
+          value_grads,
+          lane_sums,
+          lane_weights,
+          i + lane,
+          lane);
+    }
+  }
+  for (std::size_t lane = 0; i < n; i++, lane++) {
+    visit<LP, VG, PG, ADJ>(
+        kernel,
+        x,
+        adjunct,
+        log_probs,
+        value_grads,
+        lane_sums,
+        lane_weights,
+        i,
+        lane);
+  }
+  for (int j = 0; j < Kernel::num_stats; j++) {
+    sums[j] = 0;
+    for (std::size_t lane = 0; lane < kLanes; lane++) {
+      sums[j] += lane_sums[j][lane];
+    }
+  }
+  weight = 0;
+  for (std::size_t lane = 0; lane < kLanes; lane++) {
+    weight += lane_weights[lane];
+  }
+  if constexpr (not ADJ) {
+    weight = static_cast<double>(n);
+  }
+}
+
+template <bool LP, bool VG, bool PG, class Kernel>
+BM_ALWAYS_INLINE void run_pass(
+    const Kernel& kernel,
+    const typename Kernel::Value* x,
+    std::size_t n,
+    const double* adjunct,
+    const Outputs& out,
+    double* sums,
+    double& weight) {
+  if (adjunct == nullptr) {
+    run_pass<LP, VG, PG, false>(
+        kernel, x, n, adjunct, out.log_probs, out.value_grads, sums, weight);
+  } else {
+    run_pass<LP, VG, PG, true>(
+        kernel, x, n, adjunct, out.log_probs, out.value_grads, sums, weight);
+  }
+}
+
+template <class Kernel>
+BM_ALWAYS_INLINE void run(
+    const Kernel& kernel,
+    const typename Kernel::Value* x,
+    std::size_t n,
+    const double* adjunct,
+    const Outputs& out) {
+  double sums[Kernel::num_stats];
+  double weight;
+  int flags = (out.log_probs != nullptr ? 4 : 0) |
+      (out.value_grads != nullptr ? 2 : 0) |
+      (out.param_grads != nullptr ? 1 : 0);
+  switch (flags) {
+    case 1:
+      run_pass<false, false, true>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 2:
+      run_pass<false, true, false>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 3:
+      run_pass<false, true, true>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 4:
+      run_pass<true, false, false>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 5:
+      run_pass<true, false, true>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 6:
+      run_pass<true, true, false>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    case 7:
+      run_pass<true, true, true>(kernel, x, n, adjunct, out, sums, weight);
+      break;
+    default:
+      return;
+  }
+  if (out.param_grads != nullptr) {
+    kernel.param_grads(sums, weight, out.param_grads);
+  }
+}
+
+} // namespace
+
+BM_SIMD_CLONES void normal(
+    const double* x,
+    std::size_t n,
+    double m,
+    double s,
+    const double* adjunct,
+    const Outputs& out) {
+  run(NormalKernel(m, s), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void half_normal(
+    const double* x,
+    std::size_t n,
+    double s,
+    const double* adjunct,
+    const Outputs& out) {
+  run(HalfNormalKernel(s), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void log_normal(
+    const double* x,
+    std::size_t n,
+    double m,
+    double s,
+    const double* adjunct,
+    const Outputs& out) {
+  run(LogNormalKernel(m, s), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void gamma(
+    const double* x,
+    std::size_t n,
+    double a,
+    double b,
+    const double* adjunct,
+    const Outputs& out) {
+  run(GammaKernel(a, b), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void beta(
+    const double* x,
+    std::size_t n,
+    double a,
+    double b,
+    const double* adjunct,
+    const Outputs& out) {
+  run(BetaKernel(a, b), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void student_t(
+    const double* x,
+    std::size_t n,
+    double dof,
+    double l,
+    double s,
+    const double* adjunct,
+    const Outputs& out) {
+  run(StudentTKernel(dof, l, s), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void cauchy(
+    const double* x,
+    std::size_t n,
+    double x0,
+    double s,
+    const double* adjunct,
+    const Outputs& out) {
+  run(CauchyKernel(x0, s), x, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void poisson(
+    const graph::natural_t* k,
+    std::size_t n,
+    double lambda,
+    const double* adjunct,
+    const Outputs& out) {
+  run(PoissonKernel(lambda), k, n, adjunct, out);
+}
+
+BM_SIMD_CLONES void bernoulli_logit(
+    const bool* x,
+    std::size_t n,
+    double l,
+    const double* adjunct,
+    const Outputs& out) {
+  run(BernoulliLogitKernel(l), x, n, adjunct, out);
+}
+
+} // namespace iid
+} // namespace distribution
+} // namespace beanmachine
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <cstddef>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace distribution {
+namespace iid {
+
+/*
+Fused kernels over the values of an IID sample.
+
+Each kernel makes a single pass over the n values x[0..n) of a sample from
+the distribution with the given parameters and computes any subset of:
+- the log_prob of each value (assigned to log_probs[i]),
+- the gradient of the log_prob w.r.t. each value, weighted by the
+  adjunct (added to value_grads[i]),
+- the gradient of the sum of the log_probs, weighted by the adjunct, w.r.t.
+  each parameter of the distribution (assigned to param_grads[j]).
+Outputs that are null are not computed, and a null adjunct stands for an
+adjunct of one for every value. The kernels are compiled for several
+instruction sets (AVX-512, AVX2 and the baseline) and the best one
+supported by the CPU is picked at load time where the platform allows it.
+*/
+struct Outputs {
+  double* log_probs = nullptr;
+  double* value_grads = nullptr;
+  double* param_grads = nullptr;
+};
+
+// params: mean, standard deviation
+void normal(
+    const double* x,
+    std::size_t n,
+    double m,
+    double s,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: standard deviation
+void half_normal(
+    const double* x,
+    std::size_t n,
+    double s,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: mean and standard deviation of the log of the value
+void log_normal(
+    const double* x,
+    std::size_t n,
+    double m,
+    double s,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: shape, rate
+void gamma(
+    const double* x,
+    std::size_t n,
+    double a,
+    double b,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: the two shapes
+void beta(
+    const double* x,
+    std::size_t n,
+    double a,
+    double b,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: degrees of freedom, location, scale
+void student_t(
+    const double* x,
+    std::size_t n,
+    double dof,
+    double l,
+    double s,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: location, scale
+void cauchy(
+    const double* x,
+    std::size_t n,
+    double x0,
+    double s,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: rate; the values are discrete so value_grads must be null
+void poisson(
+    const graph::natural_t* k,
+    std::size_t n,
+    double lambda,
+    const double* adjunct,
+    const Outputs& out);
+
+// params: logit of the probability of true; value_grads must be null
+void bernoulli_logit(
+    const bool* x,
+    std::size_t n,
+    double l,
+    const double* adjunct,
+    const Outputs& out);
+
+} // namespace iid
+} // namespace distribution
+} // namespace beanmachine
@@ -9,6 +9,7 @@
 #include <cmath>
 
 #include "beanmachine/graph/distribution/lkj_cholesky.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -132,12 +133,12 @@ double LKJCholesky::log_prob(const graph::NodeValue& value) const {
   // log(denominator) = lgamma(alpha) * (d - 1)
   double log_pi = log(M_PI);
   double alpha = eta + 0.5 * dm1;
-  double log_denom = lgamma(alpha) * dm1;
+  double log_denom = special::lgamma(alpha) * dm1;
 
   // log(numerator) = multivariate_lgamma(alpha - 0.5, d-1)
   double log_numerator = log_pi * dm1 * (dm1 - 1.0) / 4.0;
   for (uint i = 1; i < d; i++) {
-    log_numerator += lgamma(alpha - 0.5 - (i - 1.0) / 2.0);
+    log_numerator += special::lgamma(alpha - 0.5 - (i - 1.0) / 2.0);
   }
 
   double pi_constant = 0.5 * dm1 * log_pi;
@@ -172,13 +173,13 @@ void LKJCholesky::gradient_log_prob_param(
   grad1 += 2 * diag_elems.log().sum();
 
   // from normalization factor denominator
-  grad1 += dm1 * util::polygamma(0, alpha);
-  grad2 += dm1 * util::polygamma(1, alpha);
+  grad1 += dm1 * special::digamma(alpha);
+  grad2 += dm1 * special::trigamma(alpha);
 
   // from normalization factor numerator
   for (uint i = 1; i < d; i++) {
-    grad1 -= util::polygamma(0, alpha - i / 2.0);
-    grad2 -= util::polygamma(1, alpha - i / 2.0);
+    grad1 -= special::digamma(alpha - i / 2.0);
+    grad2 -= special::trigamma(alpha - i / 2.0);
   }
 }
 
@@ -208,11 +209,11 @@ void LKJCholesky::backward_param(const graph::NodeValue& value, double adjunct)
     in_nodes[0]->back_grad1 += 2 * adjunct * diag_elems.log().sum();
 
     // from normalization factor denominator
-    in_nodes[0]->back_grad1 += dm1 * adjunct * util::polygamma(0, alpha);
+    in_nodes[0]->back_grad1 += dm1 * adjunct * special::digamma(alpha);
 
     // from normalization factor numerator
     for (uint i = 1; i < d; i++) {
-      in_nodes[0]->back_grad1 -= adjunct * util::polygamma(0, alpha - i / 2.0);
+      in_nodes[0]->back_grad1 -= adjunct * special::digamma(alpha - i / 2.0);
     }
   }
 };
@@ -11,6 +11,7 @@
 #include <Eigen/Core>
 #include <random>
 
+#include "beanmachine/graph/distribution/iid_kernels.h"
 #include "beanmachine/graph/distribution/log_normal.h"
 
 namespace beanmachine {
@@ -91,10 +92,14 @@ void LogNormal::log_prob_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic> logs =
-      value._matrix.array().log();
-  log_probs = (-std::log(s) - 0.5 * std::log(2 * M_PI)) -
-      0.5 * (logs - m).pow(2) / (s * s) - logs;
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::log_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void LogNormal::_grad1_log_prob_value(
@@ -172,9 +177,13 @@ void LogNormal::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-  back_grad +=
-      (m - value._matrix.array().log() - s_sq) / (value._matrix.array() * s_sq);
+  iid::log_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void LogNormal::backward_value_iid(
@@ -184,9 +193,13 @@ void LogNormal::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-  back_grad += (adjunct.array()) * (m - value._matrix.array().log() - s_sq) /
-      (value._matrix.array() * s_sq);
+  iid::log_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void LogNormal::backward_param(const graph::NodeValue& value, double adjunct)
@@ -208,20 +221,24 @@ void LogNormal::backward_param(const graph::NodeValue& value, double adjunct)
 
 void LogNormal::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-
-  int size = static_cast<int>(value._matrix.size());
-  double sum_logx = value._matrix.array().log().sum();
+  double grads[2];
+  iid::log_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += sum_logx / s_sq - size * m / s_sq;
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    double sum_logx_sq = value._matrix.array().log().matrix().squaredNorm();
-    in_nodes[1]->back_grad1 +=
-        (-size / s +
-         (sum_logx_sq - 2 * m * sum_logx + m * m * size) / (s * s_sq));
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -229,21 +246,24 @@ void LogNormal::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-
-  double sum_logx = (value._matrix.array().log() * adjunct.array()).sum();
-  double sum_adjunct = adjunct.sum();
+  double grads[2];
+  iid::log_normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      adjunct.data(),
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += sum_logx / s_sq - sum_adjunct * m / s_sq;
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    double sum_logx_sq =
-        (value._matrix.array().log().pow(2) * adjunct.array()).sum();
-    in_nodes[1]->back_grad1 +=
-        (-sum_adjunct / s +
-         (sum_logx_sq - 2 * m * sum_logx + m * m * sum_adjunct) / (s * s_sq));
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
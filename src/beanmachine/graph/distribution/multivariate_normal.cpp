@@ -10,9 +10,42 @@
 
 #include <beanmachine/graph/distribution/multivariate_normal.h>
 #include <beanmachine/graph/graph.h>
+#include <beanmachine/graph/operator/operator.h>
 
 namespace beanmachine {
 namespace distribution {
+
+namespace {
+
+// The LKJ Cholesky sample L if the covariance is the operator L * L^T, else
+// nullptr.
+graph::Node* lkj_cholesky_factor(graph::Node* sigma) {
+  using graph::OperatorType;
+  auto op_type = [](graph::Node* node) {
+    return static_cast<oper::Operator*>(node)->op_type;
+  };
+  if (sigma->node_type != graph::NodeType::OPERATOR or
+      op_type(sigma) != OperatorType::MATRIX_MULTIPLY) {
+    return nullptr;
+  }
+  graph::Node* left = sigma->in_nodes[0];
+  graph::Node* right = sigma->in_nodes[1];
+  if (left->node_type != graph::NodeType::OPERATOR or
+      op_type(left) != OperatorType::SAMPLE or
+      static_cast<Distribution*>(left->in_nodes[0])->dist_type !=
+          graph::DistributionType::LKJ_CHOLESKY) {
+    return nullptr;
+  }
+  if (right->node_type != graph::NodeType::OPERATOR or
+      op_type(right) != OperatorType::TRANSPOSE or
+      right->in_nodes[0] != left) {
+    return nullptr;
+  }
+  return left;
+}
+
+} // namespace
+
 MultivariateNormal::MultivariateNormal(
     graph::ValueType sample_type,
     const std::vector<graph::Node*>& in_nodes)
@@ -54,34 +87,82 @@ MultivariateNormal::MultivariateNormal(
     throw std::invalid_argument(
         "Multivariate Normal's sample type should match the shape of the first parent");
   }
+  lkj_factor = lkj_cholesky_factor(in_nodes[1]);
   // We also require that the covariance matrix be positive definite. We check
   // this using Cholesky decomposition and store the lower triangular matrix for
   // use in sampling later.
   if (in_nodes[1]->node_type == graph::NodeType::CONSTANT) {
-    // LLT is the Eigen operation for Cholesky decomposition. We store this
-    // value for constant covariance to avoid recomputation.
-
-    _llt = in_nodes[1]->value._matrix.llt();
-    if (_llt.info() == Eigen::NumericalIssue) {
-      throw std::invalid_argument(
-          "Multivariate Normal's covariance matrix must be positive definite");
-    }
+    _factorization = decompose(in_nodes[1]->value._matrix);
   }
 }
 
-Eigen::LLT<Eigen::MatrixXd> MultivariateNormal::llt() const {
+std::shared_ptr<const MultivariateNormal::Factorization>
+MultivariateNormal::factorization() const {
+  // A constant covariance was decomposed by the constructor; any other is
+  // decomposed again when its value differs from the last one decomposed,
+  // which costs O(d^2) comparisons against the O(d^3) decomposition.
+  std::shared_ptr<const Factorization> current = _factorization.load();
   if (in_nodes[1]->node_type == graph::NodeType::CONSTANT) {
-    return _llt;
+    return current;
+  }
+  const Eigen::MatrixXd& key = lkj_factor != nullptr
+      ? lkj_factor->value._matrix
+      : in_nodes[1]->value._matrix;
+  if (current != nullptr and key.rows() == current->key.rows() and
+      key == current->key) {
+    return current;
+  }
+  if (lkj_factor != nullptr) {
+    // an LKJ Cholesky sample is lower triangular with a positive diagonal
+    auto updated = std::make_shared<Factorization>();
+    updated->key = key;
+    updated->factor = key;
+    updated->log_det = 2 * key.diagonal().array().log().sum();
+    current = std::move(updated);
   } else {
-    // If the covariance is not constant, we need to recompute the
-    // Cholesky decomposition each time we sample or take the log prob.
-    auto result = in_nodes[1]->value._matrix.llt();
-    if (result.info() == Eigen::NumericalIssue) {
-      throw std::invalid_argument(
-          "Multivariate Normal's covariance matrix must be positive definite");
-    }
-    return result;
+    current = decompose(key);
   }
+  _factorization.store(current);
+  return current;
+}
+
+std::shared_ptr<const MultivariateNormal::Factorization>
+MultivariateNormal::decompose(const Eigen::MatrixXd& sigma) {
+  // LLT is the Eigen operation for Cholesky decomposition.
+  Eigen::LLT<Eigen::MatrixXd> llt(sigma);
+  if (llt.info() == Eigen::NumericalIssue) {
+    throw std::invalid_argument(
+        "Multivariate Normal's covariance matrix must be positive definite");
+  }
+  auto result = std::make_shared<Factorization>();
+  result->factor = llt.matrixL();
+  result->key = sigma;
+  // a sum of logs rather than the log of a product, which overflows in high
+  // dimensions
+  result->log_det = 2 * result->factor.diagonal().array().log().sum();
+  return result;
+}
+
+Eigen::VectorXd MultivariateNormal::whitened(
+    const Factorization& factorization,
+    const graph::NodeValue& value) const {
+  const auto l = factorization.factor.triangularView<Eigen::Lower>();
+  Eigen::VectorXd alpha = value._matrix - in_nodes[0]->value._matrix;
+  l.solveInPlace(alpha);
+  l.transpose().solveInPlace(alpha);
+  return alpha;
+}
+
+const Eigen::MatrixXd& MultivariateNormal::Factorization::sigma_inverse()
+    const {
+  std::call_once(sigma_inverse_once, [this]() {
+    // Sigma^-1 = L^-T L^-1
+    Eigen::MatrixXd l_inv =
+        Eigen::MatrixXd::Identity(factor.rows(), factor.cols());
+    factor.triangularView<Eigen::Lower>().solveInPlace(l_inv);
+    _sigma_inverse.noalias() = l_inv.transpose() * l_inv;
+  });
+  return _sigma_inverse;
 }
 
 Eigen::MatrixXd MultivariateNormal::_matrix_sampler(std::mt19937& gen) const {
@@ -97,25 +178,22 @@ Eigen::MatrixXd MultivariateNormal::_matrix_sampler(std::mt19937& gen) const {
     sample(i) = standard_normal(gen);
   }
 
-  Eigen::MatrixXd mean = in_nodes[0]->value._matrix;
-  return llt().matrixL() * sample + mean;
+  return factorization()->factor.triangularView<Eigen::Lower>() * sample +
+      in_nodes[0]->value._matrix;
 }
 
 double MultivariateNormal::log_prob(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   assert(value.type.cols == 1);
 
-  Eigen::MatrixXd x = value._matrix;
-  Eigen::MatrixXd mean = in_nodes[0]->value._matrix;
   int dims = static_cast<int>(in_nodes[0]->value._matrix.rows());
-
-  auto computed_llt = llt();
-  double mdist = computed_llt.matrixL().solve(x - mean).squaredNorm();
+  auto current = factorization();
+  double mdist = current->factor.triangularView<Eigen::Lower>()
+                     .solve(value._matrix - in_nodes[0]->value._matrix)
+                     .squaredNorm();
   const double log2pi = std::log(2 * M_PI);
-  double log_det =
-      2 * std::log(computed_llt.matrixL().nestedExpression().diagonal().prod());
 
-  return -0.5 * (dims * log2pi + log_det + mdist);
+  return -0.5 * (dims * log2pi + current->log_det + mdist);
 }
 
 // log_prob(x | u, S) =
@@ -123,33 +201,30 @@ double MultivariateNormal::log_prob(const graph::NodeValue& value) const {
 // grad1 w.r.t x = -S^-1 (x - u)
 // grad1 w.r.t u = S^-1 (x - u)
 // grad1 w.r.t S = -1/2 (S^-1 - S^-1 (x - u)(x-u)^T S^-1)
+// where S^-1 (x - u) is computed by triangular solves against the factor.
 void MultivariateNormal::backward_value(
     const graph::NodeValue& value,
     graph::DoubleMatrix& back_grad,
     double adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  Eigen::MatrixXd x = value._matrix;
-  Eigen::MatrixXd mean = in_nodes[0]->value._matrix;
-  Eigen::MatrixXd sigma = in_nodes[1]->value._matrix;
-  back_grad += adjunct * -sigma.inverse() * (x - mean);
+  back_grad += -adjunct * whitened(*factorization(), value);
 }
+
 void MultivariateNormal::backward_param(
     const graph::NodeValue& value,
     double adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
-  Eigen::MatrixXd x = value._matrix;
-  Eigen::MatrixXd mean = in_nodes[0]->value._matrix;
-  Eigen::MatrixXd sigma = in_nodes[1]->value._matrix;
-  Eigen::MatrixXd sigma_inv = sigma.inverse();
-  // Because the above values are of type Eigen::MatrixXd
-  // the * operation is a matrix multiply.
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
+  auto current = factorization();
+  Eigen::VectorXd alpha = whitened(*current, value);
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += adjunct * sigma_inv * (x - mean);
+    in_nodes[0]->back_grad1 += adjunct * alpha;
   }
   if (in_nodes[1]->needs_gradient()) {
-    Eigen::MatrixXd err = x - mean;
     in_nodes[1]->back_grad1 += adjunct * (-0.5) *
-        (sigma_inv - sigma_inv * err * err.transpose() * sigma_inv);
+        (current->sigma_inverse() - alpha * alpha.transpose());
   }
 }
 
@@ -6,6 +6,9 @@
  */
 
 #pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "beanmachine/graph/distribution/distribution.h"
 
 namespace beanmachine {
@@ -37,9 +40,37 @@ class MultivariateNormal : public Distribution {
       const override;
 
  private:
-  Eigen::LLT<Eigen::MatrixXd> llt() const;
-  Eigen::LLT<Eigen::MatrixXd>
-      _llt; // cholesky decomposition of the covariance matrix if constant
+  // A lower triangular factor L of the covariance, L L^T = Sigma, together
+  // with the log of its determinant. It is computed again only when the
+  // covariance changes (see ParameterCache, whose key is likewise the parameter
+  // value itself), and shared by the log prob, the sampler and both backward
+  // passes, so that each of those costs O(d^2) triangular solves.
+  // As in ParameterCache, a factorization is immutable once published and
+  // replaced as a whole by an atomic swap, so that a distribution evaluated
+  // by several threads at once is safe.
+  struct Factorization {
+    Eigen::MatrixXd key; // the value the factor was computed from
+    Eigen::MatrixXd factor;
+    double log_det;
+    // Sigma^-1, needed only for the gradient w.r.t. the covariance;
+    // computed from the factor at most once.
+    const Eigen::MatrixXd& sigma_inverse() const;
+
+   private:
+    mutable std::once_flag sigma_inverse_once;
+    mutable Eigen::MatrixXd _sigma_inverse;
+  };
+  std::shared_ptr<const Factorization> factorization() const;
+  // Sigma^-1 (x - mean), by two triangular solves against the factor.
+  Eigen::VectorXd whitened(
+      const Factorization& factorization,
+      const graph::NodeValue& value) const;
+  static std::shared_ptr<const Factorization> decompose(
+      const Eigen::MatrixXd& sigma);
+  // When the covariance is the operator L * L^T of an LKJ Cholesky sample L,
+  // this is that sample: its value is the factor and no decomposition is done.
+  graph::Node* lkj_factor = nullptr;
+  mutable std::atomic<std::shared_ptr<const Factorization>> _factorization;
 };
 } // namespace distribution
 } // namespace beanmachine
@@ -11,6 +11,7 @@
 #include <random>
 #include <string>
 
+#include "beanmachine/graph/distribution/iid_kernels.h"
 #include "beanmachine/graph/distribution/normal.h"
 #include "beanmachine/graph/util.h"
 
@@ -89,8 +90,14 @@ void Normal::log_prob_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  log_probs = (-std::log(s) - 0.5 * std::log(2 * M_PI)) -
-      0.5 * (value._matrix.array() - m).pow(2) / (s * s);
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void Normal::_grad1_log_prob_value(
@@ -160,8 +167,13 @@ void Normal::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-  back_grad -= ((value._matrix.array() - m) / s_sq);
+  iid::normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Normal::backward_value_iid(
@@ -171,8 +183,13 @@ void Normal::backward_value_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-  back_grad -= (adjunct.array() * (value._matrix.array() - m) / s_sq);
+  iid::normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void Normal::backward_param(const graph::NodeValue& value, double adjunct)
@@ -193,19 +210,24 @@ void Normal::backward_param(const graph::NodeValue& value, double adjunct)
 
 void Normal::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
-
-  int size = static_cast<int>(value._matrix.size());
-  double sum_x = value._matrix.sum();
+  double grads[2];
+  iid::normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += sum_x / s_sq - size * m / s_sq;
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    double sum_xsq = value._matrix.squaredNorm();
-    in_nodes[1]->back_grad1 +=
-        (-size / s + (sum_xsq - 2 * m * sum_x + m * m * size) / (s * s_sq));
+    in_nodes[1]->back_grad1 += grads[1];
   }
 }
 
@@ -213,20 +235,61 @@ void Normal::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and not in_nodes[1]->needs_gradient()) {
+    return;
+  }
   double m = in_nodes[0]->value._double;
   double s = in_nodes[1]->value._double;
-  double s_sq = s * s;
+  double grads[2];
+  iid::normal(
+      value._matrix.data(),
+      value._matrix.size(),
+      m,
+      s,
+      adjunct.data(),
+      {.param_grads = grads});
+  if (in_nodes[0]->needs_gradient()) {
+    in_nodes[0]->back_grad1 += grads[0];
+  }
+  if (in_nodes[1]->needs_gradient()) {
+    in_nodes[1]->back_grad1 += grads[1];
+  }
+}
 
-  double sum_x = (value._matrix.array() * adjunct.array()).sum();
-  double sum_adjunct = adjunct.sum();
+// The sufficient statistics are the sums of x and of x^2, so that with
+// n elements the gradients of the log prob are
+// w.r.t. m : (sum x - n m) / s^2
+// w.r.t. s : -n / s + (sum x^2 - 2 m sum x + n m^2) / s^3
+bool Normal::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  stats.size = static_cast<double>(value._matrix.size());
+  stats.sums = {value._matrix.sum(), value._matrix.squaredNorm(), 0};
+  return true;
+}
+
+double Normal::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double m = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  return util::log_normal_density(
+      stats.sums[0], stats.sums[1], m, s, static_cast<int>(stats.size));
+}
+
+void Normal::backward_param_sufficient(
+    const SufficientStatistics& stats) const {
+  double m = in_nodes[0]->value._double;
+  double s = in_nodes[1]->value._double;
+  double s_sq = s * s;
+  double n = stats.size;
+  double sum_x = stats.sums[0];
+  double sum_xsq = stats.sums[1];
   if (in_nodes[0]->needs_gradient()) {
-    in_nodes[0]->back_grad1 += sum_x / s_sq - sum_adjunct * m / s_sq;
+    in_nodes[0]->back_grad1 += (sum_x - n * m) / s_sq;
   }
   if (in_nodes[1]->needs_gradient()) {
-    double sum_xsq = (value._matrix.array().pow(2) * adjunct.array()).sum();
-    in_nodes[1]->back_grad1 +=
-        (-sum_adjunct / s +
-         (sum_xsq - 2 * m * sum_x + m * m * sum_adjunct) / (s * s_sq));
+    double sum_sq_diff = sum_xsq - 2 * m * sum_x + n * m * m;
+    in_nodes[1]->back_grad1 += -n / s + sum_sq_diff / (s_sq * s);
   }
 }
 
@@ -52,6 +52,13 @@ class Normal : public Distribution {
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
 
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
+
   static void
   _grad1_log_prob_value(double& grad1, double val, double m, double s_sq);
 };
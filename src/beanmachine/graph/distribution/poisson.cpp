@@ -10,6 +10,7 @@
 
 #include <unsupported/Eigen/SpecialFunctions>
 
+#include "beanmachine/graph/distribution/iid_kernels.h"
 #include "beanmachine/graph/distribution/poisson.h"
 #include "beanmachine/graph/util.h"
 
@@ -80,9 +81,13 @@ void Poisson::log_prob_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& log_probs) const {
   double lambda = in_nodes[0]->value._double;
-  Eigen::MatrixXd k_double = value._nmatrix.cast<double>();
-  log_probs =
-      k_double.array() * log(lambda) - lambda - (k_double.array() + 1).lgamma();
+  log_probs.resize(value._nmatrix.rows(), value._nmatrix.cols());
+  iid::poisson(
+      value._nmatrix.data(),
+      value._nmatrix.size(),
+      lambda,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void Poisson::gradient_log_prob_param(
@@ -113,8 +118,14 @@ void Poisson::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
     double lambda = in_nodes[0]->value._double;
-    Eigen::MatrixXd k_double = value._nmatrix.cast<double>();
-    in_nodes[0]->back_grad1 += (k_double.array() / lambda - 1).sum();
+    double grad;
+    iid::poisson(
+        value._nmatrix.data(),
+        value._nmatrix.size(),
+        lambda,
+        nullptr,
+        {.param_grads = &grad});
+    in_nodes[0]->back_grad1 += grad;
   }
 }
 
@@ -124,9 +135,39 @@ void Poisson::backward_param_iid(
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
   if (in_nodes[0]->needs_gradient()) {
     double lambda = in_nodes[0]->value._double;
-    Eigen::MatrixXd k_double = value._nmatrix.cast<double>();
-    in_nodes[0]->back_grad1 +=
-        (adjunct.array() * (k_double.array() / lambda - 1)).sum();
+    double grad;
+    iid::poisson(
+        value._nmatrix.data(),
+        value._nmatrix.size(),
+        lambda,
+        adjunct.data(),
+        {.param_grads = &grad});
+    in_nodes[0]->back_grad1 += grad;
+  }
+}
+
+// The sufficient statistics are the sums of k and of log(k!).
+bool Poisson::sufficient_statistics(
+    const graph::NodeValue& value,
+    SufficientStatistics& stats) const {
+  assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  Eigen::MatrixXd k_double = value._nmatrix.cast<double>();
+  stats.size = static_cast<double>(k_double.size());
+  stats.sums = {k_double.sum(), (k_double.array() + 1).lgamma().sum(), 0};
+  return true;
+}
+
+double Poisson::log_prob_sufficient(const SufficientStatistics& stats) const {
+  double lambda = in_nodes[0]->value._double;
+  return stats.sums[0] * std::log(lambda) - stats.size * lambda -
+      stats.sums[1];
+}
+
+void Poisson::backward_param_sufficient(
+    const SufficientStatistics& stats) const {
+  if (in_nodes[0]->needs_gradient()) {
+    double lambda = in_nodes[0]->value._double;
+    in_nodes[0]->back_grad1 += stats.sums[0] / lambda - stats.size;
   }
 }
 
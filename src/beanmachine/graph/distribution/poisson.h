@@ -51,6 +51,13 @@ class Poisson : public Distribution {
   void backward_param_iid(
       const graph::NodeValue& value,
       Eigen::MatrixXd& adjunct) const override;
+
+  bool sufficient_statistics(
+      const graph::NodeValue& value,
+      SufficientStatistics& stats) const override;
+  double log_prob_sufficient(const SufficientStatistics& stats) const override;
+  void backward_param_sufficient(
+      const SufficientStatistics& stats) const override;
 };
 
 } // namespace distribution
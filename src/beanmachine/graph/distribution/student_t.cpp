@@ -11,8 +11,9 @@
 #include <random>
 #include <string>
 
+#include "beanmachine/graph/distribution/iid_kernels.h"
 #include "beanmachine/graph/distribution/student_t.h"
-#include "beanmachine/graph/util.h"
+#include "beanmachine/graph/special_functions.h"
 
 // the common steps for all gradient calculation
 #define T_PREPARE_GRAD()                 \
@@ -89,13 +90,37 @@ double StudentT::_double_sampler(std::mt19937& gen) const {
 // - In forward propagation, g'(x) is given by in_nodes[x]->grad1,
 // the above equation computes f'(g) [f is the current function g is the input]
 
+double StudentT::log_normalizer() const {
+  double n = in_nodes[0]->value._double;
+  double s = in_nodes[2]->value._double;
+  return log_normalizer_cache.get({n, s}, [&]() {
+    return special::lgamma((n + 1) / 2) - special::lgamma(n / 2) -
+        0.5 * std::log(n) - 0.5 * std::log(M_PI) - std::log(s) +
+        ((n + 1) / 2) * (std::log(n) + 2 * std::log(s));
+  });
+}
+
+double StudentT::digamma_term() const {
+  double n = in_nodes[0]->value._double;
+  return digamma_term_cache.get({n}, [&]() {
+    return 0.5 * special::digamma((n + 1) / 2) -
+        0.5 * special::digamma(n / 2);
+  });
+}
+
+double StudentT::trigamma_term() const {
+  double n = in_nodes[0]->value._double;
+  return trigamma_term_cache.get({n}, [&]() {
+    return 0.25 * special::trigamma((n + 1) / 2) -
+        0.25 * special::trigamma(n / 2);
+  });
+}
+
 double StudentT::log_prob(const NodeValue& value) const {
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  double result = std::lgamma((n + 1) / 2) - std::lgamma(n / 2) -
-      0.5 * std::log(n) - 0.5 * std::log(M_PI) - std::log(s) +
-      ((n + 1) / 2) * (std::log(n) + 2 * std::log(s));
+  double result = log_normalizer();
 
   if (value.type.variable_type == graph::VariableType::SCALAR) {
     double x = value._double;
@@ -118,11 +143,15 @@ void StudentT::log_prob_iid(
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  double result = std::lgamma((n + 1) / 2) - std::lgamma(n / 2) -
-      0.5 * std::log(n) - 0.5 * std::log(M_PI) - std::log(s) +
-      ((n + 1) / 2) * (std::log(n) + 2 * std::log(s));
-
-  log_probs = result - ((n + 1) / 2) * NS2PXML2.log();
+  log_probs.resize(value._matrix.rows(), value._matrix.cols());
+  iid::student_t(
+      value._matrix.data(),
+      value._matrix.size(),
+      n,
+      l,
+      s,
+      nullptr,
+      {.log_probs = log_probs.data()});
 }
 
 void StudentT::_grad1_log_prob_value(
@@ -146,10 +175,11 @@ void StudentT::gradient_log_prob_value(
        2 * (x - l) * (x - l) / (n_s_sq_p_x_m_l_sq * n_s_sq_p_x_m_l_sq));
 }
 
-double
-StudentT::_grad1_log_prob_n(double n, double s, double n_s_sq_p_x_m_l_sq) {
-  return 0.5 * util::polygamma(0, (n + 1) / 2) -
-      0.5 * util::polygamma(0, n / 2) - 0.5 / n -
+double StudentT::_grad1_log_prob_n(
+    double n,
+    double s,
+    double n_s_sq_p_x_m_l_sq) const {
+  return digamma_term() - 0.5 / n -
       0.5 * (std::log(n_s_sq_p_x_m_l_sq) - std::log(n) - 2 * std::log(s)) -
       0.5 * (n + 1) * (s * s / n_s_sq_p_x_m_l_sq - 1 / n);
 }
@@ -179,8 +209,7 @@ void StudentT::gradient_log_prob_param(
   double n_grad2 = in_nodes[0]->grad2;
   if (n_grad != 0 or n_grad2 != 0) {
     double grad_n = _grad1_log_prob_n(n, s, n_s_sq_p_x_m_l_sq);
-    double grad2_n2 = 0.25 * util::polygamma(1, (n + 1) / 2) -
-        0.25 * util::polygamma(1, n / 2) + 0.5 / (n * n) -
+    double grad2_n2 = trigamma_term() + 0.5 / (n * n) -
         (s * s / n_s_sq_p_x_m_l_sq - 1 / n) -
         0.5 * (n + 1) *
             (-std::pow(s, 4) / (n_s_sq_p_x_m_l_sq * n_s_sq_p_x_m_l_sq) +
@@ -230,7 +259,14 @@ void StudentT::backward_value_iid(
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  back_grad -= ((n + 1) * (value._matrix.array() - l) / NS2PXML2);
+  iid::student_t(
+      value._matrix.data(),
+      value._matrix.size(),
+      n,
+      l,
+      s,
+      nullptr,
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void StudentT::backward_value_iid(
@@ -241,8 +277,14 @@ void StudentT::backward_value_iid(
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  back_grad -=
-      (adjunct.array() * (n + 1) * (value._matrix.array() - l) / NS2PXML2);
+  iid::student_t(
+      value._matrix.data(),
+      value._matrix.size(),
+      n,
+      l,
+      s,
+      adjunct.data(),
+      {.value_grads = back_grad.as_matrix().data()});
 }
 
 void StudentT::backward_param(const graph::NodeValue& value, double adjunct)
@@ -265,28 +307,31 @@ void StudentT::backward_param(const graph::NodeValue& value, double adjunct)
 
 void StudentT::backward_param_iid(const graph::NodeValue& value) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and
+      not in_nodes[1]->needs_gradient() and
+      not in_nodes[2]->needs_gradient()) {
+    return;
+  }
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  Eigen::MatrixXd NSsqPXMLsq = NS2PXML2;
-  int size = static_cast<int>(value._matrix.size());
+  double grads[3];
+  iid::student_t(
+      value._matrix.data(),
+      value._matrix.size(),
+      n,
+      l,
+      s,
+      nullptr,
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    double jacob = size *
-        (0.5 * util::polygamma(0, (n + 1) / 2) -
-         0.5 * util::polygamma(0, n / 2) - 0.5 / n + 0.5 * std::log(n) +
-         std::log(s) + 0.5 * (n + 1) / n);
-    in_nodes[0]->back_grad1 += jacob -
-        (0.5 * NSsqPXMLsq.array().log() +
-         0.5 * (n + 1) * s * s / NSsqPXMLsq.array())
-            .sum();
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 +=
-        (n + 1) * ((value._matrix.array() - l) / NSsqPXMLsq.array()).sum();
+    in_nodes[1]->back_grad1 += grads[1];
   }
   if (in_nodes[2]->needs_gradient()) {
-    in_nodes[2]->back_grad1 +=
-        size * n / s - (n + 1) * n * (s / NSsqPXMLsq.array()).sum();
+    in_nodes[2]->back_grad1 += grads[2];
   }
 }
 
@@ -294,34 +339,31 @@ void StudentT::backward_param_iid(
     const graph::NodeValue& value,
     Eigen::MatrixXd& adjunct) const {
   assert(value.type.variable_type == graph::VariableType::BROADCAST_MATRIX);
+  if (not in_nodes[0]->needs_gradient() and
+      not in_nodes[1]->needs_gradient() and
+      not in_nodes[2]->needs_gradient()) {
+    return;
+  }
   double n = in_nodes[0]->value._double;
   double l = in_nodes[1]->value._double;
   double s = in_nodes[2]->value._double;
-  Eigen::MatrixXd NSsqPXMLsq = NS2PXML2;
-  double adjunct_sum = 1.0;
-  if (in_nodes[0]->needs_gradient() or in_nodes[2]->needs_gradient()) {
-    adjunct_sum = adjunct.sum();
-  }
+  double grads[3];
+  iid::student_t(
+      value._matrix.data(),
+      value._matrix.size(),
+      n,
+      l,
+      s,
+      adjunct.data(),
+      {.param_grads = grads});
   if (in_nodes[0]->needs_gradient()) {
-    double jacob = adjunct_sum *
-        (0.5 * util::polygamma(0, (n + 1) / 2) -
-         0.5 * util::polygamma(0, n / 2) - 0.5 / n + 0.5 * std::log(n) +
-         std::log(s) + 0.5 * (n + 1) / n);
-    in_nodes[0]->back_grad1 += jacob -
-        (adjunct.array() *
-         (0.5 * NSsqPXMLsq.array().log() +
-          0.5 * (n + 1) * s * s / NSsqPXMLsq.array()))
-            .sum();
+    in_nodes[0]->back_grad1 += grads[0];
   }
   if (in_nodes[1]->needs_gradient()) {
-    in_nodes[1]->back_grad1 +=
-        (adjunct.array() * (n + 1) * (value._matrix.array() - l) /
-         NSsqPXMLsq.array())
-            .sum();
+    in_nodes[1]->back_grad1 += grads[1];
   }
   if (in_nodes[2]->needs_gradient()) {
-    in_nodes[2]->back_grad1 += adjunct_sum * n / s -
-        (adjunct.array() * (n + 1) * n * (s / NSsqPXMLsq.array())).sum();
+    in_nodes[2]->back_grad1 += grads[2];
   }
 }
 
@@ -58,10 +58,24 @@ class StudentT : public Distribution {
       double n,
       double l,
       double n_s_sq_p_x_m_l_sq);
-  static double _grad1_log_prob_n(double n, double s, double n_s_sq_p_x_m_l_sq);
+  double _grad1_log_prob_n(double n, double s, double n_s_sq_p_x_m_l_sq)
+      const;
   static double
   _grad1_log_prob_l(double x, double n, double l, double n_s_sq_p_x_m_l_sq);
   static double _grad1_log_prob_s(double n, double s, double n_s_sq_p_x_m_l_sq);
+ private:
+  // The terms of the log prob and its gradients that depend only on the
+  // parameters n and s (see ParameterCache).
+  double log_normalizer() const;
+  double digamma_term() const;
+  double trigamma_term() const;
+  // lgamma((n + 1) / 2) - lgamma(n / 2) - log(n pi) / 2 - log(s)
+  //     + (n + 1) / 2 (log(n) + 2 log(s))
+  mutable ParameterCache<2> log_normalizer_cache;
+  // (digamma((n + 1) / 2) - digamma(n / 2)) / 2
+  mutable ParameterCache<1> digamma_term_cache;
+  // (trigamma((n + 1) / 2) - trigamma(n / 2)) / 4
+  mutable ParameterCache<1> trigamma_term_cache;
 };
 
 } // namespace distribution
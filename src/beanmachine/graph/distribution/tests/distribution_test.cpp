@@ -6,10 +6,15 @@
  */
 
 #include <gtest/gtest.h>
+#include <functional>
+#include <random>
 
 #include "beanmachine/graph/distribution/bernoulli.h"
 #include "beanmachine/graph/distribution/bernoulli_noisy_or.h"
+#include "beanmachine/graph/distribution/beta.h"
 #include "beanmachine/graph/distribution/binomial.h"
+#include "beanmachine/graph/distribution/gamma.h"
+#include "beanmachine/graph/distribution/student_t.h"
 #include "beanmachine/graph/distribution/tabular.h"
 #include "beanmachine/graph/graph.h"
 
@@ -230,3 +235,141 @@ TEST(testdistrib, binomial) {
           std::vector<graph::Node*>{&cnode_n, &cnode_p2}),
       std::invalid_argument);
 }
+
+TEST(testdistrib, parameter_cache) {
+  // Beta, Gamma and StudentT keep the terms of their log prob that only
+  // depend on their parameters; these must follow parameter values
+  // assigned in place, as inference methods do.
+  graph::ConstNode cnode_1(graph::NodeValue(graph::AtomicType::POS_REAL, 1.5));
+  graph::ConstNode cnode_2(graph::NodeValue(graph::AtomicType::POS_REAL, 2.0));
+  graph::ConstNode cnode_3(graph::NodeValue(graph::AtomicType::REAL, 0.5));
+  distribution::Beta beta(
+      graph::AtomicType::PROBABILITY,
+      std::vector<graph::Node*>{&cnode_1, &cnode_2});
+  distribution::Gamma gamma(
+      graph::AtomicType::POS_REAL,
+      std::vector<graph::Node*>{&cnode_1, &cnode_2});
+  distribution::StudentT student_t(
+      graph::AtomicType::REAL,
+      std::vector<graph::Node*>{&cnode_1, &cnode_3, &cnode_2});
+  auto x = graph::NodeValue(graph::AtomicType::PROBABILITY, 0.3);
+  auto expected = [&]() {
+    double a = cnode_1.value._double;
+    double b = cnode_2.value._double;
+    double l = cnode_3.value._double;
+    double v = x._double;
+    double z = (v - l) / b;
+    return std::vector<double>{
+        std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+            (a - 1) * std::log(v) + (b - 1) * std::log(1 - v),
+        a * std::log(b) - std::lgamma(a) + (a - 1) * std::log(v) - b * v,
+        std::lgamma((a + 1) / 2) - std::lgamma(a / 2) -
+            0.5 * std::log(a * M_PI) - std::log(b) -
+            (a + 1) / 2 * std::log1p(z * z / a)};
+  };
+  for (double a : {1.5, 1.5, 3.0, 0.7}) {
+    for (double b : {2.0, 5.0, 5.0}) {
+      cnode_1.value._double = a;
+      cnode_2.value._double = b;
+      for (double v : {0.3, 0.9}) {
+        x._double = v;
+        std::vector<double> log_probs = expected();
+        EXPECT_NEAR(beta.log_prob(x), log_probs[0], 1e-12);
+        EXPECT_NEAR(gamma.log_prob(x), log_probs[1], 1e-12);
+        EXPECT_NEAR(student_t.log_prob(x), log_probs[2], 1e-12);
+      }
+    }
+  }
+}
+
+TEST(testdistrib, sufficient_statistics) {
+  // An observed IID_SAMPLE keeps the sufficient statistics of its value; its
+  // log prob and the gradients w.r.t. the parameters must match those
+  // computed from the value itself as the parameters change.
+  using graph::AtomicType;
+  using graph::DistributionType;
+  graph::Graph g;
+  auto param = [&](AtomicType type) {
+    uint dist = g.add_distribution(
+        DistributionType::FLAT, type, std::vector<uint>{});
+    return g.add_operator(graph::OperatorType::SAMPLE, std::vector<uint>{dist});
+  };
+  uint real = param(AtomicType::REAL);
+  uint pos_real = param(AtomicType::POS_REAL);
+  uint pos_real2 = param(AtomicType::POS_REAL);
+  uint prob = param(AtomicType::PROBABILITY);
+  uint n = g.add_constant_natural(5);
+  const int size = 20;
+  uint size_node = g.add_constant_natural(size);
+  auto iid = [&](DistributionType type,
+                 AtomicType sample_type,
+                 const std::vector<uint>& parents) {
+    uint dist = g.add_distribution(type, sample_type, parents);
+    return g.add_operator(
+        graph::OperatorType::IID_SAMPLE, std::vector<uint>{dist, size_node});
+  };
+  std::mt19937 gen(17);
+  std::uniform_real_distribution<double> unif(0.05, 0.95);
+  std::uniform_int_distribution<graph::natural_t> counts(0, 5);
+  Eigen::MatrixXd reals(size, 1), probs(size, 1), pos_reals(size, 1);
+  Eigen::MatrixXb bools(size, 1);
+  Eigen::MatrixXn naturals(size, 1);
+  for (int i = 0; i < size; i++) {
+    probs(i) = unif(gen);
+    reals(i) = 4 * probs(i) - 1;
+    pos_reals(i) = 3 * probs(i);
+    bools(i) = probs(i) > 0.5;
+    naturals(i) = counts(gen);
+  }
+  std::vector<uint> iids = {
+      iid(DistributionType::NORMAL, AtomicType::REAL, {real, pos_real}),
+      iid(DistributionType::BERNOULLI, AtomicType::BOOLEAN, {prob}),
+      iid(DistributionType::POISSON, AtomicType::NATURAL, {pos_real}),
+      iid(DistributionType::BINOMIAL, AtomicType::NATURAL, {n, prob}),
+      iid(DistributionType::GAMMA, AtomicType::POS_REAL, {pos_real, pos_real2}),
+      iid(DistributionType::BETA,
+          AtomicType::PROBABILITY,
+          {pos_real, pos_real2})};
+  g.observe(iids[0], reals);
+  g.observe(iids[1], bools);
+  g.observe(iids[2], naturals);
+  g.observe(iids[3], naturals);
+  g.observe(iids[4], pos_reals);
+  g.observe(iids[5], probs);
+
+  auto check = [&](uint iid_id) {
+    graph::Node* node = g.get_node(iid_id);
+    auto dist = static_cast<distribution::Distribution*>(node->in_nodes[0]);
+    double expected = dist->log_prob(node->value);
+    EXPECT_NEAR(node->log_prob(), expected, 1e-10 * (1 + std::abs(expected)));
+    auto param_grads = [&](const std::function<void()>& backward) {
+      for (graph::Node* parent : dist->in_nodes) {
+        parent->back_grad1 = 0;
+      }
+      backward();
+      std::vector<double> grads;
+      for (graph::Node* parent : dist->in_nodes) {
+        grads.push_back(parent->back_grad1.as_double());
+      }
+      return grads;
+    };
+    auto expected_grads =
+        param_grads([&]() { dist->backward_param_iid(node->value); });
+    auto grads = param_grads([&]() { node->backward(); });
+    for (std::size_t i = 0; i < grads.size(); i++) {
+      EXPECT_NEAR(
+          grads[i],
+          expected_grads[i],
+          1e-10 * (1 + std::abs(expected_grads[i])));
+    }
+  };
+  for (double v : {0.3, 0.7}) {
+    g.get_node(real)->value._double = 3 * v - 1;
+    g.get_node(pos_real)->value._double = 0.5 + 4 * v;
+    g.get_node(pos_real2)->value._double = 2 - v;
+    g.get_node(prob)->value._double = v;
+    for (uint iid_id : iids) {
+      check(iid_id);
+    }
+  }
+}
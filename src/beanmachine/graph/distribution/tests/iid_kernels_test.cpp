@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/distribution/iid_kernels.h"
+
+using namespace beanmachine;
+using namespace beanmachine::distribution;
+
+namespace {
+
+// A kernel applied to real values with its parameters bound.
+using RealKernel = std::function<void(
+    const std::vector<double>& params,
+    const double* x,
+    std::size_t n,
+    const double* adjunct,
+    const iid::Outputs& out)>;
+
+struct RealCase {
+  std::string name;
+  RealKernel kernel;
+  std::vector<double> params;
+  // samples values in the support of the distribution
+  std::function<double(std::mt19937&)> sample;
+};
+
+std::vector<RealCase> real_cases() {
+  std::uniform_real_distribution<double> unit(0.01, 0.99);
+  std::uniform_real_distribution<double> positive(0.1, 5.0);
+  std::uniform_real_distribution<double> real(-5.0, 5.0);
+  return {
+      {"normal",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::normal(x, n, p[0], p[1], adj, out);
+       },
+       {0.3, 1.7},
+       [=](std::mt19937& gen) mutable { return real(gen); }},
+      {"half_normal",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::half_normal(x, n, p[0], adj, out);
+       },
+       {1.7},
+       [=](std::mt19937& gen) mutable { return positive(gen); }},
+      {"log_normal",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::log_normal(x, n, p[0], p[1], adj, out);
+       },
+       {0.3, 1.7},
+       [=](std::mt19937& gen) mutable { return positive(gen); }},
+      {"gamma",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::gamma(x, n, p[0], p[1], adj, out);
+       },
+       {2.5, 1.5},
+       [=](std::mt19937& gen) mutable { return positive(gen); }},
+      {"beta",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::beta(x, n, p[0], p[1], adj, out);
+       },
+       {2.5, 1.5},
+       [=](std::mt19937& gen) mutable { return unit(gen); }},
+      {"student_t",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::student_t(x, n, p[0], p[1], p[2], adj, out);
+       },
+       {3.5, 0.3, 1.7},
+       [=](std::mt19937& gen) mutable { return real(gen); }},
+      {"cauchy",
+       [](auto& p, auto x, auto n, auto adj, auto& out) {
+         iid::cauchy(x, n, p[0], p[1], adj, out);
+       },
+       {0.3, 1.7},
+       [=](std::mt19937& gen) mutable { return real(gen); }},
+  };
+}
+
+// the log density of each distribution computed directly
+double reference_log_prob(
+    const std::string& name,
+    const std::vector<double>& p,
+    double x) {
+  if (name == "normal") {
+    double z = (x - p[0]) / p[1];
+    return -std::log(p[1]) - 0.5 * std::log(2 * M_PI) - 0.5 * z * z;
+  } else if (name == "half_normal") {
+    double z = x / p[0];
+    return -std::log(p[0]) - 0.5 * std::log(M_PI / 2) - 0.5 * z * z;
+  } else if (name == "log_normal") {
+    double z = (std::log(x) - p[0]) / p[1];
+    return -std::log(p[1]) - 0.5 * std::log(2 * M_PI) - 0.5 * z * z -
+        std::log(x);
+  } else if (name == "gamma") {
+    return p[0] * std::log(p[1]) - std::lgamma(p[0]) +
+        (p[0] - 1) * std::log(x) - p[1] * x;
+  } else if (name == "beta") {
+    return std::lgamma(p[0] + p[1]) - std::lgamma(p[0]) - std::lgamma(p[1]) +
+        (p[0] - 1) * std::log(x) + (p[1] - 1) * std::log(1 - x);
+  } else if (name == "student_t") {
+    double n = p[0];
+    double z = (x - p[1]) / p[2];
+    return std::lgamma((n + 1) / 2) - std::lgamma(n / 2) -
+        0.5 * std::log(n * M_PI) - std::log(p[2]) -
+        (n + 1) / 2 * std::log1p(z * z / n);
+  } else {
+    double z = (x - p[0]) / p[1];
+    return -std::log(M_PI * p[1]) - std::log1p(z * z);
+  }
+}
+
+double weighted_sum(
+    const RealCase& c,
+    const std::vector<double>& params,
+    const std::vector<double>& x,
+    const std::vector<double>& adjunct) {
+  std::vector<double> log_probs(x.size());
+  c.kernel(
+      params, x.data(), x.size(), nullptr, {.log_probs = log_probs.data()});
+  double sum = 0;
+  for (std::size_t i = 0; i < x.size(); i++) {
+    sum += adjunct[i] * log_probs[i];
+  }
+  return sum;
+}
+
+} // namespace
+
+TEST(testdistrib, iid_kernels_real) {
+  std::mt19937 gen(17);
+  std::uniform_real_distribution<double> weight(0.5, 2.0);
+  // sizes with and without a partial block of lanes
+  for (std::size_t n : {3, 16, 101}) {
+    for (const RealCase& c : real_cases()) {
+      std::vector<double> x(n), adjunct(n), ones(n, 1.0);
+      for (std::size_t i = 0; i < n; i++) {
+        x[i] = c.sample(gen);
+        adjunct[i] = weight(gen);
+      }
+      // all outputs in one pass agree with the reference and with the
+      // outputs computed one at a time
+      std::vector<double> log_probs(n), value_grads(n, 1.0);
+      std::vector<double> param_grads(c.params.size());
+      c.kernel(
+          c.params,
+          x.data(),
+          n,
+          adjunct.data(),
+          {log_probs.data(), value_grads.data(), param_grads.data()});
+      std::vector<double> value_grads_only(n, 1.0);
+      c.kernel(
+          c.params,
+          x.data(),
+          n,
+          adjunct.data(),
+          {.value_grads = value_grads_only.data()});
+      for (std::size_t i = 0; i < n; i++) {
+        EXPECT_NEAR(
+            log_probs[i], reference_log_prob(c.name, c.params, x[i]), 1e-12)
+            << c.name;
+        EXPECT_EQ(value_grads[i], value_grads_only[i]) << c.name;
+        // the gradient w.r.t. the value, against central differences
+        double h = 1e-6 * std::max(1.0, std::abs(x[i]));
+        double numeric = adjunct[i] *
+            (reference_log_prob(c.name, c.params, x[i] + h) -
+             reference_log_prob(c.name, c.params, x[i] - h)) /
+            (2 * h);
+        EXPECT_NEAR(value_grads[i] - 1.0, numeric, 1e-5) << c.name;
+      }
+      // the gradients w.r.t. the parameters, with and without adjunct
+      for (bool with_adjunct : {false, true}) {
+        const std::vector<double>& w = with_adjunct ? adjunct : ones;
+        std::vector<double> grads(c.params.size());
+        c.kernel(
+            c.params,
+            x.data(),
+            n,
+            with_adjunct ? adjunct.data() : nullptr,
+            {.param_grads = grads.data()});
+        for (std::size_t j = 0; j < c.params.size(); j++) {
+          std::vector<double> plus = c.params, minus = c.params;
+          double h = 1e-6 * std::abs(c.params[j]);
+          plus[j] += h;
+          minus[j] -= h;
+          double numeric =
+              (weighted_sum(c, plus, x, w) - weighted_sum(c, minus, x, w)) /
+              (2 * h);
+          EXPECT_NEAR(
+              grads[j], numeric, 1e-5 * std::max(1.0, std::abs(numeric)))
+              << c.name << " param " << j;
+        }
+      }
+    }
+  }
+}
+
+TEST(testdistrib, iid_kernels_discrete) {
+  std::mt19937 gen(19);
+  std::uniform_real_distribution<double> weight(0.5, 2.0);
+  const std::size_t n = 37;
+  std::vector<graph::natural_t> k(n);
+  std::vector<double> adjunct(n);
+  bool x[n];
+  for (std::size_t i = 0; i < n; i++) {
+    // values on both sides of the table of small factorials
+    k[i] = i * i;
+    x[i] = i % 3 == 0;
+    adjunct[i] = weight(gen);
+  }
+  double lambda = 4.5;
+  std::vector<double> log_probs(n);
+  double grad, weighted_grad;
+  iid::poisson(k.data(), n, lambda, nullptr, {log_probs.data()});
+  iid::poisson(k.data(), n, lambda, nullptr, {.param_grads = &grad});
+  iid::poisson(
+      k.data(), n, lambda, adjunct.data(), {.param_grads = &weighted_grad});
+  double expected_grad = 0, expected_weighted_grad = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    double kd = static_cast<double>(k[i]);
+    double expected = kd * std::log(lambda) - lambda - std::lgamma(kd + 1);
+    EXPECT_NEAR(log_probs[i], expected, 1e-12 * std::max(1.0, -expected));
+    expected_grad += kd / lambda - 1;
+    expected_weighted_grad += adjunct[i] * (kd / lambda - 1);
+  }
+  EXPECT_NEAR(grad, expected_grad, 1e-10);
+  EXPECT_NEAR(weighted_grad, expected_weighted_grad, 1e-10);
+
+  double l = -0.7;
+  iid::bernoulli_logit(x, n, l, nullptr, {log_probs.data()});
+  iid::bernoulli_logit(x, n, l, nullptr, {.param_grads = &grad});
+  iid::bernoulli_logit(
+      x, n, l, adjunct.data(), {.param_grads = &weighted_grad});
+  expected_grad = 0;
+  expected_weighted_grad = 0;
+  double p = 1 / (1 + std::exp(-l));
+  for (std::size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(log_probs[i], std::log(x[i] ? p : 1 - p), 1e-12);
+    expected_grad += (x[i] ? 1.0 : 0.0) - p;
+    expected_weighted_grad += adjunct[i] * ((x[i] ? 1.0 : 0.0) - p);
+  }
+  EXPECT_NEAR(grad, expected_grad, 1e-10);
+  EXPECT_NEAR(weighted_grad, expected_weighted_grad, 1e-10);
+}
+
+// Throughput of each kernel in elements per second, for the log_prob, the
+// value gradient and the parameter gradient passes, and all three fused.
+// Run with --gtest_also_run_disabled_tests.
+TEST(testdistrib, DISABLED_iid_kernels_benchmark) {
+  const std::size_t n = 1 << 20;
+  const int repetitions = 20;
+  std::mt19937 gen(23);
+  std::vector<double> x(n), log_probs(n), value_grads(n), param_grads(3);
+  // discrete distributions have no value gradient
+  auto report = [&](const std::string& name,
+                    bool discrete,
+                    const std::function<void(const iid::Outputs&)>& run) {
+    double* grads = discrete ? nullptr : value_grads.data();
+    std::vector<std::pair<std::string, iid::Outputs>> passes = {
+        {"log_prob", {.log_probs = log_probs.data()}},
+        {"param_grad", {.param_grads = param_grads.data()}},
+        {"fused", {log_probs.data(), grads, param_grads.data()}}};
+    if (not discrete) {
+      passes.push_back({"value_grad", {.value_grads = grads}});
+    }
+    for (const auto& [pass, out] : passes) {
+      run(out);
+      auto start = std::chrono::steady_clock::now();
+      for (int r = 0; r < repetitions; r++) {
+        run(out);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << name << " " << pass << ": "
+                << n * repetitions / elapsed.count() / 1e6
+                << " M elements/s\n";
+    }
+  };
+  for (const RealCase& c : real_cases()) {
+    for (std::size_t i = 0; i < n; i++) {
+      x[i] = c.sample(gen);
+    }
+    report(c.name, false, [&](const iid::Outputs& out) {
+      c.kernel(c.params, x.data(), n, nullptr, out);
+    });
+  }
+  std::vector<graph::natural_t> k(n);
+  std::poisson_distribution<graph::natural_t> poisson(20.0);
+  for (std::size_t i = 0; i < n; i++) {
+    k[i] = poisson(gen);
+  }
+  report("poisson", true, [&](const iid::Outputs& out) {
+    iid::poisson(k.data(), n, 20.0, nullptr, out);
+  });
+  std::unique_ptr<bool[]> b(new bool[n]);
+  for (std::size_t i = 0; i < n; i++) {
+    b[i] = k[i] % 2 == 0;
+  }
+  report("bernoulli_logit", true, [&](const iid::Outputs& out) {
+    iid::bernoulli_logit(b.get(), n, 0.3, nullptr, out);
+  });
+}
@@ -6,6 +6,9 @@
  */
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 #include <stdexcept>
 
 #include "beanmachine/graph/distribution/multivariate_normal.h"
@@ -232,3 +235,132 @@ TEST(testdistrib, lkj_multivariate_normal_sample) {
     EXPECT_NEAR(mean(i), m1(i), 0.01);
   }
 }
+
+TEST(testdistrib, lkj_multivariate_normal_factor) {
+  // The covariance L * L^T of an LKJ Cholesky sample L is factored by L
+  // itself; the log prob and gradients must match those of the same
+  // covariance built from a FLAT sample, which is decomposed instead.
+  Eigen::MatrixXd m1(3, 1);
+  m1 << 1.5, 1.0, 2.0;
+  Eigen::MatrixXd l(3, 3);
+  l << 1.0, 0.0, 0.0, 0.6, 0.8, 0.0, -0.36, 0.48, 0.8;
+  Eigen::MatrixXd obs(3, 1);
+  obs << 1.0, 0.8, 1.5;
+
+  struct Model {
+    Graph g;
+    uint factor;
+    uint mv_dist;
+    uint x;
+  };
+  auto build = [&](Model& model, DistributionType factor_type) {
+    Graph& g = model.g;
+    uint mean_dist = g.add_distribution(
+        DistributionType::FLAT,
+        ValueType(VariableType::BROADCAST_MATRIX, AtomicType::REAL, 3, 1),
+        std::vector<uint>{});
+    uint mean = g.add_operator(OperatorType::SAMPLE, {mean_dist});
+    g.observe(mean, m1);
+    std::vector<uint> factor_parents;
+    if (factor_type == DistributionType::LKJ_CHOLESKY) {
+      factor_parents.push_back(g.add_constant_pos_real(2.0));
+    }
+    uint factor_dist = g.add_distribution(
+        factor_type,
+        ValueType(VariableType::BROADCAST_MATRIX, AtomicType::REAL, 3, 3),
+        factor_parents);
+    model.factor = g.add_operator(OperatorType::SAMPLE, {factor_dist});
+    g.observe(model.factor, l);
+    uint factor_t = g.add_operator(OperatorType::TRANSPOSE, {model.factor});
+    uint cov =
+        g.add_operator(OperatorType::MATRIX_MULTIPLY, {model.factor, factor_t});
+    model.mv_dist = g.add_distribution(
+        DistributionType::MULTIVARIATE_NORMAL,
+        ValueType(VariableType::BROADCAST_MATRIX, AtomicType::REAL, 3, 1),
+        std::vector<uint>{mean, cov});
+    model.x = g.add_operator(OperatorType::SAMPLE, {model.mv_dist});
+    g.observe(model.x, obs);
+  };
+  Model lkj, flat;
+  build(lkj, DistributionType::LKJ_CHOLESKY);
+  build(flat, DistributionType::FLAT);
+
+  auto log_prob = [](Model& model) {
+    auto dist = static_cast<beanmachine::distribution::Distribution*>(
+        model.g.get_node(model.mv_dist));
+    return dist->log_prob(model.g.get_node(model.x)->value);
+  };
+  auto expected_log_prob = [&](const Eigen::MatrixXd& factor) {
+    Eigen::MatrixXd sigma = factor * factor.transpose();
+    Eigen::MatrixXd err = obs - m1;
+    return -0.5 *
+        (3 * std::log(2 * M_PI) + std::log(sigma.determinant()) +
+         (err.transpose() * sigma.inverse() * err)(0));
+  };
+  std::vector<DoubleMatrix*> lkj_grad1, flat_grad1;
+  lkj.g.eval_and_grad(lkj_grad1);
+  flat.g.eval_and_grad(flat_grad1);
+  EXPECT_NEAR(log_prob(lkj), log_prob(flat), 1e-10);
+  EXPECT_NEAR(log_prob(lkj), expected_log_prob(l), 1e-10);
+  Eigen::MatrixXd sigma = l * l.transpose();
+  Eigen::MatrixXd expected = sigma.inverse() * (obs - m1);
+  for (uint i = 0; i < 3; i++) {
+    EXPECT_NEAR((*lkj_grad1[0])(i), expected(i), 1e-10); // mean
+    EXPECT_NEAR((*flat_grad1[0])(i), expected(i), 1e-10);
+    EXPECT_NEAR((*lkj_grad1[2])(i), -expected(i), 1e-10); // value
+    EXPECT_NEAR((*flat_grad1[2])(i), -expected(i), 1e-10);
+  }
+
+  // a new factor value is picked up by the cached factorization
+  Eigen::MatrixXd l2(3, 3);
+  l2 << 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.6, 0.0, 0.8;
+  for (Model* model : {&lkj, &flat}) {
+    model->g.get_node(model->factor)->value._matrix = l2;
+    Node* cov = model->g.get_node(model->mv_dist)->in_nodes[1];
+    std::mt19937 gen;
+    cov->in_nodes[1]->eval(gen); // the transpose
+    cov->eval(gen);
+  }
+  EXPECT_NEAR(log_prob(lkj), log_prob(flat), 1e-10);
+  EXPECT_NEAR(log_prob(lkj), expected_log_prob(l2), 1e-10);
+}
+
+TEST(testdistrib, DISABLED_multivariate_normal_gradient_benchmark) {
+  // gradients w.r.t. the value, mean and covariance of a 300-dimensional
+  // multivariate normal whose covariance changes between evaluations
+  const uint dims = 300;
+  const int repetitions = 20;
+  Graph g;
+  auto flat = [&](uint cols) {
+    uint dist = g.add_distribution(
+        DistributionType::FLAT,
+        ValueType(VariableType::BROADCAST_MATRIX, AtomicType::REAL, dims, cols),
+        std::vector<uint>{});
+    return g.add_operator(OperatorType::SAMPLE, {dist});
+  };
+  uint mean = flat(1);
+  uint cov = flat(dims);
+  Eigen::MatrixXd a = Eigen::MatrixXd::Random(dims, dims);
+  Eigen::MatrixXd mean_value = Eigen::MatrixXd::Zero(dims, 1);
+  Eigen::MatrixXd cov_value =
+      a * a.transpose() + dims * Eigen::MatrixXd::Identity(dims, dims);
+  Eigen::MatrixXd x_value = Eigen::MatrixXd::Random(dims, 1);
+  g.observe(mean, mean_value);
+  g.observe(cov, cov_value);
+  uint mv_dist = g.add_distribution(
+      DistributionType::MULTIVARIATE_NORMAL,
+      ValueType(VariableType::BROADCAST_MATRIX, AtomicType::REAL, dims, 1),
+      std::vector<uint>{mean, cov});
+  uint x = g.add_operator(OperatorType::SAMPLE, {mv_dist});
+  g.observe(x, x_value);
+
+  std::vector<DoubleMatrix*> grad1;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    g.get_node(cov)->value._matrix(0, 0) += 1e-3;
+    g.eval_and_grad(grad1);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << repetitions / elapsed.count() << " gradients/s" << std::endl;
+}
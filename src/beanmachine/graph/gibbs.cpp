@@ -9,169 +9,387 @@
 #include <cmath>
 
 #include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <limits>
+#include <mutex>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/gibbs.h"
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/stepper/single_site/gibbs_enumeration_single_site_stepping_method.h"
+#include "beanmachine/graph/stepper/single_site/sequential_single_site_stepper.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
 namespace graph {
 
-// TODO: move this inference method out of Graph.
-void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
-  std::mt19937 gen(seed);
-  std::set<uint> mutable_support = compute_mutable_support();
-  // eval each node so that we have a starting value and verify that these
-  // values are all scalar
-  // also compute the pool of variables that we will infer over and
-  // compute their descendants -- i.e. all stochastic non-observed nodes
-  // that are in the support of the graph
-  // pool : nodes that we will infer over -> det_desc, sto_desc
-  std::map<uint, std::tuple<std::vector<uint>, std::vector<uint>>> pool;
-  // cache_logodds : nodes that we will infer over -> log odds of not changing
-  std::vector<double> cache_logodds = std::vector<double>(nodes.size());
-  assert(cache_logodds.size() > 0); // keep linter happy
-  // inv_sto : stochastic node -> parent nodes in pool
-  // x in sto_desc[y] => y in inv_sto[x]
-  // this is a temp object which is needed to construct markov_blanket (below)
-  std::map<uint, std::set<uint>> inv_sto;
-  for (uint node_id : mutable_support) {
-    Node* node = nodes[node_id].get();
-    bool node_is_not_observed = observed.find(node_id) == observed.end();
-    if (node_is_not_observed) {
-      node->eval(gen); // evaluate the value of non-observed operator nodes
-    }
-    if (node->is_stochastic() and node_is_not_observed) {
-      std::vector<uint> det_nodes;
-      std::vector<uint> sto_nodes;
-      std::tie(det_nodes, sto_nodes) =
-          compute_affected_nodes(node_id, mutable_support);
-      pool[node_id] = std::make_tuple(det_nodes, sto_nodes);
-      cache_logodds[node_id] = NAN; // nan => needs to be re-computed
-      for (auto sto : sto_nodes) {
-        if (inv_sto.find(sto) == inv_sto.end()) {
-          inv_sto[sto] = std::set<uint>();
-        }
-        inv_sto[sto].insert(node_id);
+namespace {
+
+// A relation over the positions of the Gibbs pool (the unobserved stochastic
+// nodes in the support) in compressed sparse row form: the neighbors of
+// position i are indices[offsets[i]], ..., indices[offsets[i + 1] - 1].
+// A position is never its own neighbor.
+struct PoolAdjacency {
+  std::vector<size_t> offsets;
+  std::vector<uint> indices;
+
+  const uint* begin(uint i) const {
+    return indices.data() + offsets[i];
+  }
+  const uint* end(uint i) const {
+    return indices.data() + offsets[i + 1];
+  }
+};
+
+// Computes the pool positions sharing at least one node in `affected`.
+// With the stochastic affected nodes alone this is the Markov blanket:
+//   x in markov_blanket[y]
+//        <==> exists z s.t. z in sto_desc[x] and z in sto_desc[y]
+// Also passing the deterministic affected nodes yields the conflict relation
+// used for coloring, since two pool nodes sharing a deterministic descendant
+// cannot be updated concurrently even if it has no stochastic descendants
+// (this happens for queried operators).
+PoolAdjacency make_pool_adjacency(
+    size_t num_nodes,
+    const std::vector<const std::vector<std::vector<Node*>>*>& affected) {
+  size_t pool_size = affected.front()->size();
+  // inv : node id -> pool positions affecting it, also in CSR form
+  std::vector<size_t> inv_offsets(num_nodes + 1, 0);
+  for (auto sets : affected) {
+    for (const auto& nodes : *sets) {
+      for (const Node* node : nodes) {
+        inv_offsets[node->index + 1]++;
       }
     }
   }
-  // markov_blanket of a node is the set of other nodes whose conditional
-  // probability changes when the value of this node changes. This is a
-  // symmetric relation and we only track it for the subset of nodes that
-  // are in the pool of variables to be inferred over.
-  // Formally, x in markov_blanket[y]
-  //                <==> exists z s.t. z in sto_desc[x] and z in sto_desc[y]
-  // Note: x is in markov_blanket[x]
-  std::map<uint, std::set<uint>> markov_blanket;
-  for (auto it = inv_sto.begin(); it != inv_sto.end(); ++it) {
-    for (auto it1 = it->second.begin(); it1 != it->second.end(); ++it1) {
-      if (markov_blanket.find(*it1) == markov_blanket.end()) {
-        markov_blanket[*it1] = std::set<uint>();
+  for (size_t id = 0; id < num_nodes; id++) {
+    inv_offsets[id + 1] += inv_offsets[id];
+  }
+  std::vector<uint> inv_indices(inv_offsets.back());
+  std::vector<size_t> fill(inv_offsets.begin(), inv_offsets.end() - 1);
+  for (auto sets : affected) {
+    for (uint i = 0; i < static_cast<uint>(pool_size); i++) {
+      for (const Node* node : (*sets)[i]) {
+        inv_indices[fill[node->index]++] = i;
       }
-      for (auto it2 = it1; it2 != it->second.end(); ++it2) {
-        markov_blanket[*it1].insert(*it2);
-        if (markov_blanket.find(*it2) == markov_blanket.end()) {
-          markov_blanket[*it2] = std::set<uint>();
+    }
+  }
+
+  PoolAdjacency result;
+  result.offsets.reserve(pool_size + 1);
+  result.offsets.push_back(0);
+  // last_seen[j] == i iff j has already been added as a neighbor of i
+  std::vector<uint> last_seen(pool_size, std::numeric_limits<uint>::max());
+  for (uint i = 0; i < static_cast<uint>(pool_size); i++) {
+    last_seen[i] = i;
+    for (auto sets : affected) {
+      for (const Node* node : (*sets)[i]) {
+        for (size_t k = inv_offsets[node->index];
+             k < inv_offsets[node->index + 1];
+             k++) {
+          uint j = inv_indices[k];
+          if (last_seen[j] != i) {
+            last_seen[j] = i;
+            result.indices.push_back(j);
+          }
         }
-        markov_blanket[*it2].insert(*it1);
       }
     }
+    result.offsets.push_back(result.indices.size());
+  }
+  return result;
+}
+
+// Greedily colors the pool so that no two conflicting positions share a color
+// and returns the color classes, each in increasing pool position order.
+std::vector<std::vector<uint>> color_pool(const PoolAdjacency& conflicts) {
+  size_t pool_size = conflicts.offsets.size() - 1;
+  std::vector<uint> color(pool_size, std::numeric_limits<uint>::max());
+  // used[c] == i iff color c is taken by a neighbor of i
+  std::vector<uint> used;
+  std::vector<std::vector<uint>> classes;
+  for (uint i = 0; i < static_cast<uint>(pool_size); i++) {
+    for (const uint* j = conflicts.begin(i); j != conflicts.end(i); ++j) {
+      if (color[*j] < used.size()) {
+        used[color[*j]] = i;
+      }
+    }
+    uint c = 0;
+    while (c < used.size() and used[c] == i) {
+      c++;
+    }
+    if (c == used.size()) {
+      used.push_back(std::numeric_limits<uint>::max());
+      classes.emplace_back();
+    }
+    color[i] = c;
+    classes[c].push_back(i);
+  }
+  return classes;
+}
+
+// Performs Metropolized Gibbs updates of the boolean nodes in the pool,
+// always proposing to flip the current value. The log odds of keeping the
+// current value are cached per pool position until some node in its Markov
+// blanket changes value.
+class GibbsSiteUpdater {
+ public:
+  GibbsSiteUpdater(
+      const std::vector<Node*>& pool,
+      const std::vector<std::vector<Node*>>& det_nodes,
+      const std::vector<std::vector<Node*>>& sto_nodes,
+      size_t num_nodes)
+      : pool(pool),
+        det_nodes(det_nodes),
+        sto_nodes(sto_nodes),
+        cache_logodds(pool.size(), NAN), // nan => needs to be re-computed
+        old_values(num_nodes) {}
+
+  // Updates the node at pool position i and returns whether its value
+  // changed, in which case the caller must call invalidate on its Markov
+  // blanket.
+  bool update(uint i, std::mt19937& gen) {
+    bool must_change = false; // must_change => must change current value
+    // if we have a cached value of the transition odds then use that instead
+    if (not std::isnan(cache_logodds[i])) {
+      // do we keep the current value?
+      if (util::sample_logodds(gen, cache_logodds[i])) {
+        return false;
+      } else {
+        must_change = true;
+      }
+    }
+    const std::vector<Node*>& det = det_nodes[i];
+    const std::vector<Node*>& sto = sto_nodes[i];
+    Node* tgt_node = pool[i];
+    assert(tgt_node == sto.front());
+    // now, compute the probability of all the stochastic nodes that are
+    // going to be affected when we change the value of the target node
+    double old_logweight = 0;
+    for (const Node* node : sto) {
+      old_logweight += node->log_prob();
+    }
+    // save the values of the deterministic descendants of the target node
+    // as well the target node itself
+    for (const Node* node : det) {
+      old_values[node->index] = node->value;
+    }
+    old_values[tgt_node->index] = tgt_node->value;
+    // propose a new value for the target node and update all the
+    // deterministic children
+    tgt_node->value._bool = not tgt_node->value._bool; // flip
+    for (Node* node : det) {
+      node->eval(gen);
+    }
+    // compute the probability of the stochastic nodes with the new value
+    // of the target node
+    double new_logweight = 0;
+    for (const Node* node : sto) {
+      new_logweight += node->log_prob();
+    }
+    // compute logodds of keeping the current value
+    double logodds = old_logweight - new_logweight;
+    // Time to make a decision! Do we keep the old value or pick a new value.
+    if ((not must_change) and util::sample_logodds(gen, logodds)) {
+      // if the move to the new value is rejected then we need to restore
+      // all the deterministic decendants and the target node to original
+      // values
+      for (Node* node : det) {
+        node->value = old_values[node->index];
+      }
+      tgt_node->value = old_values[tgt_node->index];
+      cache_logodds[i] = logodds;
+      return false;
+    }
+    cache_logodds[i] = -logodds;
+    return true;
+  }
+
+  // Invalidates the cached log odds of the Markov blanket of pool position i
+  // after it has changed value. Its own cache remains valid.
+  void invalidate(uint i, const PoolAdjacency& markov_blanket) {
+    for (const uint* j = markov_blanket.begin(i); j != markov_blanket.end(i);
+         ++j) {
+      cache_logodds[*j] = NAN;
+    }
+  }
+
+ private:
+  const std::vector<Node*>& pool;
+  const std::vector<std::vector<Node*>>& det_nodes;
+  const std::vector<std::vector<Node*>>& sto_nodes;
+  // cache_logodds : pool position -> log odds of not changing
+  std::vector<double> cache_logodds;
+  // old_values : node id -> value saved during a proposal
+  std::vector<NodeValue> old_values;
+};
+
+} // namespace
+
+Gibbs::Gibbs(Graph* graph, uint seed)
+    : MH(graph,
+         seed,
+         new SequentialSingleSiteStepper(
+             this,
+             std::vector<SingleSiteSteppingMethod*>{
+                 new GibbsEnumerationSingleSiteSteppingMethod(this)})) {}
+// Ok to allocate and not delete the stepper because MH takes ownership
+// of its stepper.
+
+Gibbs::~Gibbs() {}
+
+std::string Gibbs::is_not_supported(Node* node) {
+  if (node->value.type.variable_type != VariableType::SCALAR or
+      (node->value.type != AtomicType::BOOLEAN and
+       node->value.type != AtomicType::NATURAL) or
+      static_cast<distribution::Distribution*>(node->in_nodes[0])
+              ->finite_support_size() == 0) {
+    return "all stochastic random variables should be boolean or natural with finite support -- failing on node " +
+        std::to_string(node->index);
+  } else {
+    return "";
+  }
+}
+
+// TODO: move this inference method out of Graph.
+void Graph::gibbs(uint num_samples, uint seed, InferConfig infer_config) {
+  const std::vector<Node*>& pool = unobserved_sto_mutable_support();
+  // Categorical, binomial and other finitely supported natural variables are
+  // sampled from their enumerated full conditionals; the rest of this
+  // function is specialized to the common case of boolean variables.
+  for (const Node* node : pool) {
+    if (node->value.type != AtomicType::BOOLEAN) {
+      Gibbs(this, seed).infer(num_samples, infer_config);
+      return;
+    }
   }
-  std::vector<NodeValue> old_values = std::vector<NodeValue>(nodes.size());
-  assert(old_values.size() > 0); // keep linter happy
-  // convert the smart pointers in nodes to dumb pointers in node_ptrs
-  // for faster access
-  std::vector<Node*> node_ptrs;
-  for (uint node_id = 0; node_id < static_cast<uint>(nodes.size()); node_id++) {
-    node_ptrs.push_back(nodes[node_id].get());
-  }
-  assert(node_ptrs.size() > 0); // keep linter happy
-  // sampling outer loop
-  for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
-    for (auto it = pool.begin(); it != pool.end(); ++it) {
-      bool must_change = false; // must_change => must change current value
-      // if we have a cached value of the transition odds then use that instead
-      if (not std::isnan(cache_logodds[it->first])) {
-        // do we keep the current value?
-        if (util::sample_logodds(gen, cache_logodds[it->first])) {
-          continue;
-        } else {
-          must_change = true;
+  std::mt19937 gen(seed);
+  // eval each node so that we have a starting value
+  for (Node* node : unobserved_mutable_support()) {
+    node->eval(gen);
+  }
+  // for each node in the pool, its deterministic and stochastic affected
+  // nodes are cached by the graph and indexed by pool position
+  const auto& det_nodes = det_affected_mutable_nodes();
+  const auto& sto_nodes = sto_affected_nodes();
+  // markov_blanket of a node is the set of other nodes whose conditional
+  // probability changes when the value of this node changes.
+  PoolAdjacency markov_blanket =
+      make_pool_adjacency(nodes.size(), {&sto_nodes});
+  GibbsSiteUpdater updater(pool, det_nodes, sto_nodes, nodes.size());
+  uint pool_size = static_cast<uint>(pool.size());
+  uint num_threads = std::min(infer_config.num_threads, pool_size);
+
+  if (num_threads <= 1) {
+    // sampling outer loop
+    for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
+      for (uint i = 0; i < pool_size; i++) {
+        if (updater.update(i, gen)) {
+          // if we change the value of this node then all the other nodes in
+          // the pool that depend on this need to be recomputed
+          updater.invalidate(i, markov_blanket);
         }
       }
-      // for the target sampled node grab its deterministic and stochastic
-      // children
-      // the following dance of getting into a tuple is needed because this
-      // version of C++ doesn't have structured bindings
-      std::tuple<const std::vector<uint>&, const std::vector<uint>&> tmp_tuple =
-          it->second;
-      const std::vector<uint>& det_nodes = std::get<0>(tmp_tuple);
-      const std::vector<uint>& sto_nodes = std::get<1>(tmp_tuple);
-      assert(it->first == sto_nodes.front());
-      // now, compute the probability of all the stochastic nodes that are
-      // going to be affected when we change the value of the target node
-      double old_logweight = 0;
-      for (uint node_id : sto_nodes) {
-        const Node* node = node_ptrs[node_id];
-        old_logweight += node->log_prob();
+      if (infer_config.keep_log_prob) {
+        collect_log_prob(full_log_prob());
       }
-      // save the values of the deterministic descendants of the target node
-      // as well the target node itself
-      for (uint node_id : det_nodes) {
-        const Node* node = node_ptrs[node_id];
-        old_values[node_id] = node->value;
+      if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+        collect_sample();
       }
-      Node* tgt_node = node_ptrs[it->first];
-      old_values[it->first] = tgt_node->value;
-      // propose a new value for the target node and update all the
-      // deterministic children note: assuming only boolean values
-      if (tgt_node->value.type != AtomicType::BOOLEAN) {
-        throw std::runtime_error(
-            "all stochastic random variables should be boolean");
+    }
+    return;
+  }
+
+  // Graph-colored parallel sweeps: pool nodes with the same color share no
+  // affected nodes, so they are conditionally independent given the rest of
+  // the pool and can be updated concurrently. Each sweep updates the colors
+  // in turn; the cached log odds of the Markov blankets of changed nodes are
+  // invalidated between colors (the blanket of a node never contains nodes
+  // of its own color).
+  PoolAdjacency conflicts =
+      make_pool_adjacency(nodes.size(), {&sto_nodes, &det_nodes});
+  std::vector<std::vector<uint>> color_classes = color_pool(conflicts);
+  std::vector<char> changed(pool_size, false);
+  std::vector<std::mt19937> generators;
+  for (uint t = 0; t < num_threads; t++) {
+    generators.emplace_back(gen());
+  }
+
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception = nullptr;
+  std::mutex exception_mutex;
+  auto record_exception = [&]() {
+    std::lock_guard<std::mutex> lock(exception_mutex);
+    if (exception == nullptr) {
+      exception = std::current_exception();
+    }
+    failed = true;
+  };
+
+  uint color = 0;
+  uint snum = 0;
+  auto end_of_color = [&]() noexcept {
+    for (uint i : color_classes[color]) {
+      if (changed[i]) {
+        updater.invalidate(i, markov_blanket);
+        changed[i] = false;
       }
-      tgt_node->value._bool = not tgt_node->value._bool; // flip
-      for (uint node_id : det_nodes) {
-        Node* node = node_ptrs[node_id];
-        node->eval(gen);
+    }
+    if (++color < color_classes.size()) {
+      return;
+    }
+    color = 0;
+    try {
+      if (infer_config.keep_log_prob) {
+        collect_log_prob(full_log_prob());
       }
-      // compute the probability of the stochastic nodes with the new value
-      // of the target node
-      double new_logweight = 0;
-      for (uint node_id : sto_nodes) {
-        const Node* node = node_ptrs[node_id];
-        new_logweight += node->log_prob();
+      if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+        collect_sample();
       }
-      // compute logodds of keeping the current value
-      double logodds = old_logweight - new_logweight;
-      // Time to make a decision! Do we keep the old value or pick a new value.
-      if ((not must_change) and util::sample_logodds(gen, logodds)) {
-        // if the move to the new value is rejected then we need to restore
-        // all the deterministic decendants and the target node to original
-        // values
-        for (uint node_id : det_nodes) {
-          Node* node = node_ptrs[node_id];
-          node->value = old_values[node_id];
+    } catch (...) {
+      record_exception();
+    }
+    snum++;
+  };
+  std::barrier sync(num_threads, end_of_color);
+
+  auto worker = [&](uint t) {
+    for (uint s = 0; s < num_samples + infer_config.num_warmup; s++) {
+      for (const auto& color_class : color_classes) {
+        if (not failed) {
+          try {
+            size_t begin = color_class.size() * t / num_threads;
+            size_t end = color_class.size() * (t + 1) / num_threads;
+            for (size_t k = begin; k < end; k++) {
+              uint i = color_class[k];
+              changed[i] = updater.update(i, generators[t]);
+            }
+          } catch (...) {
+            record_exception();
+          }
         }
-        tgt_node->value = old_values[it->first];
-        cache_logodds[it->first] = logodds;
-      } else {
-        // if we change the value of this node then all the other nodes in the
-        // pool that depend on this need to be recomputed
-        for (uint node_id : markov_blanket[it->first]) {
-          cache_logodds[node_id] = NAN;
+        sync.arrive_and_wait();
+        if (failed) {
+          return;
         }
-        cache_logodds[it->first] = -logodds;
       }
     }
-    if (infer_config.keep_log_prob) {
-      collect_log_prob(full_log_prob());
-    }
-    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
-      collect_sample();
-    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint t = 1; t < num_threads; t++) {
+    threads.emplace_back(worker, t);
+  }
+  worker(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (exception != nullptr) {
+    std::rethrow_exception(exception);
   }
 }
 
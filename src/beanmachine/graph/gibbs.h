@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <string>
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/mh.h"
+
+namespace beanmachine {
+namespace graph {
+
+// Gibbs sampling over discrete random variables with finite support,
+// sampling each of them in turn from its full conditional distribution
+// (see GibbsEnumerationSingleSiteSteppingMethod).
+// Graph::gibbs uses this for graphs with non-boolean random variables;
+// purely boolean graphs take a specialized path.
+class Gibbs : public MH {
+ public:
+  virtual ~Gibbs();
+
+  Gibbs(Graph* graph, uint seed);
+
+  virtual std::string is_not_supported(Node* node) override;
+};
+
+} // namespace graph
+} // namespace beanmachine
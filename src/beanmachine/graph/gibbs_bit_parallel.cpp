@@ -0,0 +1,526 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/operator/operator.h"
+#include "beanmachine/graph/util.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+using Word = std::uint64_t;
+constexpr uint LANES = 64; // one chain per bit of a Word
+using Lanes = std::array<double, LANES>;
+
+inline bool bit(Word word, uint lane) {
+  return (word >> lane) & 1;
+}
+
+enum class LaneKind { NONE, BOOLEAN, REAL };
+
+LaneKind lane_kind(const Node* node) {
+  const ValueType& type = node->value.type;
+  if (type.variable_type != VariableType::SCALAR) {
+    return LaneKind::NONE;
+  }
+  switch (type.atomic_type) {
+    case AtomicType::BOOLEAN:
+      return LaneKind::BOOLEAN;
+    case AtomicType::REAL:
+    case AtomicType::POS_REAL:
+    case AtomicType::NEG_REAL:
+    case AtomicType::PROBABILITY:
+      return LaneKind::REAL;
+    default:
+      return LaneKind::NONE;
+  }
+}
+
+// The values of the support nodes in all chains at once.
+// A boolean node is a single Word holding its value in chain c at bit c,
+// so that boolean operators act on all chains with one instruction.
+// A real-valued node holds one double per chain in a contiguous block of
+// LANES doubles, so that arithmetic operators are simple loops the compiler
+// vectorizes.
+class BitParallelWorld {
+ public:
+  BitParallelWorld(const std::vector<Node*>& node_ptrs, const Support& support)
+      : kinds(node_ptrs.size(), LaneKind::NONE),
+        words(node_ptrs.size(), 0),
+        slots(node_ptrs.size(), std::numeric_limits<uint>::max()),
+        table_offsets(node_ptrs.size(), 0) {
+    for (NodeID node_id : support) {
+      const Node* node = node_ptrs[node_id];
+      switch (node->node_type) {
+        case NodeType::CONSTANT:
+          add_constant(node);
+          break;
+        case NodeType::DISTRIBUTION:
+          add_distribution(node);
+          break;
+        case NodeType::OPERATOR:
+          add_operator(node);
+          break;
+        default:
+          throw std::invalid_argument(
+              "bit-parallel Gibbs does not support node " +
+              std::to_string(node_id) + " of this type");
+      }
+    }
+  }
+
+  Word& bits(const Node* node) {
+    return words[node->index];
+  }
+
+  double* lanes(const Node* node) {
+    return reals.data() + static_cast<size_t>(slots[node->index]) * LANES;
+  }
+
+  // Queries are read back from the words or lanes of each chain, so they
+  // must be scalar boolean or real-valued nodes of the world.
+  void check_query(const Node* node) const {
+    LaneKind kind = kinds[node->index];
+    bool has_lanes = slots[node->index] != std::numeric_limits<uint>::max();
+    if (kind == LaneKind::BOOLEAN or (kind == LaneKind::REAL and has_lanes)) {
+      return;
+    }
+    throw std::invalid_argument(
+        "bit-parallel Gibbs does not support query of node_id " +
+        std::to_string(node->index) + " of type " +
+        node->value.type.to_string());
+  }
+
+  // Deterministic operators.
+  void eval(const Node* node) {
+    const auto& in = node->in_nodes;
+    auto op_type = static_cast<const oper::Operator*>(node)->op_type;
+    if (kinds[node->index] == LaneKind::BOOLEAN) {
+      Word& out = bits(node);
+      switch (op_type) {
+        case OperatorType::COMPLEMENT:
+          out = ~bits(in[0]);
+          break;
+        case OperatorType::MULTIPLY: // conjunction
+          out = ~Word(0);
+          for (const Node* parent : in) {
+            out &= bits(parent);
+          }
+          break;
+        case OperatorType::IF_THEN_ELSE: {
+          Word cond = bits(in[0]);
+          out = (cond & bits(in[1])) | (~cond & bits(in[2]));
+          break;
+        }
+        default:
+          assert(false);
+      }
+      return;
+    }
+    double* out = lanes(node);
+    switch (op_type) {
+      case OperatorType::TO_REAL:
+      case OperatorType::TO_POS_REAL:
+        if (kinds[in[0]->index] == LaneKind::BOOLEAN) {
+          Word word = bits(in[0]);
+          for (uint c = 0; c < LANES; c++) {
+            out[c] = bit(word, c) ? 1.0 : 0.0;
+          }
+        } else {
+          std::copy_n(lanes(in[0]), LANES, out);
+        }
+        break;
+      case OperatorType::COMPLEMENT: {
+        const double* x = lanes(in[0]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = 1 - x[c];
+        }
+        break;
+      }
+      case OperatorType::NEGATE: {
+        const double* x = lanes(in[0]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = -x[c];
+        }
+        break;
+      }
+      case OperatorType::ADD: {
+        std::copy_n(lanes(in[0]), LANES, out);
+        for (size_t i = 1; i < in.size(); i++) {
+          const double* x = lanes(in[i]);
+          for (uint c = 0; c < LANES; c++) {
+            out[c] += x[c];
+          }
+        }
+        break;
+      }
+      case OperatorType::MULTIPLY: {
+        std::copy_n(lanes(in[0]), LANES, out);
+        for (size_t i = 1; i < in.size(); i++) {
+          const double* x = lanes(in[i]);
+          for (uint c = 0; c < LANES; c++) {
+            out[c] *= x[c];
+          }
+        }
+        break;
+      }
+      case OperatorType::IF_THEN_ELSE: {
+        Word cond = bits(in[0]);
+        const double* x = lanes(in[1]);
+        const double* y = lanes(in[2]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = bit(cond, c) ? x[c] : y[c];
+        }
+        break;
+      }
+      case OperatorType::EXP: {
+        const double* x = lanes(in[0]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = std::exp(x[c]);
+        }
+        break;
+      }
+      case OperatorType::LOG: {
+        const double* x = lanes(in[0]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = std::log(x[c]);
+        }
+        break;
+      }
+      case OperatorType::LOGISTIC: {
+        // same boundary checks as NodeValue(AtomicType::PROBABILITY, ...)
+        const double* x = lanes(in[0]);
+        for (uint c = 0; c < LANES; c++) {
+          out[c] = std::clamp(util::logistic(x[c]), PRECISION, 1 - PRECISION);
+        }
+        break;
+      }
+      default:
+        assert(false);
+    }
+  }
+
+  // Probability of a sample of `dist` being true, per chain.
+  void prob_true(const Node* dist, double* p) {
+    switch (static_cast<const distribution::Distribution*>(dist)->dist_type) {
+      case DistributionType::BERNOULLI:
+        std::copy_n(lanes(dist->in_nodes[0]), LANES, p);
+        break;
+      case DistributionType::BERNOULLI_NOISY_OR: {
+        const double* param = lanes(dist->in_nodes[0]);
+        for (uint c = 0; c < LANES; c++) {
+          p[c] = -std::expm1(-param[c]);
+        }
+        break;
+      }
+      case DistributionType::TABULAR: {
+        std::array<uint, LANES> cols;
+        tabular_columns(dist, cols);
+        const double* table = tables.data() + table_offsets[dist->index];
+        for (uint c = 0; c < LANES; c++) {
+          p[c] = std::exp(table[2 * cols[c] + 1]);
+        }
+        break;
+      }
+      default:
+        assert(false);
+    }
+  }
+
+  // Adds the log probability of the value of sample node `node` in each chain
+  // to `log_probs`.
+  void add_log_prob(const Node* node, double* log_probs) {
+    const Node* dist = node->in_nodes[0];
+    Word value = bits(node);
+    switch (static_cast<const distribution::Distribution*>(dist)->dist_type) {
+      case DistributionType::BERNOULLI: {
+        const double* p = lanes(dist->in_nodes[0]);
+        for (uint c = 0; c < LANES; c++) {
+          log_probs[c] += bit(value, c) ? std::log(p[c]) : std::log1p(-p[c]);
+        }
+        break;
+      }
+      case DistributionType::BERNOULLI_NOISY_OR: {
+        const double* param = lanes(dist->in_nodes[0]);
+        for (uint c = 0; c < LANES; c++) {
+          log_probs[c] +=
+              bit(value, c) ? util::log1mexp(-param[c]) : -param[c];
+        }
+        break;
+      }
+      case DistributionType::TABULAR: {
+        std::array<uint, LANES> cols;
+        tabular_columns(dist, cols);
+        const double* table = tables.data() + table_offsets[dist->index];
+        for (uint c = 0; c < LANES; c++) {
+          log_probs[c] += table[2 * cols[c] + bit(value, c)];
+        }
+        break;
+      }
+      default:
+        assert(false);
+    }
+  }
+
+ private:
+  std::vector<LaneKind> kinds; // by node id
+  std::vector<Word> words; // by node id, for boolean nodes
+  std::vector<uint> slots; // node id -> block of LANES doubles in reals
+  std::vector<double> reals;
+  // For each TABULAR distribution (by node id), the offset in `tables` of its
+  // log probabilities, stored as (log P(false), log P(true)) per column.
+  std::vector<size_t> table_offsets;
+  std::vector<double> tables;
+
+  void add_lanes(const Node* node) {
+    slots[node->index] = static_cast<uint>(reals.size() / LANES);
+    reals.resize(reals.size() + LANES, 0.0);
+  }
+
+  void add_constant(const Node* node) {
+    kinds[node->index] = lane_kind(node);
+    switch (kinds[node->index]) {
+      case LaneKind::BOOLEAN:
+        bits(node) = node->value._bool ? ~Word(0) : Word(0);
+        break;
+      case LaneKind::REAL:
+        add_lanes(node);
+        std::fill_n(lanes(node), LANES, node->value._double);
+        break;
+      default:
+        // only used as parameters of distributions, which check them
+        break;
+    }
+  }
+
+  void add_distribution(const Node* node) {
+    auto dist = static_cast<const distribution::Distribution*>(node);
+    switch (dist->dist_type) {
+      case DistributionType::BERNOULLI:
+      case DistributionType::BERNOULLI_NOISY_OR:
+        check_in_node_kind(node, node->in_nodes[0], LaneKind::REAL);
+        break;
+      case DistributionType::TABULAR: {
+        for (size_t i = 1; i < node->in_nodes.size(); i++) {
+          check_in_node_kind(node, node->in_nodes[i], LaneKind::BOOLEAN);
+        }
+        const Eigen::MatrixXd& matrix = node->in_nodes[0]->value._matrix;
+        table_offsets[node->index] = tables.size();
+        for (Eigen::Index col = 0; col < matrix.cols(); col++) {
+          tables.push_back(std::log(matrix.coeff(0, col)));
+          tables.push_back(std::log(matrix.coeff(1, col)));
+        }
+        break;
+      }
+      default:
+        throw std::invalid_argument(
+            "bit-parallel Gibbs only supports BERNOULLI, "
+            "BERNOULLI_NOISY_OR and TABULAR distributions");
+    }
+  }
+
+  void add_operator(const Node* node) {
+    auto op_type = static_cast<const oper::Operator*>(node)->op_type;
+    kinds[node->index] = lane_kind(node);
+    if (op_type == OperatorType::SAMPLE) {
+      // sample types are checked by the distribution
+      return;
+    }
+    LaneKind kind = kinds[node->index];
+    bool supported = false;
+    switch (op_type) {
+      case OperatorType::COMPLEMENT:
+      case OperatorType::MULTIPLY:
+      case OperatorType::IF_THEN_ELSE:
+        supported = kind != LaneKind::NONE;
+        break;
+      case OperatorType::TO_REAL:
+      case OperatorType::TO_POS_REAL:
+      case OperatorType::NEGATE:
+      case OperatorType::ADD:
+      case OperatorType::EXP:
+      case OperatorType::LOG:
+      case OperatorType::LOGISTIC:
+        supported = kind == LaneKind::REAL;
+        break;
+      default:
+        break;
+    }
+    if (not supported) {
+      throw std::invalid_argument(
+          "bit-parallel Gibbs does not support operator " +
+          std::string(NAMEOF_ENUM(op_type)) + " at node_id " +
+          std::to_string(node->index));
+    }
+    for (size_t i = 0; i < node->in_nodes.size(); i++) {
+      const Node* parent = node->in_nodes[i];
+      bool is_condition = op_type == OperatorType::IF_THEN_ELSE and i == 0;
+      bool is_conversion = op_type == OperatorType::TO_REAL or
+          op_type == OperatorType::TO_POS_REAL;
+      if (is_conversion) {
+        check_in_node_kind(node, parent, kinds[parent->index]);
+      } else {
+        check_in_node_kind(
+            node, parent, is_condition ? LaneKind::BOOLEAN : kind);
+      }
+    }
+    if (kind == LaneKind::REAL) {
+      add_lanes(node);
+    }
+  }
+
+  void check_in_node_kind(const Node* node, const Node* parent, LaneKind kind) {
+    if (kind == LaneKind::NONE or kinds[parent->index] != kind) {
+      throw std::invalid_argument(
+          "bit-parallel Gibbs requires scalar boolean or real inputs, "
+          "but node_id " +
+          std::to_string(node->index) + " has input node_id " +
+          std::to_string(parent->index) + " of type " +
+          parent->value.type.to_string());
+    }
+  }
+
+  // Maps the parent values of a TABULAR distribution in each chain to the
+  // column of its conditional probability table, as in
+  // Tabular::get_probability (the last parent is the least significant bit).
+  void tabular_columns(const Node* dist, std::array<uint, LANES>& cols) {
+    cols.fill(0);
+    for (size_t i = 1; i < dist->in_nodes.size(); i++) {
+      Word word = bits(dist->in_nodes[i]);
+      for (uint c = 0; c < LANES; c++) {
+        cols[c] = (cols[c] << 1) | static_cast<uint>(bit(word, c));
+      }
+    }
+  }
+};
+
+} // namespace
+
+void Graph::gibbs_bit_parallel(
+    uint num_samples,
+    uint seed,
+    uint n_chains,
+    InferConfig infer_config) {
+  if (n_chains > LANES) {
+    throw std::invalid_argument(
+        "bit-parallel Gibbs supports at most " + std::to_string(LANES) +
+        " chains");
+  }
+  if (infer_config.keep_log_prob and log_prob_allchains.size() < n_chains) {
+    log_prob_allchains.resize(n_chains);
+  }
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  BitParallelWorld world(node_ptrs(), compute_support());
+  for (NodeID node_id : queries) {
+    world.check_query(node_ptrs()[node_id]);
+  }
+
+  // initialize all chains with ancestral samples of the unobserved nodes
+  Lanes probs;
+  for (Node* node : mutable_support_ptrs()) {
+    if (not node->is_stochastic()) {
+      world.eval(node);
+    } else if (node->is_observed) {
+      world.bits(node) = node->value._bool ? ~Word(0) : Word(0);
+    } else {
+      world.prob_true(node->in_nodes[0], probs.data());
+      Word word = 0;
+      for (uint c = 0; c < LANES; c++) {
+        word |= static_cast<Word>(uniform(gen) < probs[c]) << c;
+      }
+      world.bits(node) = word;
+    }
+  }
+
+  const std::vector<Node*>& pool = unobserved_sto_mutable_support();
+  const auto& det_nodes = det_affected_mutable_nodes();
+  const auto& sto_nodes = sto_affected_nodes();
+  Lanes log_probs_false;
+  Lanes log_probs_true;
+  auto log_prob_given = [&](uint i, Word value, Lanes& log_probs) {
+    world.bits(pool[i]) = value;
+    for (const Node* node : det_nodes[i]) {
+      world.eval(node);
+    }
+    log_probs.fill(0.0);
+    for (const Node* node : sto_nodes[i]) {
+      world.add_log_prob(node, log_probs.data());
+    }
+  };
+
+  for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
+    for (uint i = 0; i < static_cast<uint>(pool.size()); i++) {
+      // sample each chain from the exact conditional of the node given its
+      // Markov blanket
+      log_prob_given(i, Word(0), log_probs_false);
+      log_prob_given(i, ~Word(0), log_probs_true);
+      Word word = 0;
+      for (uint c = 0; c < LANES; c++) {
+        double prob_true =
+            util::logistic(log_probs_true[c] - log_probs_false[c]);
+        word |= static_cast<Word>(uniform(gen) < prob_true) << c;
+      }
+      world.bits(pool[i]) = word;
+      for (const Node* node : det_nodes[i]) {
+        world.eval(node);
+      }
+    }
+
+    if (infer_config.keep_log_prob) {
+      Lanes log_probs{};
+      for (const Node* node : mutable_support_ptrs()) {
+        if (node->is_stochastic()) {
+          world.add_log_prob(node, log_probs.data());
+        }
+      }
+      for (uint c = 0; c < n_chains; c++) {
+        log_prob_allchains[c].push_back(log_probs[c]);
+      }
+    }
+    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+      for (uint c = 0; c < n_chains; c++) {
+        std::vector<NodeValue> sample;
+        for (NodeID node_id : queries) {
+          const Node* node = node_ptrs()[node_id];
+          if (lane_kind(node) == LaneKind::BOOLEAN) {
+            sample.emplace_back(bit(world.bits(node), c));
+          } else {
+            sample.emplace_back(
+                node->value.type.atomic_type, world.lanes(node)[c]);
+          }
+        }
+        if (agg_type == AggregationType::NONE) {
+          samples_allchains[c].push_back(std::move(sample));
+        } else {
+          for (size_t pos = 0; pos < sample.size(); pos++) {
+            const NodeValue& value = sample[pos];
+            means_allchains[c][pos] +=
+                (value.type == AtomicType::BOOLEAN ? double(value._bool)
+                                                   : value._double) /
+                agg_samples;
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace graph
+} // namespace beanmachine
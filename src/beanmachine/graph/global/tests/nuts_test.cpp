@@ -6,7 +6,10 @@
  */
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
 #include <memory>
+#include <random>
 #include "beanmachine/graph/global/nuts.h"
 #include "beanmachine/graph/global/tests/conjugate_util_test.h"
 #include "beanmachine/graph/graph.h"
@@ -82,3 +85,56 @@ TEST(testglobal, global_nuts_mixed) {
       multinomial_sampling);
   test_conjugate_model_moments(mh, expected_moments);
 }
+
+TEST(testglobal, DISABLED_global_nuts_observed_iid_benchmark) {
+  // Normal and Gamma latents whose observed children are IID_SAMPLEs of
+  // 100000 elements each, so that each leapfrog step is dominated by their
+  // log probs and gradients.
+  const uint size = 100000;
+  const int num_samples = 200;
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint size_node = g.add_constant_natural(size);
+  uint mu_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{zero, one});
+  uint mu = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{mu_dist});
+  uint rate_dist = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{one, one});
+  uint rate =
+      g.add_operator(OperatorType::SAMPLE, std::vector<uint>{rate_dist});
+  g.query(mu);
+  g.query(rate);
+  auto iid = [&](DistributionType type,
+                 AtomicType sample_type,
+                 const std::vector<uint>& parents) {
+    uint dist = g.add_distribution(type, sample_type, parents);
+    return g.add_operator(
+        OperatorType::IID_SAMPLE, std::vector<uint>{dist, size_node});
+  };
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<double> unif(0.05, 0.95);
+  std::poisson_distribution<natural_t> poisson(2.0);
+  Eigen::MatrixXd reals(size, 1), pos_reals(size, 1);
+  Eigen::MatrixXn naturals(size, 1);
+  for (uint i = 0; i < size; i++) {
+    reals(i) = 4 * unif(gen) - 2;
+    pos_reals(i) = 3 * unif(gen);
+    naturals(i) = poisson(gen);
+  }
+  g.observe(iid(DistributionType::NORMAL, AtomicType::REAL, {mu, one}), reals);
+  g.observe(
+      iid(DistributionType::GAMMA, AtomicType::POS_REAL, {one, rate}),
+      pos_reals);
+  g.observe(
+      iid(DistributionType::POISSON, AtomicType::NATURAL, {rate}), naturals);
+
+  NUTS nuts = NUTS(g);
+  auto start = std::chrono::steady_clock::now();
+  nuts.infer(num_samples, 23, num_samples);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << 2 * num_samples / elapsed.count() << " samples/s" << std::endl;
+}
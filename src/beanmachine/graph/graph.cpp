@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <iomanip>
+#include <limits>
 #include <random>
 #include <sstream>
 #include <stdexcept>
@@ -667,6 +668,58 @@ function<NodeID(NodeID)> Graph::remove_node(unique_ptr<Node>& node) {
   return from_old_to_new_id;
 }
 
+function<NodeID(NodeID)> Graph::remove_nodes(const set<NodeID>& node_ids) {
+  auto is_removed = [&](const Node* node) {
+    return node_ids.contains(node->index);
+  };
+  for (NodeID node_id : node_ids) {
+    check_node_id(node_id);
+    if (not all_of(
+            nodes[node_id]->out_nodes.begin(),
+            nodes[node_id]->out_nodes.end(),
+            is_removed)) {
+      throw invalid_argument(
+          "Attempt to remove node with out-nodes. Node id = " +
+          std::to_string(node_id));
+    }
+  }
+
+  auto old_size = nodes.size();
+  vector<NodeID> new_ids(old_size);
+  NodeID new_id = 0;
+  for (NodeID old_id = 0; old_id < old_size; old_id++) {
+    new_ids[old_id] = node_ids.contains(old_id) ? old_size : new_id++;
+  }
+
+  for (auto& node : nodes) {
+    if (not is_removed(node.get())) {
+      erase_if(node->out_nodes, is_removed);
+    }
+  }
+  erase_if(queries, [&](NodeID id) { return node_ids.contains(id); });
+  for (NodeID& id : queries) {
+    id = new_ids[id];
+  }
+  erase_if(nodes, [&](const unique_ptr<Node>& node) {
+    return is_removed(node.get());
+  });
+
+  update_structure_based_properties();
+
+  return [new_ids{std::move(new_ids)}, old_size](NodeID id) {
+    if (id >= old_size) {
+      throw invalid_argument(
+          "Looking up new id for old id that is actually greater than maximum old id.");
+    }
+    if (new_ids[id] == old_size) {
+      throw invalid_argument(
+          "Looking up new id for old id after removed graph node "
+          "but given id is the one for a removed node");
+    }
+    return new_ids[id];
+  };
+}
+
 void Graph::replace_edges(
     Node* node,
     const Node* old_in_node,
@@ -1065,6 +1118,10 @@ void Graph::add_observe(Node* node, NodeValue value) {
   // for validity.
   node->value = value;
   node->is_observed = true;
+  if (node->node_type == NodeType::OPERATOR and
+      static_cast<oper::Operator*>(node)->op_type == OperatorType::IID_SAMPLE) {
+    static_cast<oper::IIdSample*>(node)->update_sufficient_statistics();
+  }
   observed.insert(node->index);
   ready_for_evaluation_and_inference = false;
   support_cache_is_valid = false;
@@ -1171,6 +1228,43 @@ vector<vector<double>>& Graph::get_log_prob() {
   return log_prob_allchains;
 }
 
+void Graph::collect_log_weight(double log_weight) {
+  auto& log_weight_collector = (master_graph == nullptr)
+      ? this->log_weight_vals
+      : master_graph->log_weights_allchains[thread_index];
+  log_weight_collector.push_back(log_weight);
+}
+
+vector<vector<double>>& Graph::get_log_weights() {
+  // like get_log_prob, single-chain inference collects into log_weight_vals
+  if (log_weight_vals.size() > 0) {
+    log_weights_allchains.clear();
+    log_weights_allchains.push_back(log_weight_vals);
+  }
+  return log_weights_allchains;
+}
+
+vector<double> Graph::get_effective_sample_size() {
+  vector<double> sizes;
+  for (const auto& log_weights : get_log_weights()) {
+    // (sum w)^2 / (sum w^2) is invariant to scaling the weights, so they are
+    // scaled by the largest one for stability
+    double max_log_weight = -std::numeric_limits<double>::infinity();
+    for (double log_weight : log_weights) {
+      max_log_weight = std::max(max_log_weight, log_weight);
+    }
+    double sum = 0;
+    double sum_of_squares = 0;
+    for (double log_weight : log_weights) {
+      double weight = std::exp(log_weight - max_log_weight);
+      sum += weight;
+      sum_of_squares += weight * weight;
+    }
+    sizes.push_back(sum_of_squares > 0 ? sum * sum / sum_of_squares : 0);
+  }
+  return sizes;
+}
+
 void Graph::collect_sample() {
   if (agg_type == AggregationType::NONE) {
     // construct a sample of the queried nodes
@@ -1234,6 +1328,8 @@ void Graph::_infer(
     nmc(num_samples, seed, infer_config);
   } else if (algorithm == InferenceType::NUTS) {
     nuts(num_samples, seed, infer_config);
+  } else if (algorithm == InferenceType::LIKELIHOOD_WEIGHTING) {
+    likelihood_weighting(num_samples, seed, infer_config);
   } else {
     throw invalid_argument("unsupported inference algorithm.");
   }
@@ -1250,6 +1346,8 @@ Graph::infer(uint num_samples, InferenceType algorithm, uint seed) {
   samples.clear();
   log_prob_vals.clear();
   log_prob_allchains.clear();
+  log_weight_vals.clear();
+  log_weights_allchains.clear();
   _infer(num_samples, algorithm, seed, infer_config);
   _produce_performance_report(num_samples, algorithm, seed);
   return samples;
@@ -1268,6 +1366,9 @@ vector<vector<vector<NodeValue>>>& Graph::infer(
   log_prob_vals.clear();
   log_prob_allchains.clear();
   log_prob_allchains.resize(n_chains, vector<double>());
+  log_weight_vals.clear();
+  log_weights_allchains.clear();
+  log_weights_allchains.resize(n_chains, vector<double>());
   _infer_parallel(num_samples, algorithm, seed, n_chains, infer_config);
   _produce_performance_report(num_samples, algorithm, seed);
   return samples_allchains;
@@ -1282,6 +1383,17 @@ void Graph::_infer_parallel(
   if (n_chains < 1) {
     throw runtime_error("n_chains can't be zero");
   }
+  if (algorithm == InferenceType::GIBBS and infer_config.bit_parallel_gibbs) {
+    // all chains run together in this graph, one per bit of a word
+    if (queries.size() == 0) {
+      throw runtime_error("no nodes queried for inference");
+    }
+    if (num_samples < 1) {
+      throw runtime_error("num_samples can't be zero");
+    }
+    gibbs_bit_parallel(num_samples, seed, n_chains, infer_config);
+    return;
+  }
   master_graph = this;
   thread_index = 0;
   // clone graphs
@@ -1344,6 +1456,8 @@ Graph::infer_mean(uint num_samples, InferenceType algorithm, uint seed) {
   means.resize(queries.size(), 0.0);
   log_prob_vals.clear();
   log_prob_allchains.clear();
+  log_weight_vals.clear();
+  log_weights_allchains.clear();
   _infer(num_samples, algorithm, seed, infer_config);
   return means;
 }
@@ -1362,6 +1476,10 @@ vector<vector<double>>& Graph::infer_mean(
   means_allchains.resize(n_chains, vector<double>(queries.size(), 0.0));
   log_prob_vals.clear();
   log_prob_allchains.clear();
+  log_prob_allchains.resize(n_chains, vector<double>());
+  log_weight_vals.clear();
+  log_weights_allchains.clear();
+  log_weights_allchains.resize(n_chains, vector<double>());
   _infer_parallel(num_samples, algorithm, seed, n_chains, infer_config);
   return means_allchains;
 }
@@ -1370,7 +1488,8 @@ vector<vector<double>>& Graph::variational(
     uint num_iters,
     uint steps_per_iter,
     uint seed,
-    uint elbo_samples) {
+    uint elbo_samples,
+    uint num_threads) {
   if (queries.size() == 0) {
     throw runtime_error("no nodes queried for inference");
   }
@@ -1384,7 +1503,7 @@ vector<vector<double>>& Graph::variational(
   }
   elbo_vals.clear();
   mt19937 generator(seed);
-  cavi(num_iters, steps_per_iter, generator, elbo_samples);
+  cavi(num_iters, steps_per_iter, generator, elbo_samples, num_threads);
   return variational_params; // TODO: this should have been defined as a
                              // field, but a value returned by cavi.
 }
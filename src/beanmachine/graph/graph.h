@@ -442,6 +442,7 @@ enum class InferenceType {
   GIBBS,
   NMC,
   NUTS,
+  LIKELIHOOD_WEIGHTING,
 };
 
 enum class AggregationType {
@@ -456,6 +457,15 @@ struct InferConfig {
   double step_size;
   uint num_warmup;
   bool keep_warmup;
+  // Number of worker threads used *within* a single chain by the
+  // inference methods that support it (e.g. graph-colored Gibbs sweeps and
+  // batched rejection sampling).
+  // A value of 0 or 1 runs the chain on the calling thread only.
+  uint num_threads;
+  // Multi-chain GIBBS only: run up to 64 chains together in the bits of a
+  // machine word instead of one graph copy per chain.
+  // Requires a purely boolean network (see Graph::gibbs_bit_parallel).
+  bool bit_parallel_gibbs;
 
   ~InferConfig() {}
   InferConfig(
@@ -463,12 +473,16 @@ struct InferConfig {
       double path_length = 1.0,
       double step_size = 1.0,
       uint num_warmup = 0,
-      bool keep_warmup = false)
+      bool keep_warmup = false,
+      uint num_threads = 1,
+      bool bit_parallel_gibbs = false)
       : keep_log_prob(keep_log_prob),
         path_length(path_length),
         step_size(step_size),
         num_warmup(num_warmup),
-        keep_warmup(keep_warmup) {}
+        keep_warmup(keep_warmup),
+        num_threads(num_threads),
+        bit_parallel_gibbs(bit_parallel_gibbs) {}
 };
 
 using NodeID = uint;
@@ -695,6 +709,15 @@ inline NodeID get_index(const Node* node) {
   return node->index;
 }
 
+/*
+A seed direction for Graph::compute_gradients_in_directions: moving element
+`element` of the value of the stochastic node `node` (0 for scalar nodes).
+*/
+struct GradientDirection {
+  Node* node;
+  uint element = 0;
+};
+
 class Graph {
  public:
   Graph() {}
@@ -764,7 +787,7 @@ class Graph {
 
   :param num_samples: The number of the MCMC samples.
   :param algorithm: The sampling algorithm, currently supporting REJECTION,
-                    GIBBS, and NMC.
+                    GIBBS, NMC, NUTS and LIKELIHOOD_WEIGHTING.
   :param seed: The seed provided to the random number generator.
   :returns: The posterior samples.
   */
@@ -776,7 +799,7 @@ class Graph {
 
   :param num_samples: The number of the MCMC samples of each chain.
   :param algorithm: The sampling algorithm, currently supporting REJECTION,
-                    GIBBS, and NMC.
+                    GIBBS, NMC, NUTS and LIKELIHOOD_WEIGHTING.
   :param seed: The seed provided to the random number generator of the first
                chain.
   :param n_chains: The number of MCMC chains.
@@ -803,7 +826,7 @@ class Graph {
 
   :param num_samples: The number of the MCMC samples of each chain.
   :param algorithm: The sampling algorithm, currently supporting REJECTION,
-                    GIBBS, and NMC.
+                    GIBBS, NMC, NUTS and LIKELIHOOD_WEIGHTING.
   :param seed: The seed provided to the random number generator of the first
                chain.
   :param n_chains: The number of MCMC chains.
@@ -826,6 +849,8 @@ class Graph {
   :param seed: The random number generator seed (default: 5123401)
   :param elbo_samples: The number of Monte Carlo samples to estimate the
                        ELBO (Evidence Lower Bound). Default 0 => no estimate.
+  :param num_threads: The number of threads sharing the Monte Carlo estimates
+                      of each iteration (default: 1)
   :returns: vector of parameters for each queried node;
             each parameter is itself a vector whose length depends
             on the type of the queried node
@@ -835,7 +860,8 @@ class Graph {
       uint num_iters,
       uint steps_per_iter,
       uint seed = 5123401,
-      uint elbo_samples = 0);
+      uint elbo_samples = 0,
+      uint num_threads = 1);
   std::vector<double>& get_elbo() {
     return elbo_vals;
   }
@@ -960,6 +986,17 @@ class Graph {
   */
   double full_log_prob();
   std::vector<std::vector<double>>& get_log_prob();
+  /*
+  The log importance weights of the samples of each chain of the last
+  LIKELIHOOD_WEIGHTING inference, in the order of the samples.
+  Weights are not normalized.
+  */
+  std::vector<std::vector<double>>& get_log_weights();
+  /*
+  The effective sample size (sum w)^2 / (sum w^2) of the importance weights of
+  each chain of the last LIKELIHOOD_WEIGHTING inference.
+  */
+  std::vector<double> get_effective_sample_size();
 
   // TODO: This public method returns a pointer to an internal data structure
   // of the graph; this seems like a bad idea. We need it to be public though
@@ -1011,6 +1048,16 @@ class Graph {
   std::function<NodeID(NodeID)> remove_node(NodeID node_id);
   std::function<NodeID(NodeID)> remove_node(std::unique_ptr<Node>& node);
 
+  /*
+  Removes a set of nodes from the graph at once, in time linear in the size
+  of the graph rather than in the product of the two sizes as repeated calls
+  to remove_node would take. The out-nodes of each removed node must be
+  removed as well. Unlike remove_node, this also maps the ids of the remaining
+  queried nodes to their new ids; removed nodes stop being queried.
+  Returns a function mapping original node ids to new node ids.
+  */
+  std::function<NodeID(NodeID)> remove_nodes(const std::set<NodeID>& node_ids);
+
   /*
   Replace all edges from `old_in_node` to a given 'node' by
   edges from 'new_in_node' to 'node'.
@@ -1073,20 +1120,49 @@ class Graph {
   std::vector<double> elbo_vals;
   void collect_sample();
   void rejection(uint num_samples, uint seed, InferConfig infer_config);
+  /*
+  Likelihood weighting: samples the unobserved nodes from their priors with
+  the observed nodes set to their observations, and weights each sample by
+  the likelihood of the observations (see get_log_weights). infer_mean
+  returns the weighted means of the queried nodes.
+  */
+  void likelihood_weighting(
+      uint num_samples,
+      uint seed,
+      InferConfig infer_config);
   void gibbs(uint num_samples, uint seed, InferConfig infer_config);
+  /*
+  Runs `n_chains` (at most 64) Gibbs chains simultaneously, one per bit of
+  a 64-bit word, and stores their samples in the *_allchains fields.
+  Only boolean networks are supported: stochastic nodes must be samples of
+  BERNOULLI, BERNOULLI_NOISY_OR or TABULAR distributions, and the
+  deterministic nodes between them must be simple scalar operators
+  (conversions, ADD, MULTIPLY, NEGATE, COMPLEMENT, IF_THEN_ELSE, EXP, LOG,
+  LOGISTIC).
+  :raises: std::invalid_argument if the graph is not supported.
+  */
+  void gibbs_bit_parallel(
+      uint num_samples,
+      uint seed,
+      uint n_chains,
+      InferConfig infer_config);
   void nmc(uint num_samples, uint seed, InferConfig infer_config);
   void nuts(uint num_samples, uint seed, InferConfig infer_config);
   void cavi(
       uint num_iters,
       uint steps_per_iter,
       std::mt19937& gen,
-      uint elbo_samples);
+      uint elbo_samples,
+      uint num_threads);
 
   // TODO: Review what members of this class can be made static.
 
   void collect_log_prob(double log_prob);
   std::vector<double> log_prob_vals;
   std::vector<std::vector<double>> log_prob_allchains;
+  void collect_log_weight(double log_weight);
+  std::vector<double> log_weight_vals;
+  std::vector<std::vector<double>> log_weights_allchains;
   std::map<TransformType, std::unique_ptr<Transformation>>
       common_transformations;
   void _test_backgrad(
@@ -1322,6 +1398,32 @@ class Graph {
 
   void compute_gradients(const std::vector<Node*>& det_nodes);
 
+  /*
+   Forward-mode gradients in up to m directions at once, for m one of
+   2, 4, 8 or 16. Sets grad1(j) and grad2(j) to the first and second
+   derivatives of the total log prob of sto_nodes along directions[j],
+   that is, the gradient and the diagonal of the Hessian with respect to
+   a block of up to m scalar latents (or elements of IID_SAMPLE latents).
+   Entries past directions.size() are zero.
+   det_nodes (in topological order) and sto_nodes must cover the nodes
+   affected by the directions' nodes, including those nodes themselves.
+
+   Each node carries m first and m second derivatives, one per direction,
+   so the affected subgraph is walked once. For a scalar node with k
+   varying scalar inputs, where k(k+1)/2 < m, the node's local Jacobian and
+   Hessian are read off k(k+1)/2 single-direction compute_gradients calls
+   and then applied to all m directions; other nodes are called once per
+   direction. The nodes' own grad1/grad2 (Grad1/Grad2) are used as scratch
+   space and are cleared on return.
+  */
+  template <int m>
+  void compute_gradients_in_directions(
+      const std::vector<GradientDirection>& directions,
+      const std::vector<Node*>& det_nodes,
+      const std::vector<Node*>& sto_nodes,
+      Eigen::Array<double, m, 1>& grad1,
+      Eigen::Array<double, m, 1>& grad2);
+
   void eval(const std::vector<Node*>& det_nodes);
 
   void clear_gradients(Node* node);
@@ -131,6 +131,8 @@ class Graph:
     ) -> None: ...
     def get_elbo(self) -> List[float]: ...
     def get_log_prob(self) -> List[List[float]]: ...
+    def get_log_weights(self) -> List[List[float]]: ...
+    def get_effective_sample_size(self) -> List[float]: ...
     @overload
     def infer(
         self, num_samples: int, algorithm: InferenceType = ..., seed: int = ...
@@ -184,6 +186,7 @@ class Graph:
         steps_per_iter: int,
         seed: int = ...,
         elbo_samples: int = ...,
+        num_threads: int = ...,
     ) -> List[List[float]]: ...
 
 class HMC:
@@ -198,8 +201,10 @@ class HMC:
     ) -> List[List[NodeValue]]: ...
 
 class InferConfig:
+    bit_parallel_gibbs: bool
     keep_log_prob: bool
     keep_warmup: bool
+    num_threads: int
     num_warmup: int
     path_length: float
     step_size: float
@@ -209,11 +214,23 @@ class InferConfig:
     def __init__(
         self, arg0: bool, arg1: float, arg2: float, arg3: int, arg4: bool
     ) -> None: ...
+    @overload
+    def __init__(
+        self,
+        arg0: bool,
+        arg1: float,
+        arg2: float,
+        arg3: int,
+        arg4: bool,
+        arg5: int,
+        arg6: bool,
+    ) -> None: ...
 
 class InferenceType:
     __doc__: ClassVar[str] = ...  # read-only
     __members__: ClassVar[dict] = ...  # read-only
     GIBBS: ClassVar[InferenceType] = ...
+    LIKELIHOOD_WEIGHTING: ClassVar[InferenceType] = ...
     NMC: ClassVar[InferenceType] = ...
     REJECTION: ClassVar[InferenceType] = ...
     __entries: ClassVar[dict] = ...
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "beanmachine/graph/batched_ancestral_sampler.h"
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+// Number of worlds sampled at once by each thread.
+const uint LIKELIHOOD_WEIGHTING_BATCH_SIZE = 256;
+
+double to_double(const NodeValue& value) {
+  if (value.type == AtomicType::BOOLEAN) {
+    return value._bool;
+  } else if (
+      value.type == AtomicType::REAL or value.type == AtomicType::POS_REAL or
+      value.type == AtomicType::NEG_REAL or
+      value.type == AtomicType::PROBABILITY) {
+    return value._double;
+  } else if (value.type == AtomicType::NATURAL) {
+    return static_cast<double>(value._natural);
+  }
+  throw std::runtime_error(
+      "Mean aggregation only supported for "
+      "boolean/real/probability/natural-valued nodes");
+}
+
+// Accumulates weighted sums of values given their log weights, keeping the
+// sums scaled by the largest weight seen so far to avoid overflow.
+class WeightedSums {
+ public:
+  explicit WeightedSums(size_t size) : sums(size, 0.0) {}
+
+  void add(double log_weight, const std::vector<double>& values) {
+    if (log_weight == -std::numeric_limits<double>::infinity()) {
+      return;
+    }
+    if (log_weight > max_log_weight) {
+      double scale = std::exp(max_log_weight - log_weight);
+      total *= scale;
+      for (double& sum : sums) {
+        sum *= scale;
+      }
+      max_log_weight = log_weight;
+    }
+    double weight = std::exp(log_weight - max_log_weight);
+    total += weight;
+    for (size_t i = 0; i < sums.size(); i++) {
+      sums[i] += weight * values[i];
+    }
+  }
+
+  std::vector<double> means() const {
+    if (total == 0) {
+      throw std::runtime_error(
+          "all samples have zero weight; the observations are impossible "
+          "under the prior samples");
+    }
+    std::vector<double> result;
+    for (double sum : sums) {
+      result.push_back(sum / total);
+    }
+    return result;
+  }
+
+ private:
+  double max_log_weight = -std::numeric_limits<double>::infinity();
+  double total = 0;
+  std::vector<double> sums;
+};
+
+} // namespace
+
+// TODO: move this inference method out of Graph.
+void Graph::likelihood_weighting(
+    uint num_samples,
+    uint seed,
+    InferConfig infer_config) {
+  std::mt19937 gen(seed);
+  // Only the observed and queried nodes and their ancestors need be sampled,
+  // unless the log prob of the whole graph is requested.
+  std::vector<Node*> sampled_nodes;
+  if (infer_config.keep_log_prob) {
+    sampled_nodes = node_ptrs();
+  } else {
+    std::vector<NodeID> roots(queries.begin(), queries.end());
+    roots.insert(roots.end(), observed.begin(), observed.end());
+    sampled_nodes = BatchedAncestralSampler::ancestors_of(*this, roots);
+  }
+
+  uint num_wanted = num_samples + infer_config.num_warmup;
+  uint snum = 0;
+  WeightedSums weighted_sums(queries.size());
+  std::vector<double> query_values(queries.size());
+  // collects the sample currently held by the query nodes
+  auto collect_world = [&](double log_weight, double log_prob) {
+    if (infer_config.keep_log_prob) {
+      collect_log_prob(log_prob);
+    }
+    if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+      collect_log_weight(log_weight);
+      if (agg_type == AggregationType::MEAN) {
+        for (uint j = 0; j < queries.size(); j++) {
+          query_values[j] = to_double(nodes[queries[j]]->value);
+        }
+        weighted_sums.add(log_weight, query_values);
+      } else {
+        collect_sample();
+      }
+    }
+    snum++;
+  };
+
+  if (not BatchedAncestralSampler::is_supported(sampled_nodes)) {
+    // matrix-valued operators: one world at a time
+    while (snum < num_wanted) {
+      double log_weight = 0;
+      for (Node* node : sampled_nodes) {
+        if (node->node_type != NodeType::OPERATOR) {
+          continue;
+        }
+        if (node->is_observed) {
+          log_weight += node->log_prob();
+        } else {
+          node->eval(gen);
+        }
+      }
+      collect_world(
+          log_weight, infer_config.keep_log_prob ? full_log_prob() : 0);
+    }
+  } else {
+    uint num_threads = std::max(infer_config.num_threads, 1u);
+    // values[t][i][j] : value of the j-th query in the i-th world of the
+    // last batch of thread t
+    std::vector<std::vector<std::vector<NodeValue>>> values(num_threads);
+    std::vector<std::vector<double>> log_weights(num_threads);
+    std::vector<std::vector<double>> log_probs(num_threads);
+    auto record = [&](uint t, Graph& graph, BatchedAncestralSampler& sampler) {
+      values[t].resize(sampler.batch_size());
+      log_weights[t].resize(sampler.batch_size());
+      log_probs[t].resize(sampler.batch_size());
+      for (uint w = 0; w < sampler.batch_size(); w++) {
+        sampler.load_world(w);
+        values[t][w].clear();
+        for (NodeID node_id : graph.queries) {
+          values[t][w].push_back(graph.nodes[node_id]->value);
+        }
+        log_weights[t][w] = sampler.log_weight(w);
+        if (infer_config.keep_log_prob) {
+          log_probs[t][w] = graph.full_log_prob();
+        }
+      }
+    };
+    auto collect = [&](uint t) {
+      for (uint i = 0; i < values[t].size() and snum < num_wanted; i++) {
+        for (uint j = 0; j < queries.size(); j++) {
+          nodes[queries[j]]->value = values[t][i][j];
+        }
+        collect_world(log_weights[t][i], log_probs[t][i]);
+      }
+      return snum == num_wanted;
+    };
+    BatchedAncestralSampler::sample_in_parallel(
+        *this,
+        sampled_nodes,
+        LIKELIHOOD_WEIGHTING_BATCH_SIZE,
+        BatchedAncestralSampler::Evidence::WEIGHT,
+        num_threads,
+        gen,
+        record,
+        collect);
+  }
+
+  if (agg_type == AggregationType::MEAN) {
+    auto& mean_collector = (master_graph == nullptr)
+        ? this->means
+        : master_graph->means_allchains[thread_index];
+    std::vector<double> weighted_means = weighted_sums.means();
+    for (uint j = 0; j < queries.size(); j++) {
+      mean_collector[j] += weighted_means[j];
+    }
+  }
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/operator/operator.h"
+
+namespace beanmachine::graph {
+
+using namespace std;
+
+namespace {
+
+// The derivatives of a node's value along each of m directions.
+// Scalar nodes use grad1 and grad2, matrix nodes use Grad1 and Grad2.
+template <int m>
+struct DirectionalGradients {
+  Eigen::Array<double, m, 1> grad1 = Eigen::Array<double, m, 1>::Zero();
+  Eigen::Array<double, m, 1> grad2 = Eigen::Array<double, m, 1>::Zero();
+  vector<Eigen::MatrixXd> Grad1;
+  vector<Eigen::MatrixXd> Grad2;
+};
+
+template <int m>
+using GradientMap = unordered_map<const Node*, DirectionalGradients<m>>;
+
+inline bool is_scalar(const Node* node) {
+  return node->value.type.variable_type == VariableType::SCALAR;
+}
+
+// Exchanges the node's single-direction gradients with those of direction j.
+// Swapping twice restores both, and dynamic matrices are swapped in O(1).
+template <int m>
+void swap_direction(Node* node, DirectionalGradients<m>& gradients, int j) {
+  if (is_scalar(node)) {
+    std::swap(node->grad1, gradients.grad1(j));
+    std::swap(node->grad2, gradients.grad2(j));
+  } else {
+    node->Grad1.swap(gradients.Grad1[j]);
+    node->Grad2.swap(gradients.Grad2[j]);
+  }
+}
+
+// The distinct in-nodes of `node` with non-zero directional gradients.
+template <int m>
+vector<Node*> varying_in_nodes(const Node* node, const GradientMap<m>& map) {
+  vector<Node*> result;
+  for (Node* in_node : node->in_nodes) {
+    if (map.count(in_node) != 0 and
+        std::find(result.begin(), result.end(), in_node) == result.end()) {
+      result.push_back(in_node);
+    }
+  }
+  return result;
+}
+
+inline bool all_scalar(const vector<Node*>& nodes) {
+  return std::all_of(nodes.begin(), nodes.end(), is_scalar);
+}
+
+/*
+Applies a scalar function of the scalar `inputs`, available only as the
+single-direction forward mode `probe` (which returns the first and second
+derivatives given the inputs' grad1 and grad2), to all m directions.
+Since probe computes
+  d1 = J g1
+  d2 = g1' H g1 + J g2
+for the local Jacobian J and Hessian H, seeding the unit vectors and their
+pairwise sums recovers J and H in k(k+1)/2 calls for k inputs.
+The inputs' grad1 and grad2 are left at zero.
+*/
+template <int m, class Probe>
+void apply_local_derivatives(
+    const vector<Node*>& inputs,
+    const GradientMap<m>& map,
+    Probe probe,
+    Eigen::Array<double, m, 1>& d1,
+    Eigen::Array<double, m, 1>& d2) {
+  auto k = static_cast<uint>(inputs.size());
+  for (Node* input : inputs) {
+    input->grad1 = 0;
+    input->grad2 = 0;
+  }
+  vector<double> jacobian(k);
+  vector<double> hessian_diagonal(k);
+  for (uint a = 0; a < k; a++) {
+    inputs[a]->grad1 = 1;
+    std::tie(jacobian[a], hessian_diagonal[a]) = probe();
+    inputs[a]->grad1 = 0;
+    const auto& g = map.at(inputs[a]);
+    d1 += jacobian[a] * g.grad1;
+    d2 += jacobian[a] * g.grad2 + hessian_diagonal[a] * g.grad1.square();
+  }
+  for (uint a = 0; a < k; a++) {
+    for (uint b = a + 1; b < k; b++) {
+      inputs[a]->grad1 = 1;
+      inputs[b]->grad1 = 1;
+      double hessian_ab =
+          (probe().second - hessian_diagonal[a] - hessian_diagonal[b]) / 2;
+      inputs[a]->grad1 = 0;
+      inputs[b]->grad1 = 0;
+      d2 += 2 * hessian_ab * map.at(inputs[a]).grad1 * map.at(inputs[b]).grad1;
+    }
+  }
+}
+
+template <int m>
+inline bool use_local_derivatives(const vector<Node*>& inputs) {
+  auto k = inputs.size();
+  return all_scalar(inputs) and k * (k + 1) / 2 < static_cast<size_t>(m);
+}
+
+} // namespace
+
+template <int m>
+void Graph::compute_gradients_in_directions(
+    const vector<GradientDirection>& directions,
+    const vector<Node*>& det_nodes,
+    const vector<Node*>& sto_nodes,
+    Eigen::Array<double, m, 1>& grad1,
+    Eigen::Array<double, m, 1>& grad2) {
+  if (directions.size() > static_cast<size_t>(m)) {
+    throw invalid_argument(
+        "compute_gradients_in_directions given more directions than m");
+  }
+  pd_begin(ProfilerEvent::NMC_COMPUTE_GRADS);
+  grad1.setZero();
+  grad2.setZero();
+  GradientMap<m> map;
+
+  // seed the directions
+  for (uint j = 0; j < directions.size(); j++) {
+    Node* node = directions[j].node;
+    auto& gradients = map[node];
+    if (is_scalar(node)) {
+      gradients.grad1(j) = 1;
+    } else {
+      if (gradients.Grad1.empty()) {
+        auto zero = Eigen::MatrixXd::Zero(
+            node->value._matrix.rows(), node->value._matrix.cols());
+        gradients.Grad1.assign(m, zero);
+        gradients.Grad2.assign(m, zero);
+      }
+      gradients.Grad1[j](directions[j].element) = 1;
+    }
+  }
+
+  for (Node* node : det_nodes) {
+    auto inputs = varying_in_nodes(node, map);
+    if (inputs.empty()) {
+      continue;
+    }
+    auto& gradients = map[node];
+    if (is_scalar(node) and use_local_derivatives<m>(inputs)) {
+      auto probe = [node]() {
+        node->compute_gradients();
+        return make_pair(node->grad1, node->grad2);
+      };
+      apply_local_derivatives<m>(
+          inputs, map, probe, gradients.grad1, gradients.grad2);
+      continue;
+    }
+    if (not is_scalar(node)) {
+      gradients.Grad1.resize(m);
+      gradients.Grad2.resize(m);
+    }
+    for (int j = 0; j < m; j++) {
+      for (Node* input : inputs) {
+        swap_direction(input, map[input], j);
+      }
+      node->compute_gradients();
+      for (Node* input : inputs) {
+        swap_direction(input, map[input], j);
+      }
+      if (is_scalar(node)) {
+        gradients.grad1(j) = node->grad1;
+        gradients.grad2(j) = node->grad2;
+      } else {
+        gradients.Grad1[j] = node->Grad1;
+        gradients.Grad2[j] = node->Grad2;
+      }
+    }
+  }
+
+  for (Node* node : sto_nodes) {
+    // The derivative through the node's own value, which only moves along
+    // the directions seeded at the node. As explained in
+    // StochasticOperator::gradient_log_prob, the parameters do not move
+    // along those directions, so no mixed terms arise.
+    const auto dist =
+        static_cast<const distribution::Distribution*>(node->in_nodes[0]);
+    for (uint j = 0; j < directions.size(); j++) {
+      if (directions[j].node != node) {
+        continue;
+      }
+      if (is_scalar(node)) {
+        node->gradient_log_prob(node, grad1(j), grad2(j));
+      } else if (
+          static_cast<oper::Operator*>(node)->op_type ==
+          OperatorType::IID_SAMPLE) {
+        // the elements are independent given the parameters
+        NodeValue element(
+            node->value.type.atomic_type,
+            node->value._matrix(directions[j].element));
+        dist->gradient_log_prob_value(element, grad1(j), grad2(j));
+      } else {
+        throw invalid_argument(
+            "compute_gradients_in_directions supports directions in scalar "
+            "and IID_SAMPLE nodes only");
+      }
+    }
+
+    // The derivative through the parameters.
+    auto inputs = varying_in_nodes(dist, map);
+    if (inputs.empty()) {
+      continue;
+    }
+    if (use_local_derivatives<m>(inputs)) {
+      auto probe = [node]() {
+        double d1 = 0;
+        double d2 = 0;
+        node->gradient_log_prob(nullptr, d1, d2);
+        return make_pair(d1, d2);
+      };
+      apply_local_derivatives<m>(inputs, map, probe, grad1, grad2);
+      continue;
+    }
+    for (int j = 0; j < m; j++) {
+      for (Node* input : inputs) {
+        swap_direction(input, map[input], j);
+      }
+      node->gradient_log_prob(nullptr, grad1(j), grad2(j));
+      for (Node* input : inputs) {
+        swap_direction(input, map[input], j);
+      }
+    }
+  }
+
+  for (const auto& entry : map) {
+    clear_gradients(const_cast<Node*>(entry.first));
+  }
+  pd_finish(ProfilerEvent::NMC_COMPUTE_GRADS);
+}
+
+template void Graph::compute_gradients_in_directions<2>(
+    const vector<GradientDirection>& directions,
+    const vector<Node*>& det_nodes,
+    const vector<Node*>& sto_nodes,
+    Eigen::Array<double, 2, 1>& grad1,
+    Eigen::Array<double, 2, 1>& grad2);
+
+template void Graph::compute_gradients_in_directions<4>(
+    const vector<GradientDirection>& directions,
+    const vector<Node*>& det_nodes,
+    const vector<Node*>& sto_nodes,
+    Eigen::Array<double, 4, 1>& grad1,
+    Eigen::Array<double, 4, 1>& grad2);
+
+template void Graph::compute_gradients_in_directions<8>(
+    const vector<GradientDirection>& directions,
+    const vector<Node*>& det_nodes,
+    const vector<Node*>& sto_nodes,
+    Eigen::Array<double, 8, 1>& grad1,
+    Eigen::Array<double, 8, 1>& grad2);
+
+template void Graph::compute_gradients_in_directions<16>(
+    const vector<GradientDirection>& directions,
+    const vector<Node*>& det_nodes,
+    const vector<Node*>& sto_nodes,
+    Eigen::Array<double, 16, 1>& grad1,
+    Eigen::Array<double, 16, 1>& grad2);
+
+} // namespace beanmachine::graph
@@ -37,12 +37,22 @@ NMC::NMC(Graph* graph, uint seed) : MH(graph, seed, new NMCStepper(this)) {}
 NMC::~NMC() {}
 
 std::string NMC::is_not_supported(Node* node) {
+  bool finite_natural = node->value.type == AtomicType::NATURAL and
+      static_cast<distribution::Distribution*>(node->in_nodes[0])
+              ->finite_support_size() > 0;
+  const ValueType& type = node->value.type;
+  bool continuous_matrix =
+      type.variable_type == VariableType::BROADCAST_MATRIX and
+      (type.atomic_type == AtomicType::PROBABILITY or
+       type.atomic_type == AtomicType::REAL or
+       type.atomic_type == AtomicType::POS_REAL);
   if (node->value.type.variable_type != VariableType::COL_SIMPLEX_MATRIX and
+      not continuous_matrix and
       node->value.type != AtomicType::PROBABILITY and
       node->value.type != AtomicType::REAL and
       node->value.type != AtomicType::POS_REAL and
-      node->value.type != AtomicType::BOOLEAN) {
-    return "NMC only supported on bool/probability/real/positive nodes -- failing on node " +
+      node->value.type != AtomicType::BOOLEAN and not finite_natural) {
+    return "NMC only supported on bool/probability/real/positive nodes (or matrices of probability/real/positive) and naturals with finite support -- failing on node " +
         std::to_string(node->index);
   } else {
     return "";
@@ -15,8 +15,11 @@
 
 #include "beanmachine/graph/graph.h"
 #include "beanmachine/graph/nmc.h"
+#include "beanmachine/graph/stepper/single_site/gibbs_enumeration_single_site_stepping_method.h"
 #include "beanmachine/graph/stepper/single_site/nmc_dirichlet_beta_single_site_stepping_method.h"
+#include "beanmachine/graph/stepper/single_site/nmc_dirichlet_gamma_block_single_site_stepping_method.h"
 #include "beanmachine/graph/stepper/single_site/nmc_dirichlet_gamma_single_site_stepping_method.h"
+#include "beanmachine/graph/stepper/single_site/nmc_matrix_single_site_stepping_method.h"
 #include "beanmachine/graph/stepper/single_site/nmc_scalar_single_site_stepping_method.h"
 #include "beanmachine/graph/stepper/single_site/sequential_single_site_stepper.h"
 
@@ -35,9 +38,16 @@ class NMCStepper : public SequentialSingleSiteStepper {
                 // because DirichletGamma is also applicable to
                 // nodes to which Beta is applicable,
                 // but we want to give priority to Beta in those cases.
+                // Likewise, the block method takes over from the
+                // coordinate-wise one for large Dirichlets.
                 new NMCScalarSingleSiteSteppingMethod(mh),
                 new NMCDirichletBetaSingleSiteSteppingMethod(mh),
-                new NMCDirichletGammaSingleSiteSteppingMethod(mh)}) {}
+                new NMCDirichletGammaBlockSingleSiteSteppingMethod(mh),
+                new NMCDirichletGammaSingleSiteSteppingMethod(mh),
+                new NMCMatrixSingleSiteSteppingMethod(mh),
+                // finitely supported natural nodes (e.g. categorical,
+                // binomial) are sampled exactly from their full conditional
+                new GibbsEnumerationSingleSiteSteppingMethod(mh)}) {}
 };
 
 } // namespace graph
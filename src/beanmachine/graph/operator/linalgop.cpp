@@ -9,8 +9,8 @@
 #include "beanmachine/graph/operator/linalgop.h"
 #include <cmath>
 #include <stdexcept>
-#include <unsupported/Eigen/SpecialFunctions>
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 /*
@@ -584,10 +584,9 @@ MatrixPhi::MatrixPhi(const std::vector<graph::Node*>& in_nodes)
 
 void MatrixPhi::eval(std::mt19937& /* gen */) {
   assert(in_nodes.size() == 1);
-  // Eigen does not implement a phi function, but we have
-  // this handy identity relating erf and phi:
-  auto x = in_nodes[0]->value._matrix.array();
-  value._matrix = (1.0 + (x * M_SQRT1_2).erf()) / 2.0;
+  const Eigen::MatrixXd& x = in_nodes[0]->value._matrix;
+  value._matrix.resize(x.rows(), x.cols());
+  special::Phi(x.data(), x.size(), value._matrix.data());
 }
 
 MatrixComplement::MatrixComplement(const std::vector<graph::Node*>& in_nodes)
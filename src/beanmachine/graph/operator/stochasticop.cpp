@@ -130,9 +130,63 @@ void Sample::_backward(bool skip_observed) {
   }
 }
 
+std::unique_ptr<graph::Node> IIdSample::clone() {
+  auto result = Operator::clone();
+  if (result->is_observed) {
+    static_cast<IIdSample*>(result.get())->update_sufficient_statistics();
+  }
+  return result;
+}
+
+void IIdSample::update_sufficient_statistics() {
+  const auto dist = static_cast<distribution::Distribution*>(in_nodes[0]);
+  has_sufficient_statistics =
+      dist->sufficient_statistics(value, sufficient_statistics);
+}
+
+double IIdSample::log_prob() const {
+  const auto dist = static_cast<distribution::Distribution*>(in_nodes[0]);
+  if (is_observed and has_sufficient_statistics) {
+    return dist->log_prob_sufficient(sufficient_statistics);
+  }
+  return dist->log_prob(value);
+}
+
+void IIdSample::gradient_log_prob(
+    const graph::Node* target_node,
+    double& log_prob_grad1,
+    double& log_prob_grad2) const {
+  if (this == target_node) {
+    StochasticOperator::gradient_log_prob(
+        target_node, log_prob_grad1, log_prob_grad2);
+    return;
+  }
+  // The log prob of the value is the sum of the log probs of its elements,
+  // and so are its gradients through the parameters. Not every distribution
+  // accepts matrix values in gradient_log_prob_param, so we sum them here.
+  const auto dist = static_cast<distribution::Distribution*>(in_nodes[0]);
+  auto atomic_type = value.type.atomic_type;
+  auto size = value.type.rows * value.type.cols;
+  for (uint i = 0; i < size; i++) {
+    graph::NodeValue element;
+    if (atomic_type == graph::AtomicType::BOOLEAN) {
+      element = graph::NodeValue(static_cast<bool>(value._bmatrix(i)));
+    } else if (atomic_type == graph::AtomicType::NATURAL) {
+      element = graph::NodeValue(value._nmatrix(i));
+    } else {
+      element = graph::NodeValue(atomic_type, value._matrix(i));
+    }
+    dist->gradient_log_prob_param(element, log_prob_grad1, log_prob_grad2);
+  }
+}
+
 void IIdSample::_backward(bool skip_observed) {
   const auto dist = static_cast<distribution::Distribution*>(in_nodes[0]);
-  dist->backward_param_iid(value);
+  if (is_observed and has_sufficient_statistics) {
+    dist->backward_param_sufficient(sufficient_statistics);
+  } else {
+    dist->backward_param_iid(value);
+  }
   if (!(is_observed and skip_observed)) {
     dist->backward_value_iid(value, back_grad1);
   }
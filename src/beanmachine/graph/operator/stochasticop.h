@@ -82,12 +82,27 @@ class IIdSample : public oper::StochasticOperator {
  public:
   explicit IIdSample(const std::vector<graph::Node*>& in_nodes);
   ~IIdSample() override {}
+  std::unique_ptr<Node> clone() override;
+  double log_prob() const override;
+  void gradient_log_prob(
+      const graph::Node* target_node,
+      double& first_grad,
+      double& second_grad) const override;
   void _backward(bool skip_observed) override;
 
+  // Computes the sufficient statistics of the observed value, if the
+  // distribution has them (see Distribution::sufficient_statistics).
+  // Must be called whenever an observed value is assigned.
+  void update_sufficient_statistics();
+
   static std::unique_ptr<Operator> new_op(
       const std::vector<graph::Node*>& in_nodes) {
     return std::make_unique<IIdSample>(in_nodes);
   }
+
+ private:
+  bool has_sufficient_statistics = false;
+  distribution::SufficientStatistics sufficient_statistics;
 };
 
 } // namespace oper
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/operator/operator.h"
+#include "beanmachine/graph/optimization/collapse_observed_samples.h"
+
+namespace beanmachine::graph {
+
+using namespace std;
+using namespace distribution;
+using namespace oper;
+
+namespace {
+
+// Distributions over scalars whose log prob, gradients and sufficient
+// statistics accept the matrix value of an IID_SAMPLE.
+bool supports_iid_values(DistributionType dist_type) {
+  switch (dist_type) {
+    case DistributionType::BERNOULLI:
+    case DistributionType::BERNOULLI_LOGIT:
+    case DistributionType::BERNOULLI_NOISY_OR:
+    case DistributionType::BETA:
+    case DistributionType::BINOMIAL:
+    case DistributionType::CAUCHY:
+    case DistributionType::GAMMA:
+    case DistributionType::GEOMETRIC:
+    case DistributionType::HALF_CAUCHY:
+    case DistributionType::HALF_NORMAL:
+    case DistributionType::LOG_NORMAL:
+    case DistributionType::NORMAL:
+    case DistributionType::POISSON:
+    case DistributionType::STUDENT_T:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool is_collapsible(const Node* node, const set<NodeID>& queried) {
+  if (node->node_type != NodeType::OPERATOR or
+      static_cast<const Operator*>(node)->op_type != OperatorType::SAMPLE or
+      not node->is_observed or not node->out_nodes.empty() or
+      queried.contains(node->index)) {
+    return false;
+  }
+  auto dist = static_cast<const Distribution*>(node->in_nodes[0]);
+  return dist->sample_type.variable_type == VariableType::SCALAR and
+      supports_iid_values(dist->dist_type);
+}
+
+// Adds an observed IID_SAMPLE of the distribution of the given samples,
+// whose value holds their values in order.
+void add_iid_sample(Graph& graph, const vector<Node*>& samples) {
+  auto count = graph.add_constant_natural(samples.size());
+  auto iid = graph.add_operator(
+      OperatorType::IID_SAMPLE, {samples[0]->in_nodes[0]->index, count});
+  NodeValue value(graph.get_node(iid)->value.type);
+  for (uint i = 0; i < samples.size(); i++) {
+    const NodeValue& sample_value = samples[i]->value;
+    switch (value.type.atomic_type) {
+      case AtomicType::BOOLEAN:
+        value._bmatrix(i) = sample_value._bool;
+        break;
+      case AtomicType::NATURAL:
+        value._nmatrix(i) = sample_value._natural;
+        break;
+      default:
+        value._matrix(i) = sample_value._double;
+    }
+  }
+  graph.observe(iid, value);
+}
+
+} // namespace
+
+function<NodeID(NodeID)> collapse_observed_samples(Graph& graph) {
+  set<NodeID> queried(graph.queries.begin(), graph.queries.end());
+  // the collapsible samples of each distribution, by distribution id so that
+  // the new nodes are added in a deterministic order
+  map<NodeID, vector<Node*>> samples_of;
+  for (const auto& node : graph.nodes) {
+    if (is_collapsible(node.get(), queried)) {
+      samples_of[node->in_nodes[0]->index].push_back(node.get());
+    }
+  }
+
+  set<NodeID> removed;
+  for (const auto& [dist_id, samples] : samples_of) {
+    if (samples.size() < 2) {
+      continue;
+    }
+    add_iid_sample(graph, samples);
+    for (const Node* sample : samples) {
+      removed.insert(sample->index);
+    }
+  }
+  return graph.remove_nodes(removed);
+}
+
+} // namespace beanmachine::graph
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine::graph {
+
+// Replaces observed SAMPLE nodes drawn from the same distribution node by a
+// single observed IID_SAMPLE of that distribution (in-place).
+//
+// Compiled models often observe thousands of scalar samples of one
+// distribution, for example
+//
+//   d = Normal(mu, sigma)
+//   x1 = sample(d) observed as v1
+//   ...
+//   xn = sample(d) observed as vn
+//
+// which we rewrite to
+//
+//   d = Normal(mu, sigma)
+//   x = iid_sample(d, n) observed as [v1, ..., vn]
+//
+// The joint distribution of the remaining nodes, and therefore the log prob
+// of the graph and its gradients w.r.t. the unobserved nodes, are unchanged,
+// while inference visits one stochastic node instead of n and can use the
+// vectorized IID log probs and gradients of the distribution.
+//
+// Only samples that are observed, not queried and without out-nodes are
+// collapsed, and only for distributions over scalars whose log prob and
+// gradients accept IID values. Groups of a single sample are left alone.
+//
+// Since nodes are removed, node ids change; queried nodes are updated
+// accordingly and the returned function maps original node ids to new ones
+// (see Graph::remove_nodes).
+std::function<NodeID(NodeID)> collapse_observed_samples(Graph& graph);
+
+} // namespace beanmachine::graph
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/optimization/collapse_observed_samples.h"
+
+using namespace beanmachine;
+using namespace graph;
+
+TEST(testoptimization, collapse_observed_normal_samples) {
+  // mu ~ Normal(0, 1), x_i ~ Normal(mu, 1) for i = 1..n
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint mu = g.add_operator(OperatorType::SAMPLE, {prior});
+  uint likelihood = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {mu, one});
+  const uint n = 20;
+  double sum = 0.0;
+  for (uint i = 0; i < n; i++) {
+    uint x = g.add_operator(OperatorType::SAMPLE, {likelihood});
+    double value = 0.1 * i - 0.5;
+    g.observe(x, value);
+    sum += value;
+  }
+  g.query(mu);
+  g.get_node(mu)->value = NodeValue(0.3);
+  double expected_log_prob = g.full_log_prob();
+  uint num_nodes = g.nodes.size();
+
+  auto new_id = collapse_observed_samples(g);
+  // n samples were replaced by a count constant and an iid sample
+  EXPECT_EQ(g.nodes.size(), num_nodes - n + 2);
+  EXPECT_EQ(new_id(mu), mu);
+  EXPECT_EQ(g.queries, std::vector<NodeID>{mu});
+  EXPECT_THROW(new_id(likelihood + 1), std::invalid_argument);
+  auto iid = g.get_node(g.nodes.size() - 1);
+  EXPECT_EQ(iid->value.type.rows, n);
+  EXPECT_TRUE(iid->is_observed);
+
+  g.get_node(mu)->value = NodeValue(0.3);
+  EXPECT_NEAR(g.full_log_prob(), expected_log_prob, 1e-10);
+  double grad1 = 0, grad2 = 0;
+  g.gradient_log_prob(mu, grad1, grad2);
+  // d/dmu of -mu^2/2 - sum_i (x_i - mu)^2 / 2
+  EXPECT_NEAR(grad1, -0.3 + sum - n * 0.3, 1e-10);
+  EXPECT_NEAR(grad2, -1.0 - n, 1e-10);
+
+  // the conjugate posterior mean is sum / (n + 1)
+  const auto& means = g.infer_mean(10000, InferenceType::NMC);
+  EXPECT_NEAR(means[0], sum / (n + 1), 0.02);
+}
+
+TEST(testoptimization, collapse_observed_bernoulli_samples) {
+  // p ~ Beta(1, 1), y_i ~ Bernoulli(p) for i = 1..n
+  Graph g;
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      DistributionType::BETA, AtomicType::PROBABILITY, {one, one});
+  uint p = g.add_operator(OperatorType::SAMPLE, {prior});
+  uint likelihood =
+      g.add_distribution(DistributionType::BERNOULLI, AtomicType::BOOLEAN, {p});
+  const uint n = 10;
+  uint num_true = 0;
+  for (uint i = 0; i < n; i++) {
+    uint y = g.add_operator(OperatorType::SAMPLE, {likelihood});
+    bool value = i % 3 == 0;
+    g.observe(y, value);
+    num_true += value;
+  }
+  g.query(p);
+  g.get_node(p)->value = NodeValue(AtomicType::PROBABILITY, 0.4);
+  double expected_log_prob = g.full_log_prob();
+
+  collapse_observed_samples(g);
+  EXPECT_EQ(g.nodes.size(), 6);
+  g.get_node(p)->value = NodeValue(AtomicType::PROBABILITY, 0.4);
+  EXPECT_NEAR(g.full_log_prob(), expected_log_prob, 1e-10);
+
+  const auto& means = g.infer_mean(10000, InferenceType::NMC);
+  EXPECT_NEAR(means[0], (1.0 + num_true) / (2.0 + n), 0.02);
+}
+
+TEST(testoptimization, collapse_observed_samples_keeps_used_samples) {
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint queried = g.add_operator(OperatorType::SAMPLE, {dist});
+  g.observe(queried, 0.5);
+  g.query(queried);
+  uint parent = g.add_operator(OperatorType::SAMPLE, {dist});
+  g.observe(parent, 0.2);
+  uint child_dist = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {parent, one});
+  uint child = g.add_operator(OperatorType::SAMPLE, {child_dist});
+  g.observe(child, 1.0);
+  uint single = g.add_operator(OperatorType::SAMPLE, {dist});
+  g.observe(single, -1.0);
+  uint num_nodes = g.nodes.size();
+
+  // only `single` is collapsible, and it is alone in its group
+  auto new_id = collapse_observed_samples(g);
+  EXPECT_EQ(g.nodes.size(), num_nodes);
+  EXPECT_EQ(new_id(single), single);
+  EXPECT_EQ(g.queries, std::vector<NodeID>{queried});
+}
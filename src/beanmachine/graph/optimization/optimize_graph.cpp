@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <set>
+#include <unordered_map>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/operator/operator.h"
+#include "beanmachine/graph/optimization/optimize_graph.h"
+
+namespace beanmachine::graph {
+
+using namespace std;
+using distribution::Distribution;
+using oper::Operator;
+
+namespace {
+
+double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double time_log_prob(Graph& graph, uint repeats) {
+  if (repeats == 0) {
+    return 0;
+  }
+  // the first call also prepares the graph for evaluation
+  graph.full_log_prob();
+  auto start = chrono::steady_clock::now();
+  for (uint i = 0; i < repeats; i++) {
+    graph.full_log_prob();
+  }
+  return seconds_since(start) / repeats;
+}
+
+void combine(size_t& seed, size_t hash) {
+  seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// A hash consistent with are_equal (for the nodes that may be merged).
+size_t hash_of(const Node* node) {
+  size_t seed = static_cast<size_t>(node->node_type);
+  if (node->node_type == NodeType::CONSTANT) {
+    const NodeValue& value = node->value;
+    combine(seed, static_cast<size_t>(value.type.variable_type));
+    combine(seed, static_cast<size_t>(value.type.atomic_type));
+    combine(seed, value.type.rows);
+    combine(seed, value.type.cols);
+    // matrices are compared approximately, so only their type is hashed
+    if (value.type.variable_type == VariableType::SCALAR) {
+      switch (value.type.atomic_type) {
+        case AtomicType::BOOLEAN:
+          combine(seed, hash<bool>{}(value._bool));
+          break;
+        case AtomicType::NATURAL:
+          combine(seed, hash<natural_t>{}(value._natural));
+          break;
+        default:
+          combine(seed, hash<double>{}(value._double));
+      }
+    }
+    return seed;
+  }
+  if (node->node_type == NodeType::DISTRIBUTION) {
+    combine(seed, static_cast<size_t>(
+        static_cast<const Distribution*>(node)->dist_type));
+  } else {
+    combine(seed, static_cast<size_t>(
+        static_cast<const Operator*>(node)->op_type));
+  }
+  for (const Node* in_node : node->in_nodes) {
+    combine(seed, hash<const Node*>{}(in_node));
+  }
+  return seed;
+}
+
+bool is_mergeable(const Node* node) {
+  switch (node->node_type) {
+    case NodeType::CONSTANT:
+    case NodeType::DISTRIBUTION:
+      return true;
+    case NodeType::OPERATOR:
+      return not node->is_stochastic();
+    default:
+      return false;
+  }
+}
+
+bool are_mergeable(const Node* node1, const Node* node2) {
+  if (not are_equal(*node1, *node2)) {
+    return false;
+  }
+  // are_equal ignores the sample type, which distinguishes for example
+  // flat distributions over different types
+  if (node1->node_type == NodeType::DISTRIBUTION) {
+    return static_cast<const Distribution*>(node1)->sample_type ==
+        static_cast<const Distribution*>(node2)->sample_type;
+  }
+  return node1->value.type == node2->value.type;
+}
+
+bool is_foldable(const Node* node) {
+  return node->node_type == NodeType::OPERATOR and
+      not node->is_stochastic() and not node->in_nodes.empty() and
+      all_of(node->in_nodes.begin(), node->in_nodes.end(), [](Node* in_node) {
+           return in_node->node_type == NodeType::CONSTANT;
+         });
+}
+
+// Replaces a deterministic operator with constant in-nodes by a constant
+// node with its value, at the same position in the graph so that the
+// topological order and node ids are preserved.
+void fold(Graph& graph, NodeID node_id) {
+  auto& node = graph.nodes[node_id];
+  mt19937 generator(12131); // seed is irrelevant for deterministic ops
+  node->eval(generator);
+  auto constant = make_unique<ConstNode>(node->value);
+  constant->index = node_id;
+  constant->out_nodes = node->out_nodes;
+  for (Node* out_node : node->out_nodes) {
+    replace(
+        out_node->in_nodes.begin(),
+        out_node->in_nodes.end(),
+        node.get(),
+        static_cast<Node*>(constant.get()));
+  }
+  for (Node* in_node : node->in_nodes) {
+    erase(in_node->out_nodes, node.get());
+  }
+  node = std::move(constant);
+}
+
+// Makes the out-nodes and queries of a node use an identical node instead.
+void merge(Graph& graph, Node* node, Node* representative) {
+  auto out_nodes = node->out_nodes;
+  for (Node* out_node : out_nodes) {
+    graph.replace_edges(out_node, node, representative);
+  }
+  replace(
+      graph.queries.begin(),
+      graph.queries.end(),
+      node->index,
+      representative->index);
+}
+
+// The nodes that are neither queried or observed nor ancestors of one.
+set<NodeID> nodes_outside_support(const Graph& graph) {
+  vector<bool> in_support(graph.nodes.size(), false);
+  for (NodeID node_id : graph.queries) {
+    in_support[node_id] = true;
+  }
+  set<NodeID> outside;
+  // out-nodes appear after their in-nodes, so this visits children first
+  for (auto node_id = graph.nodes.size(); node_id-- > 0;) {
+    const auto& node = graph.nodes[node_id];
+    in_support[node_id] = in_support[node_id] or node->is_observed or
+        any_of(node->out_nodes.begin(),
+               node->out_nodes.end(),
+               [&](const Node* out_node) {
+                 return in_support[out_node->index];
+               });
+    if (not in_support[node_id]) {
+      outside.insert(node_id);
+    }
+  }
+  return outside;
+}
+
+function<NodeID(NodeID)> sweep(Graph& graph, OptimizationSweep& stats) {
+  // candidates for merging, by hash_of
+  unordered_multimap<size_t, Node*> seen;
+  for (NodeID node_id = 0; node_id < graph.nodes.size(); node_id++) {
+    if (is_foldable(graph.nodes[node_id].get())) {
+      fold(graph, node_id);
+      stats.num_folded++;
+    }
+    Node* node = graph.nodes[node_id].get();
+    if (not is_mergeable(node)) {
+      continue;
+    }
+    // in-nodes were visited before, so they are already merged and nodes
+    // computing the same thing have the same in-nodes
+    auto hash = hash_of(node);
+    auto [begin, end] = seen.equal_range(hash);
+    auto representative = find_if(begin, end, [&](const auto& hash_and_node) {
+      return are_mergeable(hash_and_node.second, node);
+    });
+    if (representative == end) {
+      seen.emplace(hash, node);
+    } else {
+      merge(graph, node, representative->second);
+      stats.num_merged++;
+    }
+  }
+  return graph.remove_nodes(nodes_outside_support(graph));
+}
+
+} // namespace
+
+GraphOptimization optimize_graph(
+    Graph& graph,
+    uint max_sweeps,
+    uint timing_repeats) {
+  GraphOptimization result;
+  result.new_id = [](NodeID node_id) { return node_id; };
+  double log_prob_seconds = time_log_prob(graph, timing_repeats);
+  for (uint i = 0; i < max_sweeps; i++) {
+    OptimizationSweep stats;
+    stats.num_nodes_before = graph.nodes.size();
+    stats.log_prob_seconds_before = log_prob_seconds;
+    auto start = chrono::steady_clock::now();
+    auto new_id = sweep(graph, stats);
+    stats.seconds = seconds_since(start);
+    stats.num_nodes_after = graph.nodes.size();
+    log_prob_seconds = time_log_prob(graph, timing_repeats);
+    stats.log_prob_seconds_after = log_prob_seconds;
+    result.new_id = [previous{std::move(result.new_id)},
+                     new_id{std::move(new_id)}](NodeID node_id) {
+      return new_id(previous(node_id));
+    };
+    result.sweeps.push_back(stats);
+    if (stats.num_folded == 0 and stats.num_merged == 0 and
+        stats.num_nodes_removed() == 0) {
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace beanmachine::graph
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "beanmachine/graph/graph.h"
+
+namespace beanmachine::graph {
+
+// What a single sweep of optimize_graph did.
+struct OptimizationSweep {
+  size_t num_nodes_before = 0;
+  size_t num_nodes_after = 0;
+  // deterministic operators with constant inputs replaced by their value
+  uint num_folded = 0;
+  // nodes merged into an identical node appearing earlier in the graph
+  uint num_merged = 0;
+  // time taken by the sweep itself
+  double seconds = 0;
+  // average time taken by Graph::full_log_prob before and after the sweep,
+  // or zero if timing was disabled
+  double log_prob_seconds_before = 0;
+  double log_prob_seconds_after = 0;
+
+  size_t num_nodes_removed() const {
+    return num_nodes_before - num_nodes_after;
+  }
+  double log_prob_seconds_saved() const {
+    return log_prob_seconds_before - log_prob_seconds_after;
+  }
+};
+
+struct GraphOptimization {
+  std::vector<OptimizationSweep> sweeps;
+  // maps the node ids before optimization to the ids after it
+  std::function<NodeID(NodeID)> new_id;
+};
+
+/*
+Simplifies the graph in place without changing the distribution of its
+queried and observed nodes. Each sweep
+- replaces deterministic operators whose in-nodes are all constants by a
+  constant node holding their value (constant folding),
+- merges nodes that are identical according to are_equal, that is,
+  equal constants and distributions or deterministic operators of the
+  same type with the same in-nodes (common subexpression elimination),
+- removes the nodes that are neither queried or observed nor an ancestor
+  of one (that is, that are outside the support).
+
+Stochastic operators and factors are never merged, since two samples of a
+distribution are different random variables and two identical factors
+contribute twice to the log prob.
+
+Compiled models often contain many duplicate constants and conversions
+such as TO_REAL, so this can make evaluation noticeably cheaper.
+
+Sweeps stop once one of them does not change the graph, or after
+max_sweeps sweeps. If timing_repeats is positive, Graph::full_log_prob is
+timed over that many calls before and after each sweep so that the time
+saved per evaluation of the graph can be reported.
+
+Queries are updated to the new node ids, and the result holds a function
+mapping the original node ids of the nodes left to their new ids.
+*/
+GraphOptimization optimize_graph(
+    Graph& graph,
+    uint max_sweeps = 10,
+    uint timing_repeats = 0);
+
+} // namespace beanmachine::graph
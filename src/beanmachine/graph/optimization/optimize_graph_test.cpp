@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/optimization/optimize_graph.h"
+
+using namespace beanmachine;
+using namespace graph;
+
+TEST(testoptimization, optimize_graph_folds_and_merges) {
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, {zero, one});
+  uint x = g.add_operator(OperatorType::SAMPLE, {prior});
+  g.query(x);
+  // two copies of y ~ Normal(x + 2, 1), with separately compiled constants
+  std::vector<uint> ys;
+  for (uint i = 0; i < 2; i++) {
+    uint two = g.add_constant_natural(2);
+    uint two_real = g.add_operator(OperatorType::TO_REAL, {two});
+    uint sum = g.add_operator(OperatorType::ADD, {x, two_real});
+    uint one_again = g.add_constant_pos_real(1.0);
+    uint likelihood = g.add_distribution(
+        DistributionType::NORMAL, AtomicType::REAL, {sum, one_again});
+    uint y = g.add_operator(OperatorType::SAMPLE, {likelihood});
+    g.observe(y, 1.5 + i);
+    ys.push_back(y);
+  }
+  // not needed by any query or observation
+  uint unused = g.add_operator(OperatorType::NEGATE, {x});
+  g.get_node(x)->value = NodeValue(0.7);
+  double expected_log_prob = g.full_log_prob();
+  ASSERT_EQ(g.nodes.size(), 17);
+
+  auto result = optimize_graph(g);
+  // zero, one, prior, x, the constant 2.0, the sum, the likelihood and the
+  // two samples, which are different random variables
+  EXPECT_EQ(g.nodes.size(), 9);
+  ASSERT_EQ(result.sweeps.size(), 2);
+  EXPECT_EQ(result.sweeps[0].num_folded, 2);
+  // the second 2, 2.0, sum and likelihood, and both copies of one
+  EXPECT_EQ(result.sweeps[0].num_merged, 6);
+  EXPECT_EQ(result.sweeps[0].num_nodes_removed(), 8);
+  EXPECT_EQ(result.sweeps[1].num_nodes_removed(), 0);
+  EXPECT_EQ(result.new_id(x), x);
+  EXPECT_EQ(g.queries, std::vector<NodeID>{x});
+  EXPECT_THROW(result.new_id(unused), std::invalid_argument);
+  EXPECT_NE(result.new_id(ys[0]), result.new_id(ys[1]));
+  EXPECT_EQ(
+      g.get_node(result.new_id(ys[0]))->in_nodes,
+      g.get_node(result.new_id(ys[1]))->in_nodes);
+
+  g.get_node(x)->value = NodeValue(0.7);
+  EXPECT_NEAR(g.full_log_prob(), expected_log_prob, 1e-10);
+  // y_i - 2 are observations of x with unit variance
+  const auto& means = g.infer_mean(10000, InferenceType::NMC);
+  EXPECT_NEAR(means[0], 0.0, 0.03);
+}
+
+TEST(testoptimization, optimize_graph_folds_queried_operators) {
+  Graph g;
+  uint two = g.add_constant_pos_real(2.0);
+  uint three = g.add_constant_pos_real(3.0);
+  uint product = g.add_operator(OperatorType::MULTIPLY, {two, three});
+  uint log = g.add_operator(OperatorType::LOG, {product});
+  g.query(log);
+
+  auto result = optimize_graph(g);
+  ASSERT_EQ(g.nodes.size(), 1);
+  EXPECT_EQ(result.new_id(log), 0);
+  EXPECT_EQ(g.queries, std::vector<NodeID>{0});
+  EXPECT_EQ(g.get_node(0)->node_type, NodeType::CONSTANT);
+  EXPECT_NEAR(g.get_node(0)->value._double, std::log(6.0), 1e-10);
+}
+
+TEST(testoptimization, optimize_graph_keeps_factors_and_flat_types) {
+  Graph g;
+  uint real_flat =
+      g.add_distribution(DistributionType::FLAT, AtomicType::REAL, {});
+  uint pos_flat =
+      g.add_distribution(DistributionType::FLAT, AtomicType::POS_REAL, {});
+  uint x = g.add_operator(OperatorType::SAMPLE, {real_flat});
+  uint y = g.add_operator(OperatorType::SAMPLE, {pos_flat});
+  g.query(x);
+  g.query(y);
+  g.add_factor(FactorType::EXP_PRODUCT, {x});
+  g.add_factor(FactorType::EXP_PRODUCT, {x});
+  uint num_nodes = g.nodes.size();
+
+  auto result = optimize_graph(g, 10, 3);
+  EXPECT_EQ(g.nodes.size(), num_nodes);
+  ASSERT_EQ(result.sweeps.size(), 1);
+  EXPECT_EQ(result.sweeps[0].num_merged, 0);
+  EXPECT_GT(result.sweeps[0].log_prob_seconds_before, 0);
+  EXPECT_GT(result.sweeps[0].log_prob_seconds_after, 0);
+}
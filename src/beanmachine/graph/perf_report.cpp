@@ -125,6 +125,9 @@ class JSON {
       case ProfilerEvent::NMC_STEP_DIRICHLET:
         text("step_dirichlet");
         break;
+      case ProfilerEvent::NMC_STEP_ENUMERATE:
+        text("step_enumerate");
+        break;
       case ProfilerEvent::NMC_COMPUTE_GRADS:
         text("compute_grads");
         break;
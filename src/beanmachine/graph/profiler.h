@@ -91,6 +91,7 @@ enum class ProfilerEvent {
   NMC_INFER_COLLECT_SAMPLE,
   NMC_STEP,
   NMC_STEP_DIRICHLET,
+  NMC_STEP_ENUMERATE,
   NMC_COMPUTE_GRADS,
   NMC_EVAL,
   NMC_CLEAR_GRADS,
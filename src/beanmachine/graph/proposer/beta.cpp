@@ -9,6 +9,7 @@
 #include <cmath>
 
 #include "beanmachine/graph/proposer/beta.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -22,7 +23,7 @@ graph::NodeValue Beta::sample(std::mt19937& gen) const {
 double Beta::log_prob(graph::NodeValue& value) const {
   double ret_val =
       (a - 1) * log(value._double) + (b - 1) * log(1 - value._double);
-  ret_val += lgamma(a + b) - lgamma(a) - lgamma(b);
+  ret_val += special::lgamma(a + b) - special::lgamma(a) - special::lgamma(b);
   return ret_val;
 }
 
@@ -8,6 +8,7 @@
 #include "beanmachine/graph/proposer/default_initializer.h"
 #include <stdexcept>
 #include <string>
+#include "beanmachine/graph/distribution/distribution.h"
 #include "beanmachine/graph/graph.h"
 #include "beanmachine/graph/operator/operator.h"
 #include "beanmachine/graph/operator/stochasticop.h"
@@ -18,7 +19,8 @@ namespace proposer {
 
 void default_initializer(std::mt19937& gen, graph::Node* node) {
   // The initialization rules here are based on Stan's default initialization
-  // except for discrete variables which are sampled uniformly.
+  // except for discrete variables: booleans are sampled uniformly and
+  // naturals are sampled from their prior, which keeps them in the support.
   // Note: Stan doesn't support discrete variables.
   if (node->value.type.variable_type ==
       graph::VariableType::COL_SIMPLEX_MATRIX) {
@@ -36,12 +38,30 @@ void default_initializer(std::mt19937& gen, graph::Node* node) {
   } else if (node->value.type == graph::AtomicType::BOOLEAN) {
     bool val = std::bernoulli_distribution(0.5)(gen);
     node->value = graph::NodeValue(val);
+  } else if (node->value.type == graph::AtomicType::NATURAL) {
+    auto dist = static_cast<distribution::Distribution*>(node->in_nodes[0]);
+    node->value = dist->sample(gen);
   } else if (node->value.type == graph::AtomicType::PROBABILITY) {
     node->value = graph::NodeValue(graph::AtomicType::PROBABILITY, 0.5);
   } else if (node->value.type == graph::AtomicType::REAL) {
     node->value = graph::NodeValue(0.0);
   } else if (node->value.type == graph::AtomicType::POS_REAL) {
     node->value = graph::NodeValue(graph::AtomicType::POS_REAL, 1.0);
+  } else if (
+      node->value.type.variable_type ==
+          graph::VariableType::BROADCAST_MATRIX and
+      (node->value.type.atomic_type == graph::AtomicType::PROBABILITY or
+       node->value.type.atomic_type == graph::AtomicType::REAL or
+       node->value.type.atomic_type == graph::AtomicType::POS_REAL)) {
+    // the same values as for scalars, for each element
+    double element = 0.5;
+    if (node->value.type.atomic_type == graph::AtomicType::REAL) {
+      element = 0.0;
+    } else if (node->value.type.atomic_type == graph::AtomicType::POS_REAL) {
+      element = 1.0;
+    }
+    node->value = graph::NodeValue(node->value.type);
+    node->value._matrix.setConstant(element);
   } else {
     throw std::invalid_argument(
         "default initializer not defined for type " +
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "beanmachine/graph/proposer/elementwise.h"
+
+namespace beanmachine {
+namespace proposer {
+
+graph::NodeValue Elementwise::sample(std::mt19937& gen) const {
+  graph::NodeValue value(type);
+  for (uint i = 0; i < proposers.size(); i++) {
+    value._matrix(i) = proposers[i]->sample(gen)._double;
+  }
+  return value;
+}
+
+double Elementwise::log_prob(graph::NodeValue& value) const {
+  double result = 0;
+  for (uint i = 0; i < proposers.size(); i++) {
+    graph::NodeValue element(type.atomic_type, value._matrix(i));
+    result += proposers[i]->log_prob(element);
+  }
+  return result;
+}
+
+} // namespace proposer
+} // namespace beanmachine
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include "beanmachine/graph/proposer/proposer.h"
+
+namespace beanmachine {
+namespace proposer {
+
+class Elementwise : public Proposer {
+ public:
+  /*
+  Constructor for Elementwise class, a proposer for matrix values
+  whose elements are proposed independently.
+  :param type: The type of the proposed values.
+  :param proposers: The scalar proposer of each element, in column-major
+  order.
+  */
+  Elementwise(
+      graph::ValueType type,
+      std::vector<std::unique_ptr<Proposer>> in_proposers)
+      : Proposer(), type(type), proposers(std::move(in_proposers)) {
+    assert(proposers.size() == type.rows * type.cols);
+  }
+  /*
+  Sample a value from the proposer.
+  :param gen: Random number generator.
+  :returns: A value.
+  */
+  graph::NodeValue sample(std::mt19937& gen) const override;
+  /*
+  Compute the log_prob of a value.
+  :param value: The value to evaluate the distribution.
+  :returns: log probability of value.
+  */
+  double log_prob(graph::NodeValue& value) const override;
+
+ private:
+  graph::ValueType type;
+  std::vector<std::unique_ptr<Proposer>> proposers;
+};
+
+} // namespace proposer
+} // namespace beanmachine
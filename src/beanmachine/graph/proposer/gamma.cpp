@@ -11,6 +11,7 @@
 #include <random>
 
 #include "beanmachine/graph/proposer/gamma.h"
+#include "beanmachine/graph/special_functions.h"
 
 namespace beanmachine {
 namespace proposer {
@@ -24,7 +25,7 @@ graph::NodeValue Gamma::sample(std::mt19937& gen) const {
 double Gamma::log_prob(graph::NodeValue& value) const {
   double x = value._double;
   return (alpha - 1) * std::log(x) - beta * x + alpha * std::log(beta) -
-      std::lgamma(alpha);
+      special::lgamma(alpha);
 }
 
 } // namespace proposer
@@ -11,6 +11,7 @@
 #include "beanmachine/graph/graph.h"
 #include "beanmachine/graph/proposer/beta.h"
 #include "beanmachine/graph/proposer/delta.h"
+#include "beanmachine/graph/proposer/elementwise.h"
 #include "beanmachine/graph/proposer/gamma.h"
 #include "beanmachine/graph/proposer/mixture.h"
 #include "beanmachine/graph/proposer/normal.h"
@@ -22,6 +23,10 @@ namespace proposer {
 
 const double MAIN_PROPOSER_WEIGHT = 1.0;
 const double RANDOM_WALK_WEIGHT = 0.01;
+// The strength of the random walks used by nmc_elementwise_proposer for the
+// elements whose approximation is invalid.  Each walk has its mean at the
+// current value and a relative scale of about 1 / sqrt(strength).
+const double LOCAL_WALK_STRENGTH = 100.0;
 
 std::unique_ptr<Proposer>
 nmc_proposer(const graph::NodeValue& value, double grad1, double grad2) {
@@ -138,5 +143,50 @@ nmc_proposer(const graph::NodeValue& value, double grad1, double grad2) {
   return std::make_unique<Mixture>(weights, std::move(proposers));
 }
 
+std::unique_ptr<Proposer> nmc_elementwise_proposer(
+    const graph::NodeValue& value,
+    const Eigen::MatrixXd& grad1,
+    const Eigen::MatrixXd& grad2) {
+  std::vector<std::unique_ptr<Proposer>> proposers;
+  for (uint i = 0; i < value._matrix.size(); i++) {
+    double x = value._matrix(i);
+    double g1 = grad1(i);
+    double g2 = grad2(i);
+    bool is_valid_grad = std::isfinite(g1) && std::isfinite(g2);
+    // the approximations are the same as the main ones of nmc_proposer
+    if (value.type.atomic_type == graph::AtomicType::PROBABILITY) {
+      double a = 1 - x * x * (-g1 + (1 - x) * g2);
+      double b = 1 - (1 - x) * (1 - x) * (g1 + x * g2);
+      if (is_valid_grad and a > 0 and b > 0) {
+        proposers.push_back(std::make_unique<Beta>(a, b));
+      } else {
+        proposers.push_back(std::make_unique<Beta>(
+            LOCAL_WALK_STRENGTH * x, LOCAL_WALK_STRENGTH * (1 - x)));
+      }
+    } else if (value.type.atomic_type == graph::AtomicType::REAL) {
+      if (is_valid_grad and g2 < 0) {
+        proposers.push_back(
+            std::make_unique<Normal>(x - g1 / g2, std::sqrt(-1 / g2)));
+      } else {
+        proposers.push_back(
+            std::make_unique<Normal>(x, 1 / std::sqrt(LOCAL_WALK_STRENGTH)));
+      }
+    } else if (value.type.atomic_type == graph::AtomicType::POS_REAL) {
+      double alpha = 1 - x * x * g2;
+      double beta = -x * g2 - g1;
+      if (is_valid_grad and alpha > 0 and beta > 0) {
+        proposers.push_back(std::make_unique<Gamma>(alpha, beta));
+      } else {
+        proposers.push_back(std::make_unique<Gamma>(
+            LOCAL_WALK_STRENGTH, LOCAL_WALK_STRENGTH / x));
+      }
+    } else {
+      throw std::invalid_argument(
+          "nmc_elementwise_proposer requires real, positive real or probability values");
+    }
+  }
+  return std::make_unique<Elementwise>(value.type, std::move(proposers));
+}
+
 } // namespace proposer
 } // namespace beanmachine
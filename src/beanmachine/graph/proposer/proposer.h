@@ -42,5 +42,25 @@ Return a unique pointer to a Proposer object.
 std::unique_ptr<Proposer>
 nmc_proposer(const graph::NodeValue& value, double grad1, double grad2);
 
+/*
+Return a unique pointer to a Proposer object for a real, positive real or
+probability matrix value, proposing each element independently from the
+NMC approximation of the log prob around it. Unlike nmc_proposer, the
+elements are not proposed from mixtures with wider proposers and random
+walks, since the chance that some element of a large matrix would be
+drawn from those would make most proposals unlikely. The elements whose
+approximation is invalid (e.g. their gradients are not finite) are proposed
+from a narrow random walk with its mean at their current value, so that
+they do not make the whole proposal unlikely either.
+:param value: The current value.
+:param grad1: First gradient of the log prob w.r.t. each element.
+:param grad2: Second gradient of the log prob w.r.t. each element.
+:returns: A proposer object pointer.
+*/
+std::unique_ptr<Proposer> nmc_elementwise_proposer(
+    const graph::NodeValue& value,
+    const Eigen::MatrixXd& grad1,
+    const Eigen::MatrixXd& grad2);
+
 } // namespace proposer
 } // namespace beanmachine
@@ -139,18 +139,22 @@ PYBIND11_MODULE(graph, module) {
       .value("REJECTION", InferenceType::REJECTION)
       .value("GIBBS", InferenceType::GIBBS)
       .value("NMC", InferenceType::NMC)
-      .value("NUTS", InferenceType::NUTS);
+      .value("NUTS", InferenceType::NUTS)
+      .value("LIKELIHOOD_WEIGHTING", InferenceType::LIKELIHOOD_WEIGHTING);
 
   py::class_<Node>(module, "Node");
 
   py::class_<InferConfig>(module, "InferConfig")
       .def(py::init())
       .def(py::init<bool, double, double, uint, bool>())
+      .def(py::init<bool, double, double, uint, bool, uint, bool>())
       .def_readwrite("keep_log_prob", &InferConfig::keep_log_prob)
       .def_readwrite("path_length", &InferConfig::path_length)
       .def_readwrite("step_size", &InferConfig::step_size)
       .def_readwrite("num_warmup", &InferConfig::num_warmup)
-      .def_readwrite("keep_warmup", &InferConfig::keep_warmup);
+      .def_readwrite("keep_warmup", &InferConfig::keep_warmup)
+      .def_readwrite("num_threads", &InferConfig::num_threads)
+      .def_readwrite("bit_parallel_gibbs", &InferConfig::bit_parallel_gibbs);
 
   // CONSIDER: Remove the overloaded add_constant APIs; the overloaded API's
   // binding behaviour is a little confusing. For example,
@@ -372,7 +376,8 @@ PYBIND11_MODULE(graph, module) {
           py::arg("num_iters"),
           py::arg("steps_per_iter"),
           py::arg("seed") = 5123401,
-          py::arg("elbo_samples") = 0)
+          py::arg("elbo_samples") = 0,
+          py::arg("num_threads") = 1)
       .def(
           "customize_transformation",
           &Graph::customize_transformation,
@@ -387,6 +392,14 @@ PYBIND11_MODULE(graph, module) {
           "get_log_prob",
           &Graph::get_log_prob,
           "get the log probabilities of all chains")
+      .def(
+          "get_log_weights",
+          &Graph::get_log_weights,
+          "get the log importance weights of all chains")
+      .def(
+          "get_effective_sample_size",
+          &Graph::get_effective_sample_size,
+          "get the effective sample size of the importance weights of all chains")
       .def(
           "collect_performance_data",
           &Graph::collect_performance_data,
@@ -5,48 +5,142 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "beanmachine/graph/batched_ancestral_sampler.h"
 #include "beanmachine/graph/graph.h"
 
 namespace beanmachine {
 namespace graph {
 
-// TODO: move this inference method out of Graph.
-void Graph::rejection(uint num_samples, uint seed, InferConfig infer_config) {
-  std::mt19937 gen(seed);
+namespace {
+
+// Number of worlds sampled at once by each thread.
+const uint REJECTION_BATCH_SIZE = 256;
+
+// Rejection sampling of one world at a time, for graphs with matrix-valued
+// operators, which BatchedAncestralSampler does not support.
+// `nodes` are the nodes to sample, in topological order.
+void rejection_one_world_at_a_time(
+    Graph& graph,
+    const std::vector<Node*>& nodes,
+    uint num_samples,
+    std::mt19937& gen,
+    InferConfig infer_config) {
   for (uint snum = 0; snum < num_samples + infer_config.num_warmup; snum++) {
     // rejection sampling
     bool rejected;
     do {
       rejected = false;
-      for (auto& node : nodes) {
-        // We evaluate all the nodes in topological order so a node's
+      for (Node* node : nodes) {
+        // We evaluate the nodes in topological order so a node's
         // parents are evaluated before it.
         // Note: evaluation may result in sampling if there is a sample
         // operator in the graph.
-        NodeValue old_value;
-        if (node->node_type == NodeType::OPERATOR) {
-          old_value = node->value;
+        if (node->node_type != NodeType::OPERATOR) {
+          continue;
+        }
+        if (not node->is_observed) {
           node->eval(gen);
+          continue;
         }
-        if (observed.find(node->index) != observed.end()) {
-          // we can't change the value of the observed nodes
-          // sample is rejected if observed value doesn't match up
-          if (old_value != node->value) {
-            node->value = old_value;
-            rejected = true;
-            break;
-          }
+        // we can't change the value of the observed nodes
+        // sample is rejected if observed value doesn't match up
+        NodeValue old_value = node->value;
+        node->eval(gen);
+        if (old_value != node->value) {
+          node->value = old_value;
+          rejected = true;
+          break;
         }
       }
     } while (rejected);
     if (infer_config.keep_log_prob) {
-      collect_log_prob(full_log_prob());
+      graph.collect_log_prob(graph.full_log_prob());
     }
     if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
-      collect_sample();
+      graph.collect_sample();
     }
   }
 }
 
+} // namespace
+
+// TODO: move this inference method out of Graph.
+void Graph::rejection(uint num_samples, uint seed, InferConfig infer_config) {
+  std::mt19937 gen(seed);
+  // Only the observed and queried nodes and their ancestors need be sampled,
+  // unless the log prob of the whole graph is requested.
+  std::vector<Node*> sampled_nodes;
+  if (infer_config.keep_log_prob) {
+    sampled_nodes = node_ptrs();
+  } else {
+    std::vector<NodeID> roots(queries.begin(), queries.end());
+    roots.insert(roots.end(), observed.begin(), observed.end());
+    sampled_nodes = BatchedAncestralSampler::ancestors_of(*this, roots);
+  }
+  if (not BatchedAncestralSampler::is_supported(sampled_nodes)) {
+    rejection_one_world_at_a_time(
+        *this, sampled_nodes, num_samples, gen, infer_config);
+    return;
+  }
+
+  uint num_threads = std::max(infer_config.num_threads, 1u);
+  // accepted_values[t][i][j] : value of the j-th query in the i-th world
+  // accepted by thread t in its last batch
+  std::vector<std::vector<std::vector<NodeValue>>> accepted_values(
+      num_threads);
+  std::vector<std::vector<double>> accepted_log_probs(num_threads);
+  auto record = [&](uint t, Graph& graph, BatchedAncestralSampler& sampler) {
+    accepted_values[t].clear();
+    accepted_log_probs[t].clear();
+    for (uint w = 0; w < sampler.batch_size(); w++) {
+      if (not sampler.accepted(w)) {
+        continue;
+      }
+      sampler.load_world(w);
+      std::vector<NodeValue> values;
+      values.reserve(graph.queries.size());
+      for (NodeID node_id : graph.queries) {
+        values.push_back(graph.nodes[node_id]->value);
+      }
+      accepted_values[t].push_back(std::move(values));
+      if (infer_config.keep_log_prob) {
+        accepted_log_probs[t].push_back(graph.full_log_prob());
+      }
+    }
+  };
+
+  uint num_wanted = num_samples + infer_config.num_warmup;
+  uint snum = 0;
+  auto collect = [&](uint t) {
+    for (uint i = 0; i < accepted_values[t].size() and snum < num_wanted;
+         i++, snum++) {
+      for (uint j = 0; j < queries.size(); j++) {
+        nodes[queries[j]]->value = accepted_values[t][i][j];
+      }
+      if (infer_config.keep_log_prob) {
+        collect_log_prob(accepted_log_probs[t][i]);
+      }
+      if (infer_config.keep_warmup or snum >= infer_config.num_warmup) {
+        collect_sample();
+      }
+    }
+    return snum == num_wanted;
+  };
+
+  BatchedAncestralSampler::sample_in_parallel(
+      *this,
+      sampled_nodes,
+      REJECTION_BATCH_SIZE,
+      BatchedAncestralSampler::Evidence::REJECT,
+      num_threads,
+      gen,
+      record,
+      collect);
+}
+
 } // namespace graph
 } // namespace beanmachine
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <limits>
+
+#include "beanmachine/graph/special_functions.h"
+
+namespace beanmachine {
+namespace special {
+
+namespace {
+
+const std::size_t kLanes = 8;
+
+} // namespace
+
+// out[i] = f(x[i]), written out for each function rather than through a
+// template taking f, which the compiler inlines too late to vectorize. out
+// may be x, so the pointers are not declared restrict; the pragma tells the
+// compiler that the iterations are independent all the same.
+#define BM_BATCHED(f)                                                         \
+  BM_SIMD_CLONES void f(const double* x, std::size_t n, double* out) {        \
+    BM_SIMD_LOOP                                                              \
+    for (std::size_t i = 0; i < n; i++) {                                     \
+      out[i] = f(x[i]);                                                       \
+    }                                                                         \
+  }
+
+BM_BATCHED(exp)
+BM_BATCHED(log)
+BM_BATCHED(log1p)
+BM_BATCHED(log1pexp)
+BM_BATCHED(log1mexp)
+BM_BATCHED(lgamma)
+BM_BATCHED(digamma)
+BM_BATCHED(trigamma)
+BM_BATCHED(Phi)
+
+#undef BM_BATCHED
+
+BM_SIMD_CLONES double log_sum_exp(const double* x, std::size_t n) {
+  // See "log-sum-exp trick for log-domain calculations" in
+  // https://en.wikipedia.org/wiki/LogSumExp
+  // Both passes accumulate in kLanes independent lanes, so that they can be
+  // vectorized without reassociating the sums.
+  const double inf = std::numeric_limits<double>::infinity();
+  double lane_max[kLanes];
+  for (std::size_t lane = 0; lane < kLanes; lane++) {
+    lane_max[lane] = -inf;
+  }
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    BM_SIMD_LOOP
+    for (std::size_t lane = 0; lane < kLanes; lane++) {
+      double v = x[i + lane];
+      // not std::max, so that a nan propagates to the result
+      lane_max[lane] = v > lane_max[lane] or v != v ? v : lane_max[lane];
+    }
+  }
+  double max = -inf;
+  for (; i < n; i++) {
+    max = x[i] > max or x[i] != x[i] ? x[i] : max;
+  }
+  for (std::size_t lane = 0; lane < kLanes; lane++) {
+    max = lane_max[lane] > max or lane_max[lane] != lane_max[lane]
+        ? lane_max[lane]
+        : max;
+  }
+  if (std::isinf(max)) {
+    // all -inf (or empty), or some +inf
+    return max;
+  }
+  double lane_sum[kLanes] = {};
+  i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    BM_SIMD_LOOP
+    for (std::size_t lane = 0; lane < kLanes; lane++) {
+      lane_sum[lane] += exp(x[i + lane] - max);
+    }
+  }
+  double sum = 0;
+  for (; i < n; i++) {
+    sum += exp(x[i] - max);
+  }
+  for (std::size_t lane = 0; lane < kLanes; lane++) {
+    sum += lane_sum[lane];
+  }
+  return log(sum) + max;
+}
+
+} // namespace special
+} // namespace beanmachine
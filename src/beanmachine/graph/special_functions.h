@@ -0,0 +1,638 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/*
+Special functions for the graph library, in two forms:
+- scalar functions, defined in this header and written without branches
+  (special cases are handled by selects) so that loops calling them can be
+  vectorized by the compiler;
+- batched functions computing out[i] = f(x[i]) for i in [0, n), which are
+  such loops, compiled for several instruction sets (AVX-512, AVX2 and the
+  baseline) with the best one supported by the CPU picked at load time
+  where the platform allows it.
+The loops vectorize when the compiler may evaluate both sides of a select,
+that is with -fno-trapping-math, as set by setup.py.
+Both forms have the accuracy given below. Unlike std::lgamma they do not
+touch any global state, so they can be called from several threads at once.
+
+Accuracy, as checked by tests/special_functions_test.cpp against long
+double references (an ulp is the spacing of doubles at the exact result):
+- exp, log: 1 ulp;
+- log1p, log1pexp, log1mexp: 3 ulp;
+- lgamma, digamma, trigamma: 3, 5 and 5 ulp for x > 0 (including near the
+  zeros of lgamma at 1 and 2 and of digamma at 1.4616...); for x < 0, where
+  they are computed by reflection, 4e-15 relative to max(1, |f(x)|);
+- Phi: 6 ulp, down to x = -37.5 or so, below which Phi(x) underflows.
+Poles give nan for digamma and +inf for lgamma and trigamma.
+*/
+
+#if defined(__GNUC__)
+#define BM_ALWAYS_INLINE inline __attribute__((always_inline))
+#define BM_RESTRICT __restrict__
+#define BM_SIMD_LOOP _Pragma("omp simd")
+#else
+#define BM_ALWAYS_INLINE inline
+#define BM_RESTRICT
+#define BM_SIMD_LOOP
+#endif
+
+#if defined(__x86_64__) && defined(__ELF__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define BM_SIMD_CLONES \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef BM_SIMD_CLONES
+#define BM_SIMD_CLONES
+#endif
+
+namespace beanmachine {
+namespace special {
+
+namespace detail {
+
+// Adding and subtracting kRoundingShift rounds a double of magnitude below
+// 2^51 to an integer, whose value is then in the low bits of the sum.
+constexpr double kRoundingShift = 0x1.8p52;
+
+BM_ALWAYS_INLINE double round_to_integer(double x) {
+  return (x + kRoundingShift) - kRoundingShift;
+}
+
+// 2^k for an integer-valued k in [-1022, 1023]
+BM_ALWAYS_INLINE double pow2(double k) {
+  std::uint64_t bits = std::bit_cast<std::uint64_t>(k + kRoundingShift) -
+      std::bit_cast<std::uint64_t>(kRoundingShift) + 1023;
+  return std::bit_cast<double>(bits << 52);
+}
+
+// sin(pi r) and cos(pi r) for r in [-1/2, 1/2], by their Taylor series
+BM_ALWAYS_INLINE double sin_pi_reduced(double r) {
+  double u = M_PI * r;
+  double u2 = u * u;
+  double p = -1.0 / 51090942171709440000.0;
+  p = p * u2 + 1.0 / 121645100408832000.0;
+  p = p * u2 - 1.0 / 355687428096000.0;
+  p = p * u2 + 1.0 / 1307674368000.0;
+  p = p * u2 - 1.0 / 6227020800.0;
+  p = p * u2 + 1.0 / 39916800.0;
+  p = p * u2 - 1.0 / 362880.0;
+  p = p * u2 + 1.0 / 5040.0;
+  p = p * u2 - 1.0 / 120.0;
+  p = p * u2 + 1.0 / 6.0;
+  return u - u * u2 * p;
+}
+
+BM_ALWAYS_INLINE double cos_pi_reduced(double r) {
+  double u = M_PI * r;
+  double u2 = u * u;
+  double p = 1.0 / 1124000727777607680000.0;
+  p = p * u2 - 1.0 / 2432902008176640000.0;
+  p = p * u2 + 1.0 / 6402373705728000.0;
+  p = p * u2 - 1.0 / 20922789888000.0;
+  p = p * u2 + 1.0 / 87178291200.0;
+  p = p * u2 - 1.0 / 479001600.0;
+  p = p * u2 + 1.0 / 3628800.0;
+  p = p * u2 - 1.0 / 40320.0;
+  p = p * u2 + 1.0 / 720.0;
+  p = p * u2 - 1.0 / 24.0;
+  p = p * u2 + 0.5;
+  return 1.0 - u2 * p;
+}
+
+// x - round(x), which is in [-1/2, 1/2] and is zero at the integers
+// (including every double of magnitude 2^52 or more)
+BM_ALWAYS_INLINE double distance_to_integer(double x) {
+  double a = x < 0 ? -x : x;
+  double r = a - ((a + 0x1p52) - 0x1p52);
+  r = a >= 0x1p52 ? 0.0 : r;
+  return x < 0 ? -r : r;
+}
+
+// c[k] for an integer-valued k in [0, N), by selects rather than an indexed
+// load, which the compiler could only vectorize as a gather (if at all); k is
+// a double so that the selects do not mix 32- and 64-bit lanes
+template <int N>
+BM_ALWAYS_INLINE double select(const double (&c)[N], double k) {
+  double r = c[0];
+#pragma GCC unroll 8
+  for (int i = 1; i < N; i++) {
+    r = k == i ? c[i] : r;
+  }
+  return r;
+}
+
+// The rounding error of x * x, that is, x * x - fl(x * x), by Dekker's
+// product for |x| < 2^995. Each step is a separate statement so that the
+// compiler cannot contract them into fused multiply-adds.
+BM_ALWAYS_INLINE double square_error(double x, double x_sq) {
+  double c = 134217729.0 * x;
+  double c_m_x = c - x;
+  double hi = c - c_m_x;
+  double lo = x - hi;
+  double hi_sq = hi * hi;
+  double e = hi_sq - x_sq;
+  double two_hi_lo = 2.0 * hi * lo;
+  e = e + two_hi_lo;
+  double lo_sq = lo * lo;
+  return e + lo_sq;
+}
+
+// Rational approximations of erf and erfc from Boost.Math (erf.hpp, 53-bit
+// precision), one per interval of |z|:
+// [0, 0.5): erf(z) = z (Y + P(z^2) / Q(z^2))
+// [0.5, 1.5), [1.5, 2.5), [2.5, 4.5): erfc(z) = exp(-z^2) / z
+//     (Y + P(z - c) / Q(z - c)) with c = 0.5, 1.5, 3.5 respectively
+// [4.5, inf): erfc(z) = exp(-z^2) / z (Y + P(1 / z) / Q(1 / z))
+// The polynomials are padded with zeros to a common degree.
+struct ErfTable {
+  double y[5];
+  double shift[5];
+  double p[7][5];
+  double q[7][5];
+};
+inline constexpr ErfTable kErfTable = {
+    {1.044948577880859375,
+     0.405935764312744140625,
+     0.50672817230224609375,
+     0.5405750274658203125,
+     0.5579090118408203125},
+    {0.0, 0.5, 1.5, 3.5, 0.0},
+    {{0.0834305892146531832907,
+      -0.098090592216281240205,
+      -0.0243500476207698441272,
+      0.00295276716530971662634,
+      0.00628057170626964891937},
+     {-0.338165134459360935041,
+      0.178114665841120341155,
+      0.0386540375035707201728,
+      0.0137384425896355332126,
+      0.0175389834052493308818},
+     {-0.0509990735146777432841,
+      0.191003695796775433986,
+      0.04394818964209516296,
+      0.00840807615555585383007,
+      -0.212652252872804219852},
+     {-0.00772758345802133288487,
+      0.0888900368967884466578,
+      0.0175679436311802092299,
+      0.00212825620914618649141,
+      -0.687717681153649930619},
+     {-0.000322780120964605683831,
+      0.0195049001251218801359,
+      0.00323962406290842133584,
+      0.000250269961544794627958,
+      -2.5518551727311523996},
+     {0.0,
+      0.00180424538297014223957,
+      0.000235839115596880717416,
+      0.113212406648847561139e-4,
+      -3.22729451764143718517},
+     {0.0, 0.0, 0.0, 0.0, -2.8175401114513378771}},
+    {{1.0, 1.0, 1.0, 1.0, 1.0},
+     {0.455004033050794024546,
+      1.84759070983002217845,
+      1.53991494948552447182,
+      1.04217814166938418171,
+      2.79257750980575282228},
+     {0.0875222600142252549554,
+      1.42628004845511324508,
+      0.982403709157920235114,
+      0.442597659481563127003,
+      11.0567237927800161565},
+     {0.00858571925074406212772,
+      0.578052804889902404909,
+      0.325732924782444448493,
+      0.0958492726301061423444,
+      15.930646027911794143},
+     {0.000370900071787748000569,
+      0.12385097467900864233,
+      0.0563921837420478160373,
+      0.0105982906484876531489,
+      22.9367376522880577224},
+     {0.0,
+      0.0113385233577001411017,
+      0.00410369723978904575884,
+      0.000479411269521714493907,
+      13.5064170191802889145},
+     {0.0, 0.337511472483094676155e-5, 0.0, 0.0, 5.48409182238641741584}}};
+
+} // namespace detail
+
+// e^x
+BM_ALWAYS_INLINE double exp(double x) {
+  const double log2e = 1.44269504088896338700e+00;
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  // beyond these bounds the result is inf or 0 anyway; nan passes through
+  double y = x > 710.0 ? 710.0 : x;
+  y = y < -746.0 ? -746.0 : y;
+  // e^y = 2^k e^r with |r| <= ln(2) / 2
+  double k = detail::round_to_integer(y * log2e);
+  double r = (y - k * ln2_hi) - k * ln2_lo;
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = 1.0 + (r + r * r * p);
+  // 2^k as a product of two powers of two, neither of which overflows or
+  // underflows, so that the result rounds correctly into the subnormals
+  double k1 = detail::round_to_integer(0.5 * k);
+  return p * detail::pow2(k1) * detail::pow2(k - k1);
+}
+
+// The natural log of fdlibm (as found in musl), with the exponent extracted
+// by integer arithmetic and the special cases handled by selects.
+BM_ALWAYS_INLINE double log(double x) {
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  const double Lg1 = 6.666666666666735130e-01;
+  const double Lg2 = 3.999999999940941908e-01;
+  const double Lg3 = 2.857142874366239149e-01;
+  const double Lg4 = 2.222219843214978396e-01;
+  const double Lg5 = 1.818357216161805012e-01;
+  const double Lg6 = 1.531383769920937332e-01;
+  const double Lg7 = 1.479819860511658591e-01;
+  const double inf = std::numeric_limits<double>::infinity();
+  // scale subnormal numbers up into the normal range (note that the
+  // arithmetic is never made conditional, which would keep the compiler
+  // from vectorizing it)
+  bool subnormal = x < std::numeric_limits<double>::min();
+  double y = x * (subnormal ? 0x1p54 : 1.0);
+  std::uint64_t bits = std::bit_cast<std::uint64_t>(y);
+  // reduce y to m * 2^k with m in [sqrt(2)/2, sqrt(2))
+  bits += std::uint64_t(0x3ff00000 - 0x3fe6a09e) << 32;
+  std::uint64_t biased_k = bits >> 52;
+  bits = (bits & 0x000fffffffffffffULL) + (std::uint64_t(0x3fe6a09e) << 32);
+  // converts biased_k to a double without an int64 conversion, which AVX2
+  // lacks: the bits of 2^52 + biased_k
+  double k = std::bit_cast<double>(biased_k | 0x4330000000000000ULL) -
+      (0x1p52 + 1023.0) - (subnormal ? 54.0 : 0.0);
+  double f = std::bit_cast<double>(bits) - 1.0;
+  double hfsq = 0.5 * f * f;
+  double s = f / (2.0 + f);
+  double z = s * s;
+  double w = z * z;
+  double t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+  double t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+  double r = t2 + t1;
+  double result = s * (hfsq + r) + k * ln2_lo - hfsq + f + k * ln2_hi;
+  // log(0) = -inf, log(inf) = inf, log of a negative number or nan = nan
+  result = x == inf ? inf : result;
+  result = x == 0 ? -inf : result;
+  return x >= 0 ? result : std::numeric_limits<double>::quiet_NaN();
+}
+
+// log(1 + x), accurate for small x
+BM_ALWAYS_INLINE double log1p(double x) {
+  double w = 1.0 + x;
+  double d = w - 1.0;
+  // log(w) * x / d corrects for the rounding of 1 + x
+  double ratio = x / (d == 0 ? 1.0 : d);
+  return d == 0 ? x : log(w) * ratio;
+}
+
+// log(1 + e^x)
+BM_ALWAYS_INLINE double log1pexp(double x) {
+  double positive_part = x > 0 ? x : 0.0;
+  double minus_abs = x > 0 ? -x : x;
+  return positive_part + log1p(exp(minus_abs));
+}
+
+// log(1 - e^x) for x <= 0; following Maechler's note (see util::log1mexp),
+// computed as log1p(-e^x) for x < -log(2) and as log(-expm1(x)) otherwise.
+BM_ALWAYS_INLINE double log1mexp(double x) {
+  // the arguments of the two branches are clamped into their domains
+  double near = x < -M_LN2 ? -M_LN2 : x;
+  double far = x < -M_LN2 ? x : -M_LN2;
+  // expm1(near) by its Taylor series, |near| <= log(2)
+  double p = 1.0 / 355687428096000.0;
+  p = p * near + 1.0 / 20922789888000.0;
+  p = p * near + 1.0 / 1307674368000.0;
+  p = p * near + 1.0 / 87178291200.0;
+  p = p * near + 1.0 / 6227020800.0;
+  p = p * near + 1.0 / 479001600.0;
+  p = p * near + 1.0 / 39916800.0;
+  p = p * near + 1.0 / 3628800.0;
+  p = p * near + 1.0 / 362880.0;
+  p = p * near + 1.0 / 40320.0;
+  p = p * near + 1.0 / 5040.0;
+  p = p * near + 1.0 / 720.0;
+  p = p * near + 1.0 / 120.0;
+  p = p * near + 1.0 / 24.0;
+  p = p * near + 1.0 / 6.0;
+  p = p * near + 0.5;
+  double expm1_near = near + near * near * p;
+  return x < -M_LN2 ? log1p(-exp(far)) : log(-expm1_near);
+}
+
+namespace detail {
+
+// Rational approximations of lgamma on [1, 3) from Boost.Math
+// (lgamma_small.hpp, 64-bit precision), which keep the relative accuracy
+// near the zeros at 1 and 2, one per interval:
+// [1, 1.5]: lgamma(z) = (z - 1) (z - 2) (Y + P(z - 1) / Q(z - 1))
+// (1.5, 2): lgamma(z) = (z - 1) (z - 2) (Y + P(2 - z) / Q(2 - z))
+// [2, 3): lgamma(z) = (z - 2) (z + 1) (Y + P(z - 2) / Q(z - 2))
+// The polynomials are padded with zeros to a common degree.
+struct LgammaTable {
+  double y[3];
+  double p[8][3];
+  double q[8][3];
+};
+inline constexpr LgammaTable kLgammaTable = {
+    {0.52815341949462890625,
+     0.452017307281494140625,
+     0.158963680267333984375},
+    {{0.490622454069039543534e-1,
+      -0.292329721830270012337e-1,
+      -0.180355685678449379109e-1},
+     {-0.969117530159521214579e-1,
+      0.144216267757192309184e0,
+      0.25126649619989678683e-1},
+     {-0.414983358359495381969e0,
+      -0.142440390738631274135e0,
+      0.494103151567532234274e-1},
+     {-0.406567124211938417342e0,
+      0.542809694055053558157e-1,
+      0.172491608709613993966e-1},
+     {-0.158413586390692192217e0,
+      -0.850535976868336437746e-2,
+      -0.259453563205438108893e-3},
+     {-0.240149820648571559892e-1,
+      0.431171342679297331241e-3,
+      -0.541009869215204396339e-3},
+     {-0.100346687696279557415e-2, 0.0, -0.324588649825948492091e-4},
+     {0.0, 0.0, 0.0}},
+    {{1.0, 1.0, 1.0},
+     {0.302349829846463038743e1,
+      -0.150169356054485044494e1,
+      0.196202987197795200688e1},
+     {0.348739585360723852576e1,
+      0.846973248876495016101e0,
+      0.148019669424231326694e1},
+     {0.191415588274426679201e1,
+      -0.220095151814995745555e0,
+      0.541391432071720958364e0},
+     {0.507137738614363510846e0,
+      0.25582797155975869989e-1,
+      0.988504251128010129477e-1},
+     {0.577039722690451849648e-1,
+      -0.100666795539143372762e-2,
+      0.82130967464889339326e-2},
+     {0.195768102601107189171e-2,
+      -0.827193521891290553639e-6,
+      0.224936291922115757597e-3},
+     {0.0, 0.0, -0.223352763208617092964e-6}}};
+
+// lgamma(x) for x >= 0: for x < 8, from the rational approximations on
+// [1, 3), with lgamma(x) = lgamma(x + 1) - log(x) for x < 1 and
+// lgamma(x) = lgamma(y) + log(y (y + 1) ... (x - 1)) for x >= 3 and y in
+// [2, 3); for x >= 8, from Stirling's series.
+BM_ALWAYS_INLINE double lgamma_nonnegative(double x) {
+  const LgammaTable& table = kLgammaTable;
+  bool below_one = x < 1.0;
+  double y = below_one ? x + 1.0 : x;
+  double product = 1.0;
+#pragma GCC unroll 5
+  for (int i = 0; i < 5; i++) {
+    bool shift = y >= 3.0;
+    y -= shift ? 1.0 : 0.0;
+    product *= shift ? y : 1.0;
+  }
+  // y - 1 and y - 2, computed from x when y = x + 1 so that they are exact
+  double ym1 = below_one ? x : y - 1.0;
+  double ym2 = below_one ? x - 1.0 : y - 2.0;
+  double k = double(y > 1.5) + double(y >= 2.0);
+  double t = k == 0 ? ym1 : (k == 1 ? -ym2 : ym2);
+  double p = select(table.p[7], k);
+  double q = select(table.q[7], k);
+#pragma GCC unroll 7
+  for (int j = 6; j >= 0; j--) {
+    p = p * t + select(table.p[j], k);
+    q = q * t + select(table.q[j], k);
+  }
+  double prefix = ym2 * (k == 2 ? y + 1.0 : ym1);
+  double small = prefix * select(table.y, k) + prefix * (p / q);
+  double log_shift = log(below_one ? x : product);
+  small += below_one ? -log_shift : log_shift;
+
+  double inv_x = 1.0 / x;
+  double inv_x2 = inv_x * inv_x;
+  double s = -3617.0 / 122400.0;
+  s = s * inv_x2 + 1.0 / 156.0;
+  s = s * inv_x2 - 691.0 / 360360.0;
+  s = s * inv_x2 + 1.0 / 1188.0;
+  s = s * inv_x2 - 1.0 / 1680.0;
+  s = s * inv_x2 + 1.0 / 1260.0;
+  s = s * inv_x2 - 1.0 / 360.0;
+  s = s * inv_x2 + 1.0 / 12.0;
+  // (x - 1/2) log(x) - x + log(2 pi) / 2, written so that x = inf gives inf
+  const double half_log_two_pi_m_half = 0.41893853320467274178;
+  double large =
+      (x - 0.5) * (log(x) - 1.0) + half_log_two_pi_m_half + s * inv_x;
+  return x < 8.0 ? small : large;
+}
+
+// digamma(x) for x >= 0: for x < 10, from the rational approximation of
+// Boost.Math (digamma.hpp, 53-bit precision) on [1, 2), which keeps the
+// relative accuracy near the zero of digamma,
+// digamma(y) = (y - root) (Y + P(y - 1) / Q(y - 1)),
+// with digamma(x) = digamma(x + 1) - 1 / x for x < 1 and
+// digamma(x) = digamma(y) + 1 / y + 1 / (y + 1) + ... + 1 / (x - 1) for
+// x >= 2 and y in [1, 2); for x >= 10, from the asymptotic series.
+BM_ALWAYS_INLINE double digamma_nonnegative(double x) {
+  // the root, split into three parts whose sum is exact enough
+  const double root1 = 1569415565.0 / 1073741824.0;
+  const double root2 = (381566830.0 / 1073741824.0) / 1073741824.0;
+  const double root3 = 0.9016312093258695918615325266959189453125e-19;
+  const double Y = 0.99558162689208984;
+  bool below_one = x < 1.0;
+  double y = below_one ? x + 1.0 : x;
+  // the sum of the 1 / y as a fraction, so that it takes a single division
+  double numerator = 0.0;
+  double denominator = 1.0;
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; i++) {
+    bool shift = y >= 2.0;
+    y -= shift ? 1.0 : 0.0;
+    numerator = shift ? numerator * y + denominator : numerator;
+    denominator *= shift ? y : 1.0;
+  }
+  numerator = below_one ? -1.0 : numerator;
+  denominator = below_one ? x : denominator;
+  double t = below_one ? x : y - 1.0;
+  double p = -0.0020713321167745952;
+  p = p * t - 0.045251321448739056;
+  p = p * t - 0.28919126444774784;
+  p = p * t - 0.65031853770896507;
+  p = p * t - 0.32555031186804491;
+  p = p * t + 0.25479851061131551;
+  double q = -0.55789841321675513e-6;
+  q = q * t + 0.0021284987017821144;
+  q = q * t + 0.054151797245674225;
+  q = q * t + 0.43593529692665969;
+  q = q * t + 1.4606242909763515;
+  q = q * t + 2.0767117023730469;
+  q = q * t + 1.0;
+  double g = ((y - root1) - root2) - root3;
+  double small = g * Y + g * (p / q) + numerator / denominator;
+
+  double inv_x = 1.0 / x;
+  double inv_x2 = inv_x * inv_x;
+  double s = 3617.0 / 8160.0;
+  s = s * inv_x2 - 1.0 / 12.0;
+  s = s * inv_x2 + 691.0 / 32760.0;
+  s = s * inv_x2 - 1.0 / 132.0;
+  s = s * inv_x2 + 1.0 / 240.0;
+  s = s * inv_x2 - 1.0 / 252.0;
+  s = s * inv_x2 + 1.0 / 120.0;
+  s = s * inv_x2 - 1.0 / 12.0;
+  double large = log(x) - 0.5 * inv_x + s * inv_x2;
+  return x < 10.0 ? small : large;
+}
+
+// trigamma(x) for x >= 0: x is shifted up to z >= 10, where the asymptotic
+// series is accurate, with
+// trigamma(x) = trigamma(z) + 1 / x^2 + 1 / (x + 1)^2 + ... + 1 / (z - 1)^2.
+BM_ALWAYS_INLINE double trigamma_nonnegative(double x) {
+  double z = x;
+  double shifted = 0.0;
+#pragma GCC unroll 10
+  for (int i = 0; i < 10; i++) {
+    bool shift = z < 10.0;
+    double inv = 1.0 / z;
+    shifted += shift ? inv * inv : 0.0;
+    z += shift ? 1.0 : 0.0;
+  }
+  double inv_z = 1.0 / z;
+  double inv_z2 = inv_z * inv_z;
+  double s = 43867.0 / 798.0;
+  s = s * inv_z2 - 3617.0 / 510.0;
+  s = s * inv_z2 + 7.0 / 6.0;
+  s = s * inv_z2 - 691.0 / 2730.0;
+  s = s * inv_z2 + 5.0 / 66.0;
+  s = s * inv_z2 - 1.0 / 30.0;
+  s = s * inv_z2 + 1.0 / 42.0;
+  s = s * inv_z2 - 1.0 / 30.0;
+  s = s * inv_z2 + 1.0 / 6.0;
+  return inv_z + inv_z2 * (0.5 + s * inv_z) + shifted;
+}
+
+} // namespace detail
+
+// log |Gamma(x)|
+BM_ALWAYS_INLINE double lgamma(double x) {
+  const double log_pi = 1.14472988584940017414;
+  const double inf = std::numeric_limits<double>::infinity();
+  bool negative = x < 0;
+  double positive = detail::lgamma_nonnegative(negative ? 1.0 - x : x);
+  // reflection: lgamma(x) = log(pi / |sin(pi x)|) - lgamma(1 - x)
+  double sin_pi_x = detail::sin_pi_reduced(detail::distance_to_integer(x));
+  double abs_sin_pi_x = sin_pi_x < 0 ? -sin_pi_x : sin_pi_x;
+  double reflected = log_pi - log(abs_sin_pi_x) - positive;
+  reflected = x == -inf ? inf : reflected;
+  return negative ? reflected : positive;
+}
+
+// The derivative of lgamma
+BM_ALWAYS_INLINE double digamma(double x) {
+  bool negative = x < 0;
+  double positive = detail::digamma_nonnegative(negative ? 1.0 - x : x);
+  // reflection: digamma(x) = digamma(1 - x) - pi cot(pi x)
+  double r = detail::distance_to_integer(x);
+  double cot_pi_x = detail::cos_pi_reduced(r) / detail::sin_pi_reduced(r);
+  double reflected = positive - M_PI * cot_pi_x;
+  // nan at the poles (nested selects, which vectorize better than a
+  // conjunction of the two comparisons)
+  double at_or_below_zero =
+      r == 0 ? std::numeric_limits<double>::quiet_NaN() : reflected;
+  return x <= 0 ? at_or_below_zero : positive;
+}
+
+// The second derivative of lgamma
+BM_ALWAYS_INLINE double trigamma(double x) {
+  bool negative = x < 0;
+  double positive = detail::trigamma_nonnegative(negative ? 1.0 - x : x);
+  // reflection: trigamma(x) = pi^2 / sin^2(pi x) - trigamma(1 - x)
+  double sin_pi_x = detail::sin_pi_reduced(detail::distance_to_integer(x));
+  double reflected = M_PI * M_PI / (sin_pi_x * sin_pi_x) - positive;
+  return negative ? reflected : positive;
+}
+
+// The cumulative distribution function of the standard Normal,
+// Phi(x) = erfc(-x / sqrt(2)) / 2.
+BM_ALWAYS_INLINE double Phi(double x) {
+  const detail::ErfTable& table = detail::kErfTable;
+  double z = -x * M_SQRT1_2;
+  double a = z < 0 ? -z : z;
+  double k =
+      double(a >= 0.5) + double(a >= 1.5) + double(a >= 2.5) + double(a >= 4.5);
+  double inv_a = 1.0 / a;
+  double t = k == 0
+      ? a * a
+      : (k == 4 ? inv_a : a - detail::select(table.shift, k));
+  double p = detail::select(table.p[6], k);
+  double q = detail::select(table.q[6], k);
+#pragma GCC unroll 6
+  for (int j = 5; j >= 0; j--) {
+    p = p * t + detail::select(table.p[j], k);
+    q = q * t + detail::select(table.q[j], k);
+  }
+  double r = detail::select(table.y, k) + p / q;
+  // exp(-a^2) = exp(-x^2 / 2), with the rounding error of x^2 (which the
+  // exponential would amplify by x^2) compensated; below -40, it is zero.
+  double xc = x < -40.0 ? -40.0 : (x > 40.0 ? 40.0 : x);
+  double x_sq = xc * xc;
+  double gaussian =
+      exp(-0.5 * x_sq) * (1.0 - 0.5 * detail::square_error(xc, x_sq));
+  double erf_a = a * r;
+  double erfc_a = r * gaussian * inv_a;
+  double erfc_z = k == 0 ? (z < 0 ? 1.0 + erf_a : 1.0 - erf_a)
+                         : (z < 0 ? 2.0 - erfc_a : erfc_a);
+  return 0.5 * erfc_z;
+}
+
+/*
+Batched versions: out[i] = f(x[i]) for i in [0, n). out may be x itself but
+must not otherwise overlap it.
+*/
+void exp(const double* x, std::size_t n, double* out);
+void log(const double* x, std::size_t n, double* out);
+void log1p(const double* x, std::size_t n, double* out);
+void log1pexp(const double* x, std::size_t n, double* out);
+void log1mexp(const double* x, std::size_t n, double* out);
+void lgamma(const double* x, std::size_t n, double* out);
+void digamma(const double* x, std::size_t n, double* out);
+void trigamma(const double* x, std::size_t n, double* out);
+void Phi(const double* x, std::size_t n, double* out);
+
+/*
+log(sum_i exp(x[i])) over x[0..n), computed stably by factoring out the
+maximum. Returns -inf for n = 0.
+*/
+double log_sum_exp(const double* x, std::size_t n);
+
+} // namespace special
+} // namespace beanmachine
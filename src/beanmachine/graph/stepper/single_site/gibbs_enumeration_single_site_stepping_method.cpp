@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "beanmachine/graph/distribution/distribution.h"
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/mh.h"
+#include "beanmachine/graph/profiler.h"
+
+#include "beanmachine/graph/stepper/single_site/gibbs_enumeration_single_site_stepping_method.h"
+
+namespace beanmachine {
+namespace graph {
+
+namespace {
+
+inline distribution::Distribution* distribution_of(Node* tgt_node) {
+  return static_cast<distribution::Distribution*>(tgt_node->in_nodes[0]);
+}
+
+// Sets the value of a boolean or natural node to the k-th value of its
+// support without reallocating the node value.
+inline void set_to_support_value(Node* tgt_node, natural_t k) {
+  if (tgt_node->value.type == AtomicType::BOOLEAN) {
+    tgt_node->value._bool = k != 0;
+  } else {
+    tgt_node->value._natural = k;
+  }
+}
+
+inline natural_t support_index(const Node* tgt_node) {
+  return tgt_node->value.type == AtomicType::BOOLEAN
+      ? static_cast<natural_t>(tgt_node->value._bool)
+      : tgt_node->value._natural;
+}
+
+} // namespace
+
+bool GibbsEnumerationSingleSiteSteppingMethod::is_applicable_to(
+    graph::Node* tgt_node) {
+  if (not tgt_node->is_stochastic() or
+      tgt_node->value.type.variable_type != VariableType::SCALAR or
+      (tgt_node->value.type != AtomicType::BOOLEAN and
+       tgt_node->value.type != AtomicType::NATURAL)) {
+    return false;
+  }
+  return distribution_of(tgt_node)->finite_support_size() > 0;
+}
+
+void GibbsEnumerationSingleSiteSteppingMethod::step(Node* tgt_node) {
+  auto graph = mh->graph;
+  graph->pd_begin(ProfilerEvent::NMC_STEP_ENUMERATE);
+
+  // The support size may depend on the values of stochastic parents
+  // (e.g. the number of trials of a binomial), so it is queried every step.
+  natural_t support_size = distribution_of(tgt_node)->finite_support_size();
+  natural_t old_index = support_index(tgt_node);
+  const std::vector<Node*>& det_nodes =
+      graph->get_det_affected_mutable_nodes(tgt_node);
+  const std::vector<Node*>& sto_nodes = graph->get_sto_affected_nodes(tgt_node);
+
+  log_weights.resize(support_size);
+  double max_log_weight = -std::numeric_limits<double>::infinity();
+  for (natural_t k = 0; k < support_size; k++) {
+    set_to_support_value(tgt_node, k);
+    graph->eval(det_nodes);
+    log_weights[k] = graph->compute_log_prob_of(sto_nodes);
+    max_log_weight = std::max(max_log_weight, log_weights[k]);
+  }
+
+  natural_t new_index = old_index;
+  if (max_log_weight > -std::numeric_limits<double>::infinity()) {
+    // sample from the normalized weights by inverting their cumulative sum
+    double total = 0;
+    for (double& weight : log_weights) {
+      weight = std::exp(weight - max_log_weight);
+      total += weight;
+    }
+    double u = std::uniform_real_distribution<double>(0, total)(mh->gen);
+    new_index = support_size - 1;
+    for (natural_t k = 0; k + 1 < support_size; k++) {
+      u -= log_weights[k];
+      if (u < 0) {
+        new_index = k;
+        break;
+      }
+    }
+  }
+  // Otherwise no value in the support has positive probability under the
+  // current values of the other nodes, and we keep the old value.
+
+  // the deterministic nodes currently reflect the last value of the support
+  if (new_index != support_size - 1) {
+    set_to_support_value(tgt_node, new_index);
+    graph->eval(det_nodes);
+  }
+
+  graph->pd_finish(ProfilerEvent::NMC_STEP_ENUMERATE);
+}
+
+} // namespace graph
+} // namespace beanmachine
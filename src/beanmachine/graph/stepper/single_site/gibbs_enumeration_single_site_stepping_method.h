@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <vector>
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/mh.h"
+#include "beanmachine/graph/stepper/single_site/single_site_stepping_method.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+ * A single-site stepping method sampling a discrete node exactly from its
+ * full conditional distribution (a Gibbs step).
+ * It applies to boolean and natural scalar nodes whose distribution has a
+ * finite support (see Distribution::finite_support_size).
+ * The full conditional is computed by enumerating the support: for each
+ * value, the deterministic affected nodes are re-evaluated and the log probs
+ * of the stochastic affected nodes (which include the node itself) are
+ * summed. The sampled value is always accepted.
+ */
+class GibbsEnumerationSingleSiteSteppingMethod
+    : public SingleSiteSteppingMethod {
+ public:
+  explicit GibbsEnumerationSingleSiteSteppingMethod(MH* mh)
+      : SingleSiteSteppingMethod(mh) {}
+
+  virtual bool is_applicable_to(graph::Node* tgt_node) override;
+
+  virtual void step(graph::Node* tgt_node) override;
+
+ private:
+  // Unnormalized log probabilities of the values in the support,
+  // reused across steps.
+  std::vector<double> log_weights;
+};
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/mh.h"
+#include "beanmachine/graph/operator/stochasticop.h"
+#include "beanmachine/graph/profiler.h"
+#include "beanmachine/graph/special_functions.h"
+#include "beanmachine/graph/util.h"
+
+#include "beanmachine/graph/stepper/single_site/nmc_dirichlet_gamma_block_single_site_stepping_method.h"
+
+namespace beanmachine {
+namespace graph {
+
+bool NMCDirichletGammaBlockSingleSiteSteppingMethod::is_applicable_to(
+    graph::Node* tgt_node) {
+  return tgt_node->value.type.variable_type ==
+      VariableType::COL_SIMPLEX_MATRIX and
+      tgt_node->value.type.rows >= MIN_DIMENSION;
+}
+
+/*
+As in the coordinate-wise method, Y ~ Dirichlet(alphas) is represented as
+Y = X / sum(X) with independent X_k ~ Gamma(alpha_k, 1), and Y is stored in
+value and X in unconstrained_value. Here the new X' is proposed as a whole
+from independent Gamma proposals for each X'_k (see create_proposal), and
+accepted or rejected at once.
+*/
+void NMCDirichletGammaBlockSingleSiteSteppingMethod::step(Node* tgt_node) {
+  auto graph = mh->graph;
+
+  graph->pd_begin(ProfilerEvent::NMC_STEP_DIRICHLET);
+
+  const std::vector<Node*>& det_affected_mutable_nodes =
+      graph->get_det_affected_mutable_nodes(tgt_node);
+
+  // Cast needed to access fields such as unconstrained_value:
+  auto sto_tgt_node = static_cast<oper::StochasticOperator*>(tgt_node);
+  // @lint-ignore CLANGTIDY
+  auto dirichlet_distribution_node = sto_tgt_node->in_nodes[0];
+  const Eigen::VectorXd param_a =
+      dirichlet_distribution_node->in_nodes[0]->value._matrix;
+
+  // Y, and therefore the rest of the graph, does not depend on the scale
+  // S = sum(X), which is independent of Y with distribution
+  // Gamma(sum(alphas), 1). We first draw it exactly, which costs O(K) and
+  // keeps S in the region where the proposals below are accurate.
+  std::gamma_distribution<double> scale(param_a.sum(), 1.0);
+  sto_tgt_node->unconstrained_value._matrix =
+      sto_tgt_node->value._matrix * scale(mh->gen);
+
+  // save old values
+  graph->save_old_values(det_affected_mutable_nodes);
+  const Eigen::VectorXd old_x = sto_tgt_node->unconstrained_value._matrix;
+  double old_log_prob = compute_log_prob(tgt_node, param_a);
+
+  // get proposal given old value and sample new value
+  auto proposal_given_old_value = create_proposal(tgt_node, param_a);
+  Eigen::VectorXd new_x(old_x.size());
+  for (uint k = 0; k < new_x.size(); k++) {
+    std::gamma_distribution<double> gamma(
+        proposal_given_old_value.shape(k),
+        1.0 / proposal_given_old_value.rate(k));
+    new_x(k) = gamma(mh->gen);
+  }
+  // Proposals with very small shapes can underflow to zero,
+  // which is outside the support; we simply reject those.
+  if (not(new_x.array() > 0).all()) {
+    graph->pd_finish(ProfilerEvent::NMC_STEP_DIRICHLET);
+    return;
+  }
+
+  // set and propagate new value
+  set_value(tgt_node, new_x);
+  graph->eval(det_affected_mutable_nodes);
+  double new_log_prob = compute_log_prob(tgt_node, param_a);
+
+  // obtain proposal given new value
+  auto proposal_given_new_value = create_proposal(tgt_node, param_a);
+
+  // compute acceptance probability
+  double logacc = new_log_prob - old_log_prob +
+      proposal_given_new_value.log_prob(old_x) -
+      proposal_given_old_value.log_prob(new_x);
+
+  // decide acceptance
+  bool accepted = util::flip_coin_with_log_prob(mh->gen, logacc);
+  if (!accepted) {
+    // revert
+    graph->restore_old_values(det_affected_mutable_nodes);
+    set_value(tgt_node, old_x);
+  }
+  graph->pd_finish(ProfilerEvent::NMC_STEP_DIRICHLET);
+}
+
+void NMCDirichletGammaBlockSingleSiteSteppingMethod::set_value(
+    Node* tgt_node,
+    const Eigen::VectorXd& x) {
+  auto sto_tgt_node = static_cast<oper::StochasticOperator*>(tgt_node);
+  sto_tgt_node->unconstrained_value._matrix = x;
+  sto_tgt_node->value._matrix = x / x.sum();
+}
+
+double NMCDirichletGammaBlockSingleSiteSteppingMethod::compute_log_prob(
+    Node* tgt_node,
+    const Eigen::VectorXd& param_a) {
+  auto graph = mh->graph;
+  double log_prob = 0;
+  for (Node* node : graph->get_sto_affected_nodes(tgt_node)) {
+    if (node == tgt_node) {
+      // X_k ~ Gamma(param_a_k, 1), up to the lgamma(param_a_k) terms,
+      // which do not depend on X
+      auto sto_tgt_node = static_cast<oper::StochasticOperator*>(tgt_node);
+      const auto& x = sto_tgt_node->unconstrained_value._matrix.array();
+      log_prob += ((param_a.array() - 1.0) * x.log() - x).sum();
+    } else {
+      log_prob += node->log_prob();
+    }
+  }
+  return log_prob;
+}
+
+/*
+Each X'_k is proposed from the Gamma distribution whose log density has the
+same first and second derivatives in X_k as the log prob at the current X,
+like the Gamma proposer of NMC.
+
+Reverse mode gives us the gradient g = dL/dY of the log prob L of the
+stochastic affected nodes in a single pass, but not its second derivatives.
+For those we take L to be locally of the form sum_k c_k log(Y_k), with
+c_k = g_k * Y_k so that its gradient matches g. This is exact when Y is the
+parameter of categorical or multinomial observations, which is the common
+case, and in any case only changes the proposal, not the stationary
+distribution. With C = sum_k c_k and S = sum_k X_k, the log prob of X is
+  sum_k (alpha_k - 1 + c_k) log(X_k) - X_k - C log(S)
+and matching derivatives yields
+  shape_k = alpha_k + c_k - C Y_k^2
+  rate_k = 1 + C (1 - Y_k) / S.
+Where these are not positive, the proposal falls back to the prior
+Gamma(alpha_k, 1).
+*/
+NMCDirichletGammaBlockSingleSiteSteppingMethod::Proposal
+NMCDirichletGammaBlockSingleSiteSteppingMethod::create_proposal(
+    Node* tgt_node,
+    const Eigen::VectorXd& param_a) {
+  auto graph = mh->graph;
+
+  graph->pd_begin(ProfilerEvent::NMC_CREATE_PROP_DIR);
+
+  // Reverse mode through the affected nodes, in reverse topological order.
+  std::vector<Node*> affected_nodes =
+      graph->get_det_affected_mutable_nodes(tgt_node);
+  const auto& sto_affected_nodes = graph->get_sto_affected_nodes(tgt_node);
+  affected_nodes.insert(
+      affected_nodes.end(),
+      sto_affected_nodes.begin(),
+      sto_affected_nodes.end());
+  std::sort(
+      affected_nodes.begin(), affected_nodes.end(), [](Node* a, Node* b) {
+        return a->index > b->index;
+      });
+  // Reverse mode also accumulates into the in-nodes of the affected nodes
+  // (or of their distributions), so those are reset as well.
+  auto reset_backgrad = [](Node* node) {
+    if (node->node_type != NodeType::CONSTANT and
+        node->node_type != NodeType::DISTRIBUTION) {
+      node->reset_backgrad();
+    }
+  };
+  for (Node* node : affected_nodes) {
+    reset_backgrad(node);
+    for (Node* in_node : node->in_nodes) {
+      reset_backgrad(in_node);
+      if (in_node->node_type == NodeType::DISTRIBUTION) {
+        for (Node* param_node : in_node->in_nodes) {
+          reset_backgrad(param_node);
+        }
+      }
+    }
+  }
+  for (Node* node : affected_nodes) {
+    if (node == tgt_node) {
+      continue;
+    }
+    if (node->is_stochastic() and node->node_type == NodeType::OPERATOR) {
+      static_cast<oper::StochasticOperator*>(node)->_backward(true);
+    } else {
+      node->backward();
+    }
+  }
+
+  auto sto_tgt_node = static_cast<oper::StochasticOperator*>(tgt_node);
+  const Eigen::ArrayXd y = sto_tgt_node->value._matrix.array();
+  const Eigen::ArrayXd c = tgt_node->back_grad1.array() * y;
+  double x_sum = sto_tgt_node->unconstrained_value._matrix.sum();
+  double c_sum = c.sum();
+
+  Proposal proposal;
+  proposal.shape = param_a.array() + c - c_sum * y.square();
+  proposal.rate = 1.0 + c_sum * (1.0 - y) / x_sum;
+  for (uint k = 0; k < proposal.shape.size(); k++) {
+    if (not(proposal.shape(k) > 0 and proposal.rate(k) > 0 and
+            std::isfinite(proposal.shape(k)) and
+            std::isfinite(proposal.rate(k)))) {
+      proposal.shape(k) = param_a(k);
+      proposal.rate(k) = 1.0;
+    }
+  }
+  graph->pd_finish(ProfilerEvent::NMC_CREATE_PROP_DIR);
+  return proposal;
+}
+
+double NMCDirichletGammaBlockSingleSiteSteppingMethod::Proposal::log_prob(
+    const Eigen::VectorXd& x) const {
+  double result = 0;
+  for (uint k = 0; k < x.size(); k++) {
+    result += shape(k) * std::log(rate(k)) +
+        (shape(k) - 1.0) * std::log(x(k)) - rate(k) * x(k) -
+        special::lgamma(shape(k));
+  }
+  return result;
+}
+
+} // namespace graph
+} // namespace beanmachine
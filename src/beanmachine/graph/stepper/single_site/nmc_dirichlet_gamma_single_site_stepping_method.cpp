@@ -20,6 +20,7 @@
 #include "beanmachine/graph/profiler.h"
 #include "beanmachine/graph/proposer/default_initializer.h"
 #include "beanmachine/graph/proposer/proposer.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 #include "beanmachine/graph/stepper/single_site/nmc_dirichlet_gamma_single_site_stepping_method.h"
@@ -130,7 +131,8 @@ NMCDirichletGammaSingleSiteSteppingMethod::compute_sto_affected_nodes_log_prob(
       // PDF of Gamma(a, 1) is x^(a - 1)exp(-x)/gamma(a)
       // so log pdf(x) = log(x^(a - 1)) + (-x) - log(gamma(a))
       // = (a - 1)*log(x) - x - log(gamma(a))
-      logweight += (param_a_k - 1.0) * std::log(x_k) - x_k - lgamma(param_a_k);
+      logweight += (param_a_k - 1.0) * std::log(x_k) - x_k -
+          special::lgamma(param_a_k);
     } else {
       logweight += node->log_prob();
     }
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/mh.h"
+#include "beanmachine/graph/profiler.h"
+#include "beanmachine/graph/proposer/proposer.h"
+
+#include "beanmachine/graph/stepper/single_site/nmc_matrix_single_site_stepping_method.h"
+
+namespace beanmachine {
+namespace graph {
+
+bool NMCMatrixSingleSiteSteppingMethod::is_applicable_to(
+    graph::Node* tgt_node) {
+  const ValueType& type = tgt_node->value.type;
+  return type.variable_type == VariableType::BROADCAST_MATRIX and
+      (type.atomic_type == AtomicType::REAL or
+       type.atomic_type == AtomicType::POS_REAL or
+       type.atomic_type == AtomicType::PROBABILITY);
+}
+
+ProfilerEvent NMCMatrixSingleSiteSteppingMethod::get_step_profiler_event() {
+  return ProfilerEvent::NMC_STEP;
+}
+
+// Returns the NMC proposal distribution conditioned on the
+// target node's current value.
+std::unique_ptr<proposer::Proposer>
+NMCMatrixSingleSiteSteppingMethod::get_proposal_distribution(Node* tgt_node) {
+  auto graph = mh->graph;
+
+  graph->pd_begin(ProfilerEvent::NMC_CREATE_PROP);
+
+  const auto& det_affected_mutable_nodes =
+      graph->get_det_affected_mutable_nodes(tgt_node);
+  const auto& sto_affected_nodes = graph->get_sto_affected_nodes(tgt_node);
+  const auto& value = tgt_node->value;
+  auto size = static_cast<uint>(value._matrix.size());
+  Eigen::MatrixXd grad1(value.type.rows, value.type.cols);
+  Eigen::MatrixXd grad2(value.type.rows, value.type.cols);
+  // Forward mode computes the derivatives with respect to a block of
+  // elements per sweep, each element being one direction.
+  std::vector<GradientDirection> directions;
+  Eigen::Array<double, BLOCK_SIZE, 1> block_grad1;
+  Eigen::Array<double, BLOCK_SIZE, 1> block_grad2;
+  for (uint start = 0; start < size; start += BLOCK_SIZE) {
+    directions.clear();
+    for (uint i = start; i < std::min(size, start + BLOCK_SIZE); i++) {
+      directions.push_back({tgt_node, i});
+    }
+    graph->compute_gradients_in_directions<BLOCK_SIZE>(
+        directions,
+        det_affected_mutable_nodes,
+        sto_affected_nodes,
+        block_grad1,
+        block_grad2);
+    for (uint j = 0; j < directions.size(); j++) {
+      grad1(start + j) = block_grad1(j);
+      grad2(start + j) = block_grad2(j);
+    }
+  }
+
+  std::unique_ptr<proposer::Proposer> prop =
+      proposer::nmc_elementwise_proposer(value, grad1, grad2);
+  graph->pd_finish(ProfilerEvent::NMC_CREATE_PROP);
+  return prop;
+}
+
+} // namespace graph
+} // namespace beanmachine
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/proposer/proposer.h"
+#include "beanmachine/graph/stepper/single_site/default_single_site_stepping_method.h"
+
+namespace beanmachine {
+namespace graph {
+
+/*
+NMC for real, positive real and probability matrix nodes (such as
+IID_SAMPLE latents). The whole matrix is updated in a single MH step from
+a proposal with independent elements, each from the NMC approximation of
+the log prob given its first and diagonal second derivatives
+(see proposer::nmc_elementwise_proposer).
+*/
+class NMCMatrixSingleSiteSteppingMethod
+    : public DefaultSingleSiteSteppingMethod {
+ public:
+  explicit NMCMatrixSingleSiteSteppingMethod(MH* mh)
+      : DefaultSingleSiteSteppingMethod(mh) {}
+
+  virtual bool is_applicable_to(graph::Node* tgt_node) override;
+
+  // The number of elements whose derivatives are computed per sweep.
+  static constexpr int BLOCK_SIZE = 8;
+
+ protected:
+  virtual std::unique_ptr<proposer::Proposer> get_proposal_distribution(
+      Node* tgt_node) override;
+
+  virtual ProfilerEvent get_step_profiler_event() override;
+};
+
+} // namespace graph
+} // namespace beanmachine
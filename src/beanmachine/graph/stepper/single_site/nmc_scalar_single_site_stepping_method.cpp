@@ -28,7 +28,9 @@ namespace graph {
 
 bool NMCScalarSingleSiteSteppingMethod::is_applicable_to(
     graph::Node* tgt_node) {
-  return tgt_node->value.type.variable_type == VariableType::SCALAR;
+  // natural nodes are left to GibbsEnumerationSingleSiteSteppingMethod
+  return tgt_node->value.type.variable_type == VariableType::SCALAR and
+      tgt_node->value.type != AtomicType::NATURAL;
 }
 
 ProfilerEvent NMCScalarSingleSiteSteppingMethod::get_step_profiler_event() {
@@ -71,7 +71,9 @@ void SequentialSingleSiteStepper::step() {
 }
 
 SequentialSingleSiteStepper::~SequentialSingleSiteStepper() {
-  for (auto stepper : get_steppers()) {
+  // Only delete the steppers made so far; making them here would throw
+  // if inference was aborted because some node is not supported.
+  for (auto stepper : steppers) {
     delete stepper;
   }
   for (auto single_site_stepping_method : single_site_stepping_methods) {
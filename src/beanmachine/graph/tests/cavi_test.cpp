@@ -10,6 +10,7 @@
 
 #include <array>
 #include <tuple>
+#include <utility>
 
 #include <gtest/gtest.h>
 
@@ -17,9 +18,9 @@
 
 using namespace beanmachine;
 
-TEST(testcavi, noisy_or) {
-  // see cavi_test.py:build_graph2 for an explanation of this model
-  graph::Graph g;
+// builds the model of cavi_test.py:build_graph2, returning the ids of the
+// two latent variables
+static std::pair<uint, uint> build_noisy_or(graph::Graph& g) {
   uint c_prior = g.add_constant_probability(0.01);
   uint d_prior = g.add_distribution(
       graph::DistributionType::BERNOULLI,
@@ -53,6 +54,13 @@ TEST(testcavi, noisy_or) {
   uint z =
       g.add_operator(graph::OperatorType::SAMPLE, std::vector<uint>({d_like}));
   g.observe(z, true);
+  return {x, y};
+}
+
+TEST(testcavi, noisy_or) {
+  graph::Graph g;
+  uint x, y;
+  std::tie(x, y) = build_noisy_or(g);
   g.query(x);
   g.query(y);
   // run CAVI on the above graph and verify the results
@@ -63,3 +71,22 @@ TEST(testcavi, noisy_or) {
   const auto& elbo = g.get_elbo();
   EXPECT_NEAR(elbo.back(), -3.7867, 0.1);
 }
+
+TEST(testcavi, noisy_or_threads) {
+  graph::Graph g;
+  uint x, y;
+  std::tie(x, y) = build_noisy_or(g);
+  g.query(x);
+  g.query(y);
+  const std::vector<std::vector<double>> parameters =
+      g.variational(100, 1000, 81391, 1000, 4);
+  EXPECT_NEAR(parameters[0][0], parameters[1][0], 0.1);
+  EXPECT_NEAR(parameters[0][0], 0.245, 0.1);
+  EXPECT_NEAR(g.get_elbo().back(), -3.7867, 0.1);
+  // the results only depend on the seed and the number of threads
+  graph::Graph g2(g);
+  EXPECT_EQ(g2.variational(100, 1000, 81391, 1000, 4), parameters);
+  EXPECT_EQ(g2.get_elbo(), g.get_elbo());
+  // threads may outnumber the steps
+  EXPECT_EQ(g2.variational(2, 3, 81391, 2, 8).size(), 2);
+}
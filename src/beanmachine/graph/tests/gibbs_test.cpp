@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine::graph;
+
+namespace {
+
+// A small noisy-or diagnosis network:
+//   d_i ~ Bernoulli(prior_i)                         for i in 0..2
+//   s_j ~ Noisy_or(leak + sum_i weight_ji * d_i)     for j in 0..1
+// with both symptoms observed true and all diseases queried.
+const double prior[3] = {0.1, 0.2, 0.3};
+const double weight[2][3] = {{1.5, 0.0, 0.7}, {0.0, 2.0, 0.9}};
+const double leak = 0.05;
+
+void make_diagnosis_network(Graph& g) {
+  std::vector<uint> diseases;
+  std::vector<uint> diseases_real;
+  for (uint i = 0; i < 3; i++) {
+    uint p = g.add_constant_probability(prior[i]);
+    uint dist = g.add_distribution(
+        DistributionType::BERNOULLI,
+        AtomicType::BOOLEAN,
+        std::vector<uint>({p}));
+    uint d = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({dist}));
+    diseases.push_back(d);
+    diseases_real.push_back(
+        g.add_operator(OperatorType::TO_POS_REAL, std::vector<uint>({d})));
+  }
+  for (uint j = 0; j < 2; j++) {
+    std::vector<uint> terms({g.add_constant_pos_real(leak)});
+    for (uint i = 0; i < 3; i++) {
+      if (weight[j][i] > 0) {
+        uint w = g.add_constant_pos_real(weight[j][i]);
+        terms.push_back(g.add_operator(
+            OperatorType::MULTIPLY, std::vector<uint>({w, diseases_real[i]})));
+      }
+    }
+    uint param = g.add_operator(OperatorType::ADD, terms);
+    uint dist = g.add_distribution(
+        DistributionType::BERNOULLI_NOISY_OR,
+        AtomicType::BOOLEAN,
+        std::vector<uint>({param}));
+    uint s = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({dist}));
+    g.observe(s, true);
+  }
+  for (uint d : diseases) {
+    g.query(d);
+  }
+}
+
+// Exact posterior marginals of the diseases by enumeration.
+std::vector<double> diagnosis_posterior() {
+  std::vector<double> marginals(3, 0.0);
+  double total = 0;
+  for (uint config = 0; config < 8; config++) {
+    double joint = 1;
+    for (uint i = 0; i < 3; i++) {
+      joint *= (config >> i) & 1 ? prior[i] : 1 - prior[i];
+    }
+    for (uint j = 0; j < 2; j++) {
+      double param = leak;
+      for (uint i = 0; i < 3; i++) {
+        param += ((config >> i) & 1) * weight[j][i];
+      }
+      joint *= 1 - std::exp(-param);
+    }
+    total += joint;
+    for (uint i = 0; i < 3; i++) {
+      marginals[i] += ((config >> i) & 1) * joint;
+    }
+  }
+  for (auto& marginal : marginals) {
+    marginal /= total;
+  }
+  return marginals;
+}
+
+} // namespace
+
+TEST(testgibbs, colored_parallel_sweep) {
+  Graph g;
+  make_diagnosis_network(g);
+  auto expected = diagnosis_posterior();
+  InferConfig config;
+  config.num_threads = 3;
+  auto& means = g.infer_mean(10000, InferenceType::GIBBS, 314, 2, config);
+  for (const auto& chain_means : means) {
+    for (uint i = 0; i < 3; i++) {
+      EXPECT_NEAR(chain_means[i], expected[i], 0.03);
+    }
+  }
+  // the sequential sweep agrees
+  auto& serial_means = g.infer_mean(10000, InferenceType::GIBBS, 314);
+  for (uint i = 0; i < 3; i++) {
+    EXPECT_NEAR(serial_means[i], expected[i], 0.03);
+  }
+}
+
+TEST(testgibbs, colored_parallel_sweep_shared_mixture) {
+  // z_i ~ Bernoulli(0.5)
+  // y_i ~ Bimixture(z_i ? 0.8 : 0.2, Beta(2, 5), Beta(5, 2)), observed
+  // The z_i share no affected nodes, so they all have the same color and
+  // the two Beta components, and their cached normalizers, are evaluated by
+  // all the threads at once.
+  Graph g;
+  uint half = g.add_constant_probability(0.5);
+  uint high = g.add_constant_probability(0.8);
+  uint low = g.add_constant_probability(0.2);
+  auto beta = [&](double a, double b) {
+    return g.add_distribution(
+        DistributionType::BETA,
+        AtomicType::PROBABILITY,
+        std::vector<uint>(
+            {g.add_constant_pos_real(a), g.add_constant_pos_real(b)}));
+  };
+  uint beta1 = beta(2, 5);
+  uint beta2 = beta(5, 2);
+  uint prior = g.add_distribution(
+      DistributionType::BERNOULLI,
+      AtomicType::BOOLEAN,
+      std::vector<uint>({half}));
+  const uint n = 40;
+  std::vector<double> expected;
+  for (uint i = 0; i < n; i++) {
+    uint z = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({prior}));
+    uint p = g.add_operator(
+        OperatorType::IF_THEN_ELSE, std::vector<uint>({z, high, low}));
+    uint mixture = g.add_distribution(
+        DistributionType::BIMIXTURE,
+        AtomicType::PROBABILITY,
+        std::vector<uint>({p, beta1, beta2}));
+    uint y = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({mixture}));
+    double value = (i + 0.5) / n;
+    g.observe(y, value);
+    g.query(z);
+    // Beta(2, 5) and Beta(5, 2) densities up to the same constant
+    double f1 = value * std::pow(1 - value, 4);
+    double f2 = std::pow(value, 4) * (1 - value);
+    double like_true = 0.8 * f1 + 0.2 * f2;
+    double like_false = 0.2 * f1 + 0.8 * f2;
+    expected.push_back(like_true / (like_true + like_false));
+  }
+  InferConfig config;
+  config.num_threads = 4;
+  auto& means = g.infer_mean(4000, InferenceType::GIBBS, 99, 1, config);
+  for (uint i = 0; i < n; i++) {
+    EXPECT_NEAR(means[0][i], expected[i], 0.05);
+  }
+}
+
+TEST(testgibbs, bit_parallel) {
+  Graph g;
+  make_diagnosis_network(g);
+  auto expected = diagnosis_posterior();
+  InferConfig config;
+  config.bit_parallel_gibbs = true;
+  config.keep_log_prob = true;
+  uint n_chains = 64;
+  auto& samples = g.infer(500, InferenceType::GIBBS, 271, n_chains, config);
+  ASSERT_EQ(samples.size(), n_chains);
+  std::vector<double> sums(3, 0.0);
+  for (const auto& chain : samples) {
+    ASSERT_EQ(chain.size(), 500);
+    for (const auto& sample : chain) {
+      for (uint i = 0; i < 3; i++) {
+        ASSERT_EQ(sample[i].type, AtomicType::BOOLEAN);
+        sums[i] += sample[i]._bool;
+      }
+    }
+  }
+  for (uint i = 0; i < 3; i++) {
+    EXPECT_NEAR(sums[i] / (500 * n_chains), expected[i], 0.02);
+  }
+  auto& log_probs = g.get_log_prob();
+  ASSERT_EQ(log_probs.size(), n_chains);
+  EXPECT_EQ(log_probs[0].size(), 500);
+  for (double log_prob : log_probs[0]) {
+    EXPECT_LT(log_prob, 0);
+  }
+
+  // infer_mean aggregates each chain separately
+  auto& means = g.infer_mean(2000, InferenceType::GIBBS, 271, 4, config);
+  ASSERT_EQ(means.size(), 4);
+  for (uint i = 0; i < 3; i++) {
+    EXPECT_NEAR(means[0][i], expected[i], 0.05);
+  }
+}
+
+TEST(testgibbs, bit_parallel_tabular) {
+  // a ~ Bernoulli(0.4); b ~ Tabular(a); observe b = true.
+  // P(b | a) = 0.9 and P(b | not a) = 0.2, so
+  // P(a | b) = 0.36 / (0.36 + 0.12) = 0.75
+  Graph g;
+  uint p = g.add_constant_probability(0.4);
+  uint prior = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p}));
+  uint a = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({prior}));
+  Eigen::MatrixXd cpt(2, 2);
+  cpt << 0.8, 0.1, 0.2, 0.9;
+  uint table = g.add_constant_col_simplex_matrix(cpt);
+  uint like = g.add_distribution(
+      DistributionType::TABULAR,
+      AtomicType::BOOLEAN,
+      std::vector<uint>({table, a}));
+  uint b = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({like}));
+  g.observe(b, true);
+  g.query(a);
+  InferConfig config;
+  config.bit_parallel_gibbs = true;
+  auto& means = g.infer_mean(1000, InferenceType::GIBBS, 17, 64, config);
+  double mean = 0;
+  for (const auto& chain_means : means) {
+    mean += chain_means[0] / 64;
+  }
+  EXPECT_NEAR(mean, 0.75, 0.02);
+  // at most one chain per bit
+  EXPECT_THROW(
+      g.infer(10, InferenceType::GIBBS, 17, 65, config), std::invalid_argument);
+}
+
+TEST(testgibbs, bit_parallel_unsupported) {
+  Graph g;
+  uint p = g.add_constant_probability(0.4);
+  uint prior = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p}));
+  uint a = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({prior}));
+  uint a_real = g.add_operator(OperatorType::TO_REAL, std::vector<uint>({a}));
+  uint one = g.add_constant_pos_real(1.0);
+  uint normal = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({a_real, one}));
+  uint x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({normal}));
+  g.observe(x, 0.5);
+  g.query(a);
+  InferConfig config;
+  config.bit_parallel_gibbs = true;
+  EXPECT_THROW(
+      g.infer(10, InferenceType::GIBBS, 17, 4, config), std::invalid_argument);
+}
+
+TEST(testgibbs, bit_parallel_unsupported_query) {
+  Graph g;
+  uint p = g.add_constant_probability(0.4);
+  uint prior = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p}));
+  uint a = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({prior}));
+  uint n = g.add_constant_natural(3);
+  g.query(a);
+  g.query(n);
+  InferConfig config;
+  config.bit_parallel_gibbs = true;
+  EXPECT_THROW(
+      g.infer(10, InferenceType::GIBBS, 17, 4, config), std::invalid_argument);
+}
+
+TEST(testgibbs, categorical_and_binomial) {
+  // z ~ Categorical([0.2, 0.5, 0.3])
+  // k ~ Binomial(4, 0.4)
+  // x ~ Normal(z + k, 1) observed 3.0
+  Graph g;
+  Eigen::MatrixXd z_probs(3, 1);
+  z_probs << 0.2, 0.5, 0.3;
+  uint simplex = g.add_constant_col_simplex_matrix(z_probs);
+  uint z_dist = g.add_distribution(
+      DistributionType::CATEGORICAL,
+      AtomicType::NATURAL,
+      std::vector<uint>({simplex}));
+  uint z = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({z_dist}));
+  uint n = g.add_constant_natural(4);
+  uint p = g.add_constant_probability(0.4);
+  uint k_dist = g.add_distribution(
+      DistributionType::BINOMIAL,
+      AtomicType::NATURAL,
+      std::vector<uint>({n, p}));
+  uint k = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({k_dist}));
+  uint mean = g.add_operator(
+      OperatorType::ADD,
+      std::vector<uint>(
+          {g.add_operator(OperatorType::TO_REAL, std::vector<uint>({z})),
+           g.add_operator(OperatorType::TO_REAL, std::vector<uint>({k}))}));
+  uint one = g.add_constant_pos_real(1.0);
+  uint x_dist = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({mean, one}));
+  uint x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({x_dist}));
+  g.observe(x, 3.0);
+  g.query(z);
+  g.query(k);
+
+  // exact posterior means by enumeration
+  double total = 0;
+  double z_mean = 0;
+  double k_mean = 0;
+  double binomial_coefficient[5] = {1, 4, 6, 4, 1};
+  for (uint zv = 0; zv < 3; zv++) {
+    for (uint kv = 0; kv <= 4; kv++) {
+      double joint = z_probs(zv, 0) * binomial_coefficient[kv] *
+          std::pow(0.4, kv) * std::pow(0.6, 4 - kv) *
+          std::exp(-0.5 * std::pow(3.0 - zv - kv, 2));
+      total += joint;
+      z_mean += zv * joint;
+      k_mean += kv * joint;
+    }
+  }
+  z_mean /= total;
+  k_mean /= total;
+
+  auto& means = g.infer_mean(10000, InferenceType::GIBBS, 23);
+  EXPECT_NEAR(means[0], z_mean, 0.05);
+  EXPECT_NEAR(means[1], k_mean, 0.05);
+
+  auto& samples = g.infer(10, InferenceType::GIBBS, 23);
+  for (const auto& sample : samples) {
+    ASSERT_EQ(sample[0].type, AtomicType::NATURAL);
+    EXPECT_LT(sample[0]._natural, 3);
+    EXPECT_LE(sample[1]._natural, 4);
+  }
+}
+
+TEST(testgibbs, unsupported_variable) {
+  // continuous random variables are not supported
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint normal = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({zero, one}));
+  uint x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({normal}));
+  g.query(x);
+  EXPECT_THROW(g.infer(10, InferenceType::GIBBS), std::runtime_error);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine::graph;
+
+TEST(testlikelihoodweighting, continuous_evidence) {
+  // a ~ Bernoulli(0.3)
+  // x ~ Normal(a ? 2 : 0, 1) observed 1.5
+  Graph g;
+  uint p = g.add_constant_probability(0.3);
+  uint a_dist = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p}));
+  uint a = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({a_dist}));
+  uint two = g.add_constant_real(2.0);
+  uint zero = g.add_constant_real(0.0);
+  uint mean = g.add_operator(
+      OperatorType::IF_THEN_ELSE, std::vector<uint>({a, two, zero}));
+  uint one = g.add_constant_pos_real(1.0);
+  uint x_dist = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({mean, one}));
+  uint x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({x_dist}));
+  g.observe(x, 1.5);
+  g.query(a);
+  double like_true = 0.3 * std::exp(-0.5 * 0.25);
+  double like_false = 0.7 * std::exp(-0.5 * 2.25);
+  double expected = like_true / (like_true + like_false);
+
+  auto& means = g.infer_mean(20000, InferenceType::LIKELIHOOD_WEIGHTING, 17);
+  EXPECT_NEAR(means[0], expected, 0.015);
+
+  // weighted samples
+  auto& samples = g.infer(20000, InferenceType::LIKELIHOOD_WEIGHTING, 17);
+  ASSERT_EQ(samples.size(), 20000);
+  auto& log_weights = g.get_log_weights();
+  ASSERT_EQ(log_weights.size(), 1);
+  ASSERT_EQ(log_weights[0].size(), 20000);
+  double total = 0;
+  double weighted_sum = 0;
+  for (uint i = 0; i < samples.size(); i++) {
+    double weight = std::exp(log_weights[0][i]);
+    // the weight is the likelihood of x given a
+    double z = 1.5 - (samples[i][0]._bool ? 2.0 : 0.0);
+    EXPECT_NEAR(weight, std::exp(-0.5 * z * z) / std::sqrt(2 * M_PI), 1e-9);
+    total += weight;
+    weighted_sum += weight * samples[i][0]._bool;
+  }
+  EXPECT_NEAR(weighted_sum / total, means[0], 1e-9);
+  auto ess = g.get_effective_sample_size();
+  ASSERT_EQ(ess.size(), 1);
+  EXPECT_GT(ess[0], 10000);
+  EXPECT_LT(ess[0], 20000);
+
+  // threads within each of two chains
+  InferConfig config;
+  config.num_threads = 3;
+  auto& chain_means = g.infer_mean(
+      20000, InferenceType::LIKELIHOOD_WEIGHTING, 17, 2, config);
+  for (const auto& chain_mean : chain_means) {
+    EXPECT_NEAR(chain_mean[0], expected, 0.015);
+  }
+  EXPECT_EQ(g.get_log_weights().size(), 2);
+  EXPECT_EQ(g.get_log_weights()[1].size(), 20000);
+}
+
+TEST(testlikelihoodweighting, beta_binomial) {
+  // p ~ Beta(2, 3), k ~ Binomial(5, p) observed 2, so p | k ~ Beta(4, 6)
+  Graph g;
+  uint a = g.add_constant_pos_real(2.0);
+  uint b = g.add_constant_pos_real(3.0);
+  uint prior = g.add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      std::vector<uint>({a, b}));
+  uint prob = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({prior}));
+  uint n = g.add_constant_natural(5);
+  uint like = g.add_distribution(
+      DistributionType::BINOMIAL,
+      AtomicType::NATURAL,
+      std::vector<uint>({n, prob}));
+  uint k = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({like}));
+  g.observe(k, (natural_t)2);
+  g.query(prob);
+  InferConfig config;
+  config.num_threads = 2;
+  config.keep_log_prob = true;
+  auto& means = g.infer_mean(
+      20000, InferenceType::LIKELIHOOD_WEIGHTING, 31, 1, config);
+  EXPECT_NEAR(means[0][0], 0.4, 0.01);
+  EXPECT_EQ(g.get_log_prob()[0].size(), 20000);
+}
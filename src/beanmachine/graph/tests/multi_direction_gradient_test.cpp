@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "beanmachine/graph/graph.h"
+
+using namespace beanmachine::graph;
+
+namespace {
+
+// All deterministic operators (in topological order) and stochastic nodes
+// of the graph, after evaluating the deterministic ones.
+void eval_all(
+    Graph& g,
+    std::vector<Node*>& det_nodes,
+    std::vector<Node*>& sto_nodes) {
+  std::mt19937 generator(12131);
+  for (const auto& node : g.nodes) {
+    if (node->is_stochastic()) {
+      sto_nodes.push_back(node.get());
+    } else if (node->node_type == NodeType::OPERATOR) {
+      node->eval(generator);
+      det_nodes.push_back(node.get());
+    }
+  }
+}
+
+} // namespace
+
+TEST(testgradient, multi_direction_scalar_block) {
+  /*
+  Model:
+    x ~ Normal(0, 2)
+    s ~ Gamma(2, 2)
+    y ~ Normal(x * s + x, s)
+    z ~ Normal(y, exp(x)), observed
+  */
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint two = g.add_constant_pos_real(2.0);
+  uint x = g.add_operator(
+      OperatorType::SAMPLE,
+      std::vector<uint>{g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{zero, two})});
+  uint s = g.add_operator(
+      OperatorType::SAMPLE,
+      std::vector<uint>{g.add_distribution(
+          DistributionType::GAMMA,
+          AtomicType::POS_REAL,
+          std::vector<uint>{two, two})});
+  uint s_real = g.add_operator(OperatorType::TO_REAL, std::vector<uint>{s});
+  uint xs =
+      g.add_operator(OperatorType::MULTIPLY, std::vector<uint>{x, s_real});
+  uint mean = g.add_operator(OperatorType::ADD, std::vector<uint>{xs, x});
+  uint y = g.add_operator(
+      OperatorType::SAMPLE,
+      std::vector<uint>{g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{mean, s})});
+  uint scale = g.add_operator(OperatorType::EXP, std::vector<uint>{x});
+  uint z = g.add_operator(
+      OperatorType::SAMPLE,
+      std::vector<uint>{g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{y, scale})});
+  g.observe(z, 0.7);
+  g.nodes[x]->value = NodeValue(0.4);
+  g.nodes[s]->value = NodeValue(AtomicType::POS_REAL, 1.5);
+  g.nodes[y]->value = NodeValue(-0.3);
+
+  std::vector<Node*> det_nodes;
+  std::vector<Node*> sto_nodes;
+  eval_all(g, det_nodes, sto_nodes);
+
+  std::vector<uint> block = {x, s, y};
+  std::vector<double> expected_grad1;
+  std::vector<double> expected_grad2;
+  for (uint node : block) {
+    double grad1;
+    double grad2;
+    g.gradient_log_prob(node, grad1, grad2);
+    expected_grad1.push_back(grad1);
+    expected_grad2.push_back(grad2);
+  }
+
+  std::vector<GradientDirection> directions;
+  for (uint node : block) {
+    directions.push_back({g.nodes[node].get()});
+  }
+  // with m = 4 and m = 16 the local derivatives of every node are read off
+  // and applied to all directions
+  Eigen::Array<double, 4, 1> grad1_4, grad2_4;
+  g.compute_gradients_in_directions<4>(
+      directions, det_nodes, sto_nodes, grad1_4, grad2_4);
+  Eigen::Array<double, 16, 1> grad1_16, grad2_16;
+  g.compute_gradients_in_directions<16>(
+      directions, det_nodes, sto_nodes, grad1_16, grad2_16);
+  for (uint j = 0; j < block.size(); j++) {
+    EXPECT_NEAR(grad1_4(j), expected_grad1[j], 1e-6);
+    EXPECT_NEAR(grad2_4(j), expected_grad2[j], 1e-6);
+    EXPECT_NEAR(grad1_16(j), expected_grad1[j], 1e-6);
+    EXPECT_NEAR(grad2_16(j), expected_grad2[j], 1e-6);
+  }
+  EXPECT_EQ(grad1_4(3), 0);
+  EXPECT_EQ(grad2_4(3), 0);
+
+  // the gradients are cleared on return
+  for (Node* node : det_nodes) {
+    EXPECT_EQ(node->grad1, 0);
+    EXPECT_EQ(node->grad2, 0);
+  }
+
+  // with m = 2 the nodes with two varying inputs are called per direction
+  Eigen::Array<double, 2, 1> grad1_2, grad2_2;
+  g.compute_gradients_in_directions<2>(
+      {directions[0], directions[2]}, det_nodes, sto_nodes, grad1_2, grad2_2);
+  EXPECT_NEAR(grad1_2(0), expected_grad1[0], 1e-6);
+  EXPECT_NEAR(grad2_2(0), expected_grad2[0], 1e-6);
+  EXPECT_NEAR(grad1_2(1), expected_grad1[2], 1e-6);
+  EXPECT_NEAR(grad2_2(1), expected_grad2[2], 1e-6);
+  EXPECT_THROW(
+      g.compute_gradients_in_directions<2>(
+          directions, det_nodes, sto_nodes, grad1_2, grad2_2),
+      std::invalid_argument);
+}
+
+TEST(testgradient, multi_direction_matrix_elements) {
+  /*
+  Model:
+    x ~ Normal(0, 1) iid, 2 x 1
+    y_i ~ Normal(x_i, 1), observed
+    z ~ Normal(x_0 * x_1, 1), observed
+  Log prob:
+    -x_0^2/2 - x_1^2/2 - sum_i (y_i - x_i)^2/2 - (z - x_0 x_1)^2/2
+  */
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{zero, one});
+  uint x = g.add_operator(
+      OperatorType::IID_SAMPLE,
+      std::vector<uint>{prior, g.add_constant_natural(2)});
+  std::vector<double> xs = {0.5, -1.5};
+  std::vector<double> ys = {1.0, 2.0};
+  double z_value = 0.25;
+  std::vector<uint> x_elements;
+  for (uint i = 0; i < 2; i++) {
+    uint x_i = g.add_operator(
+        OperatorType::INDEX, std::vector<uint>{x, g.add_constant_natural(i)});
+    x_elements.push_back(x_i);
+    uint y_i = g.add_operator(
+        OperatorType::SAMPLE,
+        std::vector<uint>{g.add_distribution(
+            DistributionType::NORMAL,
+            AtomicType::REAL,
+            std::vector<uint>{x_i, one})});
+    g.observe(y_i, ys[i]);
+  }
+  uint product = g.add_operator(OperatorType::MULTIPLY, x_elements);
+  uint z = g.add_operator(
+      OperatorType::SAMPLE,
+      std::vector<uint>{g.add_distribution(
+          DistributionType::NORMAL,
+          AtomicType::REAL,
+          std::vector<uint>{product, one})});
+  g.observe(z, z_value);
+  Eigen::MatrixXd x_value(2, 1);
+  x_value << xs[0], xs[1];
+  g.nodes[x]->value = NodeValue(g.nodes[x]->value.type, x_value);
+
+  std::vector<Node*> det_nodes;
+  std::vector<Node*> sto_nodes;
+  eval_all(g, det_nodes, sto_nodes);
+  Eigen::Array<double, 4, 1> grad1, grad2;
+  g.compute_gradients_in_directions<4>(
+      {{g.nodes[x].get(), 0}, {g.nodes[x].get(), 1}},
+      det_nodes,
+      sto_nodes,
+      grad1,
+      grad2);
+  for (uint i = 0; i < 2; i++) {
+    double other = xs[1 - i];
+    double residual = z_value - xs[0] * xs[1];
+    EXPECT_NEAR(grad1(i), -xs[i] + (ys[i] - xs[i]) + residual * other, 1e-6);
+    EXPECT_NEAR(grad2(i), -2 - other * other, 1e-6);
+  }
+  EXPECT_EQ(grad1(2), 0);
+  EXPECT_EQ(grad2(3), 0);
+}
@@ -6,6 +6,8 @@
  */
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
 #include <random>
 
 #include "beanmachine/graph/graph.h"
@@ -430,6 +432,234 @@ TEST(testnmc, dirichlet_gamma) {
   EXPECT_NEAR(var(2), 0.4 * 0.6 / 6.0, 0.01);
 }
 
+namespace {
+
+/*
+Model:
+  p ~ Dirichlet(1, ..., K)
+  y_1, ..., y_n ~ Categorical(p) iid
+Data:
+  y_i = i mod 3 * K / 4
+Posterior:
+  p ~ Dirichlet(alpha) with alpha_k = k + 1 + |{i : y_i = k}|
+*/
+Graph categorical_dirichlet_graph(
+    uint K,
+    uint n,
+    uint& p,
+    Eigen::MatrixXd& posterior_alpha) {
+  Graph g;
+  Eigen::MatrixXd alpha(K, 1);
+  for (uint k = 0; k < K; k++) {
+    alpha(k) = k + 1;
+  }
+  uint alphas = g.add_constant_pos_matrix(alpha);
+  uint dirich_dist = g.add_distribution(
+      DistributionType::DIRICHLET,
+      ValueType(
+          VariableType::COL_SIMPLEX_MATRIX, AtomicType::PROBABILITY, K, 1),
+      std::vector<uint>{alphas});
+  p = g.add_operator(OperatorType::SAMPLE, std::vector<uint>{dirich_dist});
+  uint cat_dist = g.add_distribution(
+      DistributionType::CATEGORICAL, AtomicType::NATURAL, std::vector<uint>{p});
+  uint y = g.add_operator(
+      OperatorType::IID_SAMPLE,
+      std::vector<uint>{cat_dist, g.add_constant_natural(n)});
+  Eigen::MatrixXn ys(n, 1);
+  posterior_alpha = alpha;
+  for (uint i = 0; i < n; i++) {
+    ys(i) = i % 3 * K / 4;
+    posterior_alpha(ys(i)) += 1;
+  }
+  g.observe(y, ys);
+  g.query(p);
+  return g;
+}
+
+} // namespace
+
+TEST(testnmc, dirichlet_gamma_block) {
+  // large enough for NMCDirichletGammaBlockSingleSiteSteppingMethod
+  const uint K = 20;
+  uint p;
+  Eigen::MatrixXd alpha;
+  Graph g = categorical_dirichlet_graph(K, 60, p, alpha);
+
+  int num_samples = 4000;
+  std::vector<std::vector<NodeValue>> samples =
+      g.infer(num_samples, InferenceType::NMC);
+  Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(K, 1);
+  for (const auto& s : samples) {
+    sum += s[0]._matrix;
+  }
+  Eigen::MatrixXd mean = sum / num_samples;
+  Eigen::MatrixXd expected_mean = alpha / alpha.sum();
+  for (uint k = 0; k < K; k++) {
+    EXPECT_NEAR(mean(k), expected_mean(k), 0.01);
+  }
+}
+
+TEST(testnmc, DISABLED_dirichlet_gamma_block_benchmark) {
+  const uint K = 2000;
+  uint p;
+  Eigen::MatrixXd alpha;
+  Graph g = categorical_dirichlet_graph(K, 10000, p, alpha);
+
+  int num_samples = 100;
+  auto start = std::chrono::steady_clock::now();
+  g.infer(num_samples, InferenceType::NMC);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "Dirichlet(" << K << ") updates per second: "
+            << num_samples / elapsed.count() << std::endl;
+}
+
+TEST(testnmc, matrix_normal) {
+  /*
+  Model:
+    x ~ Normal(0, 1) iid, 5 x 1
+    y_i ~ Normal(x_i, 0.5)
+  Posterior:
+    x_i ~ Normal(0.8 y_i, sqrt(0.2))
+  */
+  Graph g;
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint half = g.add_constant_pos_real(0.5);
+  uint prior = g.add_distribution(
+      DistributionType::NORMAL, AtomicType::REAL, std::vector<uint>{zero, one});
+  const uint n = 5;
+  uint x = g.add_operator(
+      OperatorType::IID_SAMPLE,
+      std::vector<uint>{prior, g.add_constant_natural(n)});
+  std::vector<double> ys = {-2.0, -0.5, 0.0, 1.0, 3.0};
+  for (uint i = 0; i < n; i++) {
+    uint x_i = g.add_operator(
+        OperatorType::INDEX, std::vector<uint>{x, g.add_constant_natural(i)});
+    uint likelihood = g.add_distribution(
+        DistributionType::NORMAL,
+        AtomicType::REAL,
+        std::vector<uint>{x_i, half});
+    uint y_i =
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>{likelihood});
+    g.observe(y_i, ys[i]);
+  }
+  g.query(x);
+
+  int num_samples = 2000;
+  std::vector<std::vector<NodeValue>> samples =
+      g.infer(num_samples, InferenceType::NMC);
+  Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(n, 1);
+  Eigen::MatrixXd sum_sq = Eigen::MatrixXd::Zero(n, 1);
+  for (const auto& sample : samples) {
+    sum += sample[0]._matrix;
+    sum_sq += sample[0]._matrix.array().square().matrix();
+  }
+  for (uint i = 0; i < n; i++) {
+    double mean = sum(i) / num_samples;
+    EXPECT_NEAR(mean, 0.8 * ys[i], 0.05);
+    EXPECT_NEAR(sum_sq(i) / num_samples - mean * mean, 0.2, 0.03);
+  }
+}
+
+TEST(testnmc, matrix_gamma_poisson) {
+  /*
+  Model:
+    x ~ Gamma(2, 1) iid, 4 x 1
+    y_i ~ Poisson(x_i)
+  Posterior:
+    x_i ~ Gamma(2 + y_i, 2)
+  */
+  Graph g;
+  uint two = g.add_constant_pos_real(2.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint prior = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{two, one});
+  const uint n = 4;
+  uint x = g.add_operator(
+      OperatorType::IID_SAMPLE,
+      std::vector<uint>{prior, g.add_constant_natural(n)});
+  std::vector<natural_t> ys = {0, 1, 3, 8};
+  for (uint i = 0; i < n; i++) {
+    uint x_i = g.add_operator(
+        OperatorType::INDEX, std::vector<uint>{x, g.add_constant_natural(i)});
+    uint likelihood = g.add_distribution(
+        DistributionType::POISSON, AtomicType::NATURAL, std::vector<uint>{x_i});
+    uint y_i =
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>{likelihood});
+    g.observe(y_i, ys[i]);
+  }
+  g.query(x);
+
+  int num_samples = 2000;
+  std::vector<std::vector<NodeValue>> samples =
+      g.infer(num_samples, InferenceType::NMC);
+  Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(n, 1);
+  for (const auto& sample : samples) {
+    sum += sample[0]._matrix;
+  }
+  for (uint i = 0; i < n; i++) {
+    EXPECT_NEAR(sum(i) / num_samples, (2.0 + ys[i]) / 2.0, 0.1);
+  }
+}
+
+TEST(testnmc, matrix_non_finite_gradients) {
+  /*
+  Model:
+    x ~ Gamma(2, 1) iid, 3 x 1
+    y_i ~ Normal(|log(x_i)|, 1)
+  The absolute value is computed as (log(x_i) ** 2) ** 0.5, whose gradients
+  are not finite at the initial value x_i = 1, so that every element starts
+  from the fallback random walk of the elementwise proposer.
+  The posterior means are computed by numerical integration.
+  */
+  Graph g;
+  uint two = g.add_constant_pos_real(2.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint half = g.add_constant_pos_real(0.5);
+  uint prior = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>{two, one});
+  const uint n = 3;
+  uint x = g.add_operator(
+      OperatorType::IID_SAMPLE,
+      std::vector<uint>{prior, g.add_constant_natural(n)});
+  std::vector<double> ys = {0.2, 0.5, 1.0};
+  for (uint i = 0; i < n; i++) {
+    uint x_i = g.add_operator(
+        OperatorType::INDEX, std::vector<uint>{x, g.add_constant_natural(i)});
+    uint log_x_i = g.add_operator(OperatorType::LOG, std::vector<uint>{x_i});
+    uint square =
+        g.add_operator(OperatorType::POW, std::vector<uint>{log_x_i, two});
+    uint abs_log_x_i =
+        g.add_operator(OperatorType::POW, std::vector<uint>{square, half});
+    uint likelihood = g.add_distribution(
+        DistributionType::NORMAL,
+        AtomicType::REAL,
+        std::vector<uint>{abs_log_x_i, one});
+    uint y_i =
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>{likelihood});
+    g.observe(y_i, ys[i]);
+  }
+  g.query(x);
+
+  int num_samples = 4000;
+  std::vector<std::vector<NodeValue>> samples =
+      g.infer(num_samples, InferenceType::NMC);
+  Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(n, 1);
+  for (const auto& sample : samples) {
+    ASSERT_TRUE(sample[0]._matrix.allFinite());
+    sum += sample[0]._matrix;
+  }
+  std::vector<double> expected = {1.735, 1.840, 2.041};
+  for (uint i = 0; i < n; i++) {
+    EXPECT_NEAR(sum(i) / num_samples, expected[i], 0.15);
+  }
+}
+
 TEST(testnmc, warmup) {
   Graph g;
   uint flat_dist =
@@ -455,3 +685,114 @@ TEST(testnmc, warmup) {
   samples = g.infer(num_samples, InferenceType::NMC, 17, 1, infer_config);
   EXPECT_EQ(samples[0].size(), 300);
 }
+
+TEST(testnmc, categorical_mixture) {
+  // A categorical latent mixed with a continuous one:
+  // z ~ Categorical([0.5, 0.3, 0.2])
+  // mu ~ Normal(0, 1)
+  // x ~ Normal(mu + 2 z, 1) observed 4.0
+  // Marginally x | z ~ Normal(2 z, sqrt(2)), which gives the posterior of z.
+  Graph g;
+  Eigen::MatrixXd z_probs(3, 1);
+  z_probs << 0.5, 0.3, 0.2;
+  uint simplex = g.add_constant_col_simplex_matrix(z_probs);
+  uint z_dist = g.add_distribution(
+      DistributionType::CATEGORICAL,
+      AtomicType::NATURAL,
+      std::vector<uint>({simplex}));
+  uint z = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({z_dist}));
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint mu_dist = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({zero, one}));
+  uint mu = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({mu_dist}));
+  uint two = g.add_constant_real(2.0);
+  uint shift = g.add_operator(
+      OperatorType::MULTIPLY,
+      std::vector<uint>(
+          {two, g.add_operator(OperatorType::TO_REAL, std::vector<uint>({z}))}));
+  uint mean = g.add_operator(OperatorType::ADD, std::vector<uint>({mu, shift}));
+  uint x_dist = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({mean, one}));
+  uint x = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({x_dist}));
+  g.observe(x, 4.0);
+  g.query(z);
+  g.query(mu);
+
+  double total = 0;
+  double z_mean = 0;
+  double mu_mean = 0;
+  for (uint zv = 0; zv < 3; zv++) {
+    double joint = z_probs(zv, 0) * std::exp(-std::pow(4.0 - 2 * zv, 2) / 4);
+    total += joint;
+    z_mean += zv * joint;
+    // E[mu | z, x] = (x - 2 z) / 2
+    mu_mean += (4.0 - 2 * zv) / 2 * joint;
+  }
+  z_mean /= total;
+  mu_mean /= total;
+
+  const std::vector<double>& post_means =
+      g.infer_mean(10000, InferenceType::NMC, 31);
+  EXPECT_NEAR(post_means[0], z_mean, 0.05);
+  EXPECT_NEAR(post_means[1], mu_mean, 0.1);
+}
+
+TEST(testnmc, DISABLED_many_children_benchmark) {
+  // Gamma latents, each with many observed Beta, Gamma or StudentT children;
+  // every NMC step on a latent evaluates the log prob of all of its children.
+  const uint num_children = 2000;
+  const uint num_samples = 200;
+  Graph g;
+  uint one = g.add_constant_pos_real(1.0);
+  uint zero = g.add_constant_real(0.0);
+  auto latent = [&]() {
+    uint dist = g.add_distribution(
+        DistributionType::GAMMA,
+        AtomicType::POS_REAL,
+        std::vector<uint>({one, one}));
+    uint sample =
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>({dist}));
+    g.query(sample);
+    return sample;
+  };
+  uint a = latent(), b = latent(), shape = latent(), rate = latent();
+  uint nu = latent(), scale = latent();
+  uint beta = g.add_distribution(
+      DistributionType::BETA,
+      AtomicType::PROBABILITY,
+      std::vector<uint>({a, b}));
+  uint gamma = g.add_distribution(
+      DistributionType::GAMMA,
+      AtomicType::POS_REAL,
+      std::vector<uint>({shape, rate}));
+  uint student_t = g.add_distribution(
+      DistributionType::STUDENT_T,
+      AtomicType::REAL,
+      std::vector<uint>({nu, zero, scale}));
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<double> unif(0.05, 0.95);
+  for (uint i = 0; i < num_children; i++) {
+    double u = unif(gen);
+    g.observe(
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>({beta})), u);
+    g.observe(
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>({gamma})),
+        1.0 + 4.0 * u);
+    g.observe(
+        g.add_operator(OperatorType::SAMPLE, std::vector<uint>({student_t})),
+        4.0 * (u - 0.5));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  g.infer(num_samples, InferenceType::NMC, 23);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << num_samples / elapsed.count() << " samples/s, "
+            << num_samples * 6 * num_children / elapsed.count() / 1e6
+            << " M children/s" << std::endl;
+}
@@ -6,6 +6,7 @@
  */
 
 #include <array>
+#include <cmath>
 
 #include <gtest/gtest.h>
 
@@ -34,3 +35,55 @@ TEST(testrejection, beta_bernoulli) {
   // TODO: Insert closed form formula here. -- Mootaz Elnozahy
   EXPECT_NEAR(means[0], 0.4, 1e-2);
 }
+
+TEST(testrejection, batched_threads) {
+  // a ~ Bernoulli(0.3)
+  // c ~ Bernoulli(a ? 0.9 : 0.2), observed true
+  // so that P(a | c) = 0.27 / (0.27 + 0.14)
+  // d ~ Normal(0, 1) is neither observed nor an ancestor of a query
+  Graph g;
+  uint p = g.add_constant_probability(0.3);
+  uint a_dist = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p}));
+  uint a = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({a_dist}));
+  uint p_true = g.add_constant_probability(0.9);
+  uint p_false = g.add_constant_probability(0.2);
+  uint p_c = g.add_operator(
+      OperatorType::IF_THEN_ELSE, std::vector<uint>({a, p_true, p_false}));
+  uint c_dist = g.add_distribution(
+      DistributionType::BERNOULLI, AtomicType::BOOLEAN, std::vector<uint>({p_c}));
+  uint c = g.add_operator(OperatorType::SAMPLE, std::vector<uint>({c_dist}));
+  uint zero = g.add_constant_real(0.0);
+  uint one = g.add_constant_pos_real(1.0);
+  uint d_dist = g.add_distribution(
+      DistributionType::NORMAL,
+      AtomicType::REAL,
+      std::vector<uint>({zero, one}));
+  g.add_operator(OperatorType::SAMPLE, std::vector<uint>({d_dist}));
+  g.observe(c, true);
+  g.query(a);
+  double expected = 0.27 / 0.41;
+
+  auto& means = g.infer_mean(20000, InferenceType::REJECTION, 2718);
+  EXPECT_NEAR(means[0], expected, 0.015);
+
+  InferConfig config;
+  config.num_threads = 4;
+  auto& threaded_means =
+      g.infer_mean(20000, InferenceType::REJECTION, 2718, 1, config);
+  EXPECT_NEAR(threaded_means[0][0], expected, 0.015);
+
+  // samples only depend on the seed and the number of threads
+  config.keep_log_prob = true;
+  auto samples = g.infer(100, InferenceType::REJECTION, 99, 1, config)[0];
+  auto log_probs = g.get_log_prob()[0];
+  ASSERT_EQ(samples.size(), 100);
+  ASSERT_EQ(log_probs.size(), 100);
+  auto& samples2 = g.infer(100, InferenceType::REJECTION, 99, 1, config)[0];
+  for (uint i = 0; i < 100; i++) {
+    EXPECT_EQ(samples[i][0], samples2[i][0]);
+    // d is not in the support, so the log prob is that of a and c
+    EXPECT_NEAR(
+        log_probs[i], std::log(samples[i][0]._bool ? 0.27 : 0.14), 1e-9);
+  }
+}
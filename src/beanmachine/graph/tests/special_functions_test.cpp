@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <boost/math/special_functions/digamma.hpp>
+#include <boost/math/special_functions/erf.hpp>
+#include <boost/math/special_functions/trigamma.hpp>
+
+#include "beanmachine/graph/special_functions.h"
+#include "beanmachine/graph/util.h"
+
+using namespace beanmachine;
+
+namespace {
+
+const double kInf = std::numeric_limits<double>::infinity();
+const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+using Scalar = double (*)(double);
+using Batched = void (*)(const double*, std::size_t, double*);
+using Reference = std::function<long double(long double)>;
+
+struct Case {
+  std::string name;
+  Scalar scalar;
+  Batched batched;
+  Reference reference;
+};
+
+#define SPECIAL_CASE(f, reference)                                 \
+  Case {                                                           \
+    #f, static_cast<Scalar>(&special::f),                          \
+        static_cast<Batched>(&special::f), reference               \
+  }
+
+Case get_case(const std::string& name) {
+  std::vector<Case> cases = {
+      SPECIAL_CASE(exp, [](long double x) { return std::exp(x); }),
+      SPECIAL_CASE(log, [](long double x) { return std::log(x); }),
+      SPECIAL_CASE(log1p, [](long double x) { return std::log1p(x); }),
+      SPECIAL_CASE(
+          log1pexp, [](long double x) { return std::log1p(std::exp(x)); }),
+      SPECIAL_CASE(
+          log1mexp,
+          [](long double x) {
+            return x < -M_LN2 ? std::log1p(-std::exp(x))
+                              : std::log(-std::expm1(x));
+          }),
+      SPECIAL_CASE(lgamma, [](long double x) { return std::lgamma(x); }),
+      SPECIAL_CASE(
+          digamma, [](long double x) { return boost::math::digamma(x); }),
+      SPECIAL_CASE(
+          trigamma, [](long double x) { return boost::math::trigamma(x); }),
+      SPECIAL_CASE(
+          Phi,
+          [](long double x) {
+            return boost::math::erfc(-x / std::sqrt(2.0L)) / 2;
+          }),
+  };
+  for (const Case& c : cases) {
+    if (c.name == name) {
+      return c;
+    }
+  }
+  throw std::invalid_argument(name);
+}
+
+// The spacing of doubles at x
+double ulp(long double x) {
+  double d = std::abs(static_cast<double>(x));
+  return std::nextafter(d, kInf) - d;
+}
+
+// Checks f, in its scalar and batched forms, against its reference on points
+// spread over [lo, hi] (evenly, or evenly in log scale if log_scale), in ulps,
+// or relative to max(1, |f(x)|) if max_relative > 0.
+void check(
+    const std::string& name,
+    double lo,
+    double hi,
+    bool log_scale,
+    double max_ulps,
+    double max_relative = 0) {
+  const Case c = get_case(name);
+  const std::size_t n = 100003;
+  std::mt19937 gen(101);
+  std::uniform_real_distribution<double> unif(0, 1);
+  std::vector<double> x(n), batched(n);
+  for (std::size_t i = 0; i < n; i++) {
+    double t = unif(gen);
+    x[i] = log_scale
+        ? std::exp(std::log(lo) + t * (std::log(hi) - std::log(lo)))
+        : lo + t * (hi - lo);
+  }
+  c.batched(x.data(), n, batched.data());
+  for (std::size_t i = 0; i < n; i++) {
+    long double expected = c.reference(x[i]);
+    long double tolerance = max_relative > 0
+        ? max_relative * std::max(1.0L, std::abs(expected))
+        : max_ulps * ulp(expected);
+    // the batched loop may be compiled for other instructions, so it need
+    // not give the same result, only an as accurate one
+    for (double actual : {c.scalar(x[i]), batched[i]}) {
+      EXPECT_LE(std::abs(actual - expected), tolerance)
+          << name << "(" << x[i] << ")";
+    }
+  }
+}
+
+} // namespace
+
+TEST(testspecial, exp_log) {
+  check("exp", -745, 709, false, 1);
+  check("exp", -1, 1, false, 1);
+  check("log", 1e-310, 1e300, true, 1);
+  check("log", 0.5, 2, false, 1);
+  check("log1p", 1e-20, 1e10, true, 3);
+  check("log1p", -0.999, 1, false, 3);
+
+  EXPECT_EQ(special::exp(0.0), 1.0);
+  EXPECT_EQ(special::exp(-kInf), 0.0);
+  EXPECT_EQ(special::exp(710.0), kInf);
+  EXPECT_EQ(special::exp(-746.0), 0.0);
+  EXPECT_EQ(special::exp(-745.0), std::exp(-745.0));
+  EXPECT_TRUE(std::isnan(special::exp(kNaN)));
+  EXPECT_EQ(special::log(1.0), 0.0);
+  EXPECT_EQ(special::log(0.0), -kInf);
+  EXPECT_EQ(special::log(kInf), kInf);
+  EXPECT_TRUE(std::isnan(special::log(-1.0)));
+  EXPECT_TRUE(std::isnan(special::log(kNaN)));
+  EXPECT_NEAR(
+      special::log(std::numeric_limits<double>::denorm_min()),
+      -744.44007,
+      1e-5);
+  EXPECT_EQ(special::log1p(0.0), 0.0);
+  EXPECT_EQ(special::log1p(-1.0), -kInf);
+  EXPECT_EQ(special::log1p(1e-300), 1e-300);
+}
+
+TEST(testspecial, log1pexp_log1mexp) {
+  check("log1pexp", -745, 700, false, 3);
+  check("log1pexp", -5, 5, false, 3);
+  check("log1mexp", -700, -1e-15, false, 3);
+  check("log1mexp", -5, -1e-300, false, 3);
+
+  EXPECT_EQ(special::log1pexp(-kInf), 0.0);
+  EXPECT_EQ(special::log1pexp(kInf), kInf);
+  EXPECT_EQ(special::log1pexp(1000.0), 1000.0);
+  EXPECT_TRUE(std::isnan(special::log1pexp(kNaN)));
+  EXPECT_EQ(special::log1mexp(0.0), -kInf);
+  EXPECT_EQ(special::log1mexp(-kInf), 0.0);
+  EXPECT_TRUE(std::isnan(special::log1mexp(1.0)));
+  EXPECT_TRUE(std::isnan(special::log1mexp(kNaN)));
+}
+
+TEST(testspecial, gamma_functions) {
+  check("lgamma", 1e-300, 8, true, 3);
+  check("lgamma", 0.01, 8, false, 3);
+  check("lgamma", 8, 1e300, true, 3);
+  check("lgamma", -100, -0.01, false, 0, 4e-15);
+  check("digamma", 1e-300, 10, true, 5);
+  check("digamma", 0.01, 10, false, 5);
+  check("digamma", 10, 1e300, true, 5);
+  check("digamma", -100, -0.01, false, 0, 4e-15);
+  check("trigamma", 1e-150, 1e150, true, 5);
+  check("trigamma", 0.01, 20, false, 5);
+  check("trigamma", -100, -0.01, false, 0, 4e-15);
+
+  // the zeros are exact
+  EXPECT_EQ(special::lgamma(1.0), 0.0);
+  EXPECT_EQ(special::lgamma(2.0), 0.0);
+  EXPECT_NEAR(special::digamma(1.0), -0.57721566490153286, 1e-16);
+  EXPECT_NEAR(special::trigamma(1.0), M_PI * M_PI / 6, 1e-15);
+  // poles
+  for (double x : {0.0, -1.0, -2.0, -1e20}) {
+    EXPECT_EQ(special::lgamma(x), kInf) << x;
+    EXPECT_EQ(special::trigamma(x), kInf) << x;
+    EXPECT_TRUE(std::isnan(special::digamma(x))) << x;
+  }
+  EXPECT_EQ(special::lgamma(kInf), kInf);
+  EXPECT_EQ(special::lgamma(-kInf), kInf);
+  EXPECT_EQ(special::digamma(kInf), kInf);
+  EXPECT_EQ(special::trigamma(kInf), 0.0);
+  EXPECT_TRUE(std::isnan(special::lgamma(kNaN)));
+  EXPECT_TRUE(std::isnan(special::digamma(kNaN)));
+  EXPECT_TRUE(std::isnan(special::trigamma(kNaN)));
+  // against the scalar version used so far
+  for (double x : {0.1, 0.5, 1.5, 3.7, 12.0, 250.0}) {
+    EXPECT_NEAR(special::digamma(x), util::polygamma(0, x), 1e-14) << x;
+    EXPECT_NEAR(special::trigamma(x), util::polygamma(1, x), 1e-13) << x;
+  }
+}
+
+TEST(testspecial, Phi) {
+  check("Phi", -5, 40, false, 6);
+  check("Phi", -37.5, -5, false, 6);
+  check("Phi", -1, 1, false, 6);
+
+  EXPECT_EQ(special::Phi(0.0), 0.5);
+  EXPECT_EQ(special::Phi(-kInf), 0.0);
+  EXPECT_EQ(special::Phi(kInf), 1.0);
+  EXPECT_EQ(special::Phi(-40.0), 0.0);
+  EXPECT_TRUE(std::isnan(special::Phi(kNaN)));
+}
+
+TEST(testspecial, log_sum_exp) {
+  std::mt19937 gen(7);
+  std::normal_distribution<double> normal(0, 10);
+  // sizes with and without a partial block of lanes
+  for (std::size_t n : {1, 5, 8, 37}) {
+    std::vector<double> x(n);
+    for (std::size_t i = 0; i < n; i++) {
+      x[i] = normal(gen);
+    }
+    long double max = *std::max_element(x.begin(), x.end());
+    long double sum = 0;
+    for (double v : x) {
+      sum += std::exp(v - max);
+    }
+    double expected = static_cast<double>(std::log(sum) + max);
+    EXPECT_NEAR(special::log_sum_exp(x.data(), n), expected, 1e-14);
+    EXPECT_NEAR(util::log_sum_exp(x), expected, 1e-14);
+  }
+  EXPECT_NEAR(util::log_sum_exp(1.0, 2.0), std::log(M_E + M_E * M_E), 1e-15);
+  EXPECT_EQ(util::log_sum_exp(-kInf, 3.0), 3.0);
+  std::vector<double> minus_infs = {-kInf, -kInf};
+  EXPECT_EQ(special::log_sum_exp(minus_infs.data(), 2), -kInf);
+  EXPECT_EQ(special::log_sum_exp(nullptr, 0), -kInf);
+  std::vector<double> with_nan = {1.0, kNaN, 2.0};
+  EXPECT_TRUE(std::isnan(special::log_sum_exp(with_nan.data(), 3)));
+}
+
+TEST(testspecial, DISABLED_special_functions_benchmark) {
+  const std::size_t n = 1 << 20;
+  const int repetitions = 20;
+  auto time = [&](const std::function<void()>& run) {
+    run();
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      run();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return n * repetitions / elapsed.count() / 1e6;
+  };
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<double> unif(0.1, 20.0);
+  std::vector<double> x(n), out(n);
+  for (std::size_t i = 0; i < n; i++) {
+    x[i] = unif(gen);
+  }
+  // the scalar functions used before, on the same inputs
+  std::vector<std::pair<std::string, Scalar>> baselines = {
+      {"exp", [](double v) { return std::exp(-v); }},
+      {"log", [](double v) { return std::log(v); }},
+      {"log1p", [](double v) { return std::log1p(v); }},
+      {"log1pexp", [](double v) { return util::log1pexp(v - 10); }},
+      {"log1mexp",
+       [](double v) {
+         return v > 0.693 ? std::log1p(-std::exp(-v))
+                          : std::log(-std::expm1(-v));
+       }},
+      {"lgamma", [](double v) { return std::lgamma(v); }},
+      {"digamma", [](double v) { return util::polygamma(0, v); }},
+      {"trigamma", [](double v) { return util::polygamma(1, v); }},
+      {"Phi", [](double v) { return 0.5 * std::erfc(-(v - 10) * M_SQRT1_2); }},
+  };
+  for (const auto& [name, baseline] : baselines) {
+    Case c = get_case(name);
+    // shift the inputs into the domain of each function
+    std::vector<double> y = x;
+    for (double& v : y) {
+      if (name == "exp" or name == "log1mexp") {
+        v = -v;
+      } else if (name == "log1pexp" or name == "Phi") {
+        v -= 10;
+      }
+    }
+    double batched_rate = time([&]() { c.batched(y.data(), n, out.data()); });
+    double scalar_rate = time([&]() {
+      for (std::size_t i = 0; i < n; i++) {
+        out[i] = c.scalar(y[i]);
+      }
+    });
+    double baseline_rate = time([&]() {
+      for (std::size_t i = 0; i < n; i++) {
+        out[i] = baseline(x[i]);
+      }
+    });
+    std::cout << name << ": batched " << batched_rate << ", scalar "
+              << scalar_rate << ", before " << baseline_rate
+              << " M elements/s\n";
+  }
+  double lse_rate =
+      time([&]() { out[0] = special::log_sum_exp(x.data(), n); });
+  std::vector<double> values = x;
+  double lse_baseline_rate = time([&]() {
+    double max = *std::max_element(values.begin(), values.end());
+    double sum = 0;
+    for (double v : values) {
+      sum += std::exp(v - max);
+    }
+    out[0] = std::log(sum) + max;
+  });
+  std::cout << "log_sum_exp: " << lse_rate << ", before " << lse_baseline_rate
+            << " M elements/s\n";
+}
@@ -15,6 +15,7 @@
 #include <iostream>
 #include "beanmachine/graph/distribution/distribution.h"
 #include "beanmachine/graph/graph.h"
+#include "beanmachine/graph/special_functions.h"
 #include "beanmachine/graph/util.h"
 
 namespace beanmachine {
@@ -70,7 +71,7 @@ double logistic(double logodds) {
 }
 
 double Phi(double x) {
-  return 0.5 * (1 + std::erf(x / M_SQRT2));
+  return special::Phi(x);
 }
 
 double Phi_approx(double x) {
@@ -82,21 +83,15 @@ double Phi_approx_inv(double z) {
 }
 
 double log_sum_exp(const std::vector<double>& values) {
-  // See "log-sum-exp trick for log-domain calculations" in
-  // https://en.wikipedia.org/wiki/LogSumExp
   assert(values.size() != 0);
-  double max = *std::max_element(values.begin(), values.end());
-  double sum = 0;
-  for (auto value : values) {
-    sum += std::exp(value - max);
-  }
-  return std::log(sum) + max;
+  return special::log_sum_exp(values.data(), values.size());
 }
 
 double log_sum_exp(double a, double b) {
+  // log(e^a + e^b) = max + log(1 + e^(min - max))
   double max_val = a > b ? a : b;
-  double sum = std::exp(a - max_val) + std::exp(b - max_val);
-  return std::log(sum) + max_val;
+  double min_val = a > b ? b : a;
+  return max_val + special::log1pexp(min_val - max_val);
 }
 
 std::vector<double> probs_given_log_potentials(std::vector<double> log_pot) {
@@ -119,35 +114,24 @@ double polygamma(int n, double x) {
 }
 
 double log1pexp(double x) {
-  if (x <= -37) {
-    return std::exp(x);
-  } else if (x <= 18) {
-    return std::log1p(std::exp(x));
-  } else if (x <= 33.3) {
-    return x + std::exp(-x);
-  } else {
-    return x;
-  }
+  return special::log1pexp(x);
 }
 
 Eigen::MatrixXd log1pexp(const Eigen::MatrixXd& x) {
-  return x.unaryExpr([](double x) { return log1pexp(x); });
+  Eigen::MatrixXd result(x.rows(), x.cols());
+  special::log1pexp(x.data(), x.size(), result.data());
+  return result;
 }
 
 double log1mexp(double x) {
-  if (std::isnan(x)) {
-    return x;
-  }
-  assert(x <= 0);
-  if (x < -0.693) {
-    return std::log1p(-std::exp(x));
-  } else {
-    return std::log(-std::expm1(x));
-  }
+  assert(std::isnan(x) or x <= 0);
+  return special::log1mexp(x);
 }
 
 Eigen::MatrixXd log1mexp(const Eigen::MatrixXd& x) {
-  return x.unaryExpr([](double x) { return log1mexp(x); });
+  Eigen::MatrixXd result(x.rows(), x.cols());
+  special::log1mexp(x.data(), x.size(), result.data());
+  return result;
 }
 
 } // namespace util